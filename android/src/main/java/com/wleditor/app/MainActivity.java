@@ -1,9 +1,35 @@
 package com.wleditor.app;
 
 import android.app.Activity;
+import android.net.Uri;
 import android.os.Bundle;
+import android.os.ParcelFileDescriptor;
+import java.io.IOException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 public class MainActivity extends Activity {
+    // Size of the shared buffer that receives edit deltas from native code
+    private static final int DELTA_BUFFER_BYTES = 64 * 1024;
+    // Delta record layout: int offset, int removed, int inserted, int flags
+    private static final int DELTA_HEADER_BYTES = 16;
+    private static final int DELTA_INLINE_TEXT = 1;
+
+    // Offset units accepted by convertOffset()
+    public static final int OFFSET_UTF16 = 0;
+    public static final int OFFSET_CODE_POINTS = 1;
+    public static final int OFFSET_UTF8 = 2;
+    public static final int OFFSET_LINES = 3;  // line number / start of line
+
+    private final ByteBuffer deltaBuffer =
+            ByteBuffer.allocateDirect(DELTA_BUFFER_BYTES).order(ByteOrder.nativeOrder());
+
+    /** Receives the changes made by a native edit call. */
+    public interface DeltaListener {
+        void onTextChanged(int offset, int removed, CharSequence inserted);
+        void onTextReset();
+    }
+
     @Override
     protected void onCreate(Bundle savedInstanceState) {
         super.onCreate(savedInstanceState);
@@ -13,11 +39,97 @@ public class MainActivity extends Activity {
         
         // Initialize native application
         nativeInit();
+        attachDeltaBuffer(deltaBuffer);
+        setCacheDir(getCacheDir().getAbsolutePath());
+    }
+
+    @Override
+    public void onTrimMemory(int level) {
+        super.onTrimMemory(level);
+        // Always drops the offset index. RUNNING_LOW, BACKGROUND and MODERATE also
+        // compact the buffer; RUNNING_CRITICAL and COMPLETE spill undo history to
+        // the cache dir on a background thread. UI_HIDDEN only drops the index
+        nativeTrimMemory(level);
+    }
+
+    /**
+     * Loads a document into the native core. Returns the length in UTF-16
+     * units, or -1 if the file could not be read.
+     */
+    public int openDocument(Uri uri) throws IOException {
+        try (ParcelFileDescriptor pfd = getContentResolver().openFileDescriptor(uri, "r")) {
+            return pfd == null ? -1 : loadFile(pfd.getFd());
+        }
+    }
+
+    /** Writes the native document back to uri; returns false on failure. */
+    public boolean saveDocument(Uri uri) throws IOException {
+        try (ParcelFileDescriptor pfd = getContentResolver().openFileDescriptor(uri, "rw")) {
+            return pfd != null && saveFile(pfd.getFd());
+        }
+    }
+
+    /**
+     * Decodes the deltas written by the last edit call. The argument is the
+     * value that call returned: the number of bytes written, or -1 if the
+     * deltas did not fit and the whole text must be read again.
+     */
+    public void dispatchDeltas(int bytes, DeltaListener listener) {
+        if (bytes < 0) {
+            listener.onTextReset();
+            return;
+        }
+        int position = 0;
+        while (position + DELTA_HEADER_BYTES <= bytes) {
+            int offset = deltaBuffer.getInt(position);
+            int removed = deltaBuffer.getInt(position + 4);
+            int inserted = deltaBuffer.getInt(position + 8);
+            int flags = deltaBuffer.getInt(position + 12);
+            position += DELTA_HEADER_BYTES;
+
+            CharSequence text;
+            if ((flags & DELTA_INLINE_TEXT) != 0) {
+                char[] chars = new char[inserted];
+                for (int i = 0; i < inserted; i++) {
+                    chars[i] = deltaBuffer.getChar(position + i * 2);
+                }
+                text = new String(chars);
+                position += (inserted * 2 + 3) & ~3;
+            } else {
+                // Too large to inline: read just the inserted range. Native code
+                // only leaves the text out of the last record of a call, so the
+                // range is still in place in the post-call text
+                text = getTextRange(offset, inserted);
+            }
+            listener.onTextChanged(offset, removed, text);
+        }
     }
     
     // Native method declarations
+    // Offsets and lengths are in UTF-16 units, like Java string indices.
+    // Edit calls return the byte count of the deltas written to the delta buffer.
     public static native void nativeInit();
-    public static native void insertText(String text);
+    public static native void attachDeltaBuffer(ByteBuffer buffer);
+    public static native int insertText(String text);
+    public static native int deleteChar();     // previous grapheme cluster
+    public static native int deleteForward();  // next grapheme cluster
+    public static native int replaceText(int offset, int length, String text);
+    public static native int setText(String text);
+    // File I/O through a descriptor from ContentResolver.openFileDescriptor(uri, "rw").
+    // The text is memory-mapped and decoded in native code without passing through
+    // the Java heap. The descriptor stays owned by the caller; no deltas are written.
+    public static native int loadFile(int fd);        // UTF-16 length, or -1
+    public static native boolean saveFile(int fd);    // writes UTF-8 and truncates
+    public static native int undo();
+    public static native int redo();
+    public static native void setCacheDir(String path);
+    public static native long nativeTrimMemory(int level);  // bytes freed
+    public static native void setCursor(int position);
+    public static native int getCursor();
+    public static native int moveCursor(int graphemes);
+    public static native int convertOffset(int offset, int from, int to);
+    public static native int getLength();
+    public static native String getTextRange(int offset, int length);
+    public static native int readRange(int offset, int length, ByteBuffer target);
     public static native String getText();
-    public static native void deleteChar();
-}
\ No newline at end of file
+}
@@ -0,0 +1,109 @@
+// 編集コア（wlcore）のマイクロベンチマーク（Qt 不要）
+// 大きな文書での1キーの編集・位置変換・行頭の検索・行単位の検索の時間を表示する
+//   core_bench [文書の文字数]
+#include "GapBuffer.h"
+#include "TextMatch.h"
+#include "TextOffsetIndex.h"
+#include "UndoHistory.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+double nanosecondsPer(Clock::time_point start, size_t count)
+{
+    const double elapsed = double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    return elapsed / double(count ? count : 1);
+}
+
+size_t sink = 0;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t length = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 32u << 20;
+
+    // 日本語と英数字が混ざった、80文字前後で改行する文書
+    std::u16string text;
+    text.reserve(length);
+    const std::u16string words[] = {u"editor ", u"編集 ", u"テキスト ", u"buffer ", u"検索 ", u"😀 "};
+    std::mt19937 random(1);
+    size_t column = 0;
+    while (text.size() < length) {
+        const std::u16string &word = words[random() % 6];
+        text += word;
+        column += word.size();
+        if (column > 80) {
+            text += u'\n';
+            column = 0;
+        }
+    }
+
+    GapBuffer buffer;
+    TextOffsetIndex index;
+    UndoHistory history;
+    Clock::time_point start = Clock::now();
+    buffer.assign(text);
+    index.reset(buffer);
+    std::printf("document: %zu units, %zu lines\n", buffer.size(), index.total().lines);
+    std::printf("load+index: %.1f ms\n", nanosecondsPer(start, 1) / 1e6);
+
+    // 文書の中ほどで1文字ずつ入力（バッファ・索引・取り消し履歴を更新）
+    const size_t keys = 200000;
+    size_t position = buffer.size() / 2;
+    start = Clock::now();
+    for (size_t i = 0; i < keys; ++i) {
+        const char16_t key[1] = {char16_t(u'a' + i % 26)};
+        const std::u16string_view inserted(key, 1);
+        index.remove(buffer, position, 0);
+        buffer.replace(position, 0, inserted);
+        index.insert(buffer, position, 1);
+        history.record(int64_t(position), std::u16string_view(), inserted, UndoHistory::Typing, int64_t(i));
+        ++position;
+    }
+    std::printf("typing: %.1f ns/key\n", nanosecondsPer(start, keys));
+
+    // 位置の変換（IME の変換中に毎回呼ぶ想定）
+    const size_t lookups = 1000000;
+    start = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        const size_t offset = random() % buffer.size();
+        sink += index.convert(buffer, offset, TextOffsetIndex::Utf16, TextOffsetIndex::Utf8);
+    }
+    std::printf("utf16->utf8: %.1f ns/lookup\n", nanosecondsPer(start, lookups));
+
+    start = Clock::now();
+    const size_t lines = index.total().lines;
+    for (size_t i = 0; i < lookups; ++i) {
+        sink += index.convert(buffer, random() % (lines + 1), TextOffsetIndex::Lines, TextOffsetIndex::Utf16);
+    }
+    std::printf("line->offset: %.1f ns/lookup\n", nanosecondsPer(start, lookups));
+
+    // 行単位の検索（大文字小文字を区別しない・単語単位）
+    TextMatch::Options options;
+    options.wholeWords = true;
+    const std::u16string all = buffer.text(0, buffer.size());
+    size_t matches = 0;
+    start = Clock::now();
+    for (size_t lineStart = 0; lineStart < all.size();) {
+        size_t lineEnd = all.find(u'\n', lineStart);
+        if (lineEnd == std::u16string::npos) lineEnd = all.size();
+        const std::u16string_view line(all.data() + lineStart, lineEnd - lineStart);
+        for (size_t hit = TextMatch::indexIn<TextMatch::PortableTraits>(line, u"BUFFER", 0, options);
+             hit != TextMatch::NoMatch;
+             hit = TextMatch::indexIn<TextMatch::PortableTraits>(line, u"BUFFER", hit + 1, options)) {
+            ++matches;
+        }
+        lineStart = lineEnd + 1;
+    }
+    const double seconds = nanosecondsPer(start, 1) / 1e9;
+    std::printf("search: %zu matches, %.1f MB/s\n", matches, double(all.size() * 2) / 1e6 / seconds);
+
+    std::printf("index memory: %zu KB, undo memory: %zu KB\n", index.memoryBytes() / 1024,
+                history.memoryUsage() / 1024);
+    return sink == 0 ? 1 : 0;
+}
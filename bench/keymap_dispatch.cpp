@@ -0,0 +1,75 @@
+// キー割り当て表（Keymap）のディスパッチ性能を測るマイクロベンチマーク
+// WordStar 既定相当の表を作り、1キーあたりの解決時間（ナノ秒）を表示する
+//   keymap_dispatch_bench [キー数]
+#include "../src/Keymap.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+#include <vector>
+
+namespace {
+quint64 executed = 0;
+void countCommand(CustomTextEdit &) { ++executed; }
+
+const Keymap::CommandInfo Commands[] = {
+    {"count", countCommand},
+};
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const QStringList args = app.arguments();
+    const qint64 keyCount = args.size() > 1 ? args.at(1).toLongLong() : 10000000;
+
+    Keymap keymap;
+    keymap.setCommands(Commands, 1);
+    const char singles[] = "ESDXAFRCGHTYL";
+    for (const char *c = singles; *c; ++c) {
+        keymap.bind(QString("Ctrl+%1").arg(QLatin1Char(*c)), "count");
+    }
+    const char seconds[] = "FARCSDEXBKYCNFVWR0123456789";
+    for (const char *c = seconds; *c; ++c) {
+        keymap.bind(QString("Ctrl+Q, %1").arg(QLatin1Char(*c)), "count");
+        keymap.bind(QString("Ctrl+K, %1").arg(QLatin1Char(*c)), "count");
+    }
+
+    // 通常の文字入力（割り当てなし）、Ctrl+キー、2キーの並びを混ぜた入力列
+    std::vector<QKeyCombination> input;
+    const QKeyCombination pattern[] = {
+        QKeyCombination(Qt::NoModifier, Qt::Key_A),
+        QKeyCombination(Qt::NoModifier, Qt::Key_B),
+        QKeyCombination(Qt::ControlModifier, Qt::Key_E),
+        QKeyCombination(Qt::ControlModifier, Qt::Key_Q),
+        QKeyCombination(Qt::NoModifier, Qt::Key_S),
+        QKeyCombination(Qt::ControlModifier, Qt::Key_K),
+        QKeyCombination(Qt::ControlModifier, Qt::Key_B),
+        QKeyCombination(Qt::ControlModifier, Qt::Key_Q),
+        QKeyCombination(Qt::NoModifier, Qt::Key_5),
+        QKeyCombination(Qt::ShiftModifier, Qt::Key_C),
+    };
+    for (const QKeyCombination &key : pattern) {
+        input.push_back(key);
+    }
+
+    int state = 0;
+    quint64 matched = 0;
+    QElapsedTimer timer;
+    timer.start();
+    for (qint64 i = 0; i < keyCount; ++i) {
+        Keymap::Command command = nullptr;
+        if (keymap.feed(state, input[size_t(i % qint64(input.size()))], command) == Keymap::Complete) {
+            ++matched;
+            // 実際のコマンドは呼ばず、解決した関数ポインタだけを使う（エディタなしで測るため）
+            executed += command == countCommand;
+        }
+    }
+    const qint64 elapsed = timer.nsecsElapsed();
+
+    QTextStream out(stdout);
+    out << "keys: " << keyCount << "\n"
+        << "commands: " << matched << "\n"
+        << "ns/key: " << double(elapsed) / double(qMax<qint64>(1, keyCount)) << "\n";
+    return executed == matched ? 0 : 1;
+}
@@ -0,0 +1,701 @@
+// エディタ全体のベンチマーク（offscreen QPA で MainWindow / CustomTextEdit を実際に動かす）
+// 生成したコーパスごとに、開く・1画面ずつ末尾まで送る・1万文字入力・Ctrl+Y の行削除・
+// ブロックのコピー／カット・保存・設定の読み込みを測り、経過時間・ピーク RSS・確保回数を JSON で出す
+//   wledit_bench [--sizes 1,8] [--output result.json] [--baseline old.json [--tolerance 10]]
+// --sizes はコーパスの大きさ（MB）。--baseline を渡すと、経過時間か確保回数が tolerance（%）を
+// 超えて増えた項目を標準エラーに出して 1 で終わる（リリース前の比較用）
+//   wledit_bench --replay session.wlkeys [--document file] [--original-timing] [--output ...] [--baseline ...]
+// --replay は wledit --record-keys（またはマクロの保存）で記録したキー操作を、--document（省略時は
+// 1MB のコーパス）を開いたエディタへ送り直し、キーごとの処理時間と描画時間の分位数を出す
+// 既定は全速で送る。--original-timing なら記録時の間隔を空ける（その間にタイマーなども動く）
+#include "../src/MainWindow.h"
+#include "../src/TaskScheduler.h"
+#include "../src/KeyMacro.h"
+#include "../src/ClipboardRing.h"
+#include <QApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextBlock>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <random>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// 確保回数の計測。glibc では malloc を差し替えて Qt の確保（QString など）も数える
+namespace {
+std::atomic<quint64> allocationCount{0};
+std::atomic<quint64> allocatedBytes{0};
+
+inline void countAllocation(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+}
+}
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) noexcept
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept
+{
+    countAllocation(size);
+    return __libc_realloc(pointer, size);
+}
+}
+#else
+void *operator new(size_t size)
+{
+    countAllocation(size);
+    if (void *pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+#endif
+
+namespace {
+const int KeystrokeCount = 10000;
+const int DeletedLines = 1000;
+const int BlockLines = 1000;
+const int BlockRepeats = 10;
+const int SettingsLoads = 100;
+const qint64 WaitTimeoutMs = 120000;
+
+qint64 peakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+qint64 currentRssKb()
+{
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QIODevice::ReadOnly)) return 0;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return fields.size() > 1 ? fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE) / 1024 : 0;
+}
+
+// 1項目の計測（開始から finish までの差分）
+class Measurement
+{
+public:
+    explicit Measurement(const QString &name)
+        : name(name)
+        , allocations(allocationCount.load())
+        , bytes(allocatedBytes.load())
+        , rss(currentRssKb())
+    {
+        clock.start();
+    }
+
+    QJsonObject finish(int iterations)
+    {
+        const double wallMs = clock.nsecsElapsed() / 1e6;
+        QJsonObject result;
+        result["name"] = name;
+        result["iterations"] = iterations;
+        result["wall_ms"] = wallMs;
+        result["allocations"] = double(allocationCount.load() - allocations);
+        result["allocated_bytes"] = double(allocatedBytes.load() - bytes);
+        result["rss_delta_kb"] = double(currentRssKb() - rss);
+        result["peak_rss_kb"] = double(peakRssKb());
+        std::fprintf(stderr, "  %-14s %10.1f ms  %10.0f allocs\n", qPrintable(name), wallMs,
+                     result["allocations"].toDouble());
+        return result;
+    }
+
+private:
+    QString name;
+    quint64 allocations;
+    quint64 bytes;
+    qint64 rss;
+    QElapsedTimer clock;
+};
+
+// 英数字のコード風の行と日本語の文章の行を混ぜた文書（シード固定）
+QString generateCorpus(qint64 bytes)
+{
+    static const char *const Words[] = {
+        "return", "const", "value", "index", "buffer", "document", "cursor", "for", "if", "else",
+        "int", "QString", "auto", "size_t", "offset", "line", "text", "width", "count", "result"
+    };
+    static const char16_t *const Phrases[] = {
+        u"ワードスター互換のキー操作で", u"大きなファイルを編集する。", u"取り消し履歴は差分だけを持ち、",
+        u"画面に見えている行だけを描画する。", u"検索と置換は行単位で照合し、", u"保存はバックグラウンドで行う。"
+    };
+
+    std::mt19937 random(20240501);
+    QString text;
+    qint64 size = 0;
+    while (size < bytes) {
+        QString line;
+        if (random() % 3 == 0) {
+            const int count = 2 + int(random() % 4);
+            for (int i = 0; i < count; ++i) {
+                line += QString::fromUtf16(Phrases[random() % 6]);
+            }
+        } else {
+            line = QString(int(random() % 4) * 4, QLatin1Char(' '));
+            const int count = 3 + int(random() % 10);
+            for (int i = 0; i < count; ++i) {
+                line += QLatin1String(Words[random() % 20]);
+                line += i + 1 < count ? QLatin1Char(' ') : QLatin1Char(';');
+            }
+        }
+        if (random() % 10 == 0) {
+            line.clear();
+        }
+        line += QLatin1Char('\n');
+        size += line.toUtf8().size();
+        text += line;
+    }
+    return text;
+}
+
+void sendKey(QWidget *target, Qt::Key key, Qt::KeyboardModifiers modifiers = Qt::NoModifier,
+             const QString &text = QString())
+{
+    QKeyEvent press(QEvent::KeyPress, key, modifiers, text);
+    QApplication::sendEvent(target, &press);
+    QKeyEvent release(QEvent::KeyRelease, key, modifiers, text);
+    QApplication::sendEvent(target, &release);
+    // 実際の入力と同じく、キーごとに描画などの保留中のイベントを処理する
+    QApplication::processEvents();
+}
+
+// 2キーの並び（Ctrl+K, B など）
+void sendSequence(QWidget *target, Qt::Key prefix, Qt::Key key)
+{
+    sendKey(target, prefix, Qt::ControlModifier);
+    sendKey(target, key);
+}
+
+// 分位数（nearest-rank）を prefix_p50_ms などの名前で加える
+void addPercentiles(QJsonObject &result, const QString &prefix, QVector<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    const auto rank = [&samples](double quantile) {
+        if (samples.isEmpty()) return 0.0;
+        const int index = int(std::ceil(quantile * samples.size())) - 1;
+        return samples.at(qBound(0, index, int(samples.size()) - 1));
+    };
+    result[prefix + "_p50_ms"] = rank(0.50);
+    result[prefix + "_p90_ms"] = rank(0.90);
+    result[prefix + "_p99_ms"] = rank(0.99);
+    result[prefix + "_max_ms"] = samples.isEmpty() ? 0.0 : samples.last();
+}
+}
+
+// MainWindow の内部（読み込み・保存の完了待ち、設定の読み込み）を直接使う
+class EditorBench
+{
+public:
+    explicit EditorBench(MainWindow *window)
+        : window(window)
+        , editor(window->textEditor)
+    {
+    }
+
+    bool waitUntil(const std::function<bool()> &done)
+    {
+        QElapsedTimer clock;
+        clock.start();
+        while (!done()) {
+            if (clock.hasExpired(WaitTimeoutMs)) return false;
+            QApplication::processEvents(QEventLoop::AllEvents, 10);
+        }
+        return true;
+    }
+
+    bool schedulerIdle() const
+    {
+        const TaskScheduler::Statistics stats = window->scheduler->statistics();
+        return stats.busyWorkers == 0 && stats.submitted == stats.completed + stats.cancelled;
+    }
+
+    // expectedLength が負なら長さは確かめない（外から渡された文書）
+    QJsonObject open(const QString &path, int expectedLength)
+    {
+        Measurement measurement("open");
+        window->openFileFromArgs(path);
+        const bool loaded = waitUntil([&]() {
+            return window->currentFile == path && schedulerIdle()
+                && (expectedLength < 0 || editor->document()->characterCount() - 1 == expectedLength);
+        });
+        QJsonObject result = measurement.finish(1);
+        if (!loaded) result["error"] = "timed out";
+        return result;
+    }
+
+    QJsonObject pageDown()
+    {
+        editor->moveCursor(QTextCursor::Start);
+        QApplication::processEvents();
+        Measurement measurement("page-down");
+        int pages = 0;
+        int previous = -1;
+        while (editor->textCursor().position() != previous) {
+            previous = editor->textCursor().position();
+            sendKey(editor, Qt::Key_C, Qt::ControlModifier);
+            ++pages;
+        }
+        QJsonObject result = measurement.finish(pages);
+        expect(result, editor->textCursor().position() > 0, "cursor did not move");
+        return result;
+    }
+
+    QJsonObject type()
+    {
+        moveToLine(editor->document()->blockCount() / 2);
+        const int length = editor->document()->characterCount();
+        Measurement measurement("type");
+        const QString sample = QStringLiteral("The quick brown fox 素早い茶色の狐 jumps. ");
+        for (int i = 0; i < KeystrokeCount; ++i) {
+            const QChar c = sample.at(i % sample.size());
+            sendKey(editor, c == QLatin1Char(' ') ? Qt::Key_Space : Qt::Key_unknown, Qt::NoModifier, QString(c));
+        }
+        QJsonObject result = measurement.finish(KeystrokeCount);
+        expect(result, editor->document()->characterCount() == length + KeystrokeCount, "text not inserted");
+        return result;
+    }
+
+    QJsonObject deleteLines()
+    {
+        moveToLine(editor->document()->blockCount() / 3);
+        const int length = editor->document()->characterCount();
+        Measurement measurement("delete-line");
+        const int count = qMin(DeletedLines, editor->document()->blockCount() / 4);
+        for (int i = 0; i < count; ++i) {
+            sendKey(editor, Qt::Key_Y, Qt::ControlModifier);
+        }
+        QJsonObject result = measurement.finish(count);
+        expect(result, editor->document()->characterCount() < length, "no lines deleted");
+        return result;
+    }
+
+    // Ctrl+K, B で始点を置き、BlockLines 行先で Ctrl+K, K（コピー）か Ctrl+K, Y（カット）
+    // コピーはクリップボード履歴の先頭がブロックと同じか、カットは文書が縮んだかを確かめる
+    QJsonObject block(bool cut)
+    {
+        const ClipboardRing &ring = ClipboardRing::instance();
+        const int lines = qMin(BlockLines, editor->document()->blockCount() / (BlockRepeats * 4));
+        int done = 0;
+        Measurement measurement(cut ? "block-cut" : "block-copy");
+        for (int i = 0; i < BlockRepeats; ++i) {
+            const int first = editor->document()->blockCount() / 4 + i * lines;
+            const int from = editor->document()->findBlockByNumber(first).position();
+            const int to = editor->document()->findBlockByNumber(first + lines).position();
+            const int length = editor->document()->characterCount();
+            moveToLine(first);
+            sendSequence(editor, Qt::Key_K, Qt::Key_B);
+            moveToLine(first + lines);
+            sendSequence(editor, Qt::Key_K, cut ? Qt::Key_Y : Qt::Key_K);
+            const bool edited = cut ? editor->document()->characterCount() == length - (to - from)
+                                    : !ring.isEmpty() && ring.at(0).size() == to - from;
+            if (edited) ++done;
+        }
+        QJsonObject result = measurement.finish(BlockRepeats);
+        expect(result, done == BlockRepeats, cut ? "block not cut" : "block not copied");
+        return result;
+    }
+
+    QJsonObject save()
+    {
+        Measurement measurement("save");
+        const bool started = window->saveDocument(true);
+        const bool saved = started && waitUntil([&]() {
+            return !editor->document()->isModified() && schedulerIdle();
+        });
+        QJsonObject result = measurement.finish(1);
+        if (!saved) result["error"] = "not saved";
+        return result;
+    }
+
+    // 記録したキーを1つずつ送る。キーの処理（keyPressEvent）と、その後に保留中のイベント
+    // （描画・ステータス更新など）を処理し終えるまでを別々に測る
+    QJsonObject replay(const KeyMacro &keys, bool originalTiming)
+    {
+        editor->moveCursor(QTextCursor::Start);
+        QApplication::processEvents();
+
+        // 記録にファイル選択などのダイアログを開くキーがあっても止まらないよう、開いたら閉じる
+        QTimer dialogCloser;
+        dialogCloser.setInterval(50);
+        QObject::connect(&dialogCloser, &QTimer::timeout, []() {
+            if (QWidget *modal = QApplication::activeModalWidget()) modal->close();
+        });
+        dialogCloser.start();
+
+        QVector<double> processMs;
+        QVector<double> paintMs;
+        processMs.reserve(keys.size());
+        paintMs.reserve(keys.size());
+        Measurement measurement(originalTiming ? "replay-timed" : "replay");
+        QElapsedTimer sessionClock;
+        sessionClock.start();
+        QElapsedTimer clock;
+        for (int i = 0; i < keys.size(); ++i) {
+            const KeyMacro::Event &key = keys.at(i);
+            const qint64 wait = key.time - sessionClock.elapsed();
+            if (originalTiming && wait > 0) {
+                QEventLoop idle;
+                QTimer::singleShot(int(wait), &idle, &QEventLoop::quit);
+                idle.exec();
+            }
+
+            QKeyEvent press(QEvent::KeyPress, key.key, key.modifiers, key.text);
+            QKeyEvent release(QEvent::KeyRelease, key.key, key.modifiers, key.text);
+            clock.start();
+            QApplication::sendEvent(editor, &press);
+            QApplication::sendEvent(editor, &release);
+            processMs.append(clock.nsecsElapsed() / 1e6);
+
+            clock.start();
+            QApplication::processEvents();
+            paintMs.append(clock.nsecsElapsed() / 1e6);
+        }
+        QJsonObject result = measurement.finish(keys.size());
+        addPercentiles(result, "process", processMs);
+        addPercentiles(result, "paint", paintMs);
+
+        // 編集結果は保存しない（閉じるときの確認を出さない）
+        editor->document()->setModified(false);
+        return result;
+    }
+
+    QJsonObject loadSettings()
+    {
+        Measurement measurement("settings-load");
+        for (int i = 0; i < SettingsLoads; ++i) {
+            window->settings->sync();
+            window->loadSettings();
+        }
+        return measurement.finish(SettingsLoads);
+    }
+
+private:
+    // 計測した操作が文書に効いていなければ、その項目を失敗にする
+    static void expect(QJsonObject &result, bool ok, const char *error)
+    {
+        if (!ok && !result.contains("error")) result["error"] = error;
+    }
+
+    void moveToLine(int line)
+    {
+        const QTextBlock block = editor->document()->findBlockByNumber(line);
+        QTextCursor cursor(editor->document());
+        cursor.setPosition(block.isValid() ? block.position() : 0);
+        editor->setTextCursor(cursor);
+        QApplication::processEvents();
+    }
+
+    MainWindow *window;
+    CustomTextEdit *editor;
+};
+
+namespace {
+// 設定の読み込みを測るための、実際の利用に近い設定（キー割り当ての上書きを含む）
+void populateSettings()
+{
+    QSettings settings;
+    settings.clear();
+    settings.setValue("wrapWidth", 100);
+    settings.setValue("hibernateMinutes", 10);
+    settings.setValue("clipboardEntries", 20);
+    settings.setValue("overviewRulerVisible", true);
+    // 上書きは既定で空いている並びにだけ置き、計測する操作の割り当ては変えない
+    settings.beginGroup("keymap");
+    const char letters[] = "ADEGHIJLMOPQSTU";
+    for (const char *c = letters; *c; ++c) {
+        settings.setValue(QString("Ctrl+K, %1").arg(QLatin1Char(*c)), "cursor-down");
+    }
+    settings.setValue("Ctrl+Q, X", QString());
+    settings.endGroup();
+    settings.sync();
+}
+
+// 記録したときの設定だけにする（合成した設定では記録と違うコマンドが動く）
+void restoreRecordedSettings(const KeyMacro &keys)
+{
+    QSettings settings;
+    settings.clear();
+    for (auto it = keys.settings().cbegin(); it != keys.settings().cend(); ++it) {
+        settings.setValue(it.key(), it.value());
+    }
+    settings.sync();
+}
+
+// 基準より遅く（多く）なった項目を数える
+int compareWithBaseline(const QJsonObject &current, const QString &baselinePath, double tolerance)
+{
+    QFile file(baselinePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "wledit_bench: cannot read %s\n", qPrintable(baselinePath));
+        return 1;
+    }
+    const QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object();
+
+    QHash<QString, QJsonObject> previous;
+    for (const QJsonValue &corpus : baseline["corpora"].toArray()) {
+        for (const QJsonValue &scenario : corpus["scenarios"].toArray()) {
+            previous.insert(corpus["name"].toString() + "/" + scenario["name"].toString(), scenario.toObject());
+        }
+    }
+
+    int regressions = 0;
+    for (const QJsonValue &corpus : current["corpora"].toArray()) {
+        for (const QJsonValue &scenario : corpus["scenarios"].toArray()) {
+            const QString key = corpus["name"].toString() + "/" + scenario["name"].toString();
+            if (!previous.contains(key)) continue;
+            for (const char *metric : {"wall_ms", "allocations", "process_p90_ms", "paint_p90_ms"}) {
+                const double before = previous[key][metric].toDouble();
+                const double after = scenario[metric].toDouble();
+                if (before > 0 && after > before * (1 + tolerance / 100)) {
+                    std::fprintf(stderr, "REGRESSION %s %s: %.1f -> %.1f (+%.1f%%)\n", qPrintable(key), metric,
+                                 before, after, (after / before - 1) * 100);
+                    ++regressions;
+                }
+            }
+        }
+    }
+    return regressions == 0 ? 0 : 1;
+}
+
+void dropDebugMessages(QtMsgType type, const QMessageLogContext &, const QString &message)
+{
+    // 編集処理の qDebug は計測を歪めるので捨てる
+    if (type == QtDebugMsg || type == QtInfoMsg) return;
+    std::fprintf(stderr, "%s\n", qPrintable(message));
+}
+}
+
+int main(int argc, char *argv[])
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+    qInstallMessageHandler(dropDebugMessages);
+
+    QApplication app(argc, argv);
+    app.setApplicationName("WLEditor");
+    app.setApplicationVersion("1.3.0");
+    app.setOrganizationName("WLEditor");
+
+    QStringList sizes = {"1", "8"};
+    QString outputPath;
+    QString baselinePath;
+    double tolerance = 10;
+    QString replayPath;
+    QString documentPath;
+    bool originalTiming = false;
+    const QStringList args = app.arguments();
+    for (int i = 1; i < args.size(); ++i) {
+        const QString &arg = args.at(i);
+        const QString value = i + 1 < args.size() ? args.at(i + 1) : QString();
+        if (arg == "--sizes") {
+            sizes = value.split(',', Qt::SkipEmptyParts);
+            ++i;
+        } else if (arg == "--output") {
+            outputPath = value;
+            ++i;
+        } else if (arg == "--baseline") {
+            baselinePath = value;
+            ++i;
+        } else if (arg == "--tolerance") {
+            tolerance = value.toDouble();
+            ++i;
+        } else if (arg == "--replay") {
+            replayPath = value;
+            ++i;
+        } else if (arg == "--document") {
+            documentPath = value;
+            ++i;
+        } else if (arg == "--original-timing") {
+            originalTiming = true;
+        } else {
+            std::fprintf(stderr, "usage: wledit_bench [--sizes 1,8] [--output file] "
+                                 "[--baseline file [--tolerance percent]]\n"
+                                 "       wledit_bench --replay keys.wlkeys [--document file] [--original-timing] "
+                                 "[--output file] [--baseline file [--tolerance percent]]\n");
+            return 2;
+        }
+    }
+
+    // 利用者の設定・データ領域には触れない
+    QTemporaryDir workDir;
+    if (!workDir.isValid()) {
+        std::fprintf(stderr, "wledit_bench: cannot create a temporary directory\n");
+        return 1;
+    }
+    QStandardPaths::setTestModeEnabled(true);
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, workDir.filePath("settings"));
+
+    QJsonArray corpora;
+    if (!replayPath.isEmpty()) {
+        KeyMacro keys;
+        if (!keys.load(replayPath)) {
+            std::fprintf(stderr, "wledit_bench: cannot read key recording %s\n", qPrintable(replayPath));
+            return 1;
+        }
+        restoreRecordedSettings(keys);
+        // 文書を渡されなければ 1MB のコーパスで再生する
+        int expectedLength = -1;
+        if (documentPath.isEmpty()) {
+            const QString text = generateCorpus(1024 * 1024);
+            documentPath = workDir.filePath("mixed-1MB.txt");
+            QFile file(documentPath);
+            if (!file.open(QIODevice::WriteOnly) || file.write(text.toUtf8()) < 0) {
+                std::fprintf(stderr, "wledit_bench: cannot write %s\n", qPrintable(documentPath));
+                return 1;
+            }
+            expectedLength = int(text.size());
+        }
+        const QString name = "replay-" + QFileInfo(replayPath).completeBaseName();
+        std::fprintf(stderr, "%s (%d keys on %s)\n", qPrintable(name), keys.size(),
+                     qPrintable(QFileInfo(documentPath).fileName()));
+
+        MainWindow *window = new MainWindow();
+        window->show();
+        QApplication::processEvents();
+        EditorBench bench(window);
+
+        QJsonArray scenarios;
+        scenarios.append(bench.open(QFileInfo(documentPath).absoluteFilePath(), expectedLength));
+        scenarios.append(bench.replay(keys, originalTiming));
+
+        QJsonObject corpus;
+        corpus["name"] = name;
+        corpus["bytes"] = double(QFileInfo(documentPath).size());
+        corpus["keys"] = keys.size();
+        corpus["scenarios"] = scenarios;
+        corpora.append(corpus);
+
+        window->close();
+        delete window;
+        QApplication::processEvents();
+        sizes.clear();
+    } else {
+        populateSettings();
+    }
+    for (const QString &size : sizes) {
+        const qint64 bytes = qint64(size.toDouble() * 1024 * 1024);
+        const QString name = QString("mixed-%1MB").arg(size);
+        const QString text = generateCorpus(bytes);
+        const QString path = workDir.filePath(name + ".txt");
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(text.toUtf8()) < 0) {
+            std::fprintf(stderr, "wledit_bench: cannot write %s\n", qPrintable(path));
+            return 1;
+        }
+        file.close();
+        std::fprintf(stderr, "%s (%lld bytes)\n", qPrintable(name), bytes);
+
+        MainWindow *window = new MainWindow();
+        window->show();
+        QApplication::processEvents();
+        EditorBench bench(window);
+
+        QJsonArray scenarios;
+        scenarios.append(bench.loadSettings());
+        scenarios.append(bench.open(path, int(text.size())));
+        scenarios.append(bench.pageDown());
+        scenarios.append(bench.type());
+        scenarios.append(bench.deleteLines());
+        scenarios.append(bench.block(false));
+        scenarios.append(bench.block(true));
+        scenarios.append(bench.save());
+
+        QJsonObject corpus;
+        corpus["name"] = name;
+        corpus["bytes"] = double(QFileInfo(path).size());
+        corpus["lines"] = int(text.count(QLatin1Char('\n')));
+        corpus["scenarios"] = scenarios;
+        corpora.append(corpus);
+
+        // 保存済みなので閉じるときに確認は出ない
+        window->close();
+        delete window;
+        QApplication::processEvents();
+    }
+
+    QJsonObject report;
+    report["benchmark"] = "wledit_bench";
+    report["format"] = 1;
+    report["version"] = app.applicationVersion();
+    report["qt"] = qVersion();
+    report["platform"] = QApplication::platformName();
+    report["corpora"] = corpora;
+    const QByteArray json = QJsonDocument(report).toJson();
+
+    if (outputPath.isEmpty()) {
+        QTextStream(stdout) << json;
+    } else {
+        QFile output(outputPath);
+        if (!output.open(QIODevice::WriteOnly) || output.write(json) < 0) {
+            std::fprintf(stderr, "wledit_bench: cannot write %s\n", qPrintable(outputPath));
+            return 1;
+        }
+    }
+
+    // 操作が効かなかった項目があれば、時間を比べる意味がないので失敗にする
+    int failed = 0;
+    for (const QJsonValue &corpus : corpora) {
+        for (const QJsonValue &scenario : corpus["scenarios"].toArray()) {
+            if (!scenario["error"].isString()) continue;
+            std::fprintf(stderr, "%s/%s: %s\n", qPrintable(corpus["name"].toString()),
+                         qPrintable(scenario["name"].toString()), qPrintable(scenario["error"].toString()));
+            ++failed;
+        }
+    }
+    if (failed > 0) return 1;
+    return baselinePath.isEmpty() ? 0 : compareWithBaseline(report, baselinePath, tolerance);
+}
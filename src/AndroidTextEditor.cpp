@@ -0,0 +1,356 @@
+#include "AndroidTextEditor.h"
+#include "MemoryPressure.h"
+#include "TextFile.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace {
+bool isLowSurrogate(char16_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+bool isHighSurrogate(char16_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+
+// 書記素クラスタの判定に使う文字の分類（UAX #29 の規則を、ICU なしで主な範囲に絞って近似する）
+enum class Grapheme {
+    Other,
+    CR,
+    LF,
+    Control,
+    Extend,     // 結合文字・異体字セレクタ・絵文字の肌色修飾・タグ
+    ZWJ,
+    SpacingMark,
+    RegionalIndicator,
+    Pictographic,
+    HangulL,
+    HangulV,
+    HangulT,
+    HangulLV,
+    HangulLVT
+};
+
+bool inRange(char32_t c, char32_t first, char32_t last) { return c >= first && c <= last; }
+
+Grapheme classify(char32_t c)
+{
+    if (c == 0x0D) return Grapheme::CR;
+    if (c == 0x0A) return Grapheme::LF;
+    if (c == 0x200D) return Grapheme::ZWJ;
+    if (c < 0x20 || inRange(c, 0x7F, 0x9F) || c == 0x2028 || c == 0x2029) return Grapheme::Control;
+    if (inRange(c, 0x0300, 0x036F) || inRange(c, 0x0483, 0x0489) || inRange(c, 0x0591, 0x05BD)
+        || inRange(c, 0x0610, 0x061A) || inRange(c, 0x064B, 0x065F) || c == 0x0670
+        || inRange(c, 0x0900, 0x0902) || c == 0x093C || inRange(c, 0x0941, 0x0948) || c == 0x094D
+        || inRange(c, 0x0951, 0x0957) || c == 0x0E31 || inRange(c, 0x0E34, 0x0E3A) || inRange(c, 0x0E47, 0x0E4E)
+        || inRange(c, 0x1AB0, 0x1AFF) || inRange(c, 0x1DC0, 0x1DFF) || c == 0x200C || inRange(c, 0x20D0, 0x20FF)
+        || inRange(c, 0x302A, 0x302F) || inRange(c, 0x3099, 0x309A) || inRange(c, 0xFE00, 0xFE0F)
+        || inRange(c, 0xFE20, 0xFE2F) || inRange(c, 0x1F3FB, 0x1F3FF) || inRange(c, 0xE0020, 0xE007F)
+        || inRange(c, 0xE0100, 0xE01EF)) {
+        return Grapheme::Extend;
+    }
+    if (c == 0x0903 || c == 0x093B || inRange(c, 0x093E, 0x0940) || inRange(c, 0x0949, 0x094C)
+        || inRange(c, 0x094E, 0x094F)) {
+        return Grapheme::SpacingMark;
+    }
+    if (inRange(c, 0x1F1E6, 0x1F1FF)) return Grapheme::RegionalIndicator;
+    if (inRange(c, 0x1100, 0x115F) || inRange(c, 0xA960, 0xA97C)) return Grapheme::HangulL;
+    if (inRange(c, 0x1160, 0x11A7) || inRange(c, 0xD7B0, 0xD7C6)) return Grapheme::HangulV;
+    if (inRange(c, 0x11A8, 0x11FF) || inRange(c, 0xD7CB, 0xD7FB)) return Grapheme::HangulT;
+    if (inRange(c, 0xAC00, 0xD7A3)) {
+        return (c - 0xAC00) % 28 == 0 ? Grapheme::HangulLV : Grapheme::HangulLVT;
+    }
+    if (c == 0x00A9 || c == 0x00AE || c == 0x203C || c == 0x2049 || c == 0x2122 || c == 0x2139
+        || inRange(c, 0x2194, 0x21AA) || inRange(c, 0x231A, 0x23FF) || c == 0x24C2
+        || inRange(c, 0x25AA, 0x27BF) || inRange(c, 0x2934, 0x2935) || inRange(c, 0x2B05, 0x2B55)
+        || c == 0x3030 || c == 0x303D || c == 0x3297 || c == 0x3299 || inRange(c, 0x1F000, 0x1FAFF)) {
+        return Grapheme::Pictographic;
+    }
+    return Grapheme::Other;
+}
+}
+
+void AndroidTextEditor::apply(size_t offset, size_t removed, std::u16string_view inserted)
+{
+    if (offsetsValid) offsets.remove(content, offset, removed);
+    content.replace(offset, removed, inserted);
+    if (offsetsValid) offsets.insert(content, offset, inserted.size());
+    cursorPosition = offset + inserted.size();
+    if (deltaListener) {
+        deltaListener(Delta{offset, removed, inserted});
+    }
+}
+
+void AndroidTextEditor::edit(size_t offset, size_t removed, std::u16string_view inserted, UndoHistory::Kind kind)
+{
+    offset = std::min(offset, content.size());
+    removed = std::min(removed, content.size() - offset);
+    if (removed == 0 && inserted.empty()) return;
+
+    const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    history.record(int64_t(offset), content.text(offset, removed), inserted, kind, now);
+    apply(offset, removed, inserted);
+}
+
+void AndroidTextEditor::replace(size_t offset, size_t removed, std::u16string_view inserted)
+{
+    edit(offset, removed, inserted, UndoHistory::Other);
+}
+
+void AndroidTextEditor::insertText(std::u16string_view text)
+{
+    edit(cursorPosition, 0, text, UndoHistory::Typing);
+}
+
+void AndroidTextEditor::deleteChar()
+{
+    if (cursorPosition == 0) return;
+    const size_t start = previousGrapheme(cursorPosition);
+    edit(start, cursorPosition - start, std::u16string_view(), UndoHistory::Deleting);
+}
+
+void AndroidTextEditor::deleteForward()
+{
+    if (cursorPosition >= content.size()) return;
+    edit(cursorPosition, nextGrapheme(cursorPosition) - cursorPosition, std::u16string_view(), UndoHistory::Deleting);
+}
+
+void AndroidTextEditor::setText(std::u16string_view text)
+{
+    const size_t removed = content.size();
+    content.assign(text);
+    offsets.reset(content);
+    offsetsValid = true;
+    history.clear();
+    cursorPosition = 0;
+    if (deltaListener) {
+        deltaListener(Delta{0, removed, text});
+    }
+}
+
+bool AndroidTextEditor::undo()
+{
+    const std::vector<UndoHistory::Change> changes = history.undo();
+    for (auto change = changes.rbegin(); change != changes.rend(); ++change) {
+        apply(size_t(change->position), change->inserted.size(), change->removed);
+    }
+    return !changes.empty();
+}
+
+bool AndroidTextEditor::redo()
+{
+    const std::vector<UndoHistory::Change> changes = history.redo();
+    for (const UndoHistory::Change &change : changes) {
+        apply(size_t(change.position), change.removed.size(), change.inserted);
+    }
+    return !changes.empty();
+}
+
+const TextOffsetIndex &AndroidTextEditor::offsetIndex() const
+{
+    if (!offsetsValid) {
+        offsets.reset(content);
+        offsetsValid = true;
+    }
+    return offsets;
+}
+
+size_t AndroidTextEditor::onTrimMemory(int level)
+{
+    const size_t before = memoryBytes();
+
+    // 索引は次に位置を変換するときに作り直す（Java 側は描画・検索の結果を捨てる）
+    offsets.clear();
+    offsetsValid = false;
+    if (MemoryPressure::shouldCompact(level)) {
+        content.compact();
+    }
+    if (MemoryPressure::shouldSpillUndo(level) && !spillDirectory.empty() && !history.isSpilled()) {
+        // 書き込みは呼び出し元（UI スレッド）を止めないよう別スレッドで行う
+        static unsigned spillCount = 0;
+        std::function<bool()> write =
+            history.beginSpill(spillDirectory + "/wledit-undo-" + std::to_string(++spillCount) + ".spill");
+        if (write) std::thread(std::move(write)).detach();
+    }
+
+    const size_t after = memoryBytes();
+    return before > after ? before - after : 0;
+}
+
+size_t AndroidTextEditor::memoryBytes() const
+{
+    return content.capacityBytes() + offsets.memoryBytes() + history.memoryUsage();
+}
+
+int AndroidTextEditor::loadFile(int fd)
+{
+    GapBuffer loaded;
+    bool bom = false;
+    const int error = TextFile::load(fd, loaded, &bom);
+    if (error != 0) return error;
+
+    content = std::move(loaded);
+    offsets.reset(content);
+    offsetsValid = true;
+    history.clear();
+    cursorPosition = 0;
+    byteOrderMark = bom;
+    return 0;
+}
+
+int AndroidTextEditor::saveFile(int fd) const
+{
+    return TextFile::save(fd, content, byteOrderMark);
+}
+
+size_t AndroidTextEditor::copyText(size_t offset, size_t length, char16_t *out) const
+{
+    offset = std::min(offset, content.size());
+    length = std::min(length, content.size() - offset);
+
+    const std::u16string_view head = content.before();
+    const std::u16string_view tail = content.after();
+    size_t copied = 0;
+    if (offset < head.size()) {
+        const size_t count = std::min(length, head.size() - offset);
+        std::copy_n(head.data() + offset, count, out);
+        copied = count;
+    }
+    if (copied < length) {
+        const size_t tailOffset = offset + copied - head.size();
+        std::copy_n(tail.data() + tailOffset, length - copied, out + copied);
+        copied = length;
+    }
+    return copied;
+}
+
+void AndroidTextEditor::setCursor(size_t position)
+{
+    if (position > content.size()) return;
+    if (position > 0 && position < content.size()
+        && isLowSurrogate(content.at(position)) && isHighSurrogate(content.at(position - 1))) {
+        ++position;
+    }
+    cursorPosition = position;
+}
+
+void AndroidTextEditor::moveCursor(int count)
+{
+    for (; count > 0 && cursorPosition < content.size(); --count) {
+        cursorPosition = nextGrapheme(cursorPosition);
+    }
+    for (; count < 0 && cursorPosition > 0; ++count) {
+        cursorPosition = previousGrapheme(cursorPosition);
+    }
+}
+
+char32_t AndroidTextEditor::codePointAt(size_t position) const
+{
+    const char16_t unit = content.at(position);
+    if (isHighSurrogate(unit) && position + 1 < content.size() && isLowSurrogate(content.at(position + 1))) {
+        return 0x10000 + ((char32_t(unit) - 0xD800) << 10) + (content.at(position + 1) - 0xDC00);
+    }
+    return unit;
+}
+
+size_t AndroidTextEditor::codePointStartBefore(size_t position) const
+{
+    if (position >= 2 && isLowSurrogate(content.at(position - 1)) && isHighSurrogate(content.at(position - 2))) {
+        return position - 2;
+    }
+    return position - 1;
+}
+
+bool AndroidTextEditor::isGraphemeBoundary(size_t position) const
+{
+    if (position == 0 || position >= content.size()) return true;
+    if (isLowSurrogate(content.at(position)) && isHighSurrogate(content.at(position - 1))) return false;
+
+    const size_t previousStart = codePointStartBefore(position);
+    const Grapheme before = classify(codePointAt(previousStart));
+    const Grapheme after = classify(codePointAt(position));
+
+    if (before == Grapheme::CR && after == Grapheme::LF) return false;
+    if (before == Grapheme::CR || before == Grapheme::LF || before == Grapheme::Control
+        || after == Grapheme::CR || after == Grapheme::LF || after == Grapheme::Control) {
+        return true;
+    }
+    if (after == Grapheme::Extend || after == Grapheme::ZWJ || after == Grapheme::SpacingMark) return false;
+    if (before == Grapheme::HangulL
+        && (after == Grapheme::HangulL || after == Grapheme::HangulV
+            || after == Grapheme::HangulLV || after == Grapheme::HangulLVT)) {
+        return false;
+    }
+    if ((before == Grapheme::HangulLV || before == Grapheme::HangulV)
+        && (after == Grapheme::HangulV || after == Grapheme::HangulT)) {
+        return false;
+    }
+    if ((before == Grapheme::HangulLVT || before == Grapheme::HangulT) && after == Grapheme::HangulT) return false;
+    if (before == Grapheme::ZWJ && after == Grapheme::Pictographic) return false;
+    if (before == Grapheme::RegionalIndicator && after == Grapheme::RegionalIndicator) {
+        // 国旗は地域指示子2つで1文字。手前に続く地域指示子が奇数個なら組の途中
+        size_t count = 0;
+        for (size_t p = position; p > 0;) {
+            p = codePointStartBefore(p);
+            if (classify(codePointAt(p)) != Grapheme::RegionalIndicator) break;
+            ++count;
+        }
+        return count % 2 == 0;
+    }
+    return true;
+}
+
+size_t AndroidTextEditor::nextGrapheme(size_t position) const
+{
+    if (position >= content.size()) return content.size();
+    do {
+        position += isHighSurrogate(content.at(position)) && position + 1 < content.size()
+                            && isLowSurrogate(content.at(position + 1))
+                        ? 2
+                        : 1;
+    } while (!isGraphemeBoundary(position));
+    return position;
+}
+
+size_t AndroidTextEditor::previousGrapheme(size_t position) const
+{
+    if (position == 0) return 0;
+    position = std::min(position, content.size());
+    do {
+        position = codePointStartBefore(position);
+    } while (!isGraphemeBoundary(position));
+    return position;
+}
+
+void DeltaEncoder::attach(void *data, size_t bytes)
+{
+    buffer = static_cast<unsigned char *>(data);
+    capacity = bytes;
+    reset();
+}
+
+void DeltaEncoder::append(const AndroidTextEditor::Delta &delta)
+{
+    if (!buffer || overflow) return;
+    if (textPending || capacity - used < HeaderBytes) {
+        overflow = true;
+        return;
+    }
+
+    const size_t textBytes = (delta.inserted.size() * sizeof(char16_t) + 3) & ~size_t(3);
+    const bool inlineText = capacity - used - HeaderBytes >= textBytes;
+    const int32_t header[4] = {
+        int32_t(delta.offset),
+        int32_t(delta.removed),
+        int32_t(delta.inserted.size()),
+        inlineText ? int32_t(InlineText) : 0
+    };
+    std::memcpy(buffer + used, header, HeaderBytes);
+    used += HeaderBytes;
+    if (inlineText) {
+        std::memcpy(buffer + used, delta.inserted.data(), delta.inserted.size() * sizeof(char16_t));
+        std::memset(buffer + used + delta.inserted.size() * sizeof(char16_t), 0,
+                    textBytes - delta.inserted.size() * sizeof(char16_t));
+        used += textBytes;
+    } else {
+        textPending = true;
+    }
+}
@@ -0,0 +1,128 @@
+#ifndef ANDROIDTEXTEDITOR_H
+#define ANDROIDTEXTEDITOR_H
+
+#include "GapBuffer.h"
+#include "TextOffsetIndex.h"
+#include "UndoHistory.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Android 版の編集コア（JNI・Qt 非依存。ホスト上のテストからも使う）
+// 位置と長さは UTF-16 単位なので、Java の String / Editable の添字とそのまま対応する
+// コードポイント・UTF-8 バイトの位置へは TextOffsetIndex で O(log n) で変換できる
+// カーソル移動と削除は書記素クラスタ（結合文字・絵文字の ZWJ 連結・国旗など）単位
+// 編集のたびに (offset, removed, inserted) の差分を通知し、Java 側は全文を取り直さずに済む
+// メモリ不足の通知（onTrimMemory）では段階に応じて索引を捨て、バッファを詰め、取り消し履歴をディスクへ書き出す
+class AndroidTextEditor
+{
+public:
+    struct Delta {
+        size_t offset;
+        size_t removed;
+        std::u16string_view inserted;   // 通知の間だけ有効
+    };
+    using DeltaListener = std::function<void(const Delta &delta)>;
+
+    void setDeltaListener(DeltaListener listener) { deltaListener = std::move(listener); }
+
+    // カーソル位置に挿入し、カーソルを挿入した文字列の後ろへ進める
+    void insertText(std::u16string_view text);
+    // カーソルの前／後ろの1書記素クラスタを削除する
+    void deleteChar();
+    void deleteForward();
+    // [offset, offset + removed) を置き換え、カーソルを置き換えた文字列の後ろへ移す
+    void replace(size_t offset, size_t removed, std::u16string_view inserted);
+    // 全文を置き換える（新しい文書として取り消し履歴も空にする）
+    void setText(std::u16string_view text);
+
+    // 取り消し／やり直し。適用した変更を差分として通知し、何もしなければ false
+    bool undo();
+    bool redo();
+    bool canUndo() const { return history.canUndo(); }
+    bool canRedo() const { return history.canRedo(); }
+
+    // 記述子の UTF-8 ファイルを写像から直接読み込む（TextFile::load）。成功なら 0、失敗なら errno
+    // 全文を差分として通知はしない（Java 側は全体を読み直したものとして必要な範囲だけ読む）
+    int loadFile(int fd);
+    // 同じ記述子へ書き戻す。読み込んだファイルに BOM があれば付けて書く
+    int saveFile(int fd) const;
+
+    size_t length() const { return content.size(); }
+    std::u16string text(size_t offset, size_t length) const { return content.text(offset, length); }
+    // 範囲を out へ写し、写した単位数を返す（割り当てなし）
+    size_t copyText(size_t offset, size_t length, char16_t *out) const;
+
+    // サロゲートペアの間を指す位置は次の文字の境界に丸める
+    void setCursor(size_t position);
+    size_t cursor() const { return cursorPosition; }
+    // カーソルを書記素クラスタ単位で count 個（負なら前へ）動かす
+    void moveCursor(int count);
+
+    // 書記素クラスタの境界（UTF-16 単位）
+    size_t nextGrapheme(size_t position) const;
+    size_t previousGrapheme(size_t position) const;
+    bool isGraphemeBoundary(size_t position) const;
+
+    size_t convertOffset(size_t offset, TextOffsetIndex::Unit from, TextOffsetIndex::Unit to) const
+    {
+        return offsetIndex().convert(content, offset, from, to);
+    }
+    // 捨てられていれば作り直してから返す
+    const TextOffsetIndex &offsetIndex() const;
+
+    // 取り消し履歴を書き出すディレクトリ（Android では Context.getCacheDir()）
+    void setSpillDirectory(const std::string &directory) { spillDirectory = directory; }
+    // level は MemoryPressure::Level（ComponentCallbacks2 の値）。減ったバイト数を返す
+    size_t onTrimMemory(int level);
+    size_t memoryBytes() const;
+
+private:
+    void edit(size_t offset, size_t removed, std::u16string_view inserted, UndoHistory::Kind kind);
+    void apply(size_t offset, size_t removed, std::u16string_view inserted);
+    char32_t codePointAt(size_t position) const;
+    size_t codePointStartBefore(size_t position) const;
+
+    GapBuffer content;
+    mutable TextOffsetIndex offsets;
+    mutable bool offsetsValid = true;   // false なら捨ててあり、編集で更新しない
+    UndoHistory history;
+    std::string spillDirectory;
+    size_t cursorPosition = 0;
+    bool byteOrderMark = false;
+    DeltaListener deltaListener;
+};
+
+// 差分を Java と共有するダイレクト ByteBuffer へ書き込む（ネイティブのバイト順）
+// レコード: int32 offset, int32 removed, int32 inserted, int32 flags
+//          flags & InlineText なら続けて inserted 個の UTF-16 単位（4バイト境界まで詰め物）
+// 挿入文字列が入りきらなければ InlineText なしで書き、Java 側は呼び出し後の本文から範囲読み出しで取る
+// （後の差分で本文がずれないよう、そのレコードは最後にする。続く差分があればあふれとして扱う）
+// レコード自体が入りきらなければ overflowed() になり、Java 側は全体を読み直す
+class DeltaEncoder
+{
+public:
+    enum Flags : int32_t {
+        InlineText = 1
+    };
+    static constexpr size_t HeaderBytes = 4 * sizeof(int32_t);
+
+    void attach(void *data, size_t capacity);
+    bool isAttached() const { return buffer != nullptr; }
+    void reset() { used = 0; overflow = false; textPending = false; }
+    void append(const AndroidTextEditor::Delta &delta);
+
+    size_t size() const { return used; }
+    bool overflowed() const { return overflow; }
+
+private:
+    unsigned char *buffer = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    bool overflow = false;
+    bool textPending = false;   // 文字列を書かなかったレコードがある（それより後には書けない）
+};
+
+#endif // ANDROIDTEXTEDITOR_H
@@ -0,0 +1,673 @@
+#include "BatchProcessor.h"
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QSet>
+#include <QStringDecoder>
+#include <QStringEncoder>
+#include <QTextStream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace {
+const qint64 ReadChunkBytes = 1 << 20;
+const qint64 WriteChunkCharacters = 1 << 20;
+const qint64 EndOfFile = std::numeric_limits<qint64>::max();   // 行番号の $
+
+// スクリプトの1行を語に分ける（"..." 内は空白を含められる）
+bool tokenize(const QString &line, QStringList &tokens, QString &error)
+{
+    int i = 0;
+    while (i < line.size()) {
+        const QChar ch = line.at(i);
+        if (ch.isSpace()) {
+            ++i;
+        } else if (ch == QLatin1Char('#')) {
+            break;
+        } else if (ch == QLatin1Char('"')) {
+            QString token;
+            ++i;
+            bool closed = false;
+            while (i < line.size()) {
+                QChar c = line.at(i++);
+                if (c == QLatin1Char('"')) {
+                    closed = true;
+                    break;
+                }
+                if (c == QLatin1Char('\\') && i < line.size()) {
+                    c = line.at(i++);
+                    if (c == QLatin1Char('n')) c = QLatin1Char('\n');
+                    else if (c == QLatin1Char('t')) c = QLatin1Char('\t');
+                }
+                token += c;
+            }
+            if (!closed) {
+                error = "unterminated string";
+                return false;
+            }
+            tokens << token;
+        } else {
+            const int start = i;
+            while (i < line.size() && !line.at(i).isSpace()) ++i;
+            tokens << line.mid(start, i - start);
+        }
+    }
+    return true;
+}
+
+bool parseLineNumber(const QString &token, qint64 &value)
+{
+    if (token == QLatin1String("$")) {
+        value = EndOfFile;
+        return true;
+    }
+    bool ok = false;
+    value = token.toLongLong(&ok);
+    return ok && value >= 1;
+}
+
+bool isValidEncoding(const QByteArray &name)
+{
+    return QStringDecoder(name.constData()).isValid() && QStringEncoder(name.constData()).isValid();
+}
+
+// BOM を書ける（U+FEFF を符号化できる）Unicode の符号化か
+bool isUnicodeEncoding(const QByteArray &name)
+{
+    const auto encoding = QStringConverter::encodingForName(name.constData());
+    return encoding && *encoding != QStringConverter::Latin1 && *encoding != QStringConverter::System;
+}
+
+// ファイルを行に分けて読む（"\r\n" と "\n" を改行とし、ファイル全体は持たない）
+struct LineReader {
+    QString error;
+    QString eol;               // 最初に見つかった改行
+    bool finalNewline = false; // 最後の行が改行で終わっていたか
+    bool bom = false;          // 先頭に BOM があったか（BOM は行に含めない）
+
+    bool read(const QString &path, const QByteArray &encoding, TaskScheduler::TaskContext *context,
+              const std::function<bool(QString &&)> &line)
+    {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            error = file.errorString();
+            return false;
+        }
+        // BOM は読み飛ばさずに U+FEFF として受け取り、あったことを覚えてから外す
+        QStringDecoder decoder(encoding.constData(), QStringDecoder::Flag::ConvertInitialBom);
+        const qint64 size = file.size();
+        QString carry;
+        bool any = false;
+        bool first = true;
+        while (!file.atEnd()) {
+            if (context && context->isCancelled()) {
+                error = "Cancelled";
+                return false;
+            }
+            const QByteArray bytes = file.read(ReadChunkBytes);
+            if (bytes.isEmpty() && file.error() != QFileDevice::NoError) {
+                error = file.errorString();
+                return false;
+            }
+            carry += QString(decoder.decode(bytes));
+            any = any || !bytes.isEmpty();
+            if (first && !carry.isEmpty()) {
+                first = false;
+                bom = carry.startsWith(QChar(QChar::ByteOrderMark));
+                if (bom) carry.remove(0, 1);
+            }
+
+            qsizetype start = 0;
+            for (qsizetype newline = carry.indexOf(QLatin1Char('\n')); newline >= 0;
+                 newline = carry.indexOf(QLatin1Char('\n'), start)) {
+                qsizetype end = newline;
+                if (end > start && carry.at(end - 1) == QLatin1Char('\r')) --end;
+                if (eol.isEmpty()) {
+                    eol = end < newline ? QStringLiteral("\r\n") : QStringLiteral("\n");
+                }
+                if (!line(carry.mid(start, end - start))) return false;
+                start = newline + 1;
+            }
+            carry.remove(0, start);
+            if (context) context->setProgress(file.pos(), size);
+        }
+        if (decoder.hasError()) {
+            error = QString("Invalid %1 byte sequence").arg(QString::fromLatin1(encoding));
+            return false;
+        }
+        if (!carry.isEmpty()) {
+            finalNewline = false;
+            return line(std::move(carry));
+        }
+        finalNewline = any;
+        return true;
+    }
+};
+
+// 文字列をまとめて符号化しながら書く
+struct EncodedWriter {
+    QStringEncoder encoder;
+    QString buffer;
+
+    explicit EncodedWriter(const QByteArray &encoding) : encoder(encoding.constData()) {}
+
+    void append(QStringView text, QIODevice &device)
+    {
+        buffer += text;
+        if (buffer.size() >= WriteChunkCharacters) flush(device);
+    }
+
+    void flush(QIODevice &device)
+    {
+        if (buffer.isEmpty()) return;
+        const QByteArray bytes = encoder.encode(buffer);
+        device.write(bytes);
+        buffer.truncate(0);
+    }
+};
+
+// 1ファイル分の処理状態
+struct Job {
+    const BatchProcessor::Script *script = nullptr;
+    QString baseName;
+    QByteArray outputEncoding;
+    QString eol;
+    bool finalNewline = false;
+    bool bom = false;           // 出力の先頭に BOM を書く（入力にあり、出力の符号化が Unicode）
+    QString error;
+    qint64 lines = 0;
+    qint64 replacements = 0;
+    qint64 heldBytes = 0;       // ブロック移動で保留している行
+    qint64 peakBytes = 0;       // 保留中の行と処理中の行の合計の最大
+
+    QString expandPath(const QString &path) const
+    {
+        QString result = path;
+        return result.replace(QLatin1String("{name}"), baseName);
+    }
+};
+
+// パイプラインの1段。受け取った行を加工して次の段へ渡す
+class Stage
+{
+public:
+    explicit Stage(Job &job) : job(job) {}
+    virtual ~Stage() = default;
+    virtual void push(QString line) = 0;
+    virtual void finish() { next->finish(); }
+    Stage *next = nullptr;
+
+protected:
+    Job &job;
+};
+
+class ReplaceStage : public Stage
+{
+public:
+    ReplaceStage(Job &job, const BatchProcessor::Operation &operation) : Stage(job), operation(operation) {}
+    void push(QString line) override
+    {
+        job.replacements += TextSearch::replaceAll(line, operation.find, operation.replacement, operation.options);
+        next->push(std::move(line));
+    }
+
+private:
+    const BatchProcessor::Operation &operation;
+};
+
+class DeleteLinesStage : public Stage
+{
+public:
+    DeleteLinesStage(Job &job, const BatchProcessor::Operation &operation) : Stage(job), operation(operation) {}
+    void push(QString line) override
+    {
+        ++number;
+        if (number < operation.from || number > operation.to) {
+            next->push(std::move(line));
+        }
+    }
+
+private:
+    const BatchProcessor::Operation &operation;
+    qint64 number = 0;
+};
+
+class MoveLinesStage : public Stage
+{
+public:
+    MoveLinesStage(Job &job, const BatchProcessor::Operation &operation) : Stage(job), operation(operation) {}
+    void push(QString line) override
+    {
+        ++number;
+        if (operation.destination > operation.to) {
+            // 後ろへ移動: ブロックを保留し、移動先の行の前で出す
+            if (number >= operation.from && number <= operation.to) {
+                hold(std::move(line));
+                return;
+            }
+            if (number == operation.destination) release();
+            next->push(std::move(line));
+        } else {
+            // 前へ移動: 移動先からブロックの手前までを保留し、ブロックの後で出す
+            if (number >= operation.destination && number < operation.from) {
+                hold(std::move(line));
+                return;
+            }
+            next->push(std::move(line));
+            if (number == operation.to) release();
+        }
+    }
+    void finish() override
+    {
+        release();
+        next->finish();
+    }
+
+private:
+    void hold(QString &&line)
+    {
+        job.heldBytes += line.size() * qint64(sizeof(QChar));
+        held.push_back(std::move(line));
+    }
+
+    void release()
+    {
+        for (QString &line : held) {
+            job.heldBytes -= line.size() * qint64(sizeof(QChar));
+            next->push(std::move(line));
+        }
+        held.clear();
+    }
+
+    const BatchProcessor::Operation &operation;
+    qint64 number = 0;
+    std::vector<QString> held;
+};
+
+class WriteLinesStage : public Stage
+{
+public:
+    WriteLinesStage(Job &job, const BatchProcessor::Operation &operation)
+        : Stage(job), operation(operation), file(job.expandPath(operation.path)), writer(job.outputEncoding) {}
+    void push(QString line) override
+    {
+        ++number;
+        if (number >= operation.from && number <= operation.to && job.error.isEmpty()) {
+            if (!file.isOpen() && !file.open(QIODevice::WriteOnly)) {
+                job.error = QString("%1: %2").arg(file.fileName(), file.errorString());
+            } else {
+                writer.append(line, file);
+                writer.append(job.eol, file);
+            }
+        }
+        next->push(std::move(line));
+    }
+    void finish() override
+    {
+        if (file.isOpen()) {
+            writer.flush(file);
+            if (!job.error.isEmpty()) {
+                file.cancelWriting();
+            } else if (!file.commit()) {
+                job.error = QString("%1: %2").arg(file.fileName(), file.errorString());
+            }
+        }
+        next->finish();
+    }
+
+private:
+    const BatchProcessor::Operation &operation;
+    qint64 number = 0;
+    QSaveFile file;
+    EncodedWriter writer;
+};
+
+class ReadFileStage : public Stage
+{
+public:
+    ReadFileStage(Job &job, const BatchProcessor::Operation &operation) : Stage(job), operation(operation) {}
+    void push(QString line) override
+    {
+        ++number;
+        if (number == operation.destination) insert();
+        next->push(std::move(line));
+    }
+    void finish() override
+    {
+        if (!inserted) insert();
+        next->finish();
+    }
+
+private:
+    void insert()
+    {
+        inserted = true;
+        LineReader reader;
+        const QString path = job.expandPath(operation.path);
+        if (!reader.read(path, job.script->inputEncoding, nullptr, [this](QString &&line) {
+                next->push(std::move(line));
+                return true;
+            })) {
+            job.error = QString("%1: %2").arg(path, reader.error);
+        }
+    }
+
+    const BatchProcessor::Operation &operation;
+    qint64 number = 0;
+    bool inserted = false;
+};
+
+// 最後の段。出力ファイルへ書く（最後の行の改行と先頭の BOM は入力に合わせる）
+class OutputStage : public Stage
+{
+public:
+    OutputStage(Job &job, const QString &path) : Stage(job), file(path), writer(job.outputEncoding) {}
+    bool open()
+    {
+        if (!file.open(QIODevice::WriteOnly)) {
+            job.error = QString("%1: %2").arg(file.fileName(), file.errorString());
+            return false;
+        }
+        return true;
+    }
+    void push(QString line) override
+    {
+        start();
+        if (hasPending) {
+            writer.append(pending, file);
+            writer.append(job.eol, file);
+        }
+        pending = std::move(line);
+        hasPending = true;
+        ++job.lines;
+    }
+    void finish() override
+    {
+        start();
+        if (hasPending) {
+            writer.append(pending, file);
+            if (job.finalNewline) writer.append(job.eol, file);
+        }
+        writer.flush(file);
+    }
+    bool commit()
+    {
+        if (!job.error.isEmpty()) {
+            file.cancelWriting();
+            return false;
+        }
+        if (!file.commit()) {
+            job.error = file.errorString();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void start()
+    {
+        if (started) return;
+        started = true;
+        if (job.bom) writer.append(QStringView(u"\uFEFF"), file);
+    }
+
+    QSaveFile file;
+    EncodedWriter writer;
+    QString pending;
+    bool hasPending = false;
+    bool started = false;
+};
+}
+
+bool BatchProcessor::parseScript(const QString &source, Script &script, QString &error)
+{
+    const QStringList lines = source.split(QLatin1Char('\n'));
+    for (int i = 0; i < lines.size(); ++i) {
+        QStringList tokens;
+        QString message;
+        if (!tokenize(lines.at(i), tokens, message)) {
+            error = QString("line %1: %2").arg(i + 1).arg(message);
+            return false;
+        }
+        if (tokens.isEmpty()) continue;
+
+        const QString command = tokens.takeFirst();
+        Operation operation;
+        operation.scriptLine = i + 1;
+        bool ok = true;
+        if (command == QLatin1String("replace")) {
+            operation.type = Operation::Replace;
+            ok = tokens.size() >= 2 && !tokens.at(0).isEmpty();
+            if (ok) {
+                operation.find = tokens.at(0);
+                operation.replacement = tokens.at(1);
+                for (const QString &flag : tokens.mid(2)) {
+                    if (flag == QLatin1String("case")) operation.options.caseSensitive = true;
+                    else if (flag == QLatin1String("word")) operation.options.wholeWords = true;
+                    else ok = false;
+                }
+            }
+        } else if (command == QLatin1String("delete-lines")) {
+            operation.type = Operation::DeleteLines;
+            ok = tokens.size() == 2 && parseLineNumber(tokens.at(0), operation.from)
+                 && parseLineNumber(tokens.at(1), operation.to) && operation.from <= operation.to;
+        } else if (command == QLatin1String("move-lines")) {
+            operation.type = Operation::MoveLines;
+            ok = tokens.size() == 3 && parseLineNumber(tokens.at(0), operation.from)
+                 && parseLineNumber(tokens.at(1), operation.to) && operation.to != EndOfFile
+                 && parseLineNumber(tokens.at(2), operation.destination) && operation.from <= operation.to
+                 && (operation.destination < operation.from || operation.destination > operation.to + 1);
+        } else if (command == QLatin1String("write-lines")) {
+            operation.type = Operation::WriteLines;
+            ok = tokens.size() == 3 && parseLineNumber(tokens.at(0), operation.from)
+                 && parseLineNumber(tokens.at(1), operation.to) && operation.from <= operation.to;
+            if (ok) operation.path = tokens.at(2);
+        } else if (command == QLatin1String("read-file")) {
+            operation.type = Operation::ReadFile;
+            ok = tokens.size() == 2 && parseLineNumber(tokens.at(0), operation.destination);
+            if (ok) operation.path = tokens.at(1);
+        } else if (command == QLatin1String("input-encoding") || command == QLatin1String("output-encoding")) {
+            ok = tokens.size() == 1 && isValidEncoding(tokens.at(0).toLatin1());
+            if (!ok) {
+                error = QString("line %1: unknown or unsupported encoding").arg(i + 1);
+                return false;
+            }
+            (command == QLatin1String("input-encoding") ? script.inputEncoding : script.outputEncoding)
+                = tokens.at(0).toLatin1();
+            continue;
+        } else if (command == QLatin1String("eol")) {
+            const QString style = tokens.value(0);
+            ok = tokens.size() == 1;
+            if (style == QLatin1String("lf")) script.eol = QStringLiteral("\n");
+            else if (style == QLatin1String("crlf")) script.eol = QStringLiteral("\r\n");
+            else if (style == QLatin1String("keep")) script.eol.clear();
+            else ok = false;
+            if (!ok) {
+                error = QString("line %1: eol must be lf, crlf or keep").arg(i + 1);
+                return false;
+            }
+            continue;
+        } else {
+            error = QString("line %1: unknown command \"%2\"").arg(i + 1).arg(command);
+            return false;
+        }
+
+        if (!ok) {
+            error = QString("line %1: invalid arguments for %2").arg(i + 1).arg(command);
+            return false;
+        }
+        script.operations.append(operation);
+    }
+    return true;
+}
+
+BatchProcessor::Result BatchProcessor::processFile(const Script &script, const QString &inputPath,
+                                                   const QString &outputPath, TaskScheduler::TaskContext *context)
+{
+    Job job;
+    job.script = &script;
+    job.baseName = QFileInfo(inputPath).completeBaseName();
+    job.outputEncoding = script.outputEncoding.isEmpty() ? script.inputEncoding : script.outputEncoding;
+    job.eol = script.eol;
+
+    // スクリプトの順に段をつなぐ
+    std::vector<std::unique_ptr<Stage>> stages;
+    for (const Operation &operation : script.operations) {
+        switch (operation.type) {
+        case Operation::Replace: stages.push_back(std::make_unique<ReplaceStage>(job, operation)); break;
+        case Operation::DeleteLines: stages.push_back(std::make_unique<DeleteLinesStage>(job, operation)); break;
+        case Operation::MoveLines: stages.push_back(std::make_unique<MoveLinesStage>(job, operation)); break;
+        case Operation::WriteLines: stages.push_back(std::make_unique<WriteLinesStage>(job, operation)); break;
+        case Operation::ReadFile: stages.push_back(std::make_unique<ReadFileStage>(job, operation)); break;
+        }
+    }
+    auto output = std::make_unique<OutputStage>(job, outputPath);
+    for (size_t i = 0; i < stages.size(); ++i) {
+        stages[i]->next = i + 1 < stages.size() ? stages[i + 1].get() : output.get();
+    }
+    Stage *head = stages.empty() ? static_cast<Stage*>(output.get()) : stages.front().get();
+
+    Result result;
+    if (output->open()) {
+        LineReader reader;
+        const bool unicodeOutput = isUnicodeEncoding(job.outputEncoding);
+        const bool read = reader.read(inputPath, script.inputEncoding, context, [&](QString &&line) {
+            // 改行を保つ場合は最初の行が来た時点で入力の改行が分かっている
+            if (job.eol.isEmpty()) {
+                job.eol = reader.eol.isEmpty() ? QStringLiteral("\n") : reader.eol;
+            }
+            job.bom = reader.bom && unicodeOutput;
+            job.peakBytes = qMax(job.peakBytes, job.heldBytes + line.size() * qint64(sizeof(QChar)));
+            head->push(std::move(line));
+            return job.error.isEmpty();
+        });
+        if (!read && job.error.isEmpty()) {
+            job.error = reader.error;
+        }
+        job.finalNewline = reader.finalNewline;
+        job.bom = reader.bom && unicodeOutput;
+        if (job.eol.isEmpty()) {
+            job.eol = QStringLiteral("\n");
+        }
+        if (job.error.isEmpty()) {
+            head->finish();
+        }
+        output->commit();
+    }
+
+    result.ok = job.error.isEmpty();
+    result.error = job.error;
+    result.lines = job.lines;
+    result.replacements = job.replacements;
+    result.memory.text = job.peakBytes;
+    return result;
+}
+
+int BatchProcessor::run(const QStringList &arguments)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QString scriptPath;
+    QString outputDirectory;
+    int jobs = 0;
+    bool memory = false;
+    QStringList files;
+    for (int i = 0; i < arguments.size(); ++i) {
+        const QString &arg = arguments.at(i);
+        if (arg == QLatin1String("--batch") && i + 1 < arguments.size()) {
+            scriptPath = arguments.at(++i);
+        } else if (arg == QLatin1String("--jobs") && i + 1 < arguments.size()) {
+            jobs = qMax(0, arguments.at(++i).toInt());
+        } else if (arg == QLatin1String("--output") && i + 1 < arguments.size()) {
+            outputDirectory = arguments.at(++i);
+        } else if (arg == QLatin1String("--memory")) {
+            memory = true;
+        } else if (arg == QLatin1String("--new-instance") || arg == QLatin1String("--startup-profile")) {
+            continue;
+        } else if (arg.startsWith(QLatin1String("--"))) {
+            err << "wledit: unknown option " << arg << Qt::endl;
+            return 2;
+        } else {
+            files << arg;
+        }
+    }
+    if (scriptPath.isEmpty() || files.isEmpty()) {
+        err << "usage: wledit --batch SCRIPT [--jobs N] [--output DIR] [--memory] FILE..." << Qt::endl;
+        return 2;
+    }
+
+    QFile scriptFile(scriptPath);
+    if (!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        err << "wledit: " << scriptPath << ": " << scriptFile.errorString() << Qt::endl;
+        return 2;
+    }
+    Script script;
+    QString error;
+    if (!parseScript(QString::fromUtf8(scriptFile.readAll()), script, error)) {
+        err << "wledit: " << scriptPath << ": " << error << Qt::endl;
+        return 2;
+    }
+
+    // 出力先が重なると並列に書いたときに結果が壊れる
+    QStringList outputs;
+    QSet<QString> seen;
+    if (!outputDirectory.isEmpty()) QDir().mkpath(outputDirectory);
+    for (const QString &file : files) {
+        const QString output = outputDirectory.isEmpty()
+                                   ? file
+                                   : QDir(outputDirectory).filePath(QFileInfo(file).fileName());
+        const QString key = QFileInfo(output).absoluteFilePath();
+        if (seen.contains(key)) {
+            err << "wledit: more than one input is written to " << output << Qt::endl;
+            return 2;
+        }
+        seen.insert(key);
+        outputs << output;
+    }
+    if (files.size() > 1) {
+        for (const Operation &operation : script.operations) {
+            if (operation.type == Operation::WriteLines && !operation.path.contains(QLatin1String("{name}"))) {
+                err << "wledit: " << scriptPath << ": line " << operation.scriptLine
+                    << ": write-lines needs {name} in the file name when processing several files" << Qt::endl;
+                return 2;
+            }
+        }
+    }
+
+    TaskScheduler scheduler(jobs);
+    QEventLoop loop;
+    QVector<Result> results(files.size());
+    int remaining = files.size();
+    for (int i = 0; i < files.size(); ++i) {
+        scheduler.submit(files.at(i), TaskScheduler::Background,
+            [&script, &results, &files, &outputs, i](TaskScheduler::TaskContext &context) {
+                results[i] = processFile(script, files.at(i), outputs.at(i), &context);
+            },
+            [&remaining, &loop](bool) {
+                if (--remaining == 0) loop.quit();
+            });
+    }
+    if (remaining > 0) {
+        loop.exec();
+    }
+
+    int failures = 0;
+    for (int i = 0; i < files.size(); ++i) {
+        const Result &result = results.at(i);
+        if (result.ok) {
+            out << files.at(i) << ": " << result.lines << " lines, "
+                << result.replacements << " replacements";
+            if (memory) out << ", memory: " << result.memory.summary();
+            out << Qt::endl;
+        } else {
+            err << "wledit: " << files.at(i) << ": " << result.error << Qt::endl;
+            ++failures;
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
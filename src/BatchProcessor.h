@@ -0,0 +1,70 @@
+#ifndef BATCHPROCESSOR_H
+#define BATCHPROCESSOR_H
+
+#include "TaskScheduler.h"
+#include "DocumentMemory.h"
+#include "TextSearch.h"
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// ヘッドレスのバッチ処理（wledit --batch SCRIPT [--jobs N] [--output DIR] FILE...）
+// ・QtCoreのみ使用し、画面がなくても動く
+// ・スクリプトの操作を行単位のパイプラインにして、ファイルを先頭から流しながら適用する
+//   （ファイル全体を読み込まない。ブロック移動で保留する行だけがメモリに残る）
+// ・置換はエディタの「すべて置換」と同じ TextSearch の規則を使う
+// ・複数のファイルは TaskScheduler で並列に処理し、1つでも失敗すれば終了コードは 1
+// ・--memory を付けると、ファイルごとの要約に同時に持っていた行の最大（DocumentMemory）を加える
+//
+// スクリプトは1行に1つの操作（# 以降は注釈、文字列は "..." で \n \t \" \\ が使える）
+//   replace FIND REPLACEMENT [case] [word]   大文字小文字の区別 / 単語単位
+//   delete-lines FROM TO                     行のブロックを削除（Ctrl+K,Y）
+//   move-lines FROM TO DEST                  行のブロックを DEST 行の前へ移動（Ctrl+K,V）
+//   write-lines FROM TO FILE                 行のブロックをファイルへ書き出し（Ctrl+K,W）
+//   read-file LINE FILE                      ファイルを LINE 行の前へ挿入（Ctrl+K,R）
+//   input-encoding NAME / output-encoding NAME
+//   eol lf|crlf|keep
+// 入力の先頭の BOM は保ち、出力の符号化が Unicode なら出力の先頭にも書く
+// 行番号は1始まりで、$ は最終行の後ろ。行番号はそれより前の操作を適用した後の行を数える
+// FILE 中の {name} は処理中のファイル名（拡張子なし）に置き換わる
+class BatchProcessor
+{
+public:
+    struct Operation {
+        enum Type { Replace, DeleteLines, MoveLines, WriteLines, ReadFile };
+        Type type = Replace;
+        QString find;
+        QString replacement;
+        TextSearch::Options options;
+        qint64 from = 0;
+        qint64 to = 0;
+        qint64 destination = 0;
+        QString path;
+        int scriptLine = 0;
+    };
+
+    struct Script {
+        QVector<Operation> operations;
+        QByteArray inputEncoding = "UTF-8";
+        QByteArray outputEncoding;    // 空なら入力と同じ
+        QString eol;                  // 空なら入力の改行を保つ
+    };
+
+    struct Result {
+        bool ok = false;
+        QString error;
+        qint64 lines = 0;
+        qint64 replacements = 0;
+        DocumentMemory memory;    // 行単位で流すので本文（保留した行の最大）だけ
+    };
+
+    static bool parseScript(const QString &source, Script &script, QString &error);
+    static Result processFile(const Script &script, const QString &inputPath, const QString &outputPath,
+                              TaskScheduler::TaskContext *context);
+
+    // --batch 以降の引数を解釈して実行し、終了コードを返す（QCoreApplication 作成後に呼ぶ）
+    static int run(const QStringList &arguments);
+};
+
+#endif // BATCHPROCESSOR_H
@@ -0,0 +1,140 @@
+#include "ClipboardRing.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace {
+const quint32 FileMagic = 0x574c4352;   // "WLCR"
+const quint32 FileVersion = 1;
+}
+
+ClipboardRing &ClipboardRing::instance()
+{
+    static ClipboardRing ring;
+    return ring;
+}
+
+ClipboardRing::ClipboardRing()
+    : totalBytes(0)
+    , maxEntries(10)
+    , budget(256LL * 1024 * 1024)
+{
+}
+
+void ClipboardRing::setMaximumEntries(int count)
+{
+    maxEntries = qMax(1, count);
+    trim();
+}
+
+void ClipboardRing::setByteBudget(qint64 bytes)
+{
+    budget = qMax<qint64>(0, bytes);
+    trim();
+}
+
+QString ClipboardRing::add(const QString &text)
+{
+    if (text.isEmpty()) return text;
+
+    const size_t hash = qHash(text);
+    for (int i = 0; i < entries.size(); ++i) {
+        const Entry &entry = entries.at(i);
+        if (entry.hash == hash && entry.text.size() == text.size() && entry.text == text) {
+            // 同じ内容は保持している文字列を先頭へ移すだけにする
+            entries.move(i, 0);
+            return entries.first().text;
+        }
+    }
+
+    entries.prepend(Entry{text, hash});
+    totalBytes += bytesOf(text);
+    trim();
+    return text;
+}
+
+void ClipboardRing::trim()
+{
+    while (entries.size() > 1 && (entries.size() > maxEntries || totalBytes > budget)) {
+        totalBytes -= bytesOf(entries.last().text);
+        entries.removeLast();
+    }
+}
+
+QString ClipboardRing::preview(int index, int length) const
+{
+    const QString &text = entries.at(index).text;
+    QString line = QStringView(text).left(length).toString();
+    for (QChar &ch : line) {
+        if (ch == QLatin1Char('\n') || ch == QChar::ParagraphSeparator || ch == QChar::LineSeparator) {
+            ch = QChar(0x21B5);   // ↵
+        } else if (ch == QLatin1Char('\t') || ch == QLatin1Char('\r')) {
+            ch = QLatin1Char(' ');
+        }
+    }
+    if (text.size() > length) {
+        line += QChar(0x2026);   // …
+    }
+    return line;
+}
+
+bool ClipboardRing::save(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    QDataStream out(&file);
+    out << FileMagic << FileVersion << qint32(entries.size());
+    for (const Entry &entry : entries) {
+        out << entry.text;
+    }
+    return out.status() == QDataStream::Ok && file.commit();
+}
+
+bool ClipboardRing::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    QDataStream in(&file);
+    quint32 magic = 0, version = 0;
+    qint32 count = 0;
+    in >> magic >> version >> count;
+    if (magic != FileMagic || version != FileVersion || count < 0) {
+        return false;
+    }
+
+    QVector<QString> loaded;
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString text;
+        in >> text;
+        loaded.append(text);
+    }
+    if (in.status() != QDataStream::Ok) {
+        return false;
+    }
+
+    // 古いものから追加して順序を保つ（今回のセッションの履歴が優先される）
+    const QVector<Entry> current = entries;
+    entries.clear();
+    totalBytes = 0;
+    for (int i = loaded.size() - 1; i >= 0; --i) {
+        add(loaded.at(i));
+    }
+    for (int i = current.size() - 1; i >= 0; --i) {
+        add(current.at(i).text);
+    }
+    return true;
+}
+
+QString ClipboardRing::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/clipboard.ring";
+}
@@ -0,0 +1,54 @@
+#ifndef CLIPBOARDRING_H
+#define CLIPBOARDRING_H
+
+#include <QString>
+#include <QStringView>
+#include <QVector>
+
+// クリップボード履歴（プロセス内の全ウィンドウで共有）
+// ・同じ内容はハッシュで見つけて先頭へ移すだけにし、二重に持たない
+// ・件数と合計バイト数の上限を超えたら古いものから捨てる（最新の1件は常に残す）
+// ・文字列は QString の暗黙共有のまま渡すので、システムのクリップボードや貼り付け先と同じバッファを使う
+class ClipboardRing
+{
+public:
+    static ClipboardRing &instance();
+
+    void setMaximumEntries(int count);
+    int maximumEntries() const { return maxEntries; }
+    void setByteBudget(qint64 bytes);
+    qint64 byteBudget() const { return budget; }
+
+    // 追加した（または既にあった）文字列を返す。既存の内容なら保持している側を返す
+    QString add(const QString &text);
+
+    int count() const { return entries.size(); }
+    bool isEmpty() const { return entries.isEmpty(); }
+    QString at(int index) const { return entries.at(index).text; }
+    qint64 bytes() const { return totalBytes; }
+
+    // 本文をコピーせずに作る1行の見出し（改行・タブは記号に置き換え）
+    QString preview(int index, int length = 60) const;
+
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+    static QString defaultPath();
+
+private:
+    ClipboardRing();
+
+    struct Entry {
+        QString text;
+        size_t hash;
+    };
+
+    static qint64 bytesOf(const QString &text) { return qint64(text.size()) * qint64(sizeof(QChar)); }
+    void trim();
+
+    QVector<Entry> entries;   // 先頭が最新
+    qint64 totalBytes;
+    int maxEntries;
+    qint64 budget;
+};
+
+#endif // CLIPBOARDRING_H
@@ -0,0 +1,198 @@
+#include "ColumnBlock.h"
+#include "TextUtils.h"
+#include <QStringList>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+
+namespace {
+
+// 文字の桁幅（タブは次のタブ位置まで）
+int widthAt(QStringView line, int index, int column, int tabColumns, int *units)
+{
+    const QChar ch = line.at(index);
+    *units = 1;
+    if (ch == QLatin1Char('\t')) {
+        return tabColumns - column % tabColumns;
+    }
+    char32_t cp = ch.unicode();
+    if (ch.isHighSurrogate() && index + 1 < line.size() && line.at(index + 1).isLowSurrogate()) {
+        cp = QChar::surrogateToUcs4(ch, line.at(index + 1));
+        *units = 2;
+    }
+    return TextUtils::displayWidth(cp);
+}
+
+// 貼り付ける文字列を行に分ける。QTextDocument から取った文字列は段落を U+2029 で区切る
+QList<QStringView> splitLines(QStringView text)
+{
+    QList<QStringView> pieces;
+    qsizetype start = 0;
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        if (text.at(i) == QLatin1Char('\n') || text.at(i) == QChar::ParagraphSeparator) {
+            pieces.append(text.mid(start, i - start));
+            start = i + 1;
+        }
+    }
+    pieces.append(text.mid(start));
+    return pieces;
+}
+
+QString spaces(int count)
+{
+    return count > 0 ? QString(count, QLatin1Char(' ')) : QString();
+}
+
+// [firstLine, firstLine + lines.size()) の行を置き換える。文書より先の行は末尾に追加する
+// 前後の変わらない行は除いて、残りを1回の insertText で置き換える
+void replaceLines(QTextDocument *document, int firstLine, QStringList lines, const QStringList &original)
+{
+    int first = 0;
+    while (first < original.size() && first < lines.size() && lines.at(first) == original.at(first)) {
+        ++first;
+    }
+    if (first == lines.size()) return;
+    int last = lines.size() - 1;
+    while (last > first && last < original.size() && lines.at(last) == original.at(last)) {
+        --last;
+    }
+
+    const QTextBlock startBlock = document->findBlockByNumber(firstLine + first);
+    const int existingLast = qMin(last, int(original.size()) - 1);
+    QTextCursor cursor(document);
+    if (first < original.size()) {
+        const QTextBlock endBlock = document->findBlockByNumber(firstLine + existingLast);
+        cursor.setPosition(startBlock.position());
+        cursor.setPosition(endBlock.position() + endBlock.length() - 1, QTextCursor::KeepAnchor);
+    } else {
+        // すべて文書末尾より後ろの行
+        cursor.movePosition(QTextCursor::End);
+        lines[first].prepend(QChar::ParagraphSeparator);
+    }
+
+    QString text;
+    for (int i = first; i <= last; ++i) {
+        if (i > first) text += QChar::ParagraphSeparator;
+        text += lines.at(i);
+    }
+    cursor.beginEditBlock();
+    cursor.insertText(text);
+    cursor.endEditBlock();
+}
+
+QStringList linesOf(const QTextDocument *document, int firstLine, int lastLine)
+{
+    QStringList lines;
+    lines.reserve(lastLine - firstLine + 1);
+    int line = firstLine;
+    for (QTextBlock block = document->findBlockByNumber(firstLine);
+         block.isValid() && line <= lastLine; block = block.next(), ++line) {
+        lines.append(block.text());
+    }
+    return lines;
+}
+
+}
+
+namespace ColumnBlock {
+
+Span span(QStringView line, int left, int right, int tabColumns)
+{
+    Span result{-1, -1, 0, 0};
+    int column = 0;
+    int index = 0;
+    while (index < line.size()) {
+        if (result.from < 0 && column >= left) {
+            result.from = index;
+            result.startColumn = column;
+        }
+        if (column >= right) break;
+        int units = 1;
+        const int width = widthAt(line, index, column, tabColumns, &units);
+        if (column + width > right) break;
+        column += width;
+        index += units;
+    }
+    if (result.from < 0) {
+        result.from = index;
+        result.startColumn = column;
+    }
+    result.to = index;
+    result.endColumn = column;
+    return result;
+}
+
+int columnAt(QStringView line, int offset, int tabColumns)
+{
+    int column = 0;
+    int index = 0;
+    while (index < offset && index < line.size()) {
+        int units = 1;
+        column += widthAt(line, index, column, tabColumns, &units);
+        index += units;
+    }
+    return column;
+}
+
+QString copy(const QTextDocument *document, const Range &range, int tabColumns)
+{
+    QString result;
+    int line = range.firstLine;
+    for (QTextBlock block = document->findBlockByNumber(range.firstLine);
+         block.isValid() && line <= range.lastLine; block = block.next(), ++line) {
+        if (line > range.firstLine) result += QLatin1Char('\n');
+        const QString text = block.text();
+        const Span s = span(text, range.left, range.right, tabColumns);
+        result += QStringView(text).mid(s.from, s.to - s.from);
+    }
+    return result;
+}
+
+void remove(QTextDocument *document, const Range &range, int tabColumns)
+{
+    const QStringList original = linesOf(document, range.firstLine, range.lastLine);
+    QStringList lines;
+    lines.reserve(original.size());
+    for (const QString &text : original) {
+        const Span s = span(text, range.left, range.right, tabColumns);
+        lines.append(s.from == s.to ? text : text.left(s.from) + text.mid(s.to));
+    }
+    replaceLines(document, range.firstLine, lines, original);
+}
+
+void paste(QTextDocument *document, int firstLine, int column, QStringView text, int tabColumns)
+{
+    const QList<QStringView> pieces = splitLines(text);
+    const QStringList original = linesOf(document, firstLine, firstLine + int(pieces.size()) - 1);
+    QStringList lines;
+    lines.reserve(pieces.size());
+    for (int i = 0; i < pieces.size(); ++i) {
+        const QString line = i < original.size() ? original.at(i) : QString();
+        const Span s = span(line, column, column, tabColumns);
+        QStringView piece = pieces.at(i);
+        if (piece.endsWith(QLatin1Char('\r'))) piece.chop(1);
+        lines.append(line.left(s.from) + spaces(column - s.startColumn) + piece.toString() + line.mid(s.from));
+    }
+    replaceLines(document, firstLine, lines, original);
+}
+
+void fill(QTextDocument *document, const Range &range, QChar fillCharacter, int tabColumns)
+{
+    const int fillWidth = TextUtils::displayWidth(fillCharacter.unicode());
+    const QStringList original = linesOf(document, range.firstLine, range.lastLine);
+    QStringList lines;
+    lines.reserve(original.size());
+    for (const QString &text : original) {
+        const Span s = span(text, range.left, range.right, tabColumns);
+        // 短い行は left まで空白で埋め、行末まで届く範囲は right まで埋める
+        const int start = qMax(s.startColumn, range.left);
+        const int end = s.to == text.size() ? range.right : s.endColumn;
+        const int width = qMax(0, end - start);
+        const QString filled = spaces(range.left - s.startColumn)
+                               + QString(width / fillWidth, fillCharacter) + spaces(width % fillWidth);
+        lines.append(text.left(s.from) + filled + text.mid(s.to));
+    }
+    replaceLines(document, range.firstLine, lines, original);
+}
+
+} // namespace ColumnBlock
@@ -0,0 +1,44 @@
+#ifndef COLUMNBLOCK_H
+#define COLUMNBLOCK_H
+
+#include <QString>
+#include <QStringView>
+
+class QTextDocument;
+
+// 矩形（桁）ブロックの操作（Ctrl+K,N の桁ブロックモード）
+// 桁は等幅表示での位置で数える（全角・CJKは2桁、タブは次のタブ位置まで）
+// 書き換えは対象行をまとめて1回で置き換えるので、行数が多くても1つの編集になる
+namespace ColumnBlock {
+
+struct Range {
+    int firstLine;   // ブロック番号
+    int lastLine;
+    int left;        // 桁 [left, right)
+    int right;
+};
+
+// 行のうち桁範囲に収まる文字の位置 [from, to)。境界をまたぐ全角文字は含めない
+// 行が left より短いときは from == to == 行末で、startColumn は行末の桁になる
+struct Span {
+    int from;
+    int to;
+    int startColumn;   // from の桁
+    int endColumn;     // to の桁
+};
+
+Span span(QStringView line, int left, int right, int tabColumns);
+int columnAt(QStringView line, int offset, int tabColumns);
+
+// 矩形の文字列を行ごとに '\n' で区切って返す
+QString copy(const QTextDocument *document, const Range &range, int tabColumns);
+void remove(QTextDocument *document, const Range &range, int tabColumns);
+// 各行の column の位置へ text の各行を挿入する（短い行は空白で埋め、足りない行は追加）
+// text の行は '\n' と U+2029（段落区切り）のどちらで区切ってもよい
+void paste(QTextDocument *document, int firstLine, int column, QStringView text, int tabColumns);
+// 矩形を fill の繰り返しで埋める
+void fill(QTextDocument *document, const Range &range, QChar fill, int tabColumns);
+
+} // namespace ColumnBlock
+
+#endif // COLUMNBLOCK_H
@@ -0,0 +1,100 @@
+#include "DocumentMemory.h"
+#include "DocumentUndo.h"
+#include <QAbstractTextDocumentLayout>
+#include <QFontMetricsF>
+#include <QHash>
+#include <QLocale>
+#include <QStringList>
+#include <QTextDocument>
+
+namespace {
+// QTextDocument の内部構造の大きさの目安（Qt 6 の 64 ビット版）
+const qint64 BlockBytes = 112;     // ブロックとフラグメントの木の節
+const qint64 LayoutBytes = 400;    // QTextLayout と QTextEngine
+const qint64 LineBytes = 56;       // 1行分の QScriptLine
+
+QString formatSize(qint64 bytes)
+{
+    return QLocale().formattedDataSize(bytes, 1, QLocale::DataSizeTraditionalFormat);
+}
+
+// 文書ごとの前回の本文・レイアウトの見積もり（UI スレッドだけで使う）
+struct Measured {
+    int revision;
+    qreal height;
+    qint64 text;
+    qint64 layout;
+};
+QHash<const QTextDocument*, Measured> measuredDocuments;
+}
+
+DocumentMemory &DocumentMemory::operator+=(const DocumentMemory &other)
+{
+    text += other.text;
+    layout += other.layout;
+    undo += other.undo;
+    clipboard += other.clipboard;
+    search += other.search;
+    selections += other.selections;
+    return *this;
+}
+
+DocumentMemory DocumentMemory::measure(const QTextDocument *document)
+{
+    DocumentMemory memory;
+    if (!document) return memory;
+
+    // 文書の高さは表示したときのレイアウトで決まる（未表示の文書では 0）
+    const qreal height = document->documentLayout()->documentSize().height();
+    auto measured = measuredDocuments.find(document);
+    if (measured == measuredDocuments.end()) {
+        QObject::connect(document, &QObject::destroyed, [document]() { measuredDocuments.remove(document); });
+        measured = measuredDocuments.insert(document, Measured{-1, 0, 0, 0});
+    }
+    if (measured->revision != document->revision() || measured->height != height) {
+        const qint64 blocks = document->blockCount();
+        measured->revision = document->revision();
+        measured->height = height;
+        measured->text = qint64(document->characterCount()) * qint64(sizeof(QChar));
+        measured->layout = blocks * BlockBytes;
+        // 表示した文書はブロックごとにレイアウトを持つ。折り返しを含む行数は高さを行の高さで割って求める
+        if (height > 0) {
+            const qreal lineHeight = QFontMetricsF(document->defaultFont()).lineSpacing();
+            const qint64 lines = lineHeight > 0 ? qMax(blocks, qint64(height / lineHeight)) : blocks;
+            measured->layout += blocks * LayoutBytes + lines * LineBytes;
+        }
+    }
+    memory.text = measured->text;
+    memory.layout = measured->layout;
+    if (const DocumentUndo *history = DocumentUndo::forDocument(document)) {
+        memory.undo = history->memoryUsage();
+    }
+    return memory;
+}
+
+QString DocumentMemory::report() const
+{
+    const QList<QPair<QString, qint64>> rows = {
+        {"Text", text}, {"Layout", layout}, {"Undo", undo},
+        {"Clipboard", clipboard}, {"Search", search}, {"Selections", selections},
+        {"Total", total()},
+    };
+    QString result;
+    for (const auto &row : rows) {
+        result += QString("%1 %2\n").arg(row.first, -11).arg(formatSize(row.second), 10);
+    }
+    return result;
+}
+
+QString DocumentMemory::summary() const
+{
+    const QList<QPair<QString, qint64>> items = {
+        {"text", text}, {"layout", layout}, {"undo", undo},
+        {"clipboard", clipboard}, {"search", search}, {"selections", selections},
+    };
+    QStringList parts;
+    for (const auto &item : items) {
+        if (item.second > 0) parts << item.first + " " + formatSize(item.second);
+    }
+    return parts.isEmpty() ? formatSize(0) : parts.join(", ");
+}
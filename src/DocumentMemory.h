@@ -0,0 +1,32 @@
+#ifndef DOCUMENTMEMORY_H
+#define DOCUMENTMEMORY_H
+
+#include <QString>
+#include <QtGlobal>
+
+class QTextDocument;
+
+// 文書ごとのメモリの内訳（表示 > Memory Usage と wledit --batch --memory で表示する）
+// QTextDocument の内部は公開されていないので、レイアウトはブロック数と、文書の高さから求めた
+// 行数による見積もり（ブロックを1つずつ見ないので、大きな文書でも毎秒測り直せる）
+// 文書だけで決まる分（本文・レイアウト・取り消し履歴）は measure で求め、
+// エディタが持つ分（クリップボード履歴・検索の要約・追加の選択表示）は MainWindow::documentMemory が足す
+struct DocumentMemory {
+    qint64 text = 0;         // 本文（UTF-16）。バッチでは同時に持っていた行の最大
+    qint64 layout = 0;       // ブロック・行レイアウト（見積もり）
+    qint64 undo = 0;         // DocumentUndo（本文の写しと履歴）
+    qint64 clipboard = 0;    // クリップボード履歴（全文書で共有。表示中の文書に数える）
+    qint64 search = 0;       // 検索ヒットと行の要約（オーバービュールーラー）
+    qint64 selections = 0;   // ブロック表示などの追加の選択（ExtraSelection）
+
+    qint64 total() const { return text + layout + undo + clipboard + search + selections; }
+    DocumentMemory &operator+=(const DocumentMemory &other);
+
+    // 本文とレイアウトは文書の版（revision）と高さが変わるまで前回の値を使う
+    static DocumentMemory measure(const QTextDocument *document);
+    // 1項目1行の表（診断ダイアログ用）と、0 でない項目だけの1行の要約（バッチ出力用）
+    QString report() const;
+    QString summary() const;
+};
+
+#endif // DOCUMENTMEMORY_H
@@ -0,0 +1,60 @@
+#include "DocumentRange.h"
+#include <QTextCursor>
+#include <QTextDocument>
+
+namespace DocumentRange {
+
+int chunkEnd(const QTextDocument *document, int position, int to, int chunkCharacters)
+{
+    int end = int(qMin<qint64>(qint64(position) + chunkCharacters, to));
+    if (end < to && end > position + 1 && document->characterAt(end - 1).isHighSurrogate()) {
+        --end;
+    }
+    return end;
+}
+
+QString text(QTextDocument *document, int from, int to)
+{
+    QTextCursor cursor(document);
+    cursor.setPosition(from);
+    cursor.setPosition(to, QTextCursor::KeepAnchor);
+    return cursor.selectedText();
+}
+
+void move(QTextDocument *document, int start, int end, int target, int chunkCharacters)
+{
+    // 1チャンクずつ「挿入してから元を削除」する
+    // ・後ろへ移すときは先頭のチャンクから。挿入位置も元の開始位置も変わらない
+    // ・前へ移すときは末尾のチャンクから。毎回同じ挿入位置に入れると順序が保たれる
+    //   挿入した分だけ元の範囲の残りが後ろへずれるので、移し終えた文字数を足して読む
+    QTextCursor cursor(document);
+    if (target > end) {
+        for (int remaining = end - start; remaining > 0; ) {
+            const int chunk = chunkEnd(document, start, start + remaining, chunkCharacters) - start;
+            const QString chunkText = text(document, start, start + chunk);
+            cursor.setPosition(target);
+            cursor.insertText(chunkText);
+            cursor.setPosition(start);
+            cursor.setPosition(start + chunk, QTextCursor::KeepAnchor);
+            cursor.removeSelectedText();
+            remaining -= chunk;
+        }
+    } else {
+        for (int sourceEnd = end; sourceEnd > start; ) {
+            const int shift = end - sourceEnd;
+            int chunkStart = qMax(start, sourceEnd - chunkCharacters);
+            if (chunkStart > start && document->characterAt(chunkStart + shift).isLowSurrogate()) {
+                --chunkStart;
+            }
+            const QString chunkText = text(document, chunkStart + shift, sourceEnd + shift);
+            cursor.setPosition(target);
+            cursor.insertText(chunkText);
+            cursor.setPosition(chunkStart + shift + chunkText.size());
+            cursor.setPosition(sourceEnd + shift + chunkText.size(), QTextCursor::KeepAnchor);
+            cursor.removeSelectedText();
+            sourceEnd = chunkStart;
+        }
+    }
+}
+
+} // namespace DocumentRange
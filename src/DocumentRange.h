@@ -0,0 +1,24 @@
+#ifndef DOCUMENTRANGE_H
+#define DOCUMENTRANGE_H
+
+#include <QString>
+
+class QTextDocument;
+
+// 文書の範囲をチャンク単位で扱う（大きなブロックでも範囲全体の文字列を作らない）
+// 位置は QTextDocument の文字位置。段落区切りは U+2029 のまま取り出す
+namespace DocumentRange {
+
+// 1回に取り出す文字数の既定値
+const int ChunkCharacters = 1 << 20;
+
+// [position, to) から取り出すチャンクの終端（サロゲートペアは分けない）
+int chunkEnd(const QTextDocument *document, int position, int to, int chunkCharacters = ChunkCharacters);
+QString text(QTextDocument *document, int from, int to);
+
+// [start, end) を target へ移す（target は範囲の外）。呼び出し側の編集ブロックに入る
+void move(QTextDocument *document, int start, int end, int target, int chunkCharacters = ChunkCharacters);
+
+} // namespace DocumentRange
+
+#endif // DOCUMENTRANGE_H
@@ -0,0 +1,171 @@
+#include "DocumentStatistics.h"
+#include "TextUtils.h"
+
+DocumentStatistics::Counts &DocumentStatistics::Counts::operator+=(const Counts &other)
+{
+    characters += other.characters;
+    words += other.words;
+    cjk += other.cjk;
+    return *this;
+}
+
+DocumentStatistics::Counts &DocumentStatistics::Counts::operator-=(const Counts &other)
+{
+    characters -= other.characters;
+    words -= other.words;
+    cjk -= other.cjk;
+    return *this;
+}
+
+// BlockStatistics実装
+BlockStatistics::BlockStatistics(const std::shared_ptr<DocumentStatistics::Counts> &total)
+    : total(total)
+{
+}
+
+BlockStatistics::~BlockStatistics()
+{
+    // ブロックが削除・結合されたら合計から差し引く
+    *total -= blockCounts;
+}
+
+void BlockStatistics::update(const DocumentStatistics::Counts &newCounts)
+{
+    *total -= blockCounts;
+    blockCounts = newCounts;
+    *total += blockCounts;
+}
+
+// DocumentStatistics実装
+DocumentStatistics::DocumentStatistics(QObject *parent)
+    : QObject(parent)
+    , total(std::make_shared<Counts>())
+{
+}
+
+DocumentStatistics::~DocumentStatistics()
+{
+}
+
+void DocumentStatistics::setDocument(QTextDocument *document)
+{
+    doc = document;
+    if (!doc) {
+        total = std::make_shared<Counts>();
+        emit changed();
+        return;
+    }
+
+    // 以前に数えた文書は合計をそのまま使う（編集は接続したまま追跡している）
+    auto it = documentTotals.constFind(doc);
+    if (it != documentTotals.constEnd()) {
+        total = it.value();
+    } else {
+        total = std::make_shared<Counts>();
+        documentTotals.insert(doc, total);
+        connect(doc, &QTextDocument::contentsChange,
+                this, &DocumentStatistics::onContentsChange);
+        connect(doc, &QObject::destroyed, this, [this, document]() {
+            documentTotals.remove(document);
+        });
+        recountBlocks(doc->firstBlock(), doc->lastBlock(), total);
+    }
+    emit changed();
+}
+
+int DocumentStatistics::lineCount() const
+{
+    return doc ? doc->blockCount() : 0;
+}
+
+DocumentStatistics::Counts DocumentStatistics::countText(QStringView text)
+{
+    Counts counts;
+    bool inWord = false;
+
+    for (qsizetype i = 0; i < text.size(); ++i) {
+        char32_t cp = text[i].unicode();
+        if (QChar::isHighSurrogate(cp) && i + 1 < text.size() && text[i + 1].isLowSurrogate()) {
+            cp = QChar::surrogateToUcs4(text[i], text[i + 1]);
+            ++i;
+        }
+        counts.characters++;
+
+        if (QChar::isSpace(cp)) {
+            inWord = false;
+        } else if (TextUtils::isCjkCharacter(cp)) {
+            counts.cjk++;
+            counts.words++;
+            inWord = false;
+        } else if (TextUtils::isCjkPunctuation(cp)) {
+            inWord = false;
+        } else if (!inWord) {
+            counts.words++;
+            inWord = true;
+        }
+    }
+    return counts;
+}
+
+DocumentStatistics::Counts DocumentStatistics::countSelection(const QTextCursor &cursor) const
+{
+    Counts counts;
+    if (!doc || !cursor.hasSelection()) return counts;
+
+    const int start = cursor.selectionStart();
+    const int end = cursor.selectionEnd();
+    const QTextBlock first = doc->findBlock(start);
+    const QTextBlock last = doc->findBlock(end);
+
+    // 両端のブロックだけ部分的に数え、中間のブロックはキャッシュ済みの値を使う
+    for (QTextBlock block = first; block.isValid(); block = block.next()) {
+        const int blockStart = block.position();
+        const int blockEnd = blockStart + block.length() - 1;
+        const BlockStatistics *data = dynamic_cast<BlockStatistics*>(block.userData());
+
+        if (start <= blockStart && end >= blockEnd && data && data->belongsTo(total)) {
+            counts += data->counts();
+        } else {
+            const int from = qMax(start, blockStart) - blockStart;
+            const int to = qMin(end, blockEnd) - blockStart;
+            const QString text = block.text();
+            counts += countText(QStringView(text).mid(from, qMax(0, to - from)));
+        }
+
+        if (block == last) break;
+    }
+    return counts;
+}
+
+void DocumentStatistics::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    QTextDocument *changedDoc = qobject_cast<QTextDocument*>(sender());
+    const std::shared_ptr<Counts> owner = documentTotals.value(changedDoc);
+    if (!owner) return;
+
+    QTextBlock first = changedDoc->findBlock(position);
+    QTextBlock last = changedDoc->findBlock(position + charsAdded);
+    if (!first.isValid()) first = changedDoc->lastBlock();
+    if (!last.isValid()) last = changedDoc->lastBlock();
+
+    recountBlocks(first, last, owner);
+    if (changedDoc == doc) {
+        emit changed();
+    }
+}
+
+void DocumentStatistics::recountBlocks(const QTextBlock &first, const QTextBlock &last,
+                                       const std::shared_ptr<Counts> &owner)
+{
+    for (QTextBlock block = first; block.isValid(); block = block.next()) {
+        BlockStatistics *data = dynamic_cast<BlockStatistics*>(block.userData());
+        if (!data || !data->belongsTo(owner)) {
+            data = new BlockStatistics(owner);
+            block.setUserData(data);
+        }
+        data->update(countText(block.text()));
+
+        if (block == last) break;
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef DOCUMENTSTATISTICS_H
+#define DOCUMENTSTATISTICS_H
+
+#include <QObject>
+#include <QHash>
+#include <QPointer>
+#include <QStringView>
+#include <QTextBlock>
+#include <QTextBlockUserData>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <memory>
+
+// 文書統計（行数・単語数・文字数、CJK対応）
+// ブロック（行）ごとのカウンタを QTextBlockUserData に保持し、
+// contentsChange の差分範囲だけを数え直す
+// 一度数えた文書の合計は文書ごとに保持するので、タブを切り替えても数え直さない
+class DocumentStatistics : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Counts {
+        qint64 characters = 0;  // 改行を除くコードポイント数
+        qint64 words = 0;       // 空白区切りの語 + CJK文字（1文字1語）
+        qint64 cjk = 0;         // CJK文字数
+
+        Counts &operator+=(const Counts &other);
+        Counts &operator-=(const Counts &other);
+    };
+
+    explicit DocumentStatistics(QObject *parent = nullptr);
+    ~DocumentStatistics();
+
+    void setDocument(QTextDocument *document);
+    QTextDocument *document() const { return doc; }
+
+    Counts totals() const { return *total; }
+    int lineCount() const;
+    Counts countSelection(const QTextCursor &cursor) const;
+
+    static Counts countText(QStringView text);
+
+signals:
+    void changed();
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    static void recountBlocks(const QTextBlock &first, const QTextBlock &last,
+                              const std::shared_ptr<Counts> &owner);
+
+    QPointer<QTextDocument> doc;
+    std::shared_ptr<Counts> total;
+    QHash<QTextDocument*, std::shared_ptr<Counts>> documentTotals;
+};
+
+// ブロックごとのカウンタ（ブロック削除時に合計から自動で差し引く）
+class BlockStatistics : public QTextBlockUserData
+{
+public:
+    BlockStatistics(const std::shared_ptr<DocumentStatistics::Counts> &total);
+    ~BlockStatistics() override;
+
+    void update(const DocumentStatistics::Counts &newCounts);
+    const DocumentStatistics::Counts &counts() const { return blockCounts; }
+    bool belongsTo(const std::shared_ptr<DocumentStatistics::Counts> &owner) const { return total == owner; }
+
+private:
+    DocumentStatistics::Counts blockCounts;
+    std::shared_ptr<DocumentStatistics::Counts> total;
+};
+
+#endif // DOCUMENTSTATISTICS_H
@@ -0,0 +1,349 @@
+#include "DocumentUndo.h"
+#include "MemoryPressure.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QTextCursor>
+#include <cstring>
+#include <thread>
+
+namespace {
+const char FileMagic[4] = {'W', 'L', 'U', 'D'};
+const int HashLength = 20;   // SHA-1
+
+std::u16string_view toView(const QString &text)
+{
+    return std::u16string_view(reinterpret_cast<const char16_t*>(text.utf16()), size_t(text.size()));
+}
+
+QString fromView(std::u16string_view text)
+{
+    return QString::fromUtf16(text.data(), qsizetype(text.size()));
+}
+
+bool containsParagraphSeparator(std::u16string_view text)
+{
+    return text.find(char16_t(QChar::ParagraphSeparator)) != std::u16string_view::npos;
+}
+}
+
+DocumentUndo::DocumentUndo(QTextDocument *document)
+    : QObject(document)
+    , doc(document)
+    , cleanState(0)
+    , applying(false)
+    , suspended(false)
+    , unchangedText(false)
+    , lastUndoAvailable(false)
+    , lastRedoAvailable(false)
+    , lastLostCount(0)
+{
+    // 標準の undo スタック（編集ごとのコマンドオブジェクト）は使わない
+    doc->setUndoRedoEnabled(false);
+    clock.start();
+
+    connect(doc, &QTextDocument::contentsChange, this, &DocumentUndo::onContentsChange);
+    // Qt は編集ブロックの終わりに contentsChange、modificationChanged、contentsChanged の順に出す
+    connect(doc, &QTextDocument::modificationChanged, this, &DocumentUndo::onModificationChanged);
+    connect(doc, &QTextDocument::contentsChanged, this, [this]() { unchangedText = false; });
+    reset();
+}
+
+void DocumentUndo::setMemoryLimit(qint64 bytes)
+{
+    history.setMemoryLimit(size_t(qMax<qint64>(0, bytes)));
+    emitAvailability();
+}
+
+qint64 DocumentUndo::memoryUsage() const
+{
+    return qint64(history.memoryUsage() + mirror.capacityBytes());
+}
+
+qint64 DocumentUndo::trimMemory(int level)
+{
+    const qint64 before = memoryUsage();
+    if (MemoryPressure::shouldCompact(level)) {
+        mirror.compact();
+    }
+    if (MemoryPressure::shouldSpillUndo(level) && !history.isSpilled()) {
+        // 一意な名前だけ確保し、書き出しは UndoHistory が行う（読み戻した時点で消える）
+        // 書き込みは UI スレッドを止めないよう別スレッドで行う。書き終わる前に編集すればそのまま戻る
+        QTemporaryFile spill(QDir::tempPath() + "/wledit-undo-XXXXXX.spill");
+        spill.setAutoRemove(false);
+        if (spill.open()) {
+            spill.close();
+            std::function<bool()> write = history.beginSpill(QFile::encodeName(spill.fileName()).toStdString());
+            if (write) {
+                std::thread(std::move(write)).detach();
+            } else {
+                QFile::remove(spill.fileName());
+            }
+        }
+    }
+    return qMax<qint64>(0, before - memoryUsage());
+}
+
+QString DocumentUndo::documentText(int from, int to) const
+{
+    if (to <= from) return QString();
+    QTextCursor cursor(doc);
+    cursor.setPosition(from);
+    cursor.setPosition(to, QTextCursor::KeepAnchor);
+    return cursor.selectedText();
+}
+
+void DocumentUndo::reset()
+{
+    suspended = false;
+    resyncMirror();
+}
+
+void DocumentUndo::resyncMirror()
+{
+    const QString text = documentText(0, doc->characterCount() - 1);
+    mirror.assign(toView(text));
+    history.clear();
+    cleanState = history.stateId();
+    emitAvailability();
+}
+
+void DocumentUndo::dropHistory(const QString &reason)
+{
+    const bool hadHistory = history.canUndo() || history.canRedo();
+    resyncMirror();
+    if (hadHistory) {
+        emit historyDropped(reason);
+    }
+}
+
+quint64 DocumentUndo::checkpoint()
+{
+    // 保存後の入力が保存前のステップにまとめられないよう区切る
+    history.breakRun();
+    return history.stateId();
+}
+
+void DocumentUndo::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    if (suspended) return;
+
+    // setPlainText などでは末尾の段落区切りを含んだ値が通知されるので、写しと文書の長さに収める
+    const int documentLength = doc->characterCount() - 1;
+    const int mirrorLength = int(mirror.size());
+    if (position < 0 || position > mirrorLength) {
+        dropHistory("Undo history was cleared: unexpected change notification");
+        return;
+    }
+    const int removedCount = qBound(0, charsRemoved, mirrorLength - position);
+    const int addedCount = qBound(0, charsAdded, documentLength - position);
+    if (mirrorLength - removedCount + addedCount != documentLength) {
+        // 写しと一致しない通知は履歴を保てないので作り直す
+        dropHistory("Undo history was cleared: the document changed unexpectedly");
+        return;
+    }
+
+    const QString inserted = documentText(position, position + addedCount);
+    const std::u16string_view insertedView = toView(inserted);
+
+    if (!applying) {
+        const std::u16string removed = mirror.text(size_t(position), size_t(removedCount));
+
+        // 書式だけの変更や置換範囲の両端など、変わっていない前後を除く
+        size_t prefix = 0;
+        while (prefix < removed.size() && prefix < insertedView.size()
+               && removed[prefix] == insertedView[prefix]) {
+            ++prefix;
+        }
+        size_t suffix = 0;
+        while (suffix < removed.size() - prefix && suffix < insertedView.size() - prefix
+               && removed[removed.size() - 1 - suffix] == insertedView[insertedView.size() - 1 - suffix]) {
+            ++suffix;
+        }
+        const std::u16string_view removedPart = std::u16string_view(removed).substr(prefix, removed.size() - prefix - suffix);
+        const std::u16string_view insertedPart = insertedView.substr(prefix, insertedView.size() - prefix - suffix);
+        unchangedText = removedPart.empty() && insertedPart.empty();
+
+        // 1〜2単位（サロゲートペア）の入力・削除は連続したものを1ステップにまとめる
+        UndoHistory::Kind kind = UndoHistory::Other;
+        if (removedPart.empty() && insertedPart.size() <= 2 && !containsParagraphSeparator(insertedPart)) {
+            kind = UndoHistory::Typing;
+        } else if (insertedPart.empty() && removedPart.size() <= 2 && !containsParagraphSeparator(removedPart)) {
+            kind = UndoHistory::Deleting;
+        }
+        history.record(position + int64_t(prefix), removedPart, insertedPart, kind, clock.elapsed());
+    }
+
+    mirror.replace(size_t(position), size_t(removedCount), insertedView);
+    emitAvailability();
+}
+
+void DocumentUndo::onModificationChanged(bool modified)
+{
+    // 書式だけの変更で変更ありになったら、未変更の状態のままなら戻す
+    if (modified && unchangedText && !suspended && history.stateId() == cleanState) {
+        unchangedText = false;
+        doc->setModified(false);
+    }
+}
+
+int DocumentUndo::undo()
+{
+    return apply(history.undo(), true);
+}
+
+int DocumentUndo::redo()
+{
+    return apply(history.redo(), false);
+}
+
+int DocumentUndo::apply(const std::vector<UndoHistory::Change> &changes, bool reverse)
+{
+    if (changes.empty()) {
+        emitAvailability();   // 読み戻せずに履歴が空になった場合はここで知らせる
+        return -1;
+    }
+
+    // i 番目に適用する変更（取り消しは逆順に inserted を removed へ戻す）
+    const auto changeAt = [&](size_t i, std::u16string_view &from, std::u16string_view &to) {
+        const UndoHistory::Change &change = changes[reverse ? changes.size() - 1 - i : i];
+        from = reverse ? change.inserted : change.removed;
+        to = reverse ? change.removed : change.inserted;
+        return int(change.position);
+    };
+
+    // 先にすべての範囲が文書に収まるかを確かめる
+    qint64 length = doc->characterCount() - 1;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        std::u16string_view from, to;
+        const int start = changeAt(i, from, to);
+        if (start < 0 || start + qint64(from.size()) > length) {
+            dropHistory("Undo history was cleared: it no longer matches the document");
+            return -1;
+        }
+        length += qint64(to.size()) - qint64(from.size());
+    }
+
+    // 置き換える文字列が履歴と違えば、そこまでの変更を同じ編集ブロックの中で戻してやめる
+    // （編集ブロックの中では contentsChange がまだ来ないので、写しではなく文書と比べる）
+    int caret = -1;
+    size_t applied = 0;
+    applying = true;
+    QTextCursor cursor(doc);
+    cursor.beginEditBlock();
+    for (; applied < changes.size(); ++applied) {
+        std::u16string_view from, to;
+        const int start = changeAt(applied, from, to);
+        if (toView(documentText(start, start + int(from.size()))) != from) {
+            break;
+        }
+        cursor.setPosition(start);
+        cursor.setPosition(start + int(from.size()), QTextCursor::KeepAnchor);
+        cursor.insertText(fromView(to));
+        caret = start + int(to.size());
+    }
+    const bool complete = applied == changes.size();
+    while (!complete && applied > 0) {
+        std::u16string_view from, to;
+        const int start = changeAt(--applied, from, to);
+        cursor.setPosition(start);
+        cursor.setPosition(start + int(to.size()), QTextCursor::KeepAnchor);
+        cursor.insertText(fromView(from));
+    }
+    cursor.endEditBlock();
+    applying = false;
+    if (!complete) {
+        dropHistory("Undo history was cleared: it no longer matches the document");
+        return -1;
+    }
+
+    doc->setModified(history.stateId() != cleanState);
+    emitAvailability();
+    return caret;
+}
+
+void DocumentUndo::emitAvailability()
+{
+    if (history.lostCount() != lastLostCount) {
+        lastLostCount = history.lostCount();
+        emit historyDropped("Undo history was cleared: the spilled copy could not be read back");
+    }
+    const bool undoNow = history.canUndo();
+    const bool redoNow = history.canRedo();
+    if (undoNow != lastUndoAvailable) {
+        lastUndoAvailable = undoNow;
+        emit undoAvailable(undoNow);
+    }
+    if (redoNow != lastRedoAvailable) {
+        lastRedoAvailable = redoNow;
+        emit redoAvailable(redoNow);
+    }
+}
+
+QByteArray DocumentUndo::textHash() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (const std::u16string_view part : {mirror.before(), mirror.after()}) {
+        hash.addData(QByteArray::fromRawData(reinterpret_cast<const char*>(part.data()),
+                                             qsizetype(part.size() * sizeof(char16_t))));
+    }
+    return hash.result();
+}
+
+bool DocumentUndo::save(const QString &path) const
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    // 形式: "WLUD" / 本文の SHA-1 / 未変更状態の番号 / 履歴本体
+    const quint64 clean = cleanState;
+    const std::string body = history.serialize();
+    file.write(FileMagic, sizeof(FileMagic));
+    file.write(textHash());
+    file.write(reinterpret_cast<const char*>(&clean), sizeof(clean));
+    file.write(body.data(), qint64(body.size()));
+    return file.commit();
+}
+
+bool DocumentUndo::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const QByteArray data = file.readAll();
+    const int headerLength = int(sizeof(FileMagic)) + HashLength + int(sizeof(quint64));
+    if (data.size() < headerLength || !data.startsWith(QByteArray(FileMagic, sizeof(FileMagic)))) {
+        return false;
+    }
+
+    // 別の内容に対する履歴は適用できない
+    if (data.mid(sizeof(FileMagic), HashLength) != textHash()) {
+        return false;
+    }
+
+    quint64 clean = 0;
+    std::memcpy(&clean, data.constData() + sizeof(FileMagic) + HashLength, sizeof(clean));
+    if (!history.deserialize(std::string_view(data.constData() + headerLength, size_t(data.size() - headerLength)))) {
+        return false;
+    }
+    history.breakRun();
+    cleanState = clean;
+    emitAvailability();
+    return true;
+}
+
+QString DocumentUndo::sidecarPath(const QString &filePath)
+{
+    const QByteArray key = QCryptographicHash::hash(QFileInfo(filePath).absoluteFilePath().toUtf8(),
+                                                    QCryptographicHash::Sha1).toHex();
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+           + "/undo/" + QString::fromLatin1(key) + ".wlundo";
+}
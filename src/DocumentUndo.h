@@ -0,0 +1,92 @@
+#ifndef DOCUMENTUNDO_H
+#define DOCUMENTUNDO_H
+
+#include "GapBuffer.h"
+#include "UndoHistory.h"
+#include <QObject>
+#include <QElapsedTimer>
+#include <QString>
+#include <QTextDocument>
+
+// QTextDocument 用の取り消し履歴（QTextDocument 標準の undo スタックの代わり）
+// contentsChange から差分を作るため、削除された文字列を取り出せるよう
+// 文書本文の写しをギャップバッファで持つ。編集ブロック単位で1ステップになるので、
+// 置換（すべて）は変更範囲全体の1つの差分として記録・取り消しされる
+// 1ステップの適用は1つの編集ブロックで、全部の変更が文書と合うときだけ行う（途中で止めない）
+// 履歴が文書と合わなくなって捨てたときは historyDropped で知らせる
+// 文書の undo を切ると Qt は書式だけの変更（構文ハイライトなど）でも変更ありにするので、
+// 本文の変わらない変更の後は履歴の状態から変更ありかどうかを決め直す
+class DocumentUndo : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 文書の子として作成し、文書の undo/redo を無効にする
+    explicit DocumentUndo(QTextDocument *document);
+    static DocumentUndo *forDocument(const QTextDocument *document)
+    {
+        return document ? document->findChild<DocumentUndo*>(QString(), Qt::FindDirectChildrenOnly) : nullptr;
+    }
+
+    void setMemoryLimit(qint64 bytes);
+
+    bool isUndoAvailable() const { return history.canUndo(); }
+    bool isRedoAvailable() const { return history.canRedo(); }
+    int undoDepth() const { return int(history.undoDepth()); }
+    qint64 memoryUsage() const;
+    // メモリ不足への対応（level は MemoryPressure::Level）。本文の写しのギャップを詰め、
+    // 段階によっては履歴の文字列を一時ファイルへ書き出す。減ったバイト数を返す
+    qint64 trimMemory(int level);
+
+    // 取り消し／やり直し。適用後のカーソル位置を返す（何もしなければ -1）
+    int undo();
+    int redo();
+
+    // 現在の内容を基準にして履歴を空にする（ファイル読み込み後など）
+    void reset();
+    // 次の reset() まで変更を記録しない（setPlainText で全文を履歴に積まないため）
+    void suspend() { suspended = true; }
+
+    // 保存開始時の状態番号を取り、保存完了時にその状態を未変更として記録する
+    quint64 checkpoint();
+    quint64 stateId() const { return history.stateId(); }
+    void markClean(quint64 state) { cleanState = state; }
+
+    // 履歴をファイルへ保存／読み込み（本文のハッシュが一致するときだけ読み込む）
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+    // ファイルごとの履歴の保存先（アプリケーションデータ領域）
+    static QString sidecarPath(const QString &filePath);
+
+signals:
+    void undoAvailable(bool available);
+    void redoAvailable(bool available);
+    // 履歴を使えなくなって空にした（reset() では出さない）
+    void historyDropped(const QString &reason);
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void onModificationChanged(bool modified);
+
+private:
+    QString documentText(int from, int to) const;
+    QByteArray textHash() const;
+    void resyncMirror();
+    void dropHistory(const QString &reason);
+    int apply(const std::vector<UndoHistory::Change> &changes, bool reverse);
+    void emitAvailability();
+
+    QTextDocument *doc;
+    UndoHistory history;
+    GapBuffer mirror;          // 文書本文の写し（段落区切りは U+2029）
+    QElapsedTimer clock;
+    quint64 cleanState;
+    bool applying;
+    bool suspended;
+    bool unchangedText;        // 直前の変更通知で本文が変わらなかった（contentsChanged まで）
+    bool lastUndoAvailable;
+    bool lastRedoAvailable;
+    quint64 lastLostCount;
+};
+
+#endif // DOCUMENTUNDO_H
@@ -0,0 +1,205 @@
+#include "DocumentWorkspace.h"
+#include "DocumentUndo.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryFile>
+#include <QTextStream>
+
+namespace {
+const int IdleCheckIntervalMs = 30 * 1000;
+
+// 一時ファイルの名前だけを確保する（中身は呼び出し側が書く）
+QString reserveTemporaryPath(const QString &pattern)
+{
+    QTemporaryFile file(QDir::tempPath() + "/" + pattern);
+    file.setAutoRemove(false);
+    if (!file.open()) {
+        return QString();
+    }
+    return file.fileName();
+}
+}
+
+DocumentWorkspace::DocumentWorkspace(QObject *parent)
+    : QObject(parent)
+    , activeIndex(-1)
+    , hibernateMinutes(10)
+    , idleTimer(new QTimer(this))
+{
+    idleTimer->setInterval(IdleCheckIntervalMs);
+    connect(idleTimer, &QTimer::timeout, this, &DocumentWorkspace::hibernateIdleDocuments);
+    idleTimer->start();
+}
+
+DocumentWorkspace::~DocumentWorkspace()
+{
+    // 退避ファイルは終了時に削除
+    for (const Entry &e : entries) {
+        if (!e.spillPath.isEmpty()) {
+            QFile::remove(e.spillPath);
+        }
+        if (!e.undoSpillPath.isEmpty()) {
+            QFile::remove(e.undoSpillPath);
+        }
+    }
+}
+
+void DocumentWorkspace::setDocumentFactory(const DocumentFactory &factory)
+{
+    documentFactory = factory;
+}
+
+int DocumentWorkspace::indexOf(const QTextDocument *document) const
+{
+    for (int i = 0; i < entries.size(); ++i) {
+        if (entries.at(i).document == document) return i;
+    }
+    return -1;
+}
+
+int DocumentWorkspace::addDocument(const QString &filePath)
+{
+    Entry e;
+    e.document = documentFactory(filePath);
+    e.filePath = filePath;
+    e.lastActive = QDateTime::currentMSecsSinceEpoch();
+    entries.append(e);
+    return entries.size() - 1;
+}
+
+void DocumentWorkspace::removeDocument(int index)
+{
+    Entry e = entries.takeAt(index);
+    if (!e.spillPath.isEmpty()) {
+        QFile::remove(e.spillPath);
+    }
+    if (!e.undoSpillPath.isEmpty()) {
+        QFile::remove(e.undoSpillPath);
+    }
+    delete e.document;
+
+    if (activeIndex == index) {
+        activeIndex = -1;
+    } else if (activeIndex > index) {
+        --activeIndex;
+    }
+}
+
+QTextDocument *DocumentWorkspace::activate(int index)
+{
+    if (index < 0 || index >= entries.size()) return nullptr;
+
+    if (isHibernated(index) && !restore(index)) {
+        return nullptr;
+    }
+
+    // 直前まで使っていた文書の最終使用時刻も更新しておく
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (activeIndex >= 0 && activeIndex < entries.size()) {
+        entries[activeIndex].lastActive = now;
+    }
+    activeIndex = index;
+    entries[index].lastActive = now;
+    return entries[index].document;
+}
+
+void DocumentWorkspace::setHibernateAfter(int minutes)
+{
+    hibernateMinutes = qMax(0, minutes);
+}
+
+void DocumentWorkspace::hibernateIdleDocuments()
+{
+    if (hibernateMinutes <= 0) return;
+
+    const qint64 threshold = QDateTime::currentMSecsSinceEpoch() - qint64(hibernateMinutes) * 60 * 1000;
+    for (int i = 0; i < entries.size(); ++i) {
+        if (i == activeIndex || isHibernated(i)) continue;
+        if (entries.at(i).lastActive < threshold && hibernate(i)) {
+            emit hibernationChanged(i);
+        }
+    }
+}
+
+bool DocumentWorkspace::hibernate(int index)
+{
+    Entry &e = entries[index];
+    e.modified = e.document->isModified();
+
+    // 変更がある、またはファイルに対応しない文書は本文を退避する
+    if (e.modified || e.filePath.isEmpty()) {
+        if (e.document->isEmpty()) {
+            e.spillPath.clear();
+        } else {
+            QTemporaryFile spill(QDir::tempPath() + "/wledit-spill-XXXXXX.txt");
+            spill.setAutoRemove(false);
+            if (!spill.open()) {
+                return false;
+            }
+            QTextStream out(&spill);
+            out << e.document->toPlainText();
+            out.flush();
+            if (spill.error() != QFileDevice::NoError) {
+                spill.remove();
+                return false;
+            }
+            e.spillPath = spill.fileName();
+        }
+    }
+    
+    DocumentUndo *undo = DocumentUndo::forDocument(e.document);
+    if (undo && (undo->isUndoAvailable() || undo->isRedoAvailable())) {
+        e.undoSpillPath = reserveTemporaryPath("wledit-undo-XXXXXX");
+        if (e.undoSpillPath.isEmpty() || !undo->save(e.undoSpillPath)) {
+            // 履歴を退避できなくても本文は失わないので休止は続ける
+            QFile::remove(e.undoSpillPath);
+            e.undoSpillPath.clear();
+        }
+    }
+
+    delete e.document;
+    e.document = nullptr;
+    return true;
+}
+
+bool DocumentWorkspace::restore(int index)
+{
+    Entry &e = entries[index];
+
+    QString text;
+    const QString source = e.spillPath.isEmpty() ? e.filePath : e.spillPath;
+    if (!source.isEmpty()) {
+        QFile file(source);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            return false;
+        }
+        QTextStream in(&file);
+        text = in.readAll();
+    }
+
+    e.document = documentFactory(e.filePath);
+    DocumentUndo *undo = DocumentUndo::forDocument(e.document);
+    if (undo) {
+        undo->suspend();
+    }
+    e.document->setPlainText(text);
+    if (undo) {
+        undo->reset();
+        if (!e.undoSpillPath.isEmpty()) {
+            undo->load(e.undoSpillPath);
+        }
+    }
+    e.document->setModified(e.modified);
+
+    if (!e.spillPath.isEmpty()) {
+        QFile::remove(e.spillPath);
+        e.spillPath.clear();
+    }
+    if (!e.undoSpillPath.isEmpty()) {
+        QFile::remove(e.undoSpillPath);
+        e.undoSpillPath.clear();
+    }
+    emit hibernationChanged(index);
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef DOCUMENTWORKSPACE_H
+#define DOCUMENTWORKSPACE_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+#include <QTextDocument>
+#include <QTimer>
+#include <functional>
+
+// タブで開いている複数文書の管理
+// 一定時間使われていない文書は休止（ハイバネート）させてメモリを解放する：
+// ・未変更でファイルがある文書 → 文書ごと破棄し、再表示時にファイルから読み直す
+// ・変更あり／無題の文書       → 本文を一時ファイルへ退避してから破棄する
+// 取り消し履歴も一時ファイルへ退避し、復元時に読み戻す（レイアウトは再表示時に作り直す）
+class DocumentWorkspace : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Entry {
+        QTextDocument *document = nullptr;  // 休止中は nullptr
+        QString filePath;
+        QString spillPath;                  // 退避先の一時ファイル
+        QString undoSpillPath;              // 取り消し履歴の退避先
+        bool modified = false;
+        int cursorPosition = 0;
+        int scrollValue = 0;
+        qint64 lastActive = 0;              // QDateTime::currentMSecsSinceEpoch()
+    };
+
+    explicit DocumentWorkspace(QObject *parent = nullptr);
+    ~DocumentWorkspace();
+
+    // 新しい文書を作る関数（ハイライタ等の付加も含めて呼び出し側が用意）
+    using DocumentFactory = std::function<QTextDocument*(const QString &filePath)>;
+    void setDocumentFactory(const DocumentFactory &factory);
+
+    int count() const { return entries.size(); }
+    int indexOf(const QTextDocument *document) const;
+    Entry &entry(int index) { return entries[index]; }
+    const Entry &entry(int index) const { return entries[index]; }
+    bool isHibernated(int index) const { return entries.at(index).document == nullptr; }
+
+    int addDocument(const QString &filePath);
+    void removeDocument(int index);
+
+    // 文書を使用中にする（休止中なら復元）。失敗時は nullptr
+    QTextDocument *activate(int index);
+
+    void setHibernateAfter(int minutes);
+    int hibernateAfter() const { return hibernateMinutes; }
+
+signals:
+    void hibernationChanged(int index);
+
+private slots:
+    void hibernateIdleDocuments();
+
+private:
+    bool hibernate(int index);
+    bool restore(int index);
+
+    QList<Entry> entries;
+    int activeIndex;
+    int hibernateMinutes;
+    QTimer *idleTimer;
+    DocumentFactory documentFactory;
+};
+
+#endif // DOCUMENTWORKSPACE_H
@@ -0,0 +1,85 @@
+#include "KeyMacro.h"
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QKeyEvent>
+#include <QSaveFile>
+
+namespace {
+const char FormatName[] = "wledit-keys";
+const int FormatVersion = 1;
+}
+
+void KeyMacro::append(const QKeyEvent *event, qint64 time)
+{
+    Event recorded;
+    recorded.key = event->key();
+    recorded.modifiers = event->modifiers();
+    recorded.text = event->text();
+    recorded.time = time;
+    events.append(recorded);
+}
+
+QByteArray KeyMacro::toJson() const
+{
+    QJsonArray list;
+    for (const Event &event : events) {
+        QJsonObject object;
+        object["key"] = event.key;
+        object["modifiers"] = int(event.modifiers);
+        if (!event.text.isEmpty()) object["text"] = event.text;
+        object["time"] = event.time;
+        list.append(object);
+    }
+    QJsonObject root;
+    root["format"] = QString::fromLatin1(FormatName);
+    root["version"] = FormatVersion;
+    root["events"] = list;
+    if (!recordedSettings.isEmpty()) root["settings"] = QJsonObject::fromVariantMap(recordedSettings);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool KeyMacro::fromJson(const QByteArray &json)
+{
+    const QJsonDocument document = QJsonDocument::fromJson(json);
+    const QJsonObject root = document.object();
+    if (root.value("format").toString() != QLatin1String(FormatName)
+        || root.value("version").toInt() != FormatVersion) {
+        return false;
+    }
+
+    QVector<Event> loaded;
+    for (const QJsonValue &value : root.value("events").toArray()) {
+        const QJsonObject object = value.toObject();
+        Event event;
+        event.key = object.value("key").toInt();
+        event.modifiers = Qt::KeyboardModifiers(object.value("modifiers").toInt());
+        event.text = object.value("text").toString();
+        event.time = qint64(object.value("time").toDouble());
+        if (event.key == 0) return false;
+        loaded.append(event);
+    }
+    events = loaded;
+    recordedSettings = root.value("settings").toObject().toVariantMap();
+    return true;
+}
+
+bool KeyMacro::save(const QString &path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(toJson());
+    return file.commit();
+}
+
+bool KeyMacro::load(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return fromJson(file.readAll());
+}
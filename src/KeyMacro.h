@@ -0,0 +1,46 @@
+#ifndef KEYMACRO_H
+#define KEYMACRO_H
+
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include <Qt>
+
+class QKeyEvent;
+
+// キー操作の記録（キーマクロ）。CustomTextEdit::keyPressEvent を通ったキーをそのまま持つので、
+// Ctrl+Q / Ctrl+K の2段階キーも1キーずつ記録・再生される
+// ファイル形式は JSON（{"format": "wledit-keys", "version": 1, "events": [...], "settings": {...}}）
+class KeyMacro
+{
+public:
+    struct Event {
+        int key = 0;
+        Qt::KeyboardModifiers modifiers;
+        QString text;
+        qint64 time = 0;   // 記録開始からの経過時間（ミリ秒）
+    };
+
+    void append(const QKeyEvent *event, qint64 time);
+    void clear() { events.clear(); }
+    void truncate(int size) { events.resize(qMin(size, int(events.size()))); }
+    bool isEmpty() const { return events.isEmpty(); }
+    int size() const { return events.size(); }
+    const Event &at(int index) const { return events.at(index); }
+
+    // 記録したときの設定（QSettings のキーと値）。再生で同じキー割り当て・折り返し幅にするため
+    // 操作全体の記録（--record-keys）だけが持ち、キーマクロでは空のまま
+    void setSettings(const QVariantMap &values) { recordedSettings = values; }
+    const QVariantMap &settings() const { return recordedSettings; }
+
+    QByteArray toJson() const;
+    bool fromJson(const QByteArray &json);
+    bool save(const QString &path) const;
+    bool load(const QString &path);
+
+private:
+    QVector<Event> events;
+    QVariantMap recordedSettings;
+};
+
+#endif // KEYMACRO_H
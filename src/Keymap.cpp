@@ -0,0 +1,162 @@
+#include "Keymap.h"
+#include <QKeySequence>
+#include <QSettings>
+#include <QStringList>
+#include <QtDebug>
+
+Keymap::Keymap()
+{
+    clear();
+}
+
+void Keymap::setCommands(const CommandInfo *commands, int count)
+{
+    commandTable.clear();
+    commandTable.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        commandTable.insert(QString::fromLatin1(commands[i].name), commands[i].function);
+    }
+}
+
+void Keymap::clear()
+{
+    nodes.clear();
+    nodes.emplace_back();
+}
+
+void Keymap::loadDefaults(const Binding *bindings, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        if (!bind(QString::fromLatin1(bindings[i].sequence), QString::fromLatin1(bindings[i].command))) {
+            qWarning() << "Keymap: invalid default binding" << bindings[i].sequence << bindings[i].command;
+        }
+    }
+}
+
+int Keymap::loadOverrides(QSettings &settings)
+{
+    int failed = 0;
+    settings.beginGroup("keymap");
+    const QStringList sequences = settings.childKeys();
+    for (const QString &sequence : sequences) {
+        const QString command = settings.value(sequence).toString();
+        const bool ok = command.isEmpty() ? unbind(sequence) : bind(sequence, command);
+        if (!ok) {
+            qWarning() << "Keymap: cannot apply" << sequence << "=" << command;
+            ++failed;
+        }
+    }
+    settings.endGroup();
+    return failed;
+}
+
+bool Keymap::isModifierKey(int key)
+{
+    return key == Qt::Key_Control || key == Qt::Key_Shift || key == Qt::Key_Alt
+        || key == Qt::Key_Meta || key == Qt::Key_AltGr;
+}
+
+int Keymap::normalize(QKeyCombination key, bool first)
+{
+    Qt::KeyboardModifiers modifiers = key.keyboardModifiers()
+        & (Qt::ShiftModifier | Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier);
+    if (!first) {
+        // 2キー目以降は "Ctrl+Q, F" と "Ctrl+Q, Ctrl+F" を同じに扱う
+        modifiers &= ~(Qt::ControlModifier | Qt::ShiftModifier);
+    }
+    return QKeyCombination(modifiers, key.key()).toCombined();
+}
+
+bool Keymap::parseSequence(const QString &text, std::vector<int> &strokes) const
+{
+    strokes.clear();
+    const QStringList parts = text.split(QLatin1Char(','));
+    for (const QString &part : parts) {
+        const QKeySequence stroke(part.trimmed(), QKeySequence::PortableText);
+        if (stroke.count() != 1 || stroke[0].key() == Qt::Key_unknown) {
+            return false;
+        }
+        strokes.push_back(normalize(stroke[0], strokes.empty()));
+    }
+    return !strokes.empty();
+}
+
+bool Keymap::bind(const QString &sequence, const QString &command)
+{
+    const auto found = commandTable.constFind(command);
+    std::vector<int> strokes;
+    if (found == commandTable.cend() || !parseSequence(sequence, strokes)) {
+        return false;
+    }
+
+    int state = 0;
+    for (size_t i = 0; i < strokes.size(); ++i) {
+        // 途中のノードにコマンドがあれば、接頭辞として使うため外す
+        if (state != 0 && nodes[size_t(state)].command) {
+            nodes[size_t(state)].command = nullptr;
+            nodes[size_t(state)].commandName.clear();
+        }
+        const auto child = nodes[size_t(state)].children.constFind(strokes[i]);
+        if (child != nodes[size_t(state)].children.cend()) {
+            state = child.value();
+            continue;
+        }
+        Node node;
+        const QString strokeText = QKeySequence(QKeyCombination::fromCombined(strokes[i]))
+                                       .toString(QKeySequence::PortableText);
+        node.sequence = state == 0 ? strokeText : nodes[size_t(state)].sequence + ", " + strokeText;
+        nodes.push_back(node);
+        const int index = int(nodes.size()) - 1;
+        nodes[size_t(state)].children.insert(strokes[i], index);
+        state = index;
+    }
+
+    // 割り当てたノードより先の並びは使えなくなる
+    Node &target = nodes[size_t(state)];
+    target.children.clear();
+    target.command = found.value();
+    target.commandName = command;
+    return true;
+}
+
+bool Keymap::unbind(const QString &sequence)
+{
+    std::vector<int> strokes;
+    if (!parseSequence(sequence, strokes)) {
+        return false;
+    }
+    int state = 0;
+    for (int stroke : strokes) {
+        const auto child = nodes[size_t(state)].children.constFind(stroke);
+        if (child == nodes[size_t(state)].children.cend()) {
+            return true;   // もともと割り当てがない
+        }
+        state = child.value();
+    }
+    nodes[size_t(state)].command = nullptr;
+    nodes[size_t(state)].commandName.clear();
+    return true;
+}
+
+Keymap::Match Keymap::feed(int &state, QKeyCombination key, Command &command) const
+{
+    const Node &node = nodes[size_t(state)];
+    const auto child = node.children.constFind(normalize(key, state == 0));
+    if (child == node.children.cend()) {
+        state = 0;
+        return NoMatch;
+    }
+    const Node &next = nodes[size_t(child.value())];
+    if (next.command) {
+        command = next.command;
+        state = 0;
+        return Complete;
+    }
+    if (next.children.isEmpty()) {
+        // 割り当てを外した並び
+        state = 0;
+        return NoMatch;
+    }
+    state = child.value();
+    return Prefix;
+}
@@ -0,0 +1,72 @@
+#ifndef KEYMAP_H
+#define KEYMAP_H
+
+#include <QHash>
+#include <QKeySequence>
+#include <QString>
+#include <vector>
+
+class CustomTextEdit;
+class QSettings;
+
+// キー割り当て表。キーの並び（"Ctrl+Q, F" など、長さは任意）を接頭辞木で引き、
+// コマンドの関数ポインタへ解決する
+// ・既定の割り当ては静的な表から作り、QSettings の "keymap" グループで上書きできる
+//   （キーが並び、値がコマンド名。値が空なら割り当てを外す）
+// ・WordStar と同じく、2キー目以降は Ctrl / Shift の有無を区別しない
+class Keymap
+{
+public:
+    using Command = void (*)(CustomTextEdit &editor);
+
+    struct CommandInfo {
+        const char *name;
+        Command function;
+    };
+
+    struct Binding {
+        const char *sequence;
+        const char *command;
+    };
+
+    enum Match {
+        NoMatch,     // 割り当てなし（状態は先頭に戻る）
+        Prefix,      // 続きのキーを待つ
+        Complete     // command に解決した
+    };
+
+    Keymap();
+
+    // コマンド名と関数の対応（以降の bind で名前から引く）
+    void setCommands(const CommandInfo *commands, int count);
+    void clear();
+    void loadDefaults(const Binding *bindings, int count);
+    // 上書きを読み込み、適用できなかった項目の数を返す
+    int loadOverrides(QSettings &settings);
+
+    bool bind(const QString &sequence, const QString &command);
+    bool unbind(const QString &sequence);
+
+    // state は接頭辞木の現在位置（0 が先頭）。押されたキーで1段進める
+    Match feed(int &state, QKeyCombination key, Command &command) const;
+    // 状態までのキーの並び（"Ctrl+Q" など）
+    QString sequenceText(int state) const { return nodes[size_t(state)].sequence; }
+
+    static int normalize(QKeyCombination key, bool first);
+    static bool isModifierKey(int key);
+
+private:
+    struct Node {
+        QHash<int, int> children;   // 正規化したキー → 子ノードの番号
+        Command command = nullptr;
+        QString commandName;
+        QString sequence;
+    };
+
+    bool parseSequence(const QString &text, std::vector<int> &strokes) const;
+
+    std::vector<Node> nodes;
+    QHash<QString, Command> commandTable;
+};
+
+#endif // KEYMAP_H
@@ -1,5 +1,19 @@
 #include "MainWindow.h"
+#include "DocumentStatistics.h"
+#include "StartupProfiler.h"
+#include "SyntaxHighlighter.h"
+#include "OverviewRuler.h"
+#include "DocumentWorkspace.h"
+#include "TaskScheduler.h"
+#include "DocumentUndo.h"
+#include "ClipboardRing.h"
+#include "TextSearch.h"
+#include "MemoryPressure.h"
+#include "PerformanceHud.h"
+#include "Metrics.h"
+#include "DocumentRange.h"
 #include <QTextCursor>
+#include <QTextBlock>
 #include <QFileInfo>
 #include <QFontDialog>
 #include <QInputDialog>
@@ -13,16 +27,333 @@
 #include <QPainter>
 #include <QPaintEvent>
 #include <QProcess>
+#include <QAbstractTextDocumentLayout>
+#include <QFontDatabase>
+#include <QPointer>
+#include <QSaveFile>
+#include <QLocale>
+#include <QElapsedTimer>
+#include <iterator>
+
+namespace {
+// バックグラウンドでの読み書きの単位（文字数）。この単位で進捗と取り消しを確認する
+const qint64 FileChunkCharacters = 1 << 20;
+// 追加の選択1つが持つカーソルと文字書式の共有データの目安（バイト）
+const qint64 SelectionDataBytes = 128;
+
+// テキストファイルを読み込む。失敗時はエラーメッセージを返す
+QString readTextFile(const QString &fileName, QString &text, TaskScheduler::TaskContext *context)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return file.errorString();
+    }
+    
+    QTextStream in(&file);
+    const qint64 size = file.size();
+    while (!in.atEnd()) {
+        if (context && context->isCancelled()) {
+            return "Cancelled";
+        }
+        text += in.read(FileChunkCharacters);
+        if (context) {
+            context->setProgress(file.pos(), size);
+        }
+    }
+    return QString();
+}
+
+// テキストファイルを書き込む（QSaveFileで書き終えてから置き換える）
+QString writeTextFile(const QString &fileName, const QString &text, TaskScheduler::TaskContext *context)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return file.errorString();
+    }
+    
+    QTextStream out(&file);
+    for (qint64 done = 0; done < text.size(); done += FileChunkCharacters) {
+        if (context && context->isCancelled()) {
+            file.cancelWriting();
+            return "Cancelled";
+        }
+        out << QStringView(text).mid(done, FileChunkCharacters);
+        if (context) {
+            context->setProgress(done, text.size());
+        }
+    }
+    out.flush();
+    if (!file.commit()) {
+        return file.errorString();
+    }
+    return QString();
+}
+
+// 文書の範囲をチャンク単位でファイルへ書き出す（範囲全体の文字列は作らない）
+QString writeDocumentRange(QTextDocument *document, int from, int to, const QString &fileName)
+{
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return file.errorString();
+    }
+    
+    QTextStream out(&file);
+    for (int position = from; position < to; ) {
+        const int end = DocumentRange::chunkEnd(document, position, to);
+        QString chunk = DocumentRange::text(document, position, end);
+        chunk.replace(QChar::ParagraphSeparator, QLatin1Char('\n'));
+        out << chunk;
+        position = end;
+    }
+    out.flush();
+    if (!file.commit()) {
+        return file.errorString();
+    }
+    return QString();
+}
+
+// ファイルをチャンク単位で読みながらカーソル位置へ挿入する
+QString insertTextFile(QTextCursor &cursor, const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return file.errorString();
+    }
+    
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        cursor.insertText(in.read(FileChunkCharacters));
+    }
+    return QString();
+}
+}
+
+// キー割り当て表から呼ぶエディタコマンド（CustomTextEdit の friend）
+struct KeyCommands
+{
+    static void moveUp(CustomTextEdit &e) { e.moveCursor(QTextCursor::Up); if (e.blockMode) e.updateBlockSelection(); }
+    static void moveLeft(CustomTextEdit &e) { e.moveCursor(QTextCursor::Left); if (e.blockMode) e.updateBlockSelection(); }
+    static void moveRight(CustomTextEdit &e) { e.moveCursor(QTextCursor::Right); if (e.blockMode) e.updateBlockSelection(); }
+    static void moveDown(CustomTextEdit &e) { e.moveCursor(QTextCursor::Down); if (e.blockMode) e.updateBlockSelection(); }
+    static void wordLeft(CustomTextEdit &e) { e.moveCursor(QTextCursor::PreviousWord); }
+    static void wordRight(CustomTextEdit &e) { e.moveCursor(QTextCursor::NextWord); }
+    static void pageUp(CustomTextEdit &e) { e.movePage(-1); }
+    static void pageDown(CustomTextEdit &e) { e.movePage(1); }
+
+    static void deleteRight(CustomTextEdit &e)
+    {
+        QTextCursor cursor = e.textCursor();
+        cursor.deleteChar();
+    }
+    static void deleteLeft(CustomTextEdit &e)
+    {
+        QTextCursor cursor = e.textCursor();
+        cursor.deletePreviousChar();
+    }
+    static void deleteWordRight(CustomTextEdit &e)
+    {
+        QTextCursor cursor = e.textCursor();
+        cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+    }
+    static void deleteLine(CustomTextEdit &e)
+    {
+        QTextCursor cursor = e.textCursor();
+        cursor.select(QTextCursor::LineUnderCursor);
+        cursor.removeSelectedText();
+        cursor.deleteChar();
+    }
+
+    static void find(CustomTextEdit &e) { if (MainWindow *w = e.ownerWindow()) w->wordstarFind(); }
+    static void replace(CustomTextEdit &e) { if (MainWindow *w = e.ownerWindow()) w->wordstarReplace(); }
+    static void findNext(CustomTextEdit &e) { if (MainWindow *w = e.ownerWindow()) w->wordstarFindNext(); }
+
+    static void moveTo(CustomTextEdit &e, QTextCursor::MoveOperation operation, bool ensureVisible)
+    {
+        QTextCursor cursor = e.textCursor();
+        cursor.movePosition(operation);
+        e.setTextCursor(cursor);
+        if (ensureVisible) e.ensureCursorVisible();
+    }
+    static void fileStart(CustomTextEdit &e) { moveTo(e, QTextCursor::Start, true); }
+    static void fileEnd(CustomTextEdit &e) { moveTo(e, QTextCursor::End, true); }
+    static void lineStart(CustomTextEdit &e) { moveTo(e, QTextCursor::StartOfLine, false); }
+    static void lineEnd(CustomTextEdit &e) { moveTo(e, QTextCursor::EndOfLine, false); }
+    static void screenTop(CustomTextEdit &e)
+    {
+        e.setTextCursor(e.cursorForPosition(QPoint(0, 0)));
+        e.ensureCursorVisible();
+    }
+    static void screenBottom(CustomTextEdit &e)
+    {
+        e.setTextCursor(e.cursorForPosition(QPoint(0, e.viewport()->height())));
+        e.ensureCursorVisible();
+    }
+
+    static void blockBegin(CustomTextEdit &e)
+    {
+        qDebug() << "Starting block selection at position:" << e.textCursor().position();
+        e.blockStartCursor = e.textCursor();
+        e.blockMode = true;
+        e.update();
+    }
+    static void blockCopy(CustomTextEdit &e) { e.blockCopy(); }
+    static void blockCut(CustomTextEdit &e) { e.blockCut(); }
+    static void paste(CustomTextEdit &e)
+    {
+        // 続けて押すと古い履歴に切り替え
+        if (e.columnMode) {
+            e.pasteColumns();
+        } else {
+            e.pasteFromClipboardRing();
+        }
+    }
+    static void columnMode(CustomTextEdit &e)
+    {
+        e.columnMode = !e.columnMode;
+        e.viewport()->update();
+        e.showStatusMessage(e.columnMode ? "Column block mode on" : "Column block mode off");
+    }
+    static void columnFill(CustomTextEdit &e)
+    {
+        if (e.blockMode && e.columnMode) {
+            e.fillColumns();
+        } else {
+            e.showStatusMessage("Fill needs a column block - use Ctrl+K,N then Ctrl+K,B");
+        }
+    }
+    static void blockMove(CustomTextEdit &e) { e.moveBlock(); }
+    static void blockWrite(CustomTextEdit &e) { e.writeBlock(); }
+    static void blockRead(CustomTextEdit &e) { e.readBlock(); }
+
+    static void togglePerformanceHud(CustomTextEdit &e) { e.setPerformanceHudVisible(!e.isPerformanceHudVisible()); }
+
+    template <int N> static void setMarker(CustomTextEdit &e) { e.setMarker(N); }
+    template <int N> static void gotoMarker(CustomTextEdit &e) { e.gotoMarker(N); }
+};
+
+namespace {
+// コマンド名と関数（設定ファイルの keymap グループではこの名前で割り当てる）
+const Keymap::CommandInfo EditorCommands[] = {
+    {"cursor-up", KeyCommands::moveUp},
+    {"cursor-left", KeyCommands::moveLeft},
+    {"cursor-right", KeyCommands::moveRight},
+    {"cursor-down", KeyCommands::moveDown},
+    {"word-left", KeyCommands::wordLeft},
+    {"word-right", KeyCommands::wordRight},
+    {"page-up", KeyCommands::pageUp},
+    {"page-down", KeyCommands::pageDown},
+    {"delete-right", KeyCommands::deleteRight},
+    {"delete-left", KeyCommands::deleteLeft},
+    {"delete-word-right", KeyCommands::deleteWordRight},
+    {"delete-line", KeyCommands::deleteLine},
+    {"find", KeyCommands::find},
+    {"replace", KeyCommands::replace},
+    {"find-next", KeyCommands::findNext},
+    {"file-start", KeyCommands::fileStart},
+    {"file-end", KeyCommands::fileEnd},
+    {"line-start", KeyCommands::lineStart},
+    {"line-end", KeyCommands::lineEnd},
+    {"screen-top", KeyCommands::screenTop},
+    {"screen-bottom", KeyCommands::screenBottom},
+    {"block-begin", KeyCommands::blockBegin},
+    {"block-copy", KeyCommands::blockCopy},
+    {"block-cut", KeyCommands::blockCut},
+    {"paste", KeyCommands::paste},
+    {"column-mode", KeyCommands::columnMode},
+    {"column-fill", KeyCommands::columnFill},
+    {"block-move", KeyCommands::blockMove},
+    {"block-write", KeyCommands::blockWrite},
+    {"block-read", KeyCommands::blockRead},
+    {"toggle-performance-hud", KeyCommands::togglePerformanceHud},
+    {"set-marker-0", KeyCommands::setMarker<0>}, {"goto-marker-0", KeyCommands::gotoMarker<0>},
+    {"set-marker-1", KeyCommands::setMarker<1>}, {"goto-marker-1", KeyCommands::gotoMarker<1>},
+    {"set-marker-2", KeyCommands::setMarker<2>}, {"goto-marker-2", KeyCommands::gotoMarker<2>},
+    {"set-marker-3", KeyCommands::setMarker<3>}, {"goto-marker-3", KeyCommands::gotoMarker<3>},
+    {"set-marker-4", KeyCommands::setMarker<4>}, {"goto-marker-4", KeyCommands::gotoMarker<4>},
+    {"set-marker-5", KeyCommands::setMarker<5>}, {"goto-marker-5", KeyCommands::gotoMarker<5>},
+    {"set-marker-6", KeyCommands::setMarker<6>}, {"goto-marker-6", KeyCommands::gotoMarker<6>},
+    {"set-marker-7", KeyCommands::setMarker<7>}, {"goto-marker-7", KeyCommands::gotoMarker<7>},
+    {"set-marker-8", KeyCommands::setMarker<8>}, {"goto-marker-8", KeyCommands::gotoMarker<8>},
+    {"set-marker-9", KeyCommands::setMarker<9>}, {"goto-marker-9", KeyCommands::gotoMarker<9>},
+};
+
+// 既定のキー割り当て（WordStar 配列）。2キー目は Ctrl の有無を問わない
+// ダイアログで引数を尋ねるコマンド（キーマクロには記録せず、再生もしない）
+bool opensDialog(Keymap::Command command)
+{
+    return command == KeyCommands::find || command == KeyCommands::replace
+        || command == KeyCommands::columnFill || command == KeyCommands::blockWrite
+        || command == KeyCommands::blockRead;
+}
+
+const Keymap::Binding DefaultBindings[] = {
+    // ダイヤモンド配列と削除
+    {"Ctrl+E", "cursor-up"},
+    {"Ctrl+S", "cursor-left"},
+    {"Ctrl+D", "cursor-right"},
+    {"Ctrl+X", "cursor-down"},
+    {"Ctrl+A", "word-left"},
+    {"Ctrl+F", "word-right"},
+    {"Ctrl+R", "page-up"},
+    {"Ctrl+C", "page-down"},
+    {"Ctrl+G", "delete-right"},
+    {"Ctrl+H", "delete-left"},
+    {"Ctrl+T", "delete-word-right"},
+    {"Ctrl+Y", "delete-line"},
+    {"Ctrl+L", "find-next"},
+    // Ctrl+Q 系（移動・検索）
+    {"Ctrl+Q, F", "find"},
+    {"Ctrl+Q, A", "replace"},
+    {"Ctrl+Q, R", "file-start"},
+    {"Ctrl+Q, C", "file-end"},
+    {"Ctrl+Q, S", "line-start"},
+    {"Ctrl+Q, D", "line-end"},
+    {"Ctrl+Q, E", "screen-top"},
+    {"Ctrl+Q, X", "screen-bottom"},
+    // Ctrl+K 系（ブロック）
+    {"Ctrl+K, B", "block-begin"},
+    {"Ctrl+K, K", "block-copy"},
+    {"Ctrl+K, Y", "block-cut"},
+    {"Ctrl+K, C", "paste"},
+    {"Ctrl+K, N", "column-mode"},
+    {"Ctrl+K, F", "column-fill"},
+    {"Ctrl+K, V", "block-move"},
+    {"Ctrl+K, W", "block-write"},
+    {"Ctrl+K, R", "block-read"},
+    // Ctrl+O 系（画面表示）
+    {"Ctrl+O, P", "toggle-performance-hud"},
+    // マーカー（Ctrl+K,0-9 で設定、Ctrl+Q,0-9 で移動）
+    {"Ctrl+K, 0", "set-marker-0"}, {"Ctrl+Q, 0", "goto-marker-0"},
+    {"Ctrl+K, 1", "set-marker-1"}, {"Ctrl+Q, 1", "goto-marker-1"},
+    {"Ctrl+K, 2", "set-marker-2"}, {"Ctrl+Q, 2", "goto-marker-2"},
+    {"Ctrl+K, 3", "set-marker-3"}, {"Ctrl+Q, 3", "goto-marker-3"},
+    {"Ctrl+K, 4", "set-marker-4"}, {"Ctrl+Q, 4", "goto-marker-4"},
+    {"Ctrl+K, 5", "set-marker-5"}, {"Ctrl+Q, 5", "goto-marker-5"},
+    {"Ctrl+K, 6", "set-marker-6"}, {"Ctrl+Q, 6", "goto-marker-6"},
+    {"Ctrl+K, 7", "set-marker-7"}, {"Ctrl+Q, 7", "goto-marker-7"},
+    {"Ctrl+K, 8", "set-marker-8"}, {"Ctrl+Q, 8", "goto-marker-8"},
+    {"Ctrl+K, 9", "set-marker-9"}, {"Ctrl+Q, 9", "goto-marker-9"},
+};
+}
 
 // CustomTextEdit実装
 CustomTextEdit::CustomTextEdit(QWidget *parent)
     : QTextEdit(parent)
     , wrapCharacters(80)
     , useCharacterWrap(true)
-    , waitingForCtrlQ(false)
-    , waitingForCtrlK(false)
+    , keyState(0)
     , blockMode(false)
+    , columnMode(false)
     , currentClipboardIndex(0)
+    , lastPasteRevision(0)
+    , pastingFromRing(false)
+    , recordingMacro(false)
+    , replayingMacro(false)
+    , macroStopped(false)
+    , macroSequenceStart(0)
+    , recordingSession(false)
+    , hud(new PerformanceHud(this))
 {
     updateWrapWidth();
     setAcceptRichText(false);
@@ -32,6 +363,35 @@ CustomTextEdit::CustomTextEdit(QWidget *parent)
     resetTimer->setSingleShot(true);
     resetTimer->setInterval(3000);
     connect(resetTimer, &QTimer::timeout, this, &CustomTextEdit::resetTwoKeyMode);
+    
+    // 設定の上書きは MainWindow::loadSettings で読み込む
+    keymap.setCommands(EditorCommands, int(std::size(EditorCommands)));
+    loadKeymap(nullptr);
+    
+    hud->setDocument(document());
+    watchPasteCycle(document());
+}
+
+void CustomTextEdit::watchPasteCycle(QTextDocument *document)
+{
+    disconnect(pasteWatch);
+    pasteWatch = connect(document, &QTextDocument::contentsChange, this, [this, document]() {
+        // 貼り付け以外の編集が入ったら、次の Ctrl+K,C は新しい貼り付けになる
+        // （強調表示の書式だけの変更では版が進まないので続けられる）
+        if (!pastingFromRing && document->revision() != lastPasteRevision) lastPaste = QTextCursor();
+    });
+}
+
+bool CustomTextEdit::isPerformanceHudVisible() const
+{
+    return hud->isVisible();
+}
+
+void CustomTextEdit::setPerformanceHudVisible(bool visible)
+{
+    if (hud->isVisible() == visible) return;
+    hud->setVisible(visible);
+    emit performanceHudToggled(visible);
 }
 
 void CustomTextEdit::setWrapWidth(int characters)
@@ -59,17 +419,18 @@ void CustomTextEdit::resizeEvent(QResizeEvent *event)
 
 void CustomTextEdit::keyPressEvent(QKeyEvent *event)
 {
-    // 🔧 一番最初に追加
-    qDebug() << "keyPressEvent: key=" << event->key() << "modifiers=" << event->modifiers();
+    hud->keyPressed();
     
-    // 🔧 Ctrl+キーの詳細ログ
-    if (event->modifiers() == Qt::ControlModifier) {
-        qDebug() << "=== CTRL KEY PRESSED ===";
-        qDebug() << "Key code:" << event->key() << "(" << QChar(event->key()).toLatin1() << ")";
-        qDebug() << "waitingForCtrlQ:" << waitingForCtrlQ;
-        qDebug() << "waitingForCtrlK:" << waitingForCtrlK;
+    // キーマクロの記録（2段階キーも1キーずつ記録する）
+    if (recordingMacro && !replayingMacro) {
+        if (keyState == 0) macroSequenceStart = recordedMacro.size();
+        recordedMacro.append(event, macroClock.elapsed());
     }
-
+    // 操作全体の記録はマクロの再生で送られたキーも含める（再生すると同じ編集になる）
+    if (recordingSession) {
+        sessionRecording.append(event, sessionClock.elapsed());
+    }
+    
     // ESCキーでブロックモードキャンセル
     if (event->key() == Qt::Key_Escape) {
         if (blockMode) {
@@ -84,387 +445,634 @@ void CustomTextEdit::keyPressEvent(QKeyEvent *event)
             cursor.clearSelection();
             setTextCursor(cursor);
             return;
-        } else if (waitingForCtrlQ || waitingForCtrlK) {
+        } else if (keyState != 0) {
             resetTwoKeyMode();
             return;
         }
     }
     
-    // 2段階キーバインドの処理
-    if (waitingForCtrlQ) {
-        MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-        if (mainWindow) {
-            mainWindow->statusBar()->showMessage("Processing Ctrl+Q command...", 1000);
+    // キー割り当て表（Ctrl+キー、Ctrl+Q / Ctrl+K 系の並び）を1キーずつ辿る
+    // 並びの途中で押された修飾キー単体は無視する（Ctrl を離してから押し直しても続けられる）
+    if (keyState != 0 && Keymap::isModifierKey(event->key())) {
+        return;
+    }
+    const bool pending = keyState != 0;
+    Keymap::Command command = nullptr;
+    switch (keymap.feed(keyState, event->keyCombination(), command)) {
+    case Keymap::Prefix:
+        resetTimer->start();
+        showStatusMessage(keymap.sequenceText(keyState) + " pressed, waiting for next key...");
+        return;
+    case Keymap::Complete:
+        resetTwoKeyMode();
+        if (opensDialog(command)) {
+            if (replayingMacro) {
+                // 再生ではダイアログの入力を再現できないので、ここで止める
+                macroStopped = true;
+                return;
+            }
+            if (recordingMacro) {
+                recordedMacro.truncate(macroSequenceStart);
+                showStatusMessage("Commands that open a dialog are not recorded in macros");
+            }
         }
-        handleCtrlQ(event);
+        command(*this);
+        return;
+    case Keymap::NoMatch:
+        if (pending) {
+            // 割り当てのない並びはキーを捨てる（文字として入力しない）
+            resetTwoKeyMode();
+            return;
+        }
+        break;
+    }
+    
+    // 取り消し／やり直しは標準の undo スタックを使わない（Ctrl+Y は上で行削除として処理済み）
+    if (event->matches(QKeySequence::Undo)) {
+        undoEdit();
+        return;
+    }
+    if (event->matches(QKeySequence::Redo)) {
+        redoEdit();
         return;
     }
-    if (waitingForCtrlK) {
-        MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-        if (mainWindow) {
-            mainWindow->statusBar()->showMessage("Processing Ctrl+K command...", 1000);
+    
+    // 通常のキー処理
+    QTextEdit::keyPressEvent(event);
+}
+
+void CustomTextEdit::movePage(int direction)
+{
+    // 文書レイアウトのY座標（ビジュアル行インデックス）から移動先を一度で求める
+    // 1行ずつ movePosition(Up/Down) するとレイアウト問い合わせが行数分発生するため
+    QScrollBar *vbar = verticalScrollBar();
+    QScrollBar *hbar = horizontalScrollBar();
+    QAbstractTextDocumentLayout *layout = document()->documentLayout();
+
+    const QRect caret = cursorRect();
+    const int lineHeight = qMax(1, caret.height());
+    const int pageHeight = qMax(lineHeight, viewport()->height() - lineHeight);
+
+    // ビューポート座標 → 文書座標
+    const qreal docHeight = layout->documentSize().height();
+    qreal targetY = caret.center().y() + vbar->value() + direction * pageHeight;
+    targetY = qBound<qreal>(0, targetY, qMax<qreal>(0, docHeight - 1));
+
+    int targetPos = layout->hitTest(QPointF(caret.x() + hbar->value(), targetY), Qt::FuzzyHit);
+    if (targetPos < 0) {
+        targetPos = direction < 0 ? 0 : document()->characterCount() - 1;
+    }
+
+    // スクロールバーは1ページにつき1回だけ動かす
+    vbar->setValue(vbar->value() + direction * pageHeight);
+
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(targetPos);
+    setTextCursor(cursor);
+    if (blockMode) updateBlockSelection();
+}
+
+void CustomTextEdit::blockCopy()
+{
+    // 選択終了＋コピー（Ctrl+K,K）
+    qDebug() << "Processing Ctrl+K+K - Copy and end selection";
+    if (blockMode && columnMode) {
+        copyColumns(false);
+    } else if (blockMode) {
+        QTextCursor currentCursor = textCursor();
+        
+        // 選択範囲を決定
+        int startPos = qMin(blockStartCursor.position(), currentCursor.position());
+        int endPos = qMax(blockStartCursor.position(), currentCursor.position());
+        
+        qDebug() << "Block selection from" << startPos << "to" << endPos;
+        
+        // 選択範囲のテキストを取得
+        QTextCursor selectionCursor = blockStartCursor;
+        selectionCursor.setPosition(startPos);
+        selectionCursor.setPosition(endPos, QTextCursor::KeepAnchor);
+        
+        QString selectedText = selectionCursor.selectedText();
+        qDebug() << "Selected text length:" << selectedText.length();
+        
+        // 移動・書き出し用にブロックを覚えておく
+        markedBlock = selectionCursor;
+        
+        if (!selectedText.isEmpty()) {
+            // クリップボードと履歴にコピー
+            copyToClipboardRing(selectedText);
+            
+            qDebug() << "Text copied to clipboard:" << selectedText.left(50) + "...";
+        }
+        
+        // ブロックモード終了
+        blockMode = false;
+        
+        // 選択解除
+        QTextCursor cursor = textCursor();
+        cursor.clearSelection();
+        setTextCursor(cursor);
+        
+        // 画面更新
+        update();
+        
+        qDebug() << "Block mode ended, selection cleared";
+        
+        // ステータス表示
+        if (MainWindow *mainWindow = ownerWindow()) {
+            mainWindow->statusBar()->showMessage("Block copied to clipboard", 2000);
+        }
+    } else {
+        qDebug() << "Ctrl+K+K pressed but not in block mode";
+        // ブロックモードでない場合の通常のコピー処理
+        if (textCursor().hasSelection()) {
+            copy();
+            markedBlock = textCursor();
+            QTextCursor cursor = textCursor();
+            cursor.clearSelection();
+            setTextCursor(cursor);
+        }
+    }
+}
+
+void CustomTextEdit::blockCut()
+{
+    // 選択部分をカット（Ctrl+K,Y）
+    qDebug() << "Processing Ctrl+K+Y - Cut and end selection";
+    if (blockMode && columnMode) {
+        copyColumns(true);
+    } else if (blockMode) {
+        QTextCursor currentCursor = textCursor();
+        
+        // 選択範囲を決定
+        int startPos = qMin(blockStartCursor.position(), currentCursor.position());
+        int endPos = qMax(blockStartCursor.position(), currentCursor.position());
+        
+        // 選択範囲のテキストを取得してカット
+        QTextCursor selectionCursor = blockStartCursor;
+        selectionCursor.setPosition(startPos);
+        selectionCursor.setPosition(endPos, QTextCursor::KeepAnchor);
+        
+        QString selectedText = selectionCursor.selectedText();
+        
+        if (!selectedText.isEmpty()) {
+            // クリップボードと履歴にコピー
+            copyToClipboardRing(selectedText);
+            
+            // テキストを削除
+            selectionCursor.removeSelectedText();
+            
+            qDebug() << "Text cut to clipboard:" << selectedText.left(50) + "...";
+        }
+        
+        // ブロックモード終了
+        blockMode = false;
+        update();
+        
+        // ステータス表示
+        if (MainWindow *mainWindow = ownerWindow()) {
+            mainWindow->statusBar()->showMessage("Block cut to clipboard", 2000);
+        }
+    } else {
+        // ブロックモードでない場合の通常のカット処理
+        if (textCursor().hasSelection()) {
+            cut();
         }
-        handleCtrlK(event);
+    }
+}
+
+void CustomTextEdit::setMarker(int index)
+{
+    markers[index] = textCursor();
+    markers[index].clearSelection();
+    showStatusMessage(QString("Marker %1 set").arg(index));
+}
+
+void CustomTextEdit::gotoMarker(int index)
+{
+    if (markers[index].isNull() || markers[index].document() != document()) {
+        showStatusMessage(QString("Marker %1 is not set - use Ctrl+K,%1 first").arg(index));
+        return;
+    }
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(markers[index].position());
+    setTextCursor(cursor);
+    if (blockMode) updateBlockSelection();
+    ensureCursorVisible();
+}
+
+MainWindow *CustomTextEdit::ownerWindow()
+{
+    // 所属するウィンドウは変わらないので、最初に一度だけ調べて覚えておく
+    if (!owner) {
+        owner = qobject_cast<MainWindow*>(window());
+    }
+    return owner;
+}
+
+void CustomTextEdit::loadKeymap(QSettings *settings)
+{
+    keymap.clear();
+    keymap.loadDefaults(DefaultBindings, int(std::size(DefaultBindings)));
+    if (settings) {
+        keymap.loadOverrides(*settings);
+    }
+    resetTwoKeyMode();
+}
+
+QTextCursor CustomTextEdit::currentBlockRange() const
+{
+    // ブロックモード中はその範囲、選択があれば選択範囲、なければ確定済みのブロック
+    if (blockMode) {
+        QTextCursor range = blockStartCursor;
+        const int current = textCursor().position();
+        range.setPosition(qMin(blockStartCursor.position(), current));
+        range.setPosition(qMax(blockStartCursor.position(), current), QTextCursor::KeepAnchor);
+        return range;
+    }
+    if (textCursor().hasSelection()) {
+        return textCursor();
+    }
+    return markedBlock;
+}
+
+void CustomTextEdit::moveBlock()
+{
+    if (markedBlock.isNull() || markedBlock.document() != document() || !markedBlock.hasSelection()) {
+        showStatusMessage("No block marked - use Ctrl+K,B and Ctrl+K,K first");
+        return;
+    }
+    const int start = markedBlock.selectionStart();
+    const int end = markedBlock.selectionEnd();
+    const int target = textCursor().position();
+    if (target >= start && target <= end) {
+        showStatusMessage("Cursor is inside the block");
         return;
     }
     
-    // Ctrl修飾子が押されている場合のWordStarキーバインド
-    if (event->modifiers() == Qt::ControlModifier) {
-        qDebug() << "=== ENTERING CTRL SWITCH ===";  // 🔧 追加
-        qDebug() << "About to check key:" << event->key();  // 🔧 追加
-        switch (event->key()) {
-        case Qt::Key_L: // Ctrl+L - 最後の検索を繰り返し
-            {
-                qDebug() << "Processing Ctrl+L";
-                MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-                if (mainWindow) {
-                    mainWindow->wordstarFindNext();
-                }
-            }
-            return;
-        case Qt::Key_E: // 上へ
-            moveCursor(QTextCursor::Up);
-            if (blockMode) updateBlockSelection();
-            return;
-        case Qt::Key_S: // 左へ
-            moveCursor(QTextCursor::Left);
-            if (blockMode) updateBlockSelection();
-            return;
-        case Qt::Key_D: // 右へ
-            moveCursor(QTextCursor::Right);
-            if (blockMode) updateBlockSelection();
-            return;
-        case Qt::Key_X: // 下へ
-            moveCursor(QTextCursor::Down);
-            if (blockMode) updateBlockSelection();
-            return;
-        case Qt::Key_R: // ページアップ
-            {
-                QFontMetrics fm(font());
-                int lineHeight = fm.height();
-                int visibleLines = viewport()->height() / lineHeight;
-                
-                QTextCursor cursor = textCursor();
-                for (int i = 0; i < visibleLines - 1; i++) {
-                    if (!cursor.movePosition(QTextCursor::Up)) break;
-                }
-                setTextCursor(cursor);
-                ensureCursorVisible();
-            }
-            return;
-        case Qt::Key_C: // ページダウン
-            {
-                QFontMetrics fm(font());
-                int lineHeight = fm.height();
-                int visibleLines = viewport()->height() / lineHeight;
-                
-                QTextCursor cursor = textCursor();
-                for (int i = 0; i < visibleLines - 1; i++) {
-                    if (!cursor.movePosition(QTextCursor::Down)) break;
-                }
-                setTextCursor(cursor);
-                ensureCursorVisible();
-            }
-            return;
-        case Qt::Key_G: // 右の文字を削除
-            {
-                QTextCursor cursor = textCursor();
-                cursor.deleteChar();
-            }
-            return;
-        case Qt::Key_H: // 左の文字を削除
-            {
-                QTextCursor cursor = textCursor();
-                cursor.deletePreviousChar();
-            }
-            return;
-        case Qt::Key_T: // 単語の右部分を削除
-            {
-                QTextCursor cursor = textCursor();
-                cursor.movePosition(QTextCursor::EndOfWord, QTextCursor::KeepAnchor);
-                cursor.removeSelectedText();
-            }
-            return;
-        case Qt::Key_Y: // 行全体削除
-            {
-                QTextCursor cursor = textCursor();
-                cursor.select(QTextCursor::LineUnderCursor);
-                cursor.removeSelectedText();
-                cursor.deleteChar();
-            }
-            return;
-        case Qt::Key_A: // 単語の左へ
-            moveCursor(QTextCursor::PreviousWord);
-            return;
-        case Qt::Key_F: // 単語の右へ
-            moveCursor(QTextCursor::NextWord);
-            return;
-       case Qt::Key_Q: // Ctrl+Q系コマンドの開始
-            waitingForCtrlQ = true;
-            resetTimer->start();
-            {
-                MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-                if (mainWindow) {
-                    mainWindow->statusBar()->showMessage("Ctrl+Q pressed, waiting for second key...", 3000);
-                }
-            }
-            return;
-        case Qt::Key_K: // Ctrl+K系コマンドの開始
-            {
-    qDebug() << "*** CTRL+K CASE REACHED ***";
-    qDebug() << "Before setting waitingForCtrlK";  // 🔧 追加
-    waitingForCtrlK = true;
-    waitingForCtrlQ = false;
-    resetTimer->start();
-    qDebug() << "After setting waitingForCtrlK to:" << waitingForCtrlK;  // 🔧 追加
+    // チャンクごとの移動を1つの編集ブロックにまとめる
+    const int length = end - start;
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    DocumentRange::move(document(), start, end, target);
+    cursor.endEditBlock();
+    
+    // 移動先を新しいブロックにする
+    const int newStart = target > end ? target - length : target;
+    markedBlock = QTextCursor(document());
+    markedBlock.setPosition(newStart);
+    markedBlock.setPosition(newStart + length, QTextCursor::KeepAnchor);
+    QTextCursor caret = textCursor();
+    caret.setPosition(newStart);
+    setTextCursor(caret);
+    viewport()->update();
+    showStatusMessage(QString("Block moved (%1 characters)").arg(length));
+}
+
+void CustomTextEdit::writeBlock()
+{
+    const QTextCursor range = currentBlockRange();
+    if (range.isNull() || range.document() != document() || !range.hasSelection()) {
+        showStatusMessage("No block marked - use Ctrl+K,B and Ctrl+K,K first");
+        return;
+    }
+    const int start = range.selectionStart();
+    const int end = range.selectionEnd();
     
-    MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-    if (mainWindow) {
-        mainWindow->statusBar()->showMessage("Ctrl+K pressed, waiting for second key...", 3000);
+    const QString fileName = QFileDialog::getSaveFileName(this, "Write Block to File", QString(),
+                                                          "Text Files (*.txt);;All Files (*)");
+    if (fileName.isEmpty()) return;
+    
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const QString error = writeDocumentRange(document(), start, end, fileName);
+    QApplication::restoreOverrideCursor();
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, "WLEditor",
+                             QString("Cannot write file %1:\n%2.").arg(fileName, error));
+        return;
     }
-    qDebug() << "About to return from Ctrl+K case";  // 🔧 追加
-    return;
+    showStatusMessage(QString("Block written to %1").arg(QFileInfo(fileName).fileName()));
+}
 
+void CustomTextEdit::readBlock()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Read File into Document", QString(),
+                                                          "Text Files (*.txt);;All Files (*)");
+    if (fileName.isEmpty()) return;
+    
+    // 読み込んだ範囲を1つの編集ブロックにし、挿入した範囲をブロックとして選択しておく
+    QTextCursor cursor = textCursor();
+    cursor.clearSelection();
+    const int start = cursor.position();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    cursor.beginEditBlock();
+    const QString error = insertTextFile(cursor, fileName);
+    cursor.endEditBlock();
+    QApplication::restoreOverrideCursor();
+    if (!error.isEmpty()) {
+        QMessageBox::warning(this, "WLEditor",
+                             QString("Cannot read file %1:\n%2.").arg(fileName, error));
+        return;
+    }
+    
+    markedBlock = QTextCursor(document());
+    markedBlock.setPosition(start);
+    markedBlock.setPosition(cursor.position(), QTextCursor::KeepAnchor);
+    viewport()->update();
+    showStatusMessage(QString("Read %1").arg(QFileInfo(fileName).fileName()));
 }
+
+int CustomTextEdit::tabColumns() const
+{
+    const int spaceWidth = fontMetrics().horizontalAdvance(QLatin1Char(' '));
+    return spaceWidth > 0 ? qMax(1, qRound(tabStopDistance() / spaceWidth)) : 8;
+}
+
+ColumnBlock::Range CustomTextEdit::columnRange() const
+{
+    // ブロック開始位置と現在のカーソルを対角とする矩形
+    const QTextCursor current = textCursor();
+    const int tabs = tabColumns();
+    const QTextBlock startBlock = blockStartCursor.block();
+    const QTextBlock currentBlock = current.block();
+    const int startColumn = ColumnBlock::columnAt(startBlock.text(), blockStartCursor.positionInBlock(), tabs);
+    const int currentColumn = ColumnBlock::columnAt(currentBlock.text(), current.positionInBlock(), tabs);
+    
+    ColumnBlock::Range range;
+    range.firstLine = qMin(startBlock.blockNumber(), currentBlock.blockNumber());
+    range.lastLine = qMax(startBlock.blockNumber(), currentBlock.blockNumber());
+    range.left = qMin(startColumn, currentColumn);
+    range.right = qMax(startColumn, currentColumn);
+    return range;
+}
+
+void CustomTextEdit::copyColumns(bool cut)
+{
+    const ColumnBlock::Range range = columnRange();
+    if (range.left == range.right) {
+        showStatusMessage("Column block is empty");
+    } else {
+        copyToClipboardRing(ColumnBlock::copy(document(), range, tabColumns()));
+        if (cut) {
+            ColumnBlock::remove(document(), range, tabColumns());
         }
+        showStatusMessage(QString("Column block %1 (%2 lines)")
+                              .arg(cut ? "cut" : "copied")
+                              .arg(range.lastLine - range.firstLine + 1));
     }
     
-    // 通常のキー処理
-    QTextEdit::keyPressEvent(event);
+    // 左上の角にカーソルを置いてブロックモードを終える
+    blockMode = false;
+    const QTextBlock first = document()->findBlockByNumber(range.firstLine);
+    QTextCursor cursor(first);
+    cursor.setPosition(first.position() + ColumnBlock::span(first.text(), range.left, range.left, tabColumns()).from);
+    setTextCursor(cursor);
+    viewport()->update();
+}
+
+void CustomTextEdit::pasteColumns()
+{
+    const ClipboardRing &ring = ClipboardRing::instance();
+    const QString text = ring.isEmpty() ? QApplication::clipboard()->text()
+                                        : ring.at(qMin(currentClipboardIndex, ring.count() - 1));
+    if (text.isEmpty()) return;
+    
+    const QTextCursor current = textCursor();
+    const int line = current.blockNumber();
+    const int column = ColumnBlock::columnAt(current.block().text(), current.positionInBlock(), tabColumns());
+    ColumnBlock::paste(document(), line, column, text, tabColumns());
+    
+    QTextCursor cursor(document()->findBlockByNumber(line));
+    cursor.setPosition(cursor.block().position()
+                       + ColumnBlock::span(cursor.block().text(), column, column, tabColumns()).from);
+    setTextCursor(cursor);
+    showStatusMessage(QString("Column block pasted (%1 lines)").arg(text.count(QLatin1Char('\n')) + 1));
+}
+
+void CustomTextEdit::fillColumns()
+{
+    const ColumnBlock::Range range = columnRange();
+    bool ok = false;
+    const QString fill = QInputDialog::getText(this, "Fill Column Block", "Fill character:",
+                                               QLineEdit::Normal, " ", &ok);
+    if (!ok || fill.isEmpty()) return;
+    
+    ColumnBlock::fill(document(), range, fill.at(0), tabColumns());
+    blockMode = false;
+    viewport()->update();
+    showStatusMessage(QString("Column block filled (%1 lines)").arg(range.lastLine - range.firstLine + 1));
+}
+
+void CustomTextEdit::updateColumnSelections()
+{
+    // 画面に見えている行だけを強調する（矩形が何万行あっても描画の手間は変わらない）
+    const ColumnBlock::Range range = columnRange();
+    const int firstVisible = cursorForPosition(QPoint(0, 0)).blockNumber();
+    const int lastVisible = cursorForPosition(QPoint(0, viewport()->height())).blockNumber();
+    const int tabs = tabColumns();
+    
+    QList<QTextEdit::ExtraSelection> extraSelections;
+    const int from = qMax(range.firstLine, firstVisible);
+    const int to = qMin(range.lastLine, lastVisible);
+    int line = from;
+    for (QTextBlock block = document()->findBlockByNumber(from); block.isValid() && line <= to;
+         block = block.next(), ++line) {
+        const ColumnBlock::Span s = ColumnBlock::span(block.text(), range.left, range.right, tabs);
+        if (s.from == s.to) continue;
+        QTextEdit::ExtraSelection selection;
+        selection.format.setBackground(QColor(Qt::blue).lighter(160));
+        selection.cursor = QTextCursor(document());
+        selection.cursor.setPosition(block.position() + s.from);
+        selection.cursor.setPosition(block.position() + s.to, QTextCursor::KeepAnchor);
+        extraSelections.append(selection);
+    }
+    setExtraSelections(extraSelections);
+}
+
+void CustomTextEdit::showStatusMessage(const QString &message)
+{
+    if (MainWindow *mainWindow = ownerWindow()) {
+        mainWindow->statusBar()->showMessage(message, 3000);
+    }
 }
 
-void CustomTextEdit::handleCtrlQ(QKeyEvent *event)
+void CustomTextEdit::copyToClipboardRing(const QString &text)
+{
+    // 同じ内容が履歴にあればそちらを共有し、クリップボードにも同じバッファを渡す
+    const QString stored = ClipboardRing::instance().add(text);
+    QApplication::clipboard()->setText(stored);
+    currentClipboardIndex = 0;
+    lastPaste = QTextCursor();
+}
+
+void CustomTextEdit::pasteFromClipboardRing()
+{
+    ClipboardRing &ring = ClipboardRing::instance();
+    if (ring.isEmpty()) {
+        paste();
+        return;
+    }
+    if (currentClipboardIndex >= ring.count()) {
+        currentClipboardIndex = 0;
+    }
+
+    // 直前の貼り付けのあと文書が変わらず、カーソルがその末尾にあれば、その範囲を次の履歴で置き換える
+    const bool cycling = !lastPaste.isNull() && lastPaste.document() == document()
+                         && textCursor().position() == lastPaste.selectionEnd();
+    QTextCursor cursor = textCursor();
+    if (cycling) {
+        currentClipboardIndex = (currentClipboardIndex + 1) % ring.count();
+        cursor.setPosition(lastPaste.selectionStart());
+        cursor.setPosition(lastPaste.selectionEnd(), QTextCursor::KeepAnchor);
+    }
+
+    const int index = currentClipboardIndex;
+    const int start = cursor.selectionStart();
+    pastingFromRing = true;
+    cursor.insertText(ring.at(index));
+    pastingFromRing = false;
+    setTextCursor(cursor);
+
+    lastPaste = QTextCursor(document());
+    lastPaste.setPosition(start);
+    lastPaste.setPosition(cursor.position(), QTextCursor::KeepAnchor);
+    lastPasteRevision = document()->revision();
+    showClipboardPreview(index, ring.count() > 1 ? "Ctrl+K,C again for older" : QString());
+}
+
+void CustomTextEdit::showClipboardPreview(int index, const QString &hint)
+{
+    const ClipboardRing &ring = ClipboardRing::instance();
+    MainWindow *mainWindow = ownerWindow();
+    if (!mainWindow) return;
+
+    QString message = QString("Clipboard %1/%2: %3 (%4)")
+                          .arg(index + 1)
+                          .arg(ring.count())
+                          .arg(ring.preview(index))
+                          .arg(QLocale().formattedDataSize(qint64(ring.at(index).size()) * 2));
+    if (!hint.isEmpty()) {
+        message += " - " + hint;
+    }
+    mainWindow->statusBar()->showMessage(message, 4000);
+}
+
+void CustomTextEdit::switchDocument(QTextDocument *document)
 {
     resetTwoKeyMode();
+    blockMode = false;
+    blockStartCursor = QTextCursor();
+    markedBlock = QTextCursor();
+    lastPaste = QTextCursor();
+    for (QTextCursor &marker : markers) {
+        marker = QTextCursor();
+    }
     
-    // 🔧 修正: Ctrl修飾子の有無に関わらず処理
-    if (event->modifiers() == Qt::ControlModifier || event->modifiers() == Qt::NoModifier) {
-        switch (event->key()) {
-        case Qt::Key_F: // Ctrl+Q, F または Ctrl+Q, Ctrl+F - 検索ダイアログ
-            {
-                MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-                if (mainWindow) {
-                    mainWindow->wordstarFind();
-                }
-            }
-            break;
-        case Qt::Key_A: // Ctrl+Q, A または Ctrl+Q, Ctrl+A - 置換ダイアログ  
-            {
-                MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-                if (mainWindow) {
-                    mainWindow->wordstarReplace();
-                }
-            }
-            break;
-        case Qt::Key_R: // Ctrl+Q, R または Ctrl+Q, Ctrl+R - ファイル先頭へ
-            {
-                QTextCursor cursor = textCursor();
-                cursor.movePosition(QTextCursor::Start);
-                setTextCursor(cursor);
-                ensureCursorVisible();
-            }
-            break;
-        case Qt::Key_C: // Ctrl+Q, C または Ctrl+Q, Ctrl+C - ファイル末尾へ
-            {
-                QTextCursor cursor = textCursor();
-                cursor.movePosition(QTextCursor::End);
-                setTextCursor(cursor);
-                ensureCursorVisible();
-            }
-            break;
-        case Qt::Key_S: // Ctrl+Q, S または Ctrl+Q, Ctrl+S - 行頭へ
-            {
-                QTextCursor cursor = textCursor();
-                cursor.movePosition(QTextCursor::StartOfLine);
-                setTextCursor(cursor);
-            }
-            break;
-        case Qt::Key_D: // Ctrl+Q, D または Ctrl+Q, Ctrl+D - 行末へ
-            {
-                QTextCursor cursor = textCursor();
-                cursor.movePosition(QTextCursor::EndOfLine);
-                setTextCursor(cursor);
-            }
-            break;
-        case Qt::Key_E: // Ctrl+Q, E または Ctrl+Q, Ctrl+E - 画面上端へ
-            {
-                QTextCursor cursor = cursorForPosition(QPoint(0, 0));
-                setTextCursor(cursor);
-                ensureCursorVisible();
-            }
-            break;
-        case Qt::Key_X: // Ctrl+Q, X または Ctrl+Q, Ctrl+X - 画面下端へ
-            {
-                QTextCursor cursor = cursorForPosition(QPoint(0, viewport()->height()));
-                setTextCursor(cursor);
-                ensureCursorVisible();
-            }
-            break;
-        }
+    // 文書ごとの既定フォントをエディタのフォントに揃えてから表示する
+    document->setDefaultFont(font());
+    setDocument(document);
+    hud->setDocument(document);
+    watchPasteCycle(document);
+    updateWrapWidth();
+}
+
+void CustomTextEdit::undoEdit()
+{
+    DocumentUndo *history = DocumentUndo::forDocument(document());
+    const int position = history ? history->undo() : -1;
+    if (position >= 0) {
+        QTextCursor cursor = textCursor();
+        cursor.setPosition(position);
+        setTextCursor(cursor);
+    }
+}
+
+void CustomTextEdit::redoEdit()
+{
+    DocumentUndo *history = DocumentUndo::forDocument(document());
+    const int position = history ? history->redo() : -1;
+    if (position >= 0) {
+        QTextCursor cursor = textCursor();
+        cursor.setPosition(position);
+        setTextCursor(cursor);
     }
 }
 
-void CustomTextEdit::handleCtrlK(QKeyEvent *event)
+void CustomTextEdit::startMacroRecording()
+{
+    recordedMacro.clear();
+    macroClock.start();
+    recordingMacro = true;
+}
+
+void CustomTextEdit::stopMacroRecording()
 {
+    recordingMacro = false;
     resetTwoKeyMode();
+}
+
+void CustomTextEdit::startSessionRecording()
+{
+    sessionRecording.clear();
+    sessionClock.start();
+    recordingSession = true;
+}
+
+int CustomTextEdit::replayMacro(int count)
+{
+    if (recordedMacro.isEmpty() || replayingMacro) return 0;
     
-    // 🔧 修正: Ctrl修飾子の有無に関わらず処理
-    if (event->modifiers() == Qt::ControlModifier || event->modifiers() == Qt::NoModifier) {
-        switch (event->key()) {
-        case Qt::Key_B: // Ctrl+K, B または Ctrl+K, Ctrl+B - 選択開始
-            qDebug() << "Starting block selection at position:" << textCursor().position();
-            blockStartCursor = textCursor();
-            blockMode = true;
-            update();
-            break;
-            
-        case Qt::Key_K: // Ctrl+K, K または Ctrl+K, Ctrl+K - 選択終了＋コピー
-            qDebug() << "Processing Ctrl+K+K - Copy and end selection";
-            if (blockMode) {
-                QTextCursor currentCursor = textCursor();
-                
-                // 選択範囲を決定
-                int startPos = qMin(blockStartCursor.position(), currentCursor.position());
-                int endPos = qMax(blockStartCursor.position(), currentCursor.position());
-                
-                qDebug() << "Block selection from" << startPos << "to" << endPos;
-                
-                // 選択範囲のテキストを取得
-                QTextCursor selectionCursor = blockStartCursor;
-                selectionCursor.setPosition(startPos);
-                selectionCursor.setPosition(endPos, QTextCursor::KeepAnchor);
-                
-                QString selectedText = selectionCursor.selectedText();
-                qDebug() << "Selected text length:" << selectedText.length();
-                
-                if (!selectedText.isEmpty()) {
-                    // クリップボードにコピー
-                    QApplication::clipboard()->setText(selectedText);
-                    
-                    // クリップボード履歴に追加
-                    clipboardHistory.prepend(selectedText);
-                    if (clipboardHistory.size() > 10) {
-                        clipboardHistory.removeLast();
-                    }
-                    currentClipboardIndex = 0;
-                    
-                    qDebug() << "Text copied to clipboard:" << selectedText.left(50) + "...";
-                }
-                
-                // ブロックモード終了
-                blockMode = false;
-                
-                // 選択解除
-                QTextCursor cursor = textCursor();
-                cursor.clearSelection();
-                setTextCursor(cursor);
-                
-                // 画面更新
-                update();
-                
-                qDebug() << "Block mode ended, selection cleared";
-                
-                // ステータス表示
-                MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-                if (mainWindow) {
-                    mainWindow->statusBar()->showMessage("Block copied to clipboard", 2000);
-                }
-            } else {
-                qDebug() << "Ctrl+K+K pressed but not in block mode";
-                // ブロックモードでない場合の通常のコピー処理
-                if (textCursor().hasSelection()) {
-                    copy();
-                    QTextCursor cursor = textCursor();
-                    cursor.clearSelection();
-                    setTextCursor(cursor);
-                }
-            }
-            break;
-            
-        case Qt::Key_C: // Ctrl+K, C または Ctrl+K, Ctrl+C - ペースト
-            if (!clipboardHistory.isEmpty()) {
-                QString textToPaste = clipboardHistory.at(currentClipboardIndex);
-                insertPlainText(textToPaste);
-                qDebug() << "Pasted from history index:" << currentClipboardIndex;
-            } else {
-                paste();
-            }
-            break;
-            
-        case Qt::Key_V: // Ctrl+K, V または Ctrl+K, Ctrl+V - ペースト＆履歴を戻す
-            if (!clipboardHistory.isEmpty()) {
-                QString textToPaste = clipboardHistory.at(currentClipboardIndex);
-                insertPlainText(textToPaste);
-                
-                // 履歴インデックスを進める
-                currentClipboardIndex = (currentClipboardIndex + 1) % clipboardHistory.size();
-                qDebug() << "Pasted and moved to history index:" << currentClipboardIndex;
-            } else {
-                paste();
-            }
-            break;
-            
-        case Qt::Key_Y: // Ctrl+K, Y または Ctrl+K, Ctrl+Y - 選択部分をカット
-            qDebug() << "Processing Ctrl+K+Y - Cut and end selection";
-            if (blockMode) {
-                QTextCursor currentCursor = textCursor();
-                
-                // 選択範囲を決定
-                int startPos = qMin(blockStartCursor.position(), currentCursor.position());
-                int endPos = qMax(blockStartCursor.position(), currentCursor.position());
-                
-                // 選択範囲のテキストを取得してカット
-                QTextCursor selectionCursor = blockStartCursor;
-                selectionCursor.setPosition(startPos);
-                selectionCursor.setPosition(endPos, QTextCursor::KeepAnchor);
-                
-                QString selectedText = selectionCursor.selectedText();
-                
-                if (!selectedText.isEmpty()) {
-                    // クリップボードにコピー
-                    QApplication::clipboard()->setText(selectedText);
-                    
-                    // クリップボード履歴に追加
-                    clipboardHistory.prepend(selectedText);
-                    if (clipboardHistory.size() > 10) {
-                        clipboardHistory.removeLast();
-                    }
-                    currentClipboardIndex = 0;
-                    
-                    // テキストを削除
-                    selectionCursor.removeSelectedText();
-                    
-                    qDebug() << "Text cut to clipboard:" << selectedText.left(50) + "...";
-                }
-                
-                // ブロックモード終了
-                blockMode = false;
-                update();
-                
-                // ステータス表示
-                MainWindow *mainWindow = qobject_cast<MainWindow*>(window());
-                if (mainWindow) {
-                    mainWindow->statusBar()->showMessage("Block cut to clipboard", 2000);
-                }
-            } else {
-                // ブロックモードでない場合の通常のカット処理
-                if (textCursor().hasSelection()) {
-                    cut();
-                }
+    // 再生中は描画を止め、全体を1つの編集ブロックにする
+    // （カーソル移動などのシグナルはエディタがそのまま出す。ステータス更新は MainWindow 側でまとまる）
+    replayingMacro = true;
+    macroStopped = false;
+    setUpdatesEnabled(false);
+    resetTwoKeyMode();
+    
+    QTextCursor editBlock(document());
+    editBlock.beginEditBlock();
+    int played = 0;
+    while (!macroStopped && (count == 0 || played < count)) {
+        const int positionBefore = textCursor().position();
+        const int lengthBefore = document()->characterCount();
+        for (int i = 0; i < recordedMacro.size() && !macroStopped; ++i) {
+            const KeyMacro::Event &recorded = recordedMacro.at(i);
+            QKeyEvent event(QEvent::KeyPress, recorded.key, recorded.modifiers, recorded.text);
+            keyPressEvent(&event);
+        }
+        if (macroStopped) break;
+        ++played;
+        
+        if (count == 0) {
+            // 文書末尾に達したか、1回の再生で何も変わらなければ終える（無限ループ防止）
+            const QTextCursor cursor = textCursor();
+            if (cursor.atEnd()
+                || (cursor.position() == positionBefore && document()->characterCount() == lengthBefore)) {
+                break;
             }
-            break;
         }
     }
+    editBlock.endEditBlock();
+    
+    resetTwoKeyMode();
+    setUpdatesEnabled(true);
+    replayingMacro = false;
+    ensureCursorVisible();
+    if (macroStopped) {
+        showStatusMessage("Macro stopped: it contains a command that opens a dialog");
+    }
+    return played;
 }
+
 void CustomTextEdit::resetTwoKeyMode()
 {
-    waitingForCtrlQ = false;
-    waitingForCtrlK = false;
+    keyState = 0;
     resetTimer->stop();
 }
 
 void CustomTextEdit::paintEvent(QPaintEvent *event)
 {
+    hud->frameStarted();
     QTextEdit::paintEvent(event);
     
     if (blockMode) {
@@ -479,7 +1087,9 @@ void CustomTextEdit::paintEvent(QPaintEvent *event)
         selectionCursor.setPosition(startPos);
         selectionCursor.setPosition(endPos, QTextCursor::KeepAnchor);
         
-        if (selectionCursor.hasSelection()) {
+        if (columnMode) {
+            updateColumnSelections();
+        } else if (selectionCursor.hasSelection()) {
             QList<QTextEdit::ExtraSelection> extraSelections;
             QTextEdit::ExtraSelection selection;
             
@@ -496,10 +1106,24 @@ void CustomTextEdit::paintEvent(QPaintEvent *event)
         painter.drawRect(startRect.x() - 2, startRect.y(), 4, startRect.height());
         
         painter.setPen(QPen(Qt::blue, 1));
-        painter.drawText(10, 20, "Block Mode - ESC to cancel, Ctrl+K,K to copy, Ctrl+K,Y to cut");
+        painter.drawText(10, 20, columnMode
+                         ? "Column Block Mode - ESC to cancel, Ctrl+K,K to copy, Ctrl+K,Y to cut, Ctrl+K,F to fill"
+                         : "Block Mode - ESC to cancel, Ctrl+K,K to copy, Ctrl+K,Y to cut");
+    } else if (!markedBlock.isNull() && markedBlock.document() == document() && markedBlock.hasSelection()) {
+        // 確定済みのブロックを薄く表示する（Ctrl+K,V / W の対象）
+        QTextEdit::ExtraSelection selection;
+        selection.format.setBackground(QColor(Qt::blue).lighter(185));
+        selection.cursor = markedBlock;
+        setExtraSelections(QList<QTextEdit::ExtraSelection>() << selection);
     } else {
         setExtraSelections(QList<QTextEdit::ExtraSelection>());
     }
+    
+    if (hud->isVisible()) {
+        QPainter painter(viewport());
+        hud->paint(painter);
+    }
+    hud->frameFinished(event->region());
 }
 
 void CustomTextEdit::updateBlockSelection()
@@ -518,29 +1142,94 @@ bool CustomTextEdit::eventFilter(QObject *obj, QEvent *event)
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , textEditor(new CustomTextEdit(this))
+    , fontComboBox(nullptr)
     , settings(new QSettings(this))
+    , documentStats(new DocumentStatistics(this))
+    , statusUpdateTimer(new QTimer(this))
+    , scheduler(&TaskScheduler::shared())
+    , workspace(new DocumentWorkspace(this))
+    , tabBar(new QTabBar(this))
+    , overviewRuler(nullptr)
     , findDialog(nullptr)
     , toolBarVisible(true)
     , statusExtrasVisible(true)
+    , overviewRulerVisible(true)
+    , startupFinished(false)
+    , mainToolBar(nullptr)
     , lastCaseSensitive(false)
     , lastWholeWord(false)
+    , searchTask(0)
 {
-    setCentralWidget(textEditor);
+    StartupProfiler::mark("MainWindow: editor");
+    
+    // エディタの右側にオーバービュールーラーを配置
+    QWidget *editorArea = new QWidget(this);
+    QHBoxLayout *editorLayout = new QHBoxLayout(editorArea);
+    editorLayout->setContentsMargins(0, 0, 0, 0);
+    editorLayout->setSpacing(0);
+    editorLayout->addWidget(textEditor);
+    overviewRuler = new OverviewRuler(textEditor, editorArea);
+    editorLayout->addWidget(overviewRuler);
+    
+    // タブバーは文書が2つ以上のときだけ表示
+    tabBar->setDocumentMode(true);
+    tabBar->setTabsClosable(true);
+    tabBar->setExpanding(false);
+    tabBar->setAutoHide(true);
+    
+    QWidget *centralArea = new QWidget(this);
+    QVBoxLayout *centralLayout = new QVBoxLayout(centralArea);
+    centralLayout->setContentsMargins(0, 0, 0, 0);
+    centralLayout->setSpacing(0);
+    centralLayout->addWidget(tabBar);
+    centralLayout->addWidget(editorArea);
+    setCentralWidget(centralArea);
+    
+    workspace->setDocumentFactory([this](const QString &fileName) {
+        return createDocument(fileName);
+    });
+    connect(workspace, &DocumentWorkspace::hibernationChanged,
+            this, &MainWindow::updateTabTitle);
     
+    // ツールバーとフォントコンボボックスは初回描画後に作成する（finishStartup）
     setupMenus();
-    setupToolBar();
+    StartupProfiler::mark("MainWindow: menus");
     setupStatusBar();
+    StartupProfiler::mark("MainWindow: status bar");
     loadSettings();
+    StartupProfiler::mark("MainWindow: settings");
+    
+    // 初回描画を検出するためビューポートを監視
+    textEditor->viewport()->installEventFilter(this);
+    
+    // 最初の（無題の）文書を開く
+    addDocumentTab("");
+    connect(tabBar, &QTabBar::currentChanged, this, &MainWindow::onTabChanged);
+    connect(tabBar, &QTabBar::tabCloseRequested, this, &MainWindow::closeTab);
+    onTabChanged(0);
+    
+    // ステータスバー更新は16ms（1フレーム）に1回へまとめる
+    statusUpdateTimer->setSingleShot(true);
+    statusUpdateTimer->setInterval(16);
+    connect(statusUpdateTimer, &QTimer::timeout,
+            this, &MainWindow::updateStatusBar);
     
     // シグナル接続
     connect(textEditor, &QTextEdit::cursorPositionChanged,
-            this, &MainWindow::updateStatusBar);
-    connect(textEditor->document(), &QTextDocument::modificationChanged,
-            this, &MainWindow::documentModified);
-    connect(textEditor, &QTextEdit::undoAvailable,
-            undoAction, &QAction::setEnabled);
-    connect(textEditor, &QTextEdit::redoAvailable,
-            redoAction, &QAction::setEnabled);
+            this, &MainWindow::scheduleStatusUpdate);
+    connect(textEditor, &QTextEdit::selectionChanged,
+            this, &MainWindow::scheduleStatusUpdate);
+    connect(documentStats, &DocumentStatistics::changed,
+            this, &MainWindow::scheduleStatusUpdate);
+    // スケジューラは他のウィンドウと共有しているので、自分の処理の進捗だけを表示する
+    connect(scheduler, &TaskScheduler::progressChanged, this,
+            [this](quint64 id, const QString &name, int percent) {
+                if (ownTasks.contains(id)) {
+                    statusLabel->setText(QString("%1... %2%").arg(name).arg(percent));
+                }
+            });
+    connect(scheduler, &TaskScheduler::taskFinished, this,
+            [this](quint64 id) { ownTasks.remove(id); });
     connect(textEditor, &QTextEdit::copyAvailable,
             copyAction, &QAction::setEnabled);
     connect(textEditor, &QTextEdit::copyAvailable,
@@ -551,10 +1240,15 @@ MainWindow::MainWindow(QWidget *parent)
     resize(800, 600);
     
     updateStatusBar();
+    StartupProfiler::mark("MainWindow: constructed");
 }
 
 MainWindow::~MainWindow()
 {
+    // 表示先のなくなる読み込みは取り消す（保存は書き終えるまで続ける）
+    for (const quint64 id : std::as_const(pendingOpens)) {
+        scheduler->cancel(id);
+    }
     saveSettings();
 }
 
@@ -589,6 +1283,12 @@ void MainWindow::setupMenus()
     connect(saveAsAction, &QAction::triggered, this, &MainWindow::saveAsFile);
     fileMenu->addAction(saveAsAction);
     
+    closeTabAction = new QAction("&Close Tab", this);
+    closeTabAction->setShortcut(QKeySequence("Ctrl+W"));
+    closeTabAction->setStatusTip("Close the current document tab");
+    connect(closeTabAction, &QAction::triggered, this, &MainWindow::closeCurrentTab);
+    fileMenu->addAction(closeTabAction);
+    
     fileMenu->addSeparator();
     
     exitAction = new QAction("E&xit", this);
@@ -666,6 +1366,32 @@ void MainWindow::setupMenus()
     findReplaceAction->setStatusTip("Advanced find and replace dialog (F3)");
     connect(findReplaceAction, &QAction::triggered, this, &MainWindow::findReplace);
     editMenu->addAction(findReplaceAction);
+    
+    editMenu->addSeparator();
+    
+    // キーマクロ
+    recordMacroAction = new QAction("&Record Macro", this);
+    recordMacroAction->setCheckable(true);
+    recordMacroAction->setShortcut(QKeySequence("Ctrl+Shift+R"));
+    recordMacroAction->setStatusTip("Start/stop recording keystrokes (Ctrl+Shift+R)");
+    connect(recordMacroAction, &QAction::triggered, this, &MainWindow::toggleMacroRecording);
+    editMenu->addAction(recordMacroAction);
+    
+    QAction *playMacroAction = new QAction("&Play Macro...", this);
+    playMacroAction->setShortcut(QKeySequence("Ctrl+Shift+P"));
+    playMacroAction->setStatusTip("Replay the recorded keystrokes N times or until end of file (Ctrl+Shift+P)");
+    connect(playMacroAction, &QAction::triggered, this, &MainWindow::playMacro);
+    editMenu->addAction(playMacroAction);
+    
+    QAction *saveMacroAction = new QAction("Save Macro...", this);
+    saveMacroAction->setStatusTip("Save the recorded keystrokes to a file");
+    connect(saveMacroAction, &QAction::triggered, this, &MainWindow::saveMacro);
+    editMenu->addAction(saveMacroAction);
+    
+    QAction *loadMacroAction = new QAction("Load Macro...", this);
+    loadMacroAction->setStatusTip("Load keystrokes from a file");
+    connect(loadMacroAction, &QAction::triggered, this, &MainWindow::loadMacro);
+    editMenu->addAction(loadMacroAction);
 
     // 表示メニュー
     QMenu *viewMenu = menuBar()->addMenu("&View");
@@ -696,8 +1422,37 @@ void MainWindow::setupMenus()
     connect(toggleStatusExtrasAction, &QAction::triggered, this, &MainWindow::toggleStatusBarExtras);
     viewMenu->addAction(toggleStatusExtrasAction);
     
+    toggleOverviewRulerAction = new QAction("&Overview Ruler", this);
+    toggleOverviewRulerAction->setCheckable(true);
+    toggleOverviewRulerAction->setChecked(true);
+    toggleOverviewRulerAction->setStatusTip("Show/hide document overview beside the editor");
+    connect(toggleOverviewRulerAction, &QAction::triggered, this, &MainWindow::toggleOverviewRuler);
+    viewMenu->addAction(toggleOverviewRulerAction);
+    
+    togglePerformanceHudAction = new QAction("Performance &HUD", this);
+    togglePerformanceHudAction->setCheckable(true);
+    togglePerformanceHudAction->setStatusTip("Show/hide frame time, latency and memory over the editor (Ctrl+O,P)");
+    connect(togglePerformanceHudAction, &QAction::triggered,
+            textEditor, &CustomTextEdit::setPerformanceHudVisible);
+    // Ctrl+O,P で切り替えたときもメニューと設定を合わせる
+    connect(textEditor, &CustomTextEdit::performanceHudToggled, this, [this](bool visible) {
+        togglePerformanceHudAction->setChecked(visible);
+        settings->setValue("performanceHudVisible", visible);
+    });
+    viewMenu->addAction(togglePerformanceHudAction);
+    
     viewMenu->addSeparator();
     
+    QAction *taskDiagnosticsAction = new QAction("Background &Tasks...", this);
+    taskDiagnosticsAction->setStatusTip("Show background task queues and worker utilization");
+    connect(taskDiagnosticsAction, &QAction::triggered, this, &MainWindow::showTaskDiagnostics);
+    viewMenu->addAction(taskDiagnosticsAction);
+    
+    QAction *memoryDiagnosticsAction = new QAction("&Memory Usage...", this);
+    memoryDiagnosticsAction->setStatusTip("Show where each open document's memory goes");
+    connect(memoryDiagnosticsAction, &QAction::triggered, this, &MainWindow::showMemoryDiagnostics);
+    viewMenu->addAction(memoryDiagnosticsAction);
+    
     preferencesAction = new QAction("&Preferences...", this);
     preferencesAction->setStatusTip("Configure application settings");
     connect(preferencesAction, &QAction::triggered, this, &MainWindow::showPreferences);
@@ -705,6 +1460,65 @@ void MainWindow::setupMenus()
 
 }
 
+bool MainWindow::eventFilter(QObject *obj, QEvent *event)
+{
+    if (!startupFinished && obj == textEditor->viewport() && event->type() == QEvent::Paint) {
+        // 初回描画の直後（イベントループに戻ってから）に残りのUIを構築
+        startupFinished = true;
+        textEditor->viewport()->removeEventFilter(this);
+        QTimer::singleShot(0, this, &MainWindow::finishStartup);
+    }
+    return QMainWindow::eventFilter(obj, event);
+}
+
+void MainWindow::changeEvent(QEvent *event)
+{
+    QMainWindow::changeEvent(event);
+    // 最小化は Android で画面から外れたとき（TRIM_MEMORY_UI_HIDDEN）に当たる。キャッシュだけ捨てる
+    if (event->type() == QEvent::WindowStateChange && isMinimized()) {
+        trimMemory(MemoryPressure::UiHidden);
+    }
+}
+
+qint64 MainWindow::trimMemory(int level)
+{
+    qint64 freed = overviewRuler->releaseCache();
+    for (int i = 0; i < workspace->count(); ++i) {
+        if (workspace->isHibernated(i)) continue;
+        if (DocumentUndo *history = DocumentUndo::forDocument(workspace->entry(i).document)) {
+            freed += history->trimMemory(level);
+        }
+    }
+    return freed;
+}
+
+DocumentMemory MainWindow::documentMemory(int index) const
+{
+    const QTextDocument *document = workspace->entry(index).document;
+    DocumentMemory memory = DocumentMemory::measure(document);
+    if (document && document == textEditor->document()) {
+        memory.clipboard = ClipboardRing::instance().bytes();
+        memory.search = overviewRuler->memoryUsage();
+        memory.selections = textEditor->extraSelections().size()
+                            * qint64(sizeof(QTextEdit::ExtraSelection) + SelectionDataBytes);
+    }
+    return memory;
+}
+
+void MainWindow::finishStartup()
+{
+    StartupProfiler::mark("first paint");
+    
+    setupToolBar();
+    mainToolBar->setVisible(toolBarVisible);
+    StartupProfiler::mark("deferred: tool bar");
+    
+    setupFontComboBox();
+    StartupProfiler::mark("deferred: font combo box");
+    
+    StartupProfiler::report();
+}
+
 void MainWindow::setupToolBar()    // 🔧 強制的にCtrl+Q系を処理するアクション
 {
     mainToolBar = addToolBar("Main");
@@ -744,17 +1558,8 @@ void MainWindow::setupStatusBar()
             this, &MainWindow::onWrapWidthChanged);
     extrasLayout->addWidget(wrapWidthSpinBox);
     
+    // フォントコンボボックスは全フォントを列挙するため初回描画後に挿入する
     extrasLayout->addWidget(new QLabel("Font:"));
-    fontComboBox = new QFontComboBox();
-    fontComboBox->setMaximumWidth(150);
-    fontComboBox->setToolTip("Select font family");
-    connect(fontComboBox, &QFontComboBox::currentFontChanged,
-            [this](const QFont &font) { 
-                QFont newFont = font;
-                newFont.setPointSize(fontSizeSpinBox->value());
-                textEditor->setFont(newFont);
-            });
-    extrasLayout->addWidget(fontComboBox);
     
     fontSizeSpinBox = new QSpinBox();
     fontSizeSpinBox->setRange(8, 48);
@@ -774,10 +1579,31 @@ void MainWindow::setupStatusBar()
     positionLabel = new QLabel("Line: 1, Col: 1");
     statusBar()->addPermanentWidget(positionLabel);
     
+    statsLabel = new QLabel("Lines: 1  Words: 0  Chars: 0");
+    statsLabel->setToolTip("Document statistics (CJK characters count as one word each)");
+    statusBar()->addPermanentWidget(statsLabel);
+    
     encodingLabel = new QLabel("UTF-8");
     statusBar()->addPermanentWidget(encodingLabel);
 }
 
+void MainWindow::setupFontComboBox()
+{
+    QHBoxLayout *extrasLayout = qobject_cast<QHBoxLayout*>(statusExtrasWidget->layout());
+    
+    fontComboBox = new QFontComboBox();
+    fontComboBox->setMaximumWidth(150);
+    fontComboBox->setToolTip("Select font family");
+    fontComboBox->setCurrentFont(textEditor->font());
+    connect(fontComboBox, &QFontComboBox::currentFontChanged,
+            [this](const QFont &font) { 
+                QFont newFont = font;
+                newFont.setPointSize(fontSizeSpinBox->value());
+                textEditor->setFont(newFont);
+            });
+    extrasLayout->insertWidget(extrasLayout->indexOf(fontSizeSpinBox), fontComboBox);
+}
+
 void MainWindow::onWrapWidthChanged(int value)
 {
     textEditor->setWrapWidth(value);
@@ -790,36 +1616,22 @@ void MainWindow::onWrapWidthChanged(int value)
 
 void MainWindow::newFile()
 {
-    if (maybeSave()) {
-        textEditor->clear();
-        setCurrentFile("");
-        statusLabel->setText("New file created - WordStar Keys Enabled");
-    }
+    // 新しい文書は新しいタブに開く
+    tabBar->setCurrentIndex(addDocumentTab(""));
+    statusLabel->setText("New file created - WordStar Keys Enabled");
 }
 
 void MainWindow::openFile()
 {
-    if (maybeSave()) {
-        QString fileName = QFileDialog::getOpenFileName(this, 
-            "Open File", "", 
-            "Text Files (*.txt *.cpp *.h *.py *.java *.js *.html *.css *.md *.xml *.json);;"
-            "C++ Files (*.cpp *.cxx *.cc *.c *.h *.hpp *.hxx);;"
-            "Python Files (*.py *.pyw);;"
-            "Web Files (*.html *.htm *.css *.js *.json *.xml);;"
-            "All Files (*)");
-        if (!fileName.isEmpty()) {
-            QFile file(fileName);
-            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                QTextStream in(&file);
-                textEditor->setPlainText(in.readAll());
-                setCurrentFile(fileName);
-                statusLabel->setText("File opened: " + QFileInfo(fileName).fileName() + " - WordStar Keys Enabled");
-            } else {
-                QMessageBox::warning(this, "WLEditor",
-                    QString("Cannot read file %1:\n%2.")
-                    .arg(fileName).arg(file.errorString()));
-            }
-        }
+    QString fileName = QFileDialog::getOpenFileName(this, 
+        "Open File", "", 
+        "Text Files (*.txt *.cpp *.h *.py *.java *.js *.html *.css *.md *.xml *.json);;"
+        "C++ Files (*.cpp *.cxx *.cc *.c *.h *.hpp *.hxx);;"
+        "Python Files (*.py *.pyw);;"
+        "Web Files (*.html *.htm *.css *.js *.json *.xml);;"
+        "All Files (*)");
+    if (!fileName.isEmpty()) {
+        openFileFromArgs(fileName);
     }
 }
 
@@ -833,46 +1645,107 @@ void MainWindow::openInNewWindow()
         "Web Files (*.html *.htm *.css *.js *.json *.xml);;"
         "All Files (*)");
     if (!fileName.isEmpty()) {
-        QProcess::startDetached(QApplication::applicationFilePath(), 
-                              QStringList() << fileName);
+        // 別プロセスを起動せず、同じプロセス内にウィンドウを追加する
+        MainWindow *window = openWindow(fileName);
+        window->move(pos() + QPoint(30, 30));
+    }
+}
+
+MainWindow *MainWindow::openWindow(const QString &fileName)
+{
+    MainWindow *window = new MainWindow();
+    window->setAttribute(Qt::WA_DeleteOnClose);
+    if (!fileName.isEmpty() && QFile::exists(fileName)) {
+        window->openFileFromArgs(fileName);
     }
+    window->show();
+    window->raise();
+    window->activateWindow();
+    return window;
+}
+
+void MainWindow::recordKeys(const QString &path)
+{
+    keyRecordingPath = path;
+    textEditor->startSessionRecording();
 }
 
 void MainWindow::openFileFromArgs(const QString &fileName)
 {
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QMessageBox::warning(this, "WLEditor", 
-                           QString("Cannot read file %1:\n%2")
-                           .arg(fileName)
-                           .arg(file.errorString()));
+    // 既に開いている文書ならそのタブへ切り替えるだけ
+    const QString absolutePath = QFileInfo(fileName).absoluteFilePath();
+    for (int i = 0; i < workspace->count(); ++i) {
+        const QString openPath = workspace->entry(i).filePath;
+        if (!openPath.isEmpty() && QFileInfo(openPath).absoluteFilePath() == absolutePath) {
+            tabBar->setCurrentIndex(i);
+            return;
+        }
+    }
+    // 読み込み中のファイルをもう一度開いても、タブは1つだけにする
+    if (pendingOpens.contains(absolutePath)) {
         return;
     }
     
-    QTextStream in(&file);
-    textEditor->setPlainText(in.readAll());
-    setCurrentFile(fileName);
-    statusLabel->setText("File opened: " + QFileInfo(fileName).fileName() + " - WordStar Keys Enabled");
+    // ファイルの読み込みと文字コード変換はワーカースレッドで行い、文書への反映だけUIスレッドで行う
+    const QString shownName = QFileInfo(fileName).fileName();
+    auto text = std::make_shared<QString>();
+    auto error = std::make_shared<QString>();
+    statusLabel->setText("Opening " + shownName + "...");
+    QElapsedTimer clock;
+    clock.start();
+    
+    // 完了はスケジューラから届くので、その前にウィンドウが閉じられていれば何もしない
+    QPointer<MainWindow> window(this);
+    const quint64 id = scheduler->submit("Opening " + shownName, TaskScheduler::Interactive,
+        [fileName, text, error](TaskScheduler::TaskContext &context) {
+            *error = readTextFile(fileName, *text, &context);
+        },
+        [this, window, absolutePath, fileName, shownName, text, error, clock](bool cancelled) {
+            if (!window) return;
+            pendingOpens.remove(absolutePath);
+            if (cancelled) {
+                statusLabel->setText("Open cancelled: " + shownName + " - WordStar Keys Enabled");
+                return;
+            }
+            if (!error->isEmpty()) {
+                Metrics::openFailures.add();
+                QMessageBox::warning(this, "WLEditor", 
+                                   QString("Cannot read file %1:\n%2")
+                                   .arg(fileName)
+                                   .arg(*error));
+                return;
+            }
+            
+            // 無題・未変更・空のタブはそのまま使い、それ以外は新しいタブを開く
+            QTextDocument *current = textEditor->document();
+            if (!currentFile.isEmpty() || current->isModified() || !current->isEmpty()) {
+                tabBar->setCurrentIndex(addDocumentTab(fileName));
+            }
+            
+            // 読み込んだ全文は履歴に積まず、保存済みの履歴があれば読み戻す
+            DocumentUndo *history = DocumentUndo::forDocument(textEditor->document());
+            if (history) {
+                history->suspend();
+            }
+            textEditor->setPlainText(*text);
+            if (history) {
+                history->reset();
+                if (settings->value("persistUndo", false).toBool()) {
+                    history->load(DocumentUndo::sidecarPath(fileName));
+                }
+            }
+            setCurrentFile(fileName);
+            updateUndoActions();
+            Metrics::openDuration.observe(clock.nsecsElapsed());
+            statusLabel->setText("File opened: " + shownName + " - WordStar Keys Enabled");
+        });
+    pendingOpens.insert(absolutePath, id);
+    ownTasks.insert(id);
 }
 
 void MainWindow::saveFile()
 {
-    if (currentFile.isEmpty()) {
-        saveAsFile();
-        return;
-    }
-    
-    QFile file(currentFile);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << textEditor->toPlainText();
-        textEditor->document()->setModified(false);
-        statusLabel->setText("File saved: " + QFileInfo(currentFile).fileName() + " - WordStar Keys Enabled");
-    } else {
-        QMessageBox::warning(this, "WLEditor",
-            QString("Cannot write file %1:\n%2.")
-            .arg(currentFile).arg(file.errorString()));
-    }
+    saveDocument(true);
 }
 
 void MainWindow::saveAsFile()
@@ -880,9 +1753,82 @@ void MainWindow::saveAsFile()
     QString fileName = QFileDialog::getSaveFileName(this,
         "Save File", "", "Text Files (*.txt);;All Files (*)");
     if (!fileName.isEmpty()) {
+        // 書き込みに失敗しても変更ありのまま残す
+        setCurrentFile(fileName);
+        textEditor->document()->setModified(true);
+        saveDocument(true);
+    }
+}
+
+bool MainWindow::saveDocument(bool inBackground)
+{
+    if (currentFile.isEmpty()) {
+        QString fileName = QFileDialog::getSaveFileName(this,
+            "Save File", "", "Text Files (*.txt);;All Files (*)");
+        if (fileName.isEmpty()) {
+            return false;
+        }
         setCurrentFile(fileName);
-        saveFile();
+        textEditor->document()->setModified(true);
     }
+    
+    const QString fileName = currentFile;
+    const QString shownName = QFileInfo(fileName).fileName();
+    QTextDocument *document = textEditor->document();
+    QElapsedTimer clock;
+    clock.start();
+    
+    if (!inBackground) {
+        const QString error = writeTextFile(fileName, document->toPlainText(), nullptr);
+        if (!error.isEmpty()) {
+            Metrics::saveFailures.add();
+            QMessageBox::warning(this, "WLEditor",
+                QString("Cannot write file %1:\n%2.").arg(fileName).arg(error));
+            return false;
+        }
+        Metrics::saveDuration.observe(clock.nsecsElapsed());
+        DocumentUndo *history = DocumentUndo::forDocument(document);
+        markSaved(document, history ? history->checkpoint() : 0, fileName);
+        statusLabel->setText("File saved: " + shownName + " - WordStar Keys Enabled");
+        return true;
+    }
+    
+    // 本文の取り出しだけUIスレッドで行い、書き込みはワーカースレッドで行う
+    auto text = std::make_shared<QString>(document->toPlainText());
+    auto error = std::make_shared<QString>();
+    DocumentUndo *history = DocumentUndo::forDocument(document);
+    const quint64 state = history ? history->checkpoint() : 0;
+    QPointer<QTextDocument> target(document);
+    statusLabel->setText("Saving " + shownName + "...");
+    
+    // 保存はウィンドウを閉じても書き終える。失敗は閉じた後でも知らせる
+    QPointer<MainWindow> window(this);
+    const quint64 id = scheduler->submit("Saving " + shownName, TaskScheduler::Interactive,
+        [fileName, text, error](TaskScheduler::TaskContext &context) {
+            *error = writeTextFile(fileName, *text, &context);
+        },
+        [this, window, fileName, shownName, error, state, target, clock](bool cancelled) {
+            if (!cancelled && !error->isEmpty()) {
+                Metrics::saveFailures.add();
+                QMessageBox::warning(window, "WLEditor",
+                    QString("Cannot write file %1:\n%2.").arg(fileName).arg(*error));
+                return;
+            }
+            if (!cancelled) {
+                Metrics::saveDuration.observe(clock.nsecsElapsed());
+            }
+            if (!window) return;
+            if (cancelled) {
+                statusLabel->setText("Save cancelled: " + shownName + " - WordStar Keys Enabled");
+                return;
+            }
+            if (target) {
+                markSaved(target, state, fileName);
+            }
+            statusLabel->setText("File saved: " + shownName + " - WordStar Keys Enabled");
+        });
+    ownTasks.insert(id);
+    return true;
 }
 
 void MainWindow::copy()
@@ -903,15 +1849,99 @@ void MainWindow::paste()
     statusLabel->setText("Text pasted - WordStar Keys Enabled");
 }
 
+void MainWindow::markSaved(QTextDocument *document, quint64 state, const QString &fileName)
+{
+    // 保存中に編集されていれば変更ありのまま残す
+    DocumentUndo *history = DocumentUndo::forDocument(document);
+    if (history && history->stateId() != state) {
+        return;
+    }
+    document->setModified(false);
+    if (history) {
+        history->markClean(state);
+        if (settings->value("persistUndo", false).toBool()) {
+            history->save(DocumentUndo::sidecarPath(fileName));
+        }
+    }
+}
+
+void MainWindow::toggleMacroRecording()
+{
+    if (textEditor->isRecordingMacro()) {
+        textEditor->stopMacroRecording();
+        statusLabel->setText(QString("Macro recorded (%1 keys) - WordStar Keys Enabled")
+                                 .arg(textEditor->macro().size()));
+    } else {
+        textEditor->startMacroRecording();
+        statusLabel->setText("Recording macro... Ctrl+Shift+R to stop");
+    }
+    recordMacroAction->setChecked(textEditor->isRecordingMacro());
+}
+
+void MainWindow::playMacro()
+{
+    if (textEditor->isRecordingMacro()) {
+        toggleMacroRecording();
+    }
+    if (textEditor->macro().isEmpty()) {
+        statusLabel->setText("No macro recorded - WordStar Keys Enabled");
+        return;
+    }
+    
+    bool ok = false;
+    const int count = QInputDialog::getInt(this, "Play Macro",
+                                           "Repeat count (0 = until end of file):",
+                                           settings->value("macroRepeat", 1).toInt(), 0, 100000000, 1, &ok);
+    if (!ok) return;
+    settings->setValue("macroRepeat", count);
+    
+    QElapsedTimer timer;
+    timer.start();
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const int played = textEditor->replayMacro(count);
+    QApplication::restoreOverrideCursor();
+    statusLabel->setText(QString("Macro played %1 times in %2 ms - WordStar Keys Enabled")
+                             .arg(played).arg(timer.elapsed()));
+    scheduleStatusUpdate();
+}
+
+void MainWindow::saveMacro()
+{
+    if (textEditor->macro().isEmpty()) {
+        statusLabel->setText("No macro recorded - WordStar Keys Enabled");
+        return;
+    }
+    const QString fileName = QFileDialog::getSaveFileName(this, "Save Macro", QString(),
+                                                          "WLEditor Macros (*.wlkeys);;All Files (*)");
+    if (fileName.isEmpty()) return;
+    if (!textEditor->macro().save(fileName)) {
+        QMessageBox::warning(this, "WLEditor", QString("Cannot write file %1.").arg(fileName));
+    }
+}
+
+void MainWindow::loadMacro()
+{
+    const QString fileName = QFileDialog::getOpenFileName(this, "Load Macro", QString(),
+                                                          "WLEditor Macros (*.wlkeys);;All Files (*)");
+    if (fileName.isEmpty()) return;
+    KeyMacro macro;
+    if (!macro.load(fileName)) {
+        QMessageBox::warning(this, "WLEditor", QString("%1 is not a WLEditor macro file.").arg(fileName));
+        return;
+    }
+    textEditor->setMacro(macro);
+    statusLabel->setText(QString("Macro loaded (%1 keys) - WordStar Keys Enabled").arg(macro.size()));
+}
+
 void MainWindow::undo()
 {
-    textEditor->undo();
+    textEditor->undoEdit();
     statusLabel->setText("Undo - WordStar Keys Enabled");
 }
 
 void MainWindow::redo()
 {
-    textEditor->redo();
+    textEditor->redoEdit();
     statusLabel->setText("Redo - WordStar Keys Enabled");
 }
 
@@ -1016,31 +2046,73 @@ void MainWindow::performWordStarSearch()
 {
     if (lastSearchText.isEmpty()) return;
     
-    QTextDocument::FindFlags flags = QTextDocument::FindFlags();
-    
-    if (lastCaseSensitive) {
-        flags |= QTextDocument::FindCaseSensitively;
-    }
-    if (lastWholeWord) {
-        flags |= QTextDocument::FindWholeWords;
-    }
-    
-    bool found = textEditor->find(lastSearchText, flags);
-    
-    if (found) {
-        statusLabel->setText(QString("Found: \"%1\" - WordStar Keys Enabled").arg(lastSearchText));
-    } else {
-        QTextCursor cursor = textEditor->textCursor();
-        cursor.movePosition(QTextCursor::Start);
-        textEditor->setTextCursor(cursor);
-        
-        found = textEditor->find(lastSearchText, flags);
-        if (found) {
-            statusLabel->setText(QString("Found from beginning: \"%1\" - WordStar Keys Enabled").arg(lastSearchText));
-        } else {
-            statusLabel->setText(QString("Not found: \"%1\" - WordStar Keys Enabled").arg(lastSearchText));
-        }
-    }
+    // 保存と同じく本文の写しだけUIスレッドで取り、照合はワーカースレッドで行う
+    // ブロックごとのヒット（オーバービュールーラー用）と、カーソルより後・先頭からの最初の一致を求める
+    QTextDocument *document = textEditor->document();
+    auto text = std::make_shared<QString>(DocumentRange::text(document, 0, document->characterCount() - 1));
+    auto hits = std::make_shared<QVector<bool>>();
+    auto next = std::make_shared<qsizetype>(-1);
+    auto first = std::make_shared<qsizetype>(-1);
+    const qsizetype from = textEditor->textCursor().selectionEnd();
+    const int revision = document->revision();
+    const QString needle = lastSearchText;
+    TextSearch::Options options;
+    options.caseSensitive = lastCaseSensitive;
+    options.wholeWords = lastWholeWord;
+    QPointer<QTextDocument> target(document);
+    QPointer<MainWindow> window(this);
+    QElapsedTimer clock;
+    clock.start();
+    
+    // 前の検索がまだ動いていれば、その結果は使わない
+    scheduler->cancel(searchTask);
+    statusLabel->setText(QString("Searching: \"%1\"...").arg(needle));
+    searchTask = scheduler->submit("Searching", TaskScheduler::Interactive,
+        [text, hits, next, first, needle, options, from](TaskScheduler::TaskContext &context) {
+            const QStringView all(*text);
+            qsizetype start = 0;
+            for (;;) {
+                if (context.isCancelled()) return;
+                qsizetype end = all.indexOf(QChar(QChar::ParagraphSeparator), start);
+                if (end < 0) end = all.size();
+                const QStringView line = all.mid(start, end - start);
+                int index = TextSearch::indexIn(line, needle, 0, options);
+                hits->append(index >= 0);
+                if (index >= 0 && *first < 0) *first = start + index;
+                if (index >= 0 && *next < 0 && end >= from) {
+                    if (start + index < from) index = TextSearch::indexIn(line, needle, int(from - start), options);
+                    if (index >= 0) *next = start + index;
+                }
+                context.setProgress(end, all.size());
+                if (end >= all.size()) break;
+                start = end + 1;
+            }
+        },
+        [this, window, target, revision, hits, next, first, needle, options, clock](bool cancelled) {
+            if (!window || cancelled) return;
+            // 照合している間に編集されていれば、位置がずれているので使わない
+            if (!target || target != textEditor->document() || target->revision() != revision) {
+                statusLabel->setText(QString("Search for \"%1\" stopped: the document changed - WordStar Keys Enabled")
+                                     .arg(needle));
+                return;
+            }
+            Metrics::searchDuration.observe(clock.nsecsElapsed());
+            overviewRuler->setSearchHits(needle, options, *hits);
+            
+            const qsizetype position = *next >= 0 ? *next : *first;
+            if (position < 0) {
+                statusLabel->setText(QString("Not found: \"%1\" - WordStar Keys Enabled").arg(needle));
+                return;
+            }
+            QTextCursor cursor(target);
+            cursor.setPosition(int(position));
+            cursor.setPosition(int(position + needle.size()), QTextCursor::KeepAnchor);
+            textEditor->setTextCursor(cursor);
+            statusLabel->setText(QString(*next >= 0 ? "Found: \"%1\" - WordStar Keys Enabled"
+                                                    : "Found from beginning: \"%1\" - WordStar Keys Enabled")
+                                 .arg(needle));
+        });
+    ownTasks.insert(searchTask);
 }
 
 void MainWindow::setFont()
@@ -1049,7 +2121,9 @@ void MainWindow::setFont()
     QFont font = QFontDialog::getFont(&ok, textEditor->font(), this);
     if (ok) {
         textEditor->setFont(font);
-        fontComboBox->setCurrentFont(font);
+        if (fontComboBox) {
+            fontComboBox->setCurrentFont(font);
+        }
         fontSizeSpinBox->setValue(font.pointSize());
         statusLabel->setText("Font changed - WordStar Keys Enabled");
     }
@@ -1077,6 +2151,32 @@ void MainWindow::updateStatusBar()
     int line = cursor.blockNumber() + 1;
     int col = cursor.columnNumber() + 1;
     positionLabel->setText(QString("Line: %1, Col: %2").arg(line).arg(col));
+    
+    // 文書統計はブロック単位のキャッシュから合計するだけ
+    const DocumentStatistics::Counts counts = documentStats->totals();
+    QString stats = QString("Lines: %1  Words: %2  Chars: %3")
+                    .arg(documentStats->lineCount())
+                    .arg(counts.words)
+                    .arg(counts.characters);
+    if (cursor.hasSelection()) {
+        const DocumentStatistics::Counts selected = documentStats->countSelection(cursor);
+        stats += QString("  Sel: %1 words, %2 chars").arg(selected.words).arg(selected.characters);
+    }
+    statsLabel->setText(stats);
+    statsLabel->setToolTip(QString("CJK characters: %1").arg(counts.cjk));
+    
+    // 書き出す文書の大きさは操作中のウィンドウのもの
+    if (isActiveWindow()) {
+        Metrics::documentBytes.set(qint64(textEditor->document()->characterCount() - 1) * qint64(sizeof(QChar)));
+        Metrics::openDocuments.set(workspace->count());
+    }
+}
+
+void MainWindow::scheduleStatusUpdate()
+{
+    if (!statusUpdateTimer->isActive()) {
+        statusUpdateTimer->start();
+    }
 }
 
 void MainWindow::documentModified()
@@ -1094,8 +2194,8 @@ bool MainWindow::maybeSave()
             QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
         
         if (ret == QMessageBox::Save) {
-            saveFile();
-            return !textEditor->document()->isModified();
+            // 確認の直後に閉じるので、ここでは書き込みを待つ
+            return saveDocument(false);
         } else if (ret == QMessageBox::Cancel) {
             return false;
         }
@@ -1112,35 +2212,188 @@ void MainWindow::setCurrentFile(const QString &fileName)
     QString shownName = currentFile.isEmpty() ? "untitled.txt" : 
                        QFileInfo(currentFile).fileName();
     setWindowTitle(QString("%1[*] - WLEditor").arg(shownName));
+    
+    const int index = workspace->indexOf(textEditor->document());
+    if (index >= 0) {
+        workspace->entry(index).filePath = currentFile;
+        updateTabTitle(index);
+    }
+    if (SyntaxHighlighter *highlighter = currentHighlighter()) {
+        highlighter->setLanguage(SyntaxHighlighter::languageForFile(currentFile));
+    }
 }
 
-void MainWindow::loadSettings()
+QTextDocument *MainWindow::createDocument(const QString &fileName)
 {
-    restoreGeometry(settings->value("geometry").toByteArray());
+    QTextDocument *document = new QTextDocument(workspace);
+    document->setDefaultFont(textEditor->font());
+    
+    // 構文ハイライタは文書の子として持たせ、文書と一緒に破棄する
+    SyntaxHighlighter *highlighter = new SyntaxHighlighter(document);
+    highlighter->attach(document);
+    highlighter->setLanguage(SyntaxHighlighter::languageForFile(fileName));
+    
+    connect(document, &QTextDocument::modificationChanged, this, [this, document]() {
+        updateTabTitle(workspace->indexOf(document));
+        if (document == textEditor->document()) {
+            documentModified();
+        }
+    });
     
-    QFont defaultFont("Noto Sans Mono CJK JP", 12);
-    
-    if (!QFontDatabase().families().contains("Noto Sans Mono CJK JP")) {
-        QStringList fallbackFonts = {
-            "Noto Sans Mono",
-            "DejaVu Sans Mono", 
-            "Liberation Mono",
-            "Consolas",
-            "Monaco",
-            "Courier New"
-        };
-        
-        for (const QString &fontName : fallbackFonts) {
-            if (QFontDatabase().families().contains(fontName)) {
-                defaultFont.setFamily(fontName);
-                break;
-            }
+    // 標準の undo スタックの代わりに差分の履歴を持つ
+    DocumentUndo *history = new DocumentUndo(document);
+    history->setMemoryLimit(settings->value("undoMemoryLimitMB", 64).toLongLong() * 1024 * 1024);
+    connect(history, &DocumentUndo::undoAvailable, this, [this, document]() {
+        if (document == textEditor->document()) {
+            updateUndoActions();
+        }
+    });
+    connect(history, &DocumentUndo::redoAvailable, this, [this, document]() {
+        if (document == textEditor->document()) {
+            updateUndoActions();
         }
+    });
+    connect(history, &DocumentUndo::historyDropped, this, [this](const QString &reason) {
+        statusBar()->showMessage(reason, 8000);
+    });
+    return document;
+}
+
+void MainWindow::updateUndoActions()
+{
+    DocumentUndo *history = DocumentUndo::forDocument(textEditor->document());
+    undoAction->setEnabled(history && history->isUndoAvailable());
+    redoAction->setEnabled(history && history->isRedoAvailable());
+}
+
+int MainWindow::addDocumentTab(const QString &fileName)
+{
+    const int index = workspace->addDocument(fileName);
+    tabBar->insertTab(index, QString());
+    updateTabTitle(index);
+    return index;
+}
+
+bool MainWindow::isTabModified(int index) const
+{
+    const DocumentWorkspace::Entry &entry = workspace->entry(index);
+    return entry.document ? entry.document->isModified() : entry.modified;
+}
+
+void MainWindow::updateTabTitle(int index)
+{
+    if (index < 0 || index >= tabBar->count()) return;
+    
+    const DocumentWorkspace::Entry &entry = workspace->entry(index);
+    QString title = entry.filePath.isEmpty() ? "untitled.txt" : QFileInfo(entry.filePath).fileName();
+    if (isTabModified(index)) {
+        title += "*";
+    }
+    tabBar->setTabText(index, title);
+    
+    // 休止中のタブは灰色で表示
+    const bool hibernated = workspace->isHibernated(index);
+    tabBar->setTabTextColor(index, hibernated ? QColor(Qt::gray) : QColor());
+    QString tip = entry.filePath.isEmpty() ? title : entry.filePath;
+    if (hibernated) {
+        tip += " (hibernated)";
+    }
+    tabBar->setTabToolTip(index, tip);
+}
+
+SyntaxHighlighter *MainWindow::currentHighlighter() const
+{
+    return textEditor->document()->findChild<SyntaxHighlighter*>(QString(), Qt::FindDirectChildrenOnly);
+}
+
+void MainWindow::onTabChanged(int index)
+{
+    if (index < 0) return;
+    
+    // 切り替え前の文書のカーソルとスクロール位置を保存
+    const int previous = workspace->indexOf(textEditor->document());
+    if (previous >= 0 && previous != index) {
+        DocumentWorkspace::Entry &entry = workspace->entry(previous);
+        entry.cursorPosition = textEditor->textCursor().position();
+        entry.scrollValue = textEditor->verticalScrollBar()->value();
+    }
+    
+    // 休止中の文書はここで復元される
+    QTextDocument *document = workspace->activate(index);
+    if (!document) {
+        const DocumentWorkspace::Entry &entry = workspace->entry(index);
+        QMessageBox::warning(this, "WLEditor",
+                             QString("Cannot restore %1.").arg(entry.filePath.isEmpty() ? "untitled.txt" : entry.filePath));
+        if (previous >= 0 && previous != index) {
+            QSignalBlocker blocker(tabBar);
+            tabBar->setCurrentIndex(previous);
+        }
+        return;
+    }
+    
+    if (document != textEditor->document()) {
+        textEditor->switchDocument(document);
+        documentStats->setDocument(document);
+        overviewRuler->setDocument(document);
+        
+        const DocumentWorkspace::Entry &entry = workspace->entry(index);
+        QTextCursor cursor(document);
+        cursor.setPosition(qBound(0, entry.cursorPosition, document->characterCount() - 1));
+        textEditor->setTextCursor(cursor);
+        textEditor->verticalScrollBar()->setValue(entry.scrollValue);
     }
     
-    QFont font = settings->value("font", defaultFont).value<QFont>();
+    currentFile = workspace->entry(index).filePath;
+    const QString shownName = currentFile.isEmpty() ? "untitled.txt" : QFileInfo(currentFile).fileName();
+    setWindowTitle(QString("%1[*] - WLEditor").arg(shownName));
+    setWindowModified(document->isModified());
+    updateTabTitle(index);
+    updateUndoActions();
+    scheduleStatusUpdate();
+}
+
+void MainWindow::closeTab(int index)
+{
+    if (index < 0 || index >= workspace->count()) return;
+    
+    if (isTabModified(index)) {
+        tabBar->setCurrentIndex(index);
+        if (!maybeSave()) return;
+    }
+    
+    // 最後のタブを閉じるときは空の文書を残す
+    if (workspace->count() == 1) {
+        addDocumentTab("");
+    }
+    if (index == tabBar->currentIndex()) {
+        tabBar->setCurrentIndex(index + 1 < tabBar->count() ? index + 1 : index - 1);
+    }
+    
+    {
+        // 番号のずれた currentChanged で文書を切り替えないよう、削除中は通知を止める
+        QSignalBlocker blocker(tabBar);
+        tabBar->removeTab(index);
+    }
+    workspace->removeDocument(index);
+}
+
+void MainWindow::closeCurrentTab()
+{
+    closeTab(tabBar->currentIndex());
+}
+
+void MainWindow::loadSettings()
+{
+    restoreGeometry(settings->value("geometry").toByteArray());
+    
+    // 保存済みフォントがあればフォントデータベースを参照しない
+    QFont font;
+    if (settings->contains("font")) {
+        font = settings->value("font").value<QFont>();
+    } else {
+        font = QFont(resolveDefaultFontFamily(), 12);
+    }
     textEditor->setFont(font);
-    fontComboBox->setCurrentFont(font);
     fontSizeSpinBox->setValue(font.pointSize());
     
     int wrapWidth = settings->value("wrapWidth", 80).toInt();
@@ -1149,12 +2402,57 @@ void MainWindow::loadSettings()
     
     toolBarVisible = settings->value("toolBarVisible", true).toBool();
     statusExtrasVisible = settings->value("statusExtrasVisible", true).toBool();
+    overviewRulerVisible = settings->value("overviewRulerVisible", true).toBool();
+    workspace->setHibernateAfter(settings->value("hibernateMinutes", 10).toInt());
+    textEditor->loadKeymap(settings);
+    
+    // クリップボード履歴は全ウィンドウで共有するので、保存分は最初のウィンドウで読み込む
+    ClipboardRing &ring = ClipboardRing::instance();
+    ring.setMaximumEntries(settings->value("clipboardEntries", 10).toInt());
+    ring.setByteBudget(settings->value("clipboardBudgetMB", 256).toLongLong() * 1024 * 1024);
+    if (ring.isEmpty() && settings->value("persistClipboard", false).toBool()) {
+        ring.load(ClipboardRing::defaultPath());
+    }
     
-    mainToolBar->setVisible(toolBarVisible);
     statusExtrasWidget->setVisible(statusExtrasVisible);
+    overviewRuler->setVisible(overviewRulerVisible);
     
     toggleToolBarAction->setChecked(toolBarVisible);
     toggleStatusExtrasAction->setChecked(statusExtrasVisible);
+    toggleOverviewRulerAction->setChecked(overviewRulerVisible);
+    textEditor->setPerformanceHudVisible(settings->value("performanceHudVisible", false).toBool());
+}
+
+QString MainWindow::resolveDefaultFontFamily()
+{
+    // 解決済みのファミリー名はQSettingsにキャッシュし、次回起動では列挙を省略
+    const QString cached = settings->value("resolvedFontFamily").toString();
+    if (!cached.isEmpty()) {
+        return cached;
+    }
+    
+    const QStringList candidates = {
+        "Noto Sans Mono CJK JP",
+        "Noto Sans Mono",
+        "DejaVu Sans Mono", 
+        "Liberation Mono",
+        "Consolas",
+        "Monaco",
+        "Courier New"
+    };
+    
+    // フォントファミリー一覧の取得は1回だけ
+    const QStringList families = QFontDatabase::families();
+    QString resolved = candidates.first();
+    for (const QString &fontName : candidates) {
+        if (families.contains(fontName)) {
+            resolved = fontName;
+            break;
+        }
+    }
+    
+    settings->setValue("resolvedFontFamily", resolved);
+    return resolved;
 }
 
 void MainWindow::saveSettings()
@@ -1164,22 +2462,49 @@ void MainWindow::saveSettings()
     settings->setValue("wrapWidth", wrapWidthSpinBox->value());
     settings->setValue("toolBarVisible", toolBarVisible);
     settings->setValue("statusExtrasVisible", statusExtrasVisible);
+    settings->setValue("overviewRulerVisible", overviewRulerVisible);
+    settings->setValue("performanceHudVisible", textEditor->isPerformanceHudVisible());
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    if (maybeSave()) {
-        saveSettings();
-        event->accept();
-    } else {
-        event->ignore();
+    // 変更のあるタブを順に表示して保存を確認する
+    for (int i = 0; i < workspace->count(); ++i) {
+        if (!isTabModified(i)) continue;
+        tabBar->setCurrentIndex(i);
+        if (!maybeSave()) {
+            event->ignore();
+            return;
+        }
+    }
+    saveSettings();
+    if (settings->value("persistClipboard", false).toBool()) {
+        ClipboardRing::instance().save(ClipboardRing::defaultPath());
+    }
+    if (!keyRecordingPath.isEmpty()) {
+        // 再生で同じ動きになるよう、キーの意味を変える設定も一緒に保存する
+        KeyMacro keys = textEditor->sessionKeys();
+        QVariantMap recorded;
+        recorded.insert("wrapWidth", settings->value("wrapWidth", 80));
+        settings->beginGroup("keymap");
+        for (const QString &sequence : settings->childKeys()) {
+            recorded.insert("keymap/" + sequence, settings->value(sequence));
+        }
+        settings->endGroup();
+        keys.setSettings(recorded);
+        if (!keys.save(keyRecordingPath)) {
+            qWarning() << "cannot write key recording" << keyRecordingPath;
+        }
     }
+    event->accept();
 }
 
 void MainWindow::toggleToolBar()
 {
     toolBarVisible = !toolBarVisible;
-    mainToolBar->setVisible(toolBarVisible);
+    if (mainToolBar) {
+        mainToolBar->setVisible(toolBarVisible);
+    }
     toggleToolBarAction->setChecked(toolBarVisible);
     settings->setValue("toolBarVisible", toolBarVisible);
 }
@@ -1192,6 +2517,14 @@ void MainWindow::toggleStatusBarExtras()
     settings->setValue("statusExtrasVisible", statusExtrasVisible);
 }
 
+void MainWindow::toggleOverviewRuler()
+{
+    overviewRulerVisible = !overviewRulerVisible;
+    overviewRuler->setVisible(overviewRulerVisible);
+    toggleOverviewRulerAction->setChecked(overviewRulerVisible);
+    settings->setValue("overviewRulerVisible", overviewRulerVisible);
+}
+
 void MainWindow::showPreferences()
 {
     QDialog *prefDialog = new QDialog(this);
@@ -1208,7 +2541,9 @@ void MainWindow::showPreferences()
     toolBarCheck->setChecked(toolBarVisible);
     connect(toolBarCheck, &QCheckBox::toggled, [this](bool checked) {
         toolBarVisible = checked;
-        mainToolBar->setVisible(checked);
+        if (mainToolBar) {
+            mainToolBar->setVisible(checked);
+        }
         toggleToolBarAction->setChecked(checked);
         settings->setValue("toolBarVisible", checked);
     });
@@ -1226,6 +2561,83 @@ void MainWindow::showPreferences()
     
     layout->addWidget(uiGroup);
     
+    QGroupBox *documentGroup = new QGroupBox("Documents", prefDialog);
+    QGridLayout *documentLayout = new QGridLayout(documentGroup);
+    documentLayout->addWidget(new QLabel("Hibernate inactive tabs after:", documentGroup), 0, 0);
+    QSpinBox *hibernateSpinBox = new QSpinBox(documentGroup);
+    hibernateSpinBox->setRange(0, 240);
+    hibernateSpinBox->setSpecialValueText("Never");
+    hibernateSpinBox->setSuffix(" min");
+    hibernateSpinBox->setValue(workspace->hibernateAfter());
+    hibernateSpinBox->setToolTip("Unused tabs release their memory and are restored when selected (0=never)");
+    connect(hibernateSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), [this](int minutes) {
+        workspace->setHibernateAfter(minutes);
+        settings->setValue("hibernateMinutes", minutes);
+    });
+    documentLayout->addWidget(hibernateSpinBox, 0, 1);
+    
+    documentLayout->addWidget(new QLabel("Undo memory per document:", documentGroup), 1, 0);
+    QSpinBox *undoLimitSpinBox = new QSpinBox(documentGroup);
+    undoLimitSpinBox->setRange(1, 1024);
+    undoLimitSpinBox->setSuffix(" MB");
+    undoLimitSpinBox->setValue(settings->value("undoMemoryLimitMB", 64).toInt());
+    undoLimitSpinBox->setToolTip("Oldest undo steps are discarded when a document's history exceeds this size");
+    connect(undoLimitSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), [this](int megabytes) {
+        settings->setValue("undoMemoryLimitMB", megabytes);
+        for (int i = 0; i < workspace->count(); ++i) {
+            if (DocumentUndo *history = DocumentUndo::forDocument(workspace->entry(i).document)) {
+                history->setMemoryLimit(qint64(megabytes) * 1024 * 1024);
+            }
+        }
+    });
+    documentLayout->addWidget(undoLimitSpinBox, 1, 1);
+    
+    QCheckBox *persistUndoCheck = new QCheckBox("Keep undo history of saved files after closing", documentGroup);
+    persistUndoCheck->setChecked(settings->value("persistUndo", false).toBool());
+    connect(persistUndoCheck, &QCheckBox::toggled, [this](bool checked) {
+        settings->setValue("persistUndo", checked);
+    });
+    documentLayout->addWidget(persistUndoCheck, 2, 0, 1, 2);
+    documentLayout->setColumnStretch(2, 1);
+    layout->addWidget(documentGroup);
+    
+    // クリップボード履歴
+    QGroupBox *clipboardGroup = new QGroupBox("Clipboard History", prefDialog);
+    QGridLayout *clipboardLayout = new QGridLayout(clipboardGroup);
+    clipboardLayout->addWidget(new QLabel("Entries:", clipboardGroup), 0, 0);
+    QSpinBox *clipboardEntriesSpinBox = new QSpinBox(clipboardGroup);
+    clipboardEntriesSpinBox->setRange(1, 100);
+    clipboardEntriesSpinBox->setValue(ClipboardRing::instance().maximumEntries());
+    connect(clipboardEntriesSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), [this](int count) {
+        settings->setValue("clipboardEntries", count);
+        ClipboardRing::instance().setMaximumEntries(count);
+    });
+    clipboardLayout->addWidget(clipboardEntriesSpinBox, 0, 1);
+    
+    clipboardLayout->addWidget(new QLabel("Memory budget:", clipboardGroup), 1, 0);
+    QSpinBox *clipboardBudgetSpinBox = new QSpinBox(clipboardGroup);
+    clipboardBudgetSpinBox->setRange(1, 4096);
+    clipboardBudgetSpinBox->setSuffix(" MB");
+    clipboardBudgetSpinBox->setValue(int(ClipboardRing::instance().byteBudget() / (1024 * 1024)));
+    clipboardBudgetSpinBox->setToolTip("Oldest entries are dropped when the history exceeds this size; the newest entry is always kept");
+    connect(clipboardBudgetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), [this](int megabytes) {
+        settings->setValue("clipboardBudgetMB", megabytes);
+        ClipboardRing::instance().setByteBudget(qint64(megabytes) * 1024 * 1024);
+    });
+    clipboardLayout->addWidget(clipboardBudgetSpinBox, 1, 1);
+    
+    QCheckBox *persistClipboardCheck = new QCheckBox("Keep clipboard history between sessions", clipboardGroup);
+    persistClipboardCheck->setChecked(settings->value("persistClipboard", false).toBool());
+    connect(persistClipboardCheck, &QCheckBox::toggled, [this](bool checked) {
+        settings->setValue("persistClipboard", checked);
+        if (!checked) {
+            QFile::remove(ClipboardRing::defaultPath());
+        }
+    });
+    clipboardLayout->addWidget(persistClipboardCheck, 2, 0, 1, 2);
+    clipboardLayout->setColumnStretch(2, 1);
+    layout->addWidget(clipboardGroup);
+    
     QHBoxLayout *buttonLayout = new QHBoxLayout();
     QPushButton *okButton = new QPushButton("OK", prefDialog);
     QPushButton *cancelButton = new QPushButton("Cancel", prefDialog);
@@ -1243,10 +2655,102 @@ void MainWindow::showPreferences()
     delete prefDialog;
 }
 
+void MainWindow::showTaskDiagnostics()
+{
+    QDialog *dialog = new QDialog(this);
+    dialog->setWindowTitle("Background Tasks");
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    QLabel *report = new QLabel(dialog);
+    report->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    report->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(report);
+    
+    QHBoxLayout *buttonLayout = new QHBoxLayout();
+    QPushButton *cancelAllButton = new QPushButton("Cancel &All", dialog);
+    QPushButton *closeButton = new QPushButton("&Close", dialog);
+    connect(cancelAllButton, &QPushButton::clicked, scheduler, &TaskScheduler::cancelAll);
+    connect(closeButton, &QPushButton::clicked, dialog, &QDialog::close);
+    buttonLayout->addWidget(cancelAllButton);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(closeButton);
+    layout->addLayout(buttonLayout);
+    
+    // キューの長さとワーカーの稼働率を0.5秒ごとに表示
+    auto refresh = [this, report]() {
+        const TaskScheduler::Statistics stats = scheduler->statistics();
+        QString text = QString("Workers: %1 (busy %2)\n").arg(stats.workerCount).arg(stats.busyWorkers);
+        text += QString("Queued: interactive %1, visible %2, background %3\n")
+                .arg(stats.queued[TaskScheduler::Interactive])
+                .arg(stats.queued[TaskScheduler::Visible])
+                .arg(stats.queued[TaskScheduler::Background]);
+        text += QString("Tasks: %1 submitted, %2 completed, %3 cancelled, %4 stolen\n")
+                .arg(stats.submitted).arg(stats.completed).arg(stats.cancelled).arg(stats.stolen);
+        for (int i = 0; i < stats.utilization.size(); ++i) {
+            text += QString("\nWorker %1: %2%").arg(i + 1, 2).arg(int(stats.utilization.at(i) * 100), 3);
+        }
+        report->setText(text);
+    };
+    QTimer *refreshTimer = new QTimer(dialog);
+    refreshTimer->setInterval(500);
+    connect(refreshTimer, &QTimer::timeout, dialog, refresh);
+    refreshTimer->start();
+    refresh();
+    
+    dialog->show();
+}
+
+void MainWindow::showMemoryDiagnostics()
+{
+    QDialog *dialog = new QDialog(this);
+    dialog->setWindowTitle("Memory Usage");
+    dialog->setAttribute(Qt::WA_DeleteOnClose);
+    
+    QVBoxLayout *layout = new QVBoxLayout(dialog);
+    QLabel *report = new QLabel(dialog);
+    report->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    report->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(report);
+    
+    QPushButton *closeButton = new QPushButton("&Close", dialog);
+    connect(closeButton, &QPushButton::clicked, dialog, &QDialog::close);
+    layout->addWidget(closeButton, 0, Qt::AlignRight);
+    
+    // レイアウトの見積もりは全ブロックを数えるので、更新は1秒ごと
+    auto refresh = [this, report]() {
+        DocumentMemory all;
+        QString text;
+        for (int i = 0; i < workspace->count(); ++i) {
+            const DocumentWorkspace::Entry &entry = workspace->entry(i);
+            text += entry.filePath.isEmpty() ? QString("untitled.txt") : QFileInfo(entry.filePath).fileName();
+            if (workspace->isHibernated(i)) {
+                text += " (hibernated)\n\n";
+                continue;
+            }
+            const DocumentMemory memory = documentMemory(i);
+            text += "\n" + memory.report() + "\n";
+            all += memory;
+        }
+        if (workspace->count() > 1) {
+            text += "All documents\n" + all.report();
+        }
+        report->setText(text.trimmed());
+    };
+    QTimer *refreshTimer = new QTimer(dialog);
+    refreshTimer->setInterval(1000);
+    connect(refreshTimer, &QTimer::timeout, dialog, refresh);
+    refreshTimer->start();
+    refresh();
+    
+    dialog->show();
+}
+
 // FindReplaceDialog実装
 FindReplaceDialog::FindReplaceDialog(QWidget *parent)
     : QDialog(parent)
     , textEditor(nullptr)
+    , replaceTask(0)
 {
     setWindowTitle("Find/Replace");
     setModal(false);
@@ -1318,7 +2822,10 @@ void FindReplaceDialog::findNext()
     if (wholeWordCheckBox->isChecked())
         flags |= QTextDocument::FindWholeWords;
     
+    QElapsedTimer clock;
+    clock.start();
     bool found = textEditor->find(searchText, flags);
+    Metrics::searchDuration.observe(clock.nsecsElapsed());
     
     if (!found) {
         QMessageBox::information(this, "Find", "Text not found");
@@ -1337,7 +2844,10 @@ void FindReplaceDialog::findPrevious()
     if (wholeWordCheckBox->isChecked())
         flags |= QTextDocument::FindWholeWords;
     
+    QElapsedTimer clock;
+    clock.start();
     bool found = textEditor->find(searchText, flags);
+    Metrics::searchDuration.observe(clock.nsecsElapsed());
     
     if (!found) {
         QMessageBox::information(this, "Find", "Text not found");
@@ -1357,29 +2867,77 @@ void FindReplaceDialog::replace()
 
 void FindReplaceDialog::replaceAll()
 {
-    if (!textEditor || findLineEdit->text().isEmpty()) return;
-    
-    QString searchText = findLineEdit->text();
-    QString replaceText = replaceLineEdit->text();
-    
-    QTextCursor cursor = textEditor->textCursor();
-    cursor.movePosition(QTextCursor::Start);
-    textEditor->setTextCursor(cursor);
-    
-    int replacements = 0;
-    QTextDocument::FindFlags flags = QTextDocument::FindFlags();
-    
-    if (caseSensitiveCheckBox->isChecked())
-        flags |= QTextDocument::FindCaseSensitively;
-    if (wholeWordCheckBox->isChecked())
-        flags |= QTextDocument::FindWholeWords;
-    
-    while (textEditor->find(searchText, flags)) {
-        QTextCursor currentCursor = textEditor->textCursor();
-        currentCursor.insertText(replaceText);
-        replacements++;
+    TaskScheduler &scheduler = TaskScheduler::shared();
+    // 置換中にもう一度押せば取り消す
+    if (replaceTask) {
+        scheduler.cancel(replaceTask);
+        return;
     }
+    if (!textEditor || findLineEdit->text().isEmpty()) return;
     
-    QMessageBox::information(this, "Replace All", 
-        QString("Replaced %1 occurrences").arg(replacements));
-}
\ No newline at end of file
+    const QString searchText = findLineEdit->text();
+    const QString replaceText = replaceLineEdit->text();
+    
+    TextSearch::Options options;
+    options.caseSensitive = caseSensitiveCheckBox->isChecked();
+    options.wholeWords = wholeWordCheckBox->isChecked();
+    
+    // 本文の写しを行ごとに置き換える処理はワーカースレッドで行い（バッチモードと同じ TextSearch の規則）、
+    // 文書が変わっていなければ、変わった行だけを1つの編集ブロックで差し替える
+    QTextDocument *document = textEditor->document();
+    auto text = std::make_shared<QString>(DocumentRange::text(document, 0, document->characterCount() - 1));
+    auto changes = std::make_shared<std::vector<std::pair<int, QString>>>();   // ブロック番号と置き換え後の行
+    auto replacements = std::make_shared<int>(0);
+    const int revision = document->revision();
+    QPointer<QTextDocument> target(document);
+    QPointer<FindReplaceDialog> dialog(this);
+    QElapsedTimer clock;
+    clock.start();
+    
+    replaceAllButton->setText("Stop Replace &All");
+    replaceTask = scheduler.submit("Replacing " + searchText, TaskScheduler::Interactive,
+        [text, changes, replacements, searchText, replaceText, options](TaskScheduler::TaskContext &context) {
+            const QStringView all(*text);
+            qsizetype start = 0;
+            for (int block = 0; ; ++block) {
+                if (context.isCancelled()) return;
+                qsizetype end = all.indexOf(QChar(QChar::ParagraphSeparator), start);
+                if (end < 0) end = all.size();
+                const QStringView line = all.mid(start, end - start);
+                if (TextSearch::indexIn(line, searchText, 0, options) >= 0) {
+                    QString replaced = line.toString();
+                    *replacements += TextSearch::replaceAll(replaced, searchText, replaceText, options);
+                    changes->emplace_back(block, std::move(replaced));
+                }
+                context.setProgress(end, all.size());
+                if (end >= all.size()) break;
+                start = end + 1;
+            }
+        },
+        [this, dialog, target, revision, changes, replacements, clock](bool cancelled) {
+            if (!dialog) return;
+            replaceTask = 0;
+            replaceAllButton->setText("Replace &All");
+            if (cancelled) return;
+            if (!target || target->revision() != revision) {
+                QMessageBox::information(this, "Replace All",
+                    "The document changed while searching. Nothing was replaced.");
+                return;
+            }
+            
+            QTextCursor cursor(target);
+            cursor.beginEditBlock();
+            for (const auto &change : *changes) {
+                const QTextBlock block = target->findBlockByNumber(change.first);
+                if (!block.isValid()) break;
+                cursor.setPosition(block.position());
+                cursor.setPosition(block.position() + block.length() - 1, QTextCursor::KeepAnchor);
+                cursor.insertText(change.second);
+            }
+            cursor.endEditBlock();
+            Metrics::searchDuration.observe(clock.nsecsElapsed());
+            
+            QMessageBox::information(this, "Replace All",
+                QString("Replaced %1 occurrences").arg(*replacements));
+        });
+}
@@ -33,8 +33,24 @@
 #include <QGroupBox>
 #include <QWidget>
 #include <QProcess>
+#include <QTabBar>
+#include "ColumnBlock.h"
+#include "KeyMacro.h"
+#include "Keymap.h"
+#include "DocumentMemory.h"
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QHash>
+#include <QSet>
 
 class FindReplaceDialog;
+class DocumentStatistics;
+class SyntaxHighlighter;
+class OverviewRuler;
+class DocumentWorkspace;
+class TaskScheduler;
+class MainWindow;
+class PerformanceHud;
 
 // カスタムテキストエディタクラス（WordStarキーバインド対応）
 class CustomTextEdit : public QTextEdit
@@ -45,6 +61,43 @@ public:
     CustomTextEdit(QWidget *parent = nullptr);
     void setWrapWidth(int characters);
     int getWrapWidth() const { return wrapCharacters; }
+    bool isBlockMode() const { return blockMode; }
+    QTextCursor blockStart() const { return blockStartCursor; }
+    
+    // タブ切り替え時に表示する文書を差し替える（ブロック選択と2段階キー状態は解除）
+    void switchDocument(QTextDocument *document);
+    
+    // 文書ごとの取り消し履歴（DocumentUndo）で取り消し／やり直し
+    void undoEdit();
+    void redoEdit();
+    
+    // キーマクロ。記録中は keyPressEvent を通ったキーを順に保存する
+    // ダイアログで引数を尋ねるコマンド（検索・置換・桁の塗りつぶし・ブロックの読み書き）は
+    // 記録せず、読み込んだマクロにあれば再生をそこで止める
+    void startMacroRecording();
+    void stopMacroRecording();
+    bool isRecordingMacro() const { return recordingMacro; }
+    bool isReplayingMacro() const { return replayingMacro; }
+    const KeyMacro &macro() const { return recordedMacro; }
+    void setMacro(const KeyMacro &macro) { recordedMacro = macro; }
+    // count 回（0 なら文書末尾に達するか何も変わらなくなるまで）再生し、再生した回数を返す
+    int replayMacro(int count);
+    
+    // 操作全体の記録（--record-keys）。マクロの記録とは別に、エディタが受けたキーをすべて持つ
+    // 形式はキーマクロと同じなので、wledit_bench --replay でそのまま再生して遅延を測れる
+    void startSessionRecording();
+    const KeyMacro &sessionKeys() const { return sessionRecording; }
+    
+    // キー割り当てを既定に戻し、settings があれば "keymap" グループの上書きを適用する
+    void loadKeymap(QSettings *settings);
+    
+    // 性能表示（Ctrl+O,P）。計測は表示していなくても続ける
+    PerformanceHud *performanceHud() const { return hud; }
+    bool isPerformanceHudVisible() const;
+    void setPerformanceHudVisible(bool visible);
+
+signals:
+    void performanceHudToggled(bool visible);
 
 protected:
     void resizeEvent(QResizeEvent *event) override;
@@ -54,26 +107,74 @@ protected:
 
 private:
     void updateWrapWidth();
-    void handleCtrlQ(QKeyEvent *event);
-    void handleCtrlK(QKeyEvent *event);
+    void movePage(int direction);
     void resetTwoKeyMode();
+    MainWindow *ownerWindow();
+    void blockCopy();
+    void blockCut();
+    void setMarker(int index);
+    void gotoMarker(int index);
     void updateBlockSelection();
+    void copyToClipboardRing(const QString &text);
+    void pasteFromClipboardRing();
+    void showClipboardPreview(int index, const QString &hint);
+    
+    // ブロック操作（Ctrl+K,V / W / R）。大きな範囲もチャンク単位で処理する
+    QTextCursor currentBlockRange() const;
+    void moveBlock();
+    void writeBlock();
+    void readBlock();
+    void showStatusMessage(const QString &message);
+    
+    // 桁ブロックモード（Ctrl+K,N）
+    int tabColumns() const;
+    ColumnBlock::Range columnRange() const;
+    void copyColumns(bool cut);
+    void pasteColumns();
+    void fillColumns();
+    void updateColumnSelections();
     
     int wrapCharacters;
     bool useCharacterWrap;
     
-    // 2段階キーバインド用
-    bool waitingForCtrlQ;
-    bool waitingForCtrlK;
+    // キー割り当て（keyState は入力途中の並びの位置、0 なら先頭）
+    friend struct KeyCommands;
+    Keymap keymap;
+    int keyState;
     QTimer *resetTimer;
+    QPointer<MainWindow> owner;
     
     // 選択機能用
     QTextCursor blockStartCursor;
     bool blockMode;
+    // Ctrl+K,K で確定したブロック（編集に合わせて位置が追従する）
+    QTextCursor markedBlock;
+    bool columnMode;
+    // Ctrl+K,0-9 で置くマーカー（Ctrl+Q,0-9 で移動）
+    QTextCursor markers[10];
     
-    // クリップボード履歴
-    QStringList clipboardHistory;
+    // クリップボード履歴（ClipboardRing）の貼り付け位置
     int currentClipboardIndex;
+    // 直前の Ctrl+K,C で貼り付けた範囲（続けて押すと古い履歴に置き換える）
+    // 範囲は QTextCursor で持ち、貼り付け以外の編集（版 revision が進む変更）があった時点で空にする
+    QTextCursor lastPaste;
+    int lastPasteRevision;
+    bool pastingFromRing;
+    QMetaObject::Connection pasteWatch;
+    void watchPasteCycle(QTextDocument *document);
+    
+    // キーマクロ
+    KeyMacro recordedMacro;
+    QElapsedTimer macroClock;
+    bool recordingMacro;
+    bool replayingMacro;
+    bool macroStopped;           // 再生中にダイアログのコマンドに当たった
+    int macroSequenceStart;      // 記録中のキーの並びの先頭（記録しない並びを外すため）
+    KeyMacro sessionRecording;
+    QElapsedTimer sessionClock;
+    bool recordingSession;
+    
+    PerformanceHud *hud;
 };
 
 class MainWindow : public QMainWindow
@@ -84,6 +185,20 @@ public:
     MainWindow(QWidget *parent = nullptr);
     ~MainWindow();
     void openFileFromArgs(const QString &fileName);
+    
+    // 同じプロセス内に新しいウィンドウを開く（閉じると自動で破棄）
+    static MainWindow *openWindow(const QString &fileName);
+    
+    // このウィンドウのキー操作を記録し、閉じるときに path へ書き出す（--record-keys）
+    void recordKeys(const QString &path);
+
+    // メモリ不足への対応（level は MemoryPressure::Level。Android の onTrimMemory と同じ段階）
+    // ルーラーの要約を捨て、段階に応じて文書の写しを詰め、取り消し履歴を書き出す。減ったバイト数を返す
+    qint64 trimMemory(int level);
+    
+    // タブ index の文書のメモリの内訳（休止中の文書は 0）
+    // 表示中の文書にはクリップボード履歴・検索の要約・追加の選択表示も数える
+    DocumentMemory documentMemory(int index) const;
 
     // WordStar検索メソッド
     void wordstarFind();
@@ -106,41 +221,91 @@ private slots:
     void setFont();
     void setWrapWidth();
     void updateStatusBar();
+    void scheduleStatusUpdate();
     void documentModified();
     void onWrapWidthChanged(int value);
     void toggleToolBar();
     void toggleStatusBarExtras();
+    void toggleOverviewRuler();
     void showPreferences();
+    void onTabChanged(int index);
+    void closeTab(int index);
+    void closeCurrentTab();
+    void showTaskDiagnostics();
+    void showMemoryDiagnostics();
+    void toggleMacroRecording();
+    void playMacro();
+    void saveMacro();
+    void loadMacro();
+
+protected:
+    bool eventFilter(QObject *obj, QEvent *event) override;
+    void changeEvent(QEvent *event) override;
 
 private:
+    // bench/wledit_bench.cpp から読み込み・保存・設定の読み込みを直接呼ぶ
+    friend class EditorBench;
+    
     void setupMenus();
     void setupStatusBar();
     void setupToolBar();
+    void setupFontComboBox();
+    void finishStartup();
     void closeEvent(QCloseEvent *event) override;
     bool maybeSave();
+    bool saveDocument(bool inBackground);
     void setCurrentFile(const QString &fileName);
     void loadSettings();
     void saveSettings();
+    QString resolveDefaultFontFamily();
+    
+    // タブ（文書）管理
+    QTextDocument *createDocument(const QString &fileName);
+    int addDocumentTab(const QString &fileName);
+    bool isTabModified(int index) const;
+    void updateTabTitle(int index);
+    SyntaxHighlighter *currentHighlighter() const;
+    void updateUndoActions();
+    void markSaved(QTextDocument *document, quint64 state, const QString &fileName);
     
     // WordStar検索用プライベートメソッド
     void performWordStarSearch();
     
     CustomTextEdit *textEditor;
     QString currentFile;
+    QString keyRecordingPath;
     QLabel *statusLabel;
     QLabel *positionLabel;
+    QLabel *statsLabel;
     QLabel *encodingLabel;
     QSpinBox *wrapWidthSpinBox;
     QFontComboBox *fontComboBox;
     QSpinBox *fontSizeSpinBox;
     QSettings *settings;
     
+    // 文書統計（ステータスバー表示は1フレームに1回へまとめる）
+    DocumentStatistics *documentStats;
+    QTimer *statusUpdateTimer;
+    
+    // 読み込み・保存などのバックグラウンド処理（スケジューラはプロセスで1つ）
+    TaskScheduler *scheduler;
+    QSet<quint64> ownTasks;                  // このウィンドウが投入した処理（進捗の表示用）
+    QHash<QString, quint64> pendingOpens;    // 読み込み中のファイル（絶対パス）と処理のID
+    
+    // タブで開いている文書（構文ハイライタは文書ごとに持つ）
+    DocumentWorkspace *workspace;
+    QTabBar *tabBar;
+    
+    // 文書全体の縮小表示
+    OverviewRuler *overviewRuler;
+    
     // アクション
     QAction *newAction;
     QAction *openAction;
     QAction *openInNewWindowAction;
     QAction *saveAction;
     QAction *saveAsAction;
+    QAction *closeTabAction;
     QAction *exitAction;
     QAction *copyAction;
     QAction *cutAction;
@@ -149,15 +314,20 @@ private:
     QAction *redoAction;
     QAction *selectAllAction;
     QAction *findReplaceAction;
+    QAction *recordMacroAction;
     
     FindReplaceDialog *findDialog;
     QAction *toggleToolBarAction;
     QAction *toggleStatusExtrasAction;
+    QAction *toggleOverviewRulerAction;
+    QAction *togglePerformanceHudAction;
     QAction *preferencesAction;
     
     // 設定用メンバー
     bool toolBarVisible;
     bool statusExtrasVisible;
+    bool overviewRulerVisible;
+    bool startupFinished;
     
     // UI要素の参照
     QToolBar *mainToolBar;
@@ -167,6 +337,7 @@ private:
     QString lastSearchText;
     bool lastCaseSensitive;
     bool lastWholeWord;
+    quint64 searchTask;          // 実行中の検索（次の検索を始めたら取り消す）
 };
 
 // 検索・置換ダイアログ
@@ -199,6 +370,7 @@ private:
     
     QTextEdit *textEditor;
     QTextCursor lastFoundCursor;
+    quint64 replaceTask;         // 実行中のすべて置換（0 なら実行していない）
 };
 
 #endif // MAINWINDOW_H
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include "Metrics.h"
+#include <QCoreApplication>
+#include <QFile>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace Metrics {
+
+const double Histogram::BucketSeconds[BucketCount] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10
+};
+
+Histogram openDuration;
+Histogram saveDuration;
+Histogram searchDuration;
+Histogram keyLatency;
+Counter openFailures;
+Counter saveFailures;
+Gauge documentBytes;
+Gauge openDocuments;
+
+void Histogram::observe(qint64 nanoseconds)
+{
+    const double seconds = nanoseconds / 1e9;
+    int index = 0;
+    while (index < BucketCount && seconds > BucketSeconds[index]) ++index;
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+    sumNanoseconds.fetch_add(quint64(qMax<qint64>(0, nanoseconds)), std::memory_order_relaxed);
+}
+
+qint64 residentBytes()
+{
+#ifdef Q_OS_LINUX
+    // /proc/self/statm の2番目の値が常駐ページ数
+    if (FILE *file = std::fopen("/proc/self/statm", "r")) {
+        long size = 0;
+        long resident = 0;
+        const int fields = std::fscanf(file, "%ld %ld", &size, &resident);
+        std::fclose(file);
+        if (fields == 2) return qint64(resident) * sysconf(_SC_PAGESIZE);
+    }
+#endif
+    // 他の環境では現在値が取れないので最大値で代用する
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef Q_OS_MACOS
+    return qint64(usage.ru_maxrss);
+#else
+    return qint64(usage.ru_maxrss) * 1024;
+#endif
+}
+
+namespace {
+QByteArray version;
+
+// ソケットへの接続と送信の上限。受け手が止まっていても stopExport を待たせない
+const std::chrono::milliseconds SocketTimeout(2000);
+#ifdef MSG_NOSIGNAL
+const int SendFlags = MSG_NOSIGNAL;   // 受け手が閉じていても SIGPIPE で落ちない
+#else
+const int SendFlags = 0;              // SO_NOSIGPIPE で同じことをする（macOS）
+#endif
+
+void appendHeader(QByteArray &out, const char *name, const char *type, const char *help)
+{
+    out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+    out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+}
+
+void appendValue(QByteArray &out, const char *name, double value)
+{
+    out += name;
+    out += ' ';
+    out += QByteArray::number(value, 'g', 12);
+    out += '\n';
+}
+
+void appendHistogram(QByteArray &out, const char *name, const char *help, const Histogram &histogram)
+{
+    appendHeader(out, name, "histogram", help);
+    // 数は累積にし、count は最後のバケットと揃える（読む間に増えても矛盾しない）
+    quint64 cumulative = 0;
+    for (int i = 0; i <= Histogram::BucketCount; ++i) {
+        cumulative += histogram.bucket(i);
+        out += name;
+        out += "_bucket{le=\"";
+        out += i < Histogram::BucketCount ? QByteArray::number(Histogram::BucketSeconds[i]) : QByteArray("+Inf");
+        out += "\"} ";
+        out += QByteArray::number(cumulative);
+        out += '\n';
+    }
+    appendValue(out, QByteArray(name).append("_sum").constData(), histogram.sumSeconds());
+    appendValue(out, QByteArray(name).append("_count").constData(), double(cumulative));
+}
+
+bool writeAll(int fd, const QByteArray &data)
+{
+    qint64 done = 0;
+    while (done < data.size()) {
+        const ssize_t count = ::write(fd, data.constData() + done, size_t(data.size() - done));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+// 一時ファイルに書いてから置き換える（読む側が書きかけを見ない）
+bool writeFile(const QByteArray &path, const QByteArray &data)
+{
+    const QByteArray temporary = path + ".tmp";
+    const int fd = ::open(temporary.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) return false;
+    const bool written = writeAll(fd, data);
+    ::close(fd);
+    return written && ::rename(temporary.constData(), path.constData()) == 0;
+}
+
+// 書き込めるようになるまで待つ。deadline を過ぎたら false
+bool waitWritable(int fd, std::chrono::steady_clock::time_point deadline)
+{
+    for (;;) {
+        const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) return false;
+        pollfd target = {fd, POLLOUT, 0};
+        const int ready = ::poll(&target, 1, int(remaining));
+        if (ready > 0) return (target.revents & POLLOUT) != 0;
+        if (ready == 0 || errno != EINTR) return false;
+    }
+}
+
+// 非ブロッキングのソケットへ送り切る
+bool sendAll(int fd, const QByteArray &data, std::chrono::steady_clock::time_point deadline)
+{
+    qint64 done = 0;
+    while (done < data.size()) {
+        const ssize_t count = ::send(fd, data.constData() + done, size_t(data.size() - done), SendFlags);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && waitWritable(fd, deadline)) continue;
+            return false;
+        }
+        done += count;
+    }
+    return true;
+}
+
+// 接続から送信までを SocketTimeout で打ち切る（受け手の待ち行列があふれていれば今回は諦める）
+bool writeSocket(const QByteArray &path, const QByteArray &data)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (size_t(path.size()) >= sizeof(address.sun_path)) return false;
+    std::memcpy(address.sun_path, path.constData(), size_t(path.size()));
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return false;
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+    const int noSignal = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &noSignal, sizeof(noSignal));
+#endif
+
+    const auto deadline = std::chrono::steady_clock::now() + SocketTimeout;
+    bool connected = ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == 0;
+    if (!connected && errno == EINPROGRESS && waitWritable(fd, deadline)) {
+        int error = 0;
+        socklen_t length = sizeof(error);
+        connected = ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) == 0 && error == 0;
+    }
+    const bool sent = connected && sendAll(fd, data, deadline);
+    ::close(fd);
+    return sent;
+}
+
+// 書き出し用のスレッド。stopExport まで interval ごとに起きて書く
+class Exporter
+{
+public:
+    Exporter(const QByteArray &target, int intervalSeconds)
+        : socket(target.startsWith("unix:"))
+        , path(socket ? target.mid(5) : target)
+        , interval(intervalSeconds)
+        , thread([this]() { run(); })
+    {
+    }
+
+    ~Exporter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+private:
+    void run()
+    {
+        bool warned = false;
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            const bool last = wake.wait_for(lock, interval, [this]() { return stopping; });
+            lock.unlock();
+            const QByteArray data = render();
+            const bool ok = socket ? writeSocket(path, data) : writeFile(path, data);
+            // 受け手がいない間も動き続ける。警告は最初の1回だけ
+            if (!ok && !warned) {
+                std::fprintf(stderr, "wledit: cannot write metrics to %s\n", path.constData());
+                warned = true;
+            }
+            lock.lock();
+            if (last) return;
+        }
+    }
+
+    const bool socket;
+    const QByteArray path;
+    const std::chrono::seconds interval;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::thread thread;   // 他のメンバーの後に作る
+};
+
+Exporter *exporter = nullptr;
+}
+
+QByteArray render()
+{
+    QByteArray out;
+    out.reserve(4096);
+    appendHistogram(out, "wledit_open_duration_seconds", "Time to open a file, from read to document.", openDuration);
+    appendHistogram(out, "wledit_save_duration_seconds", "Time to save a document.", saveDuration);
+    appendHistogram(out, "wledit_search_duration_seconds", "Time of a find or replace-all.", searchDuration);
+    appendHistogram(out, "wledit_key_latency_seconds", "Time from a key press to the repaint that shows it.", keyLatency);
+
+    appendHeader(out, "wledit_open_failures_total", "counter", "Files that could not be read.");
+    appendValue(out, "wledit_open_failures_total", double(openFailures.value()));
+    appendHeader(out, "wledit_save_failures_total", "counter", "Saves that could not be written.");
+    appendValue(out, "wledit_save_failures_total", double(saveFailures.value()));
+
+    appendHeader(out, "wledit_document_bytes", "gauge", "Size of the shown document in the active window (UTF-16).");
+    appendValue(out, "wledit_document_bytes", double(documentBytes.value()));
+    appendHeader(out, "wledit_open_documents", "gauge", "Tabs open in the active window.");
+    appendValue(out, "wledit_open_documents", double(openDocuments.value()));
+    appendHeader(out, "wledit_resident_memory_bytes", "gauge", "Resident set size of the process.");
+    appendValue(out, "wledit_resident_memory_bytes", double(residentBytes()));
+
+    appendHeader(out, "wledit_build_info", "gauge", "Always 1; labelled with the version.");
+    out += "wledit_build_info{version=\"" + version + "\"} 1\n";
+    return out;
+}
+
+bool startExport(const QString &target, int intervalSeconds)
+{
+    if (exporter || target.isEmpty()) return false;
+    version = QCoreApplication::applicationVersion().toUtf8();
+    exporter = new Exporter(QFile::encodeName(target), qMax(1, intervalSeconds));
+    return true;
+}
+
+void stopExport()
+{
+    delete exporter;
+    exporter = nullptr;
+}
+
+} // namespace Metrics
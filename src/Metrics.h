@@ -0,0 +1,76 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+
+// 稼働状況の計測値（wledit --metrics-out TARGET で Prometheus のテキスト形式に書き出す）
+// 計測点では atomic の加算だけを行う（ロック・確保なし）。--metrics-out がなくても数えるだけ
+// 書き出しは専用のスレッドが一定間隔で行い、UI スレッドは待たない
+// TARGET が unix:PATH なら Unix ソケットへ毎回接続して送り（接続と送信は2秒で打ち切る）、
+// それ以外はファイルを置き換える
+// （node_exporter の textfile コレクタが読めるよう、一時ファイルに書いてから rename する）
+namespace Metrics {
+
+class Counter
+{
+public:
+    void add(quint64 amount = 1) { count.fetch_add(amount, std::memory_order_relaxed); }
+    quint64 value() const { return count.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> count{0};
+};
+
+class Gauge
+{
+public:
+    void set(qint64 value) { current.store(value, std::memory_order_relaxed); }
+    qint64 value() const { return current.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<qint64> current{0};
+};
+
+// 所要時間のヒストグラム（バケットは 0.5ms〜10s の固定。分位数は histogram_quantile で求める）
+class Histogram
+{
+public:
+    static const int BucketCount = 14;
+    static const double BucketSeconds[BucketCount];
+
+    void observe(qint64 nanoseconds);
+
+    // 累積でないバケットごとの数（最後は上限なし）と合計
+    quint64 bucket(int index) const { return buckets[index].load(std::memory_order_relaxed); }
+    double sumSeconds() const { return sumNanoseconds.load(std::memory_order_relaxed) / 1e9; }
+
+private:
+    std::atomic<quint64> buckets[BucketCount + 1] = {};
+    std::atomic<quint64> sumNanoseconds{0};
+};
+
+extern Histogram openDuration;     // ファイルを開く（読み込み開始から文書への反映まで）
+extern Histogram saveDuration;     // 保存（本文の取り出しから書き込み完了まで）
+extern Histogram searchDuration;   // 検索・すべて置換
+extern Histogram keyLatency;       // キー入力から描画完了まで（PerformanceHud が測る）
+extern Counter openFailures;
+extern Counter saveFailures;
+extern Gauge documentBytes;        // アクティブなウィンドウで表示中の文書（UTF-16）
+extern Gauge openDocuments;        // アクティブなウィンドウのタブ数
+
+// プロセスの常駐メモリ（Linux は /proc/self/statm、他は getrusage の最大値）
+qint64 residentBytes();
+
+// 現在の値を Prometheus のテキスト形式で返す
+QByteArray render();
+
+// 書き出しを始める（UI スレッドから1回だけ呼ぶ）。stopExport は最後に1回書いてスレッドを止める
+bool startExport(const QString &target, int intervalSeconds);
+void stopExport();
+
+} // namespace Metrics
+
+#endif // METRICS_H
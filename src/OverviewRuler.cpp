@@ -0,0 +1,406 @@
+#include "OverviewRuler.h"
+#include "MainWindow.h"
+#include <QAbstractTextDocumentLayout>
+#include <QElapsedTimer>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <algorithm>
+#include <climits>
+
+namespace {
+const int RulerWidth = 64;
+const int MarkerWidth = 6;          // 右端の検索ヒット表示幅
+const int ColumnsPerPixel = 2;
+const int FrameBudgetMs = 8;
+const int IdleIntervalMs = 16;
+const int SyncRecountLimit = 2000;  // これ以上のブロックはアイドル時に走査
+
+const QRgb BackgroundColor = qRgb(0xf4, 0xf4, 0xf4);
+const QRgb TextColor = qRgb(0xa0, 0xa0, 0xa0);
+const QRgb HitColor = qRgb(0xff, 0x8c, 0x00);
+}
+
+OverviewRuler::OverviewRuler(CustomTextEdit *editor, QWidget *parent)
+    : QWidget(parent)
+    , editor(editor)
+    , scannedUpTo(0)
+    , staleRow(0)
+    , idleTimer(new QTimer(this))
+    , cacheReleased(false)
+{
+    setFixedWidth(RulerWidth);
+    setCursor(Qt::PointingHandCursor);
+    setToolTip("Overview - click or drag to jump");
+
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(IdleIntervalMs);
+    connect(idleTimer, &QTimer::timeout, this, &OverviewRuler::processIdleSlice);
+
+    // 表示範囲・カーソル・ブロック選択の変化は再描画だけで済む（画像は作り直さない）
+    connect(editor->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, QOverload<>::of(&QWidget::update));
+    connect(editor, &QTextEdit::cursorPositionChanged,
+            this, QOverload<>::of(&QWidget::update));
+
+    setDocument(editor->document());
+}
+
+void OverviewRuler::setDocument(QTextDocument *document)
+{
+    if (doc == document) return;
+    if (doc) {
+        disconnect(doc, &QTextDocument::contentsChange, this, &OverviewRuler::onContentsChange);
+        storeSummaries();
+    }
+    doc = document;
+    if (!doc) {
+        rescan();
+        return;
+    }
+    connect(doc, &QTextDocument::contentsChange,
+            this, &OverviewRuler::onContentsChange);
+
+    // 裏で本文が変わった文書は、どのブロックが変わったか分からないので走査し直す
+    // （書式だけの変更では revision() は変わらない）
+    const auto stored = storedSummaries.find(doc);
+    if (stored == storedSummaries.end() || cacheReleased
+        || stored->revision != doc->revision()
+        || stored->summaries.size() != doc->blockCount()) {
+        rescan();
+        return;
+    }
+    summaries.swap(stored->summaries);
+    QVector<BlockSummary>().swap(stored->summaries);
+    scannedUpTo = stored->scannedUpTo;
+    // しまった後に検索条件が変わっていれば、ヒットは走査し直しで付け直す
+    if (stored->searchText != searchText
+        || stored->searchOptions.caseSensitive != searchOptions.caseSensitive
+        || stored->searchOptions.wholeWords != searchOptions.wholeWords) {
+        scannedUpTo = 0;
+    }
+    rebuildImage();
+    scheduleScan();
+}
+
+void OverviewRuler::storeSummaries()
+{
+    if (cacheReleased) return;
+    QTextDocument *document = doc;
+    if (!storedSummaries.contains(document)) {
+        connect(document, &QObject::destroyed, this, [this, document]() {
+            storedSummaries.remove(document);
+        });
+    }
+    StoredSummaries &stored = storedSummaries[document];
+    stored.summaries = std::move(summaries);
+    stored.scannedUpTo = scannedUpTo;
+    stored.revision = document->revision();
+    stored.searchText = searchText;
+    stored.searchOptions = searchOptions;
+    summaries.clear();
+}
+
+void OverviewRuler::rescan()
+{
+    cacheReleased = false;
+    summaries.clear();
+    scannedUpTo = 0;
+    if (doc) {
+        // しまってあった要約は使わないので手放す（文書が残る間は項目ごと残す）
+        const auto stored = storedSummaries.find(doc);
+        if (stored != storedSummaries.end()) {
+            QVector<BlockSummary>().swap(stored->summaries);
+        }
+        summaries.resize(doc->blockCount());
+    }
+    rebuildImage();
+    scheduleScan();
+}
+
+void OverviewRuler::setSearchHits(const QString &text, const TextSearch::Options &options, const QVector<bool> &hits)
+{
+    searchText = text;
+    searchOptions = options;
+    if (hits.size() != summaries.size()) {
+        // 文書と合わないヒットは使わず、要約ごと先頭から走査し直す
+        scannedUpTo = 0;
+        scheduleScan();
+        return;
+    }
+
+    // 要約はそのままヒットだけ差し替え、画像はアイドル時に描き直す
+    // （まだ走査していないブロックは、走査のときに同じ条件で照合する）
+    for (int i = 0; i < summaries.size(); ++i) {
+        BlockSummary &summary = summaries[i];
+        summary.flags = quint8(hits.at(i) ? (summary.flags | SearchHit) : (summary.flags & ~SearchHit));
+    }
+    staleRow = 0;
+    idleTimer->start();
+}
+
+qint64 OverviewRuler::memoryUsage() const
+{
+    qint64 bytes = summaries.capacity() * qint64(sizeof(BlockSummary)) + image.sizeInBytes();
+    for (const StoredSummaries &stored : storedSummaries) {
+        bytes += stored.summaries.capacity() * qint64(sizeof(BlockSummary));
+    }
+    return bytes;
+}
+
+qint64 OverviewRuler::releaseCache()
+{
+    const qint64 freed = memoryUsage();
+    idleTimer->stop();
+    QVector<BlockSummary>().swap(summaries);
+    for (StoredSummaries &stored : storedSummaries) {
+        QVector<BlockSummary>().swap(stored.summaries);
+    }
+    image = QImage();
+    scannedUpTo = 0;
+    cacheReleased = true;
+    return freed;
+}
+
+OverviewRuler::BlockSummary OverviewRuler::summarize(const QTextBlock &block) const
+{
+    const QString text = block.text();
+    BlockSummary summary;
+
+    int indent = 0;
+    while (indent < text.length() && (text.at(indent) == ' ' || text.at(indent) == '\t')) {
+        ++indent;
+    }
+    summary.indent = quint16(qMin(indent, 0xffff));
+    summary.length = quint16(qMin<qsizetype>(text.length(), 0xffff));
+    summary.flags = Known;
+    if (!searchText.isEmpty() && TextSearch::indexIn(text, searchText, 0, searchOptions) >= 0) {
+        summary.flags |= SearchHit;
+    }
+    return summary;
+}
+
+void OverviewRuler::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    if (!doc || cacheReleased) return;
+
+    const int blockCount = doc->blockCount();
+    const int delta = blockCount - summaries.size();
+
+    QTextBlock firstBlock = doc->findBlock(position);
+    QTextBlock lastBlock = doc->findBlock(position + charsAdded);
+    if (!firstBlock.isValid()) firstBlock = doc->lastBlock();
+    if (!lastBlock.isValid()) lastBlock = doc->lastBlock();
+
+    const int first = firstBlock.blockNumber();
+    const int last = lastBlock.blockNumber();
+    const int newSpan = last - first + 1;
+    const int oldSpan = newSpan - delta;
+
+    if (oldSpan < 1 || first + oldSpan > summaries.size()) {
+        // 想定外の差分は作り直す
+        rescan();
+        return;
+    }
+
+    // 変更範囲の要約だけを差し替える（後ろの要約を動かすのはブロック数が変わったときの1回だけ）
+    if (delta > 0) {
+        summaries.insert(first + oldSpan, delta, BlockSummary());
+    } else if (delta < 0) {
+        summaries.remove(first + newSpan, -delta);
+    }
+    std::fill(summaries.begin() + first, summaries.begin() + first + newSpan, BlockSummary());
+
+    if (newSpan <= SyncRecountLimit) {
+        int number = first;
+        for (QTextBlock block = firstBlock; block.isValid() && number <= last; block = block.next(), ++number) {
+            summaries[number] = summarize(block);
+        }
+        if (scannedUpTo > first) {
+            scannedUpTo = qMax(last + 1, scannedUpTo + delta);
+        }
+    } else {
+        scannedUpTo = qMin(scannedUpTo, first);
+    }
+    scannedUpTo = qMin(scannedUpTo, int(summaries.size()));
+
+    renderBlocks(first, last);
+    update();
+    if (delta != 0) {
+        // 行数が変わると全行の対応がずれる。変更箇所だけ今描き、残りは入力が途切れてから描き直す
+        staleRow = 0;
+        idleTimer->start();
+    }
+    scheduleScan();
+}
+
+void OverviewRuler::scheduleScan()
+{
+    const bool pending = scannedUpTo < summaries.size() || (!image.isNull() && staleRow < image.height());
+    if (doc && pending && !idleTimer->isActive()) {
+        idleTimer->start();
+    }
+}
+
+void OverviewRuler::processIdleSlice()
+{
+    if (!doc) return;
+
+    QElapsedTimer clock;
+    clock.start();
+
+    const int firstScanned = scannedUpTo;
+    QTextBlock block = doc->findBlockByNumber(scannedUpTo);
+    while (block.isValid() && scannedUpTo < summaries.size() && !clock.hasExpired(FrameBudgetMs)) {
+        summaries[scannedUpTo] = summarize(block);
+        ++scannedUpTo;
+        block = block.next();
+    }
+
+    if (scannedUpTo > firstScanned) {
+        renderBlocks(firstScanned, scannedUpTo - 1);
+        update();
+    }
+
+    // 行数の変化で古くなった行を、残りの時間で描き直す（要約だけを使い、本文は読まない）
+    if (!image.isNull() && staleRow < image.height() && !clock.hasExpired(FrameBudgetMs)) {
+        while (staleRow < image.height() && !clock.hasExpired(FrameBudgetMs)) {
+            renderRows(staleRow, staleRow);
+            ++staleRow;
+        }
+        update();
+    }
+    scheduleScan();
+}
+
+int OverviewRuler::rowForBlock(int blockNumber) const
+{
+    if (summaries.isEmpty() || image.isNull()) return 0;
+    return int(qint64(blockNumber) * image.height() / summaries.size());
+}
+
+void OverviewRuler::rebuildImage()
+{
+    if (width() <= 0 || height() <= 0) {
+        image = QImage();
+        return;
+    }
+    image = QImage(width(), height(), QImage::Format_RGB32);
+    image.fill(BackgroundColor);
+    renderRows(0, image.height() - 1);
+    staleRow = image.height();
+}
+
+void OverviewRuler::renderBlocks(int firstBlock, int lastBlock)
+{
+    renderRows(rowForBlock(firstBlock), rowForBlock(lastBlock));
+}
+
+void OverviewRuler::renderRows(int firstRow, int lastRow)
+{
+    if (image.isNull() || summaries.isEmpty()) return;
+
+    const qint64 blockCount = summaries.size();
+    const int rows = image.height();
+    const int textWidth = image.width() - MarkerWidth;
+    firstRow = qBound(0, firstRow, rows - 1);
+    lastRow = qBound(0, lastRow, rows - 1);
+
+    for (int row = firstRow; row <= lastRow; ++row) {
+        // この行に対応するブロック範囲 [b0, b1)
+        const int b0 = int(row * blockCount / rows);
+        const int b1 = qMax(b0 + 1, int((row + 1) * blockCount / rows));
+
+        int indent = INT_MAX;
+        int end = 0;
+        bool hit = false;
+        for (int b = b0; b < b1 && b < blockCount; ++b) {
+            const BlockSummary &summary = summaries.at(b);
+            if (!(summary.flags & Known) || summary.length == 0) continue;
+            indent = qMin(indent, int(summary.indent));
+            end = qMax(end, int(summary.length));
+            hit = hit || (summary.flags & SearchHit);
+        }
+
+        QRgb *line = reinterpret_cast<QRgb*>(image.scanLine(row));
+        std::fill(line, line + image.width(), BackgroundColor);
+        if (end > 0) {
+            const int x0 = qMin(textWidth, indent / ColumnsPerPixel);
+            const int x1 = qMin(textWidth, qMax(x0 + 1, end / ColumnsPerPixel));
+            std::fill(line + x0, line + x1, TextColor);
+        }
+        if (hit) {
+            std::fill(line + textWidth, line + image.width(), HitColor);
+        }
+    }
+}
+
+void OverviewRuler::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    if (cacheReleased) {
+        rescan();
+    }
+    QPainter painter(this);
+    painter.drawImage(0, 0, image);
+    if (!doc || summaries.isEmpty()) return;
+
+    // 表示中の範囲
+    const int firstVisible = editor->cursorForPosition(QPoint(0, 0)).blockNumber();
+    const int lastVisible = editor->cursorForPosition(QPoint(0, editor->viewport()->height() - 1)).blockNumber();
+    const int top = rowForBlock(firstVisible);
+    const int bottom = qMax(top + 2, rowForBlock(lastVisible + 1));
+    painter.fillRect(0, top, width(), bottom - top, QColor(0, 0, 0, 32));
+    painter.setPen(QColor(0, 0, 0, 96));
+    painter.drawRect(0, top, width() - 1, bottom - top - 1);
+
+    // ブロックモードの範囲
+    if (editor->isBlockMode()) {
+        const int anchor = editor->blockStart().blockNumber();
+        const int current = editor->textCursor().blockNumber();
+        const int blockTop = rowForBlock(qMin(anchor, current));
+        const int blockBottom = qMax(blockTop + 2, rowForBlock(qMax(anchor, current) + 1));
+        painter.fillRect(0, blockTop, 3, blockBottom - blockTop, QColor(Qt::blue).lighter(140));
+    }
+
+    // カーソル位置
+    const int cursorRow = rowForBlock(editor->textCursor().blockNumber());
+    painter.fillRect(0, cursorRow, width(), 1, QColor(Qt::red));
+}
+
+void OverviewRuler::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    rebuildImage();
+}
+
+void OverviewRuler::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton) {
+        jumpToRow(event->position().toPoint().y());
+    }
+}
+
+void OverviewRuler::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton) {
+        jumpToRow(event->position().toPoint().y());
+    }
+}
+
+void OverviewRuler::jumpToRow(int y)
+{
+    if (!doc || summaries.isEmpty() || height() <= 0) return;
+
+    const int row = qBound(0, y, height() - 1);
+    const int blockNumber = int(qint64(row) * summaries.size() / height());
+    const QTextBlock block = doc->findBlockByNumber(qMin(blockNumber, int(summaries.size()) - 1));
+    if (!block.isValid()) return;
+
+    // 対象ブロックを画面中央に表示
+    editor->setTextCursor(QTextCursor(block));
+    const QRectF rect = doc->documentLayout()->blockBoundingRect(block);
+    editor->verticalScrollBar()->setValue(int(rect.top()) - editor->viewport()->height() / 2);
+}
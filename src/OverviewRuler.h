@@ -0,0 +1,92 @@
+#ifndef OVERVIEWRULER_H
+#define OVERVIEWRULER_H
+
+#include "TextSearch.h"
+#include <QWidget>
+#include <QHash>
+#include <QImage>
+#include <QPointer>
+#include <QTextDocument>
+#include <QTimer>
+#include <QVector>
+
+class CustomTextEdit;
+
+// 文書全体の縮小表示（オーバービュールーラー）
+// ブロックごとの要約（インデント・長さ・検索ヒット）をアイドル時に作成し、
+// 編集時は変更されたブロック範囲の要約と画像の行だけを更新する
+// 行数が変わると他の行の対応もずれるが、それはアイドル時に少しずつ描き直す
+// タブを切り替えても、以前に表示した文書の要約は文書ごとに残して使い直す
+class OverviewRuler : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit OverviewRuler(CustomTextEdit *editor, QWidget *parent = nullptr);
+
+    // 以前に表示した文書で、その後本文が変わっていなければ残した要約を使う
+    void setDocument(QTextDocument *document);
+    // 検索条件と、ワーカースレッドで求めたブロックごとのヒット（文書と同じブロック数のとき使う）
+    // 以後の編集で変わったブロックは同じ条件で照合し直す
+    void setSearchHits(const QString &text, const TextSearch::Options &options, const QVector<bool> &hits);
+    // 要約と画像を捨て、解放したバイト数を返す（次に描画するときに作り直す）
+    qint64 releaseCache();
+    qint64 memoryUsage() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void processIdleSlice();
+
+private:
+    enum SummaryFlag {
+        Known = 0x1,      // 要約作成済み
+        SearchHit = 0x2   // 検索文字列を含む
+    };
+
+    struct BlockSummary {
+        quint16 indent = 0;
+        quint16 length = 0;
+        quint8 flags = 0;
+    };
+
+    BlockSummary summarize(const QTextBlock &block) const;
+    int rowForBlock(int blockNumber) const;
+    void rebuildImage();
+    void renderBlocks(int firstBlock, int lastBlock);
+    void renderRows(int firstRow, int lastRow);
+    void scheduleScan();
+    void jumpToRow(int y);
+    void storeSummaries();
+    void rescan();
+
+    CustomTextEdit *editor;
+    QPointer<QTextDocument> doc;
+
+    QVector<BlockSummary> summaries;   // ブロック番号ごと
+    int scannedUpTo;                   // これより前のブロックは現在の検索条件で走査済み
+    QString searchText;
+    TextSearch::Options searchOptions;
+
+    // 表示していない文書の要約（文書が破棄されたら消す）
+    struct StoredSummaries {
+        QVector<BlockSummary> summaries;
+        int scannedUpTo = 0;
+        int revision = 0;              // しまったときの QTextDocument::revision()
+        QString searchText;
+        TextSearch::Options searchOptions;
+    };
+    QHash<QTextDocument*, StoredSummaries> storedSummaries;
+
+    QImage image;
+    int staleRow;                      // 画像のこの行以降は行数の変化で古くなっている
+    QTimer *idleTimer;
+    bool cacheReleased;
+};
+
+#endif // OVERVIEWRULER_H
@@ -0,0 +1,181 @@
+#include "PerformanceHud.h"
+#include "DocumentUndo.h"
+#include "ClipboardRing.h"
+#include "Metrics.h"
+#include <QAbstractTextDocumentLayout>
+#include <QFontDatabase>
+#include <QFontMetrics>
+#include <QLocale>
+#include <QPainter>
+#include <QTextEdit>
+#include <QTimer>
+#include <QStringList>
+
+namespace {
+const int RefreshIntervalMs = 500;
+const int StaleKeyMs = 1000;         // 描画を伴わなかったキー（2段階キーの1キー目など）は捨てる
+const int Margin = 8;
+const int Padding = 6;
+const double AverageWeight = 0.1;   // 描画時間の移動平均に新しい値を混ぜる割合
+
+const QRgb PanelColor = qRgba(0x20, 0x20, 0x20, 0xc0);
+const QRgb PanelTextColor = qRgb(0xe0, 0xe0, 0xe0);
+
+double elapsedMs(const QElapsedTimer &clock)
+{
+    return clock.nsecsElapsed() / 1e6;
+}
+}
+
+PerformanceHud::PerformanceHud(QTextEdit *editor)
+    : QObject(editor)
+    , editor(editor)
+    , refreshTimer(new QTimer(this))
+    , font(QFontDatabase::systemFont(QFontDatabase::FixedFont))
+    , visible(false)
+    , keyPending(false)
+    , layoutPending(false)
+{
+    refreshTimer->setInterval(RefreshIntervalMs);
+    connect(refreshTimer, &QTimer::timeout, this, &PerformanceHud::refresh);
+}
+
+void PerformanceHud::setDocument(QTextDocument *document)
+{
+    if (doc) {
+        disconnect(doc, nullptr, this, nullptr);
+        disconnect(doc->documentLayout(), nullptr, this, nullptr);
+    }
+    doc = document;
+    layoutPending = false;
+    if (doc) {
+        connect(doc, &QTextDocument::contentsChange, this, &PerformanceHud::onContentsChange);
+        // 編集から、それを反映したレイアウトの更新通知までをレイアウト時間とする
+        connect(doc->documentLayout(), &QAbstractTextDocumentLayout::update,
+                this, &PerformanceHud::onLayoutUpdated);
+    }
+    if (visible) refresh();
+}
+
+void PerformanceHud::setVisible(bool show)
+{
+    if (visible == show) return;
+    visible = show;
+    if (visible) {
+        refresh();
+        refreshTimer->start();
+    } else {
+        refreshTimer->stop();
+        editor->viewport()->update(panelRect());
+    }
+}
+
+void PerformanceHud::keyPressed()
+{
+    // 押しっぱなしで描画より先にキーが来ても、最初のキーから測る
+    if (keyPending && keyClock.elapsed() < StaleKeyMs) return;
+    keyClock.start();
+    keyPending = true;
+}
+
+void PerformanceHud::frameStarted()
+{
+    frameClock.start();
+}
+
+void PerformanceHud::frameFinished(const QRegion &region)
+{
+    // HUD だけの描き直しは数えない（数えると表示の更新そのものが計測値になる）
+    if (visible && panelRect().contains(region.boundingRect())) return;
+
+    current.frameMs = elapsedMs(frameClock);
+    current.averageFrameMs = current.averageFrameMs == 0
+        ? current.frameMs
+        : current.averageFrameMs + (current.frameMs - current.averageFrameMs) * AverageWeight;
+    if (keyPending) {
+        const qint64 latency = keyClock.nsecsElapsed();
+        current.keyLatencyMs = latency / 1e6;
+        Metrics::keyLatency.observe(latency);
+        keyPending = false;
+    }
+}
+
+void PerformanceHud::onContentsChange()
+{
+    if (layoutPending) return;
+    layoutClock.start();
+    layoutPending = true;
+}
+
+void PerformanceHud::onLayoutUpdated()
+{
+    if (!layoutPending) return;
+    current.layoutMs = elapsedMs(layoutClock);
+    layoutPending = false;
+}
+
+PerformanceHud::Sample PerformanceHud::sample() const
+{
+    Sample result = current;
+    if (doc) {
+        result.documentBytes = qint64(doc->characterCount() - 1) * qint64(sizeof(QChar));
+        result.blockCount = doc->blockCount();
+        if (const DocumentUndo *history = DocumentUndo::forDocument(doc)) {
+            result.undoDepth = history->undoDepth();
+            result.undoBytes = history->memoryUsage();
+        }
+    }
+    result.clipboardBytes = ClipboardRing::instance().bytes();
+    result.residentBytes = Metrics::residentBytes();
+    return result;
+}
+
+void PerformanceHud::refresh()
+{
+    current = sample();
+    editor->viewport()->update(panelRect());
+}
+
+QRect PerformanceHud::panelRect() const
+{
+    const QFontMetrics metrics(font);
+    const int width = metrics.horizontalAdvance(QLatin1Char('0')) * 24 + Padding * 2;
+    const int height = metrics.lineSpacing() * 8 + Padding * 2;
+    const QRect viewport = editor->viewport()->rect();
+    return QRect(viewport.right() - Margin - width, viewport.top() + Margin, width, height);
+}
+
+void PerformanceHud::paint(QPainter &painter)
+{
+    const QLocale locale;
+    const auto ms = [](double value) { return QString::number(value, 'f', 2) + " ms"; };
+    const auto size = [&locale](qint64 bytes) {
+        return locale.formattedDataSize(bytes, 1, QLocale::DataSizeTraditionalFormat);
+    };
+
+    const QStringList lines = {
+        QString("frame   %1 (avg %2)").arg(ms(current.frameMs), QString::number(current.averageFrameMs, 'f', 1)),
+        QString("layout  %1").arg(ms(current.layoutMs)),
+        QString("key     %1").arg(ms(current.keyLatencyMs)),
+        QString("text    %1").arg(size(current.documentBytes)),
+        QString("blocks  %1").arg(current.blockCount),
+        QString("undo    %1 (%2)").arg(current.undoDepth).arg(size(current.undoBytes)),
+        QString("clip    %1").arg(size(current.clipboardBytes)),
+        QString("rss     %1").arg(size(current.residentBytes)),
+    };
+
+    const QRect rect = panelRect();
+    const QFontMetrics metrics(font);
+    painter.save();
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor::fromRgba(PanelColor));
+    painter.drawRect(rect);
+    painter.setFont(font);
+    painter.setPen(QColor(PanelTextColor));
+    int y = rect.top() + Padding + metrics.ascent();
+    for (const QString &line : lines) {
+        painter.drawText(rect.left() + Padding, y, line);
+        y += metrics.lineSpacing();
+    }
+    painter.restore();
+}
@@ -0,0 +1,74 @@
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <QElapsedTimer>
+#include <QFont>
+#include <QObject>
+#include <QPointer>
+#include <QRect>
+#include <QRegion>
+#include <QTextDocument>
+
+class QPainter;
+class QTextEdit;
+class QTimer;
+
+// 性能表示（HUD）。エディタのビューポート右上に重ねて描く（Ctrl+O,P / 表示メニュー）
+// 時間の計測は表示していなくても常に行う（描画・キー・編集ごとに QElapsedTimer を読むだけ）
+// 文書の大きさやメモリなどの値は、表示中だけ 0.5 秒ごとに取り直す
+class PerformanceHud : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Sample {
+        double frameMs = 0;            // 直近の描画時間
+        double averageFrameMs = 0;     // 描画時間の指数移動平均
+        double layoutMs = 0;           // 直近の編集でのレイアウト時間
+        double keyLatencyMs = 0;       // 直近のキー入力から描画完了まで
+        qint64 documentBytes = 0;      // 本文（UTF-16）
+        int blockCount = 0;
+        int undoDepth = 0;
+        qint64 undoBytes = 0;
+        qint64 clipboardBytes = 0;
+        qint64 residentBytes = 0;      // プロセスの RSS
+    };
+
+    explicit PerformanceHud(QTextEdit *editor);
+
+    void setDocument(QTextDocument *document);
+    void setVisible(bool visible);
+    bool isVisible() const { return visible; }
+
+    // CustomTextEdit から呼ぶ計測点
+    void keyPressed();
+    void frameStarted();
+    void frameFinished(const QRegion &region);
+    void paint(QPainter &painter);
+
+    // 計測値と、その時点の文書・メモリの値
+    Sample sample() const;
+
+private slots:
+    void refresh();
+    void onContentsChange();
+    void onLayoutUpdated();
+
+private:
+    QRect panelRect() const;
+
+    QTextEdit *editor;
+    QPointer<QTextDocument> doc;
+    QTimer *refreshTimer;
+    QFont font;
+    bool visible;
+
+    QElapsedTimer frameClock;
+    QElapsedTimer keyClock;
+    QElapsedTimer layoutClock;
+    bool keyPending;
+    bool layoutPending;
+    Sample current;
+};
+
+#endif // PERFORMANCEHUD_H
@@ -0,0 +1,101 @@
+#include "SingleInstance.h"
+#include "MainWindow.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+namespace {
+const int ConnectTimeoutMs = 500;
+}
+
+SingleInstance::SingleInstance(QObject *parent)
+    : QObject(parent)
+    , server(new QLocalServer(this))
+    , lock(QDir::temp().filePath(serverName() + ".lock"))
+{
+    // 経過時間では古いとみなさない（持ち主のプロセスが生きている限り有効）
+    lock.setStaleLockTime(0);
+    connect(server, &QLocalServer::newConnection, this, &SingleInstance::onNewConnection);
+}
+
+QString SingleInstance::serverName()
+{
+    // ユーザーごとに1つのサーバー
+    QByteArray user = qgetenv("USER");
+    if (user.isEmpty()) user = qgetenv("USERNAME");
+    const QByteArray hash = QCryptographicHash::hash(user + QDir::homePath().toUtf8(),
+                                                     QCryptographicHash::Sha1).toHex().left(12);
+    return QString("WLEditor-%1").arg(QString::fromLatin1(hash));
+}
+
+bool SingleInstance::sendToRunningInstance(const QStringList &files)
+{
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(ConnectTimeoutMs)) {
+        return false;
+    }
+
+    // 相対パスは受け取り側のカレントディレクトリと異なるため絶対パスで渡す
+    QStringList absoluteFiles;
+    for (const QString &file : files) {
+        absoluteFiles << QDir::current().absoluteFilePath(file);
+    }
+
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    out << absoluteFiles;
+    socket.write(message);
+    if (!socket.waitForBytesWritten(ConnectTimeoutMs)) {
+        return false;
+    }
+
+    // 受け取り確認（1バイト）を待つ
+    if (!socket.waitForReadyRead(ConnectTimeoutMs)) {
+        return false;
+    }
+    socket.disconnectFromServer();
+    return true;
+}
+
+bool SingleInstance::listen()
+{
+    // 持ち主が生きていればロックは取れない。異常終了したプロセスのロックは QLockFile が取り直す
+    if (!lock.tryLock(0)) {
+        return false;
+    }
+    if (server->listen(serverName())) {
+        return true;
+    }
+
+    // ロックを取れたので、残っているソケットは異常終了したプロセスのもの
+    QLocalServer::removeServer(serverName());
+    return server->listen(serverName());
+}
+
+void SingleInstance::onNewConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [socket]() {
+            QDataStream in(socket);
+            in.startTransaction();
+            QStringList files;
+            in >> files;
+            if (!in.commitTransaction()) {
+                return;  // 続きのデータを待つ
+            }
+            socket->write("1");
+            socket->flush();
+
+            if (files.isEmpty()) {
+                MainWindow::openWindow(QString());
+            }
+            for (const QString &file : files) {
+                MainWindow::openWindow(file);
+            }
+        });
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QLockFile>
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+
+// 単一プロセスでの複数ウィンドウ管理
+// 2回目以降の起動はQLocalSocketで既存プロセスにファイルを渡して終了し、
+// 既存プロセス側で新しいMainWindowを開く（フォント・グリフ・設定のキャッシュを共有）
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(QObject *parent = nullptr);
+
+    // 既に起動しているプロセスへファイルを渡せたら true
+    static bool sendToRunningInstance(const QStringList &files);
+
+    // 待ち受けを始める。サーバー名の持ち主はロックファイルで決め、他のプロセスが持っていれば
+    // ソケットには触れずに false を返す（呼び出し側は受け渡しをやり直すか、単独で動く）
+    // 持ち主が異常終了して残ったソケットだけを消して待ち受け直す
+    bool listen();
+
+private slots:
+    void onNewConnection();
+
+private:
+    static QString serverName();
+
+    QLocalServer *server;
+    QLockFile lock;
+};
+
+#endif // SINGLEINSTANCE_H
@@ -0,0 +1,47 @@
+#include "StartupProfiler.h"
+#include <QElapsedTimer>
+#include <QList>
+#include <QPair>
+#include <QByteArray>
+#include <cstdio>
+
+namespace {
+bool enabled = false;
+bool reported = false;
+QElapsedTimer clock;
+QList<QPair<QByteArray, qint64>> phases;  // (区間名, 開始からの経過ns)
+}
+
+void StartupProfiler::start()
+{
+    enabled = true;
+    clock.start();
+}
+
+bool StartupProfiler::isEnabled()
+{
+    return enabled;
+}
+
+void StartupProfiler::mark(const char *phase)
+{
+    if (!enabled || reported) return;
+    phases.append(qMakePair(QByteArray(phase), clock.nsecsElapsed()));
+}
+
+void StartupProfiler::report()
+{
+    if (!enabled || reported) return;
+    reported = true;
+
+    std::fprintf(stderr, "WLEditor startup profile:\n");
+    qint64 previous = 0;
+    for (const auto &phase : phases) {
+        std::fprintf(stderr, "  %-28s %8.2f ms  (total %8.2f ms)\n",
+                     phase.first.constData(),
+                     (phase.second - previous) / 1e6,
+                     phase.second / 1e6);
+        previous = phase.second;
+    }
+    std::fflush(stderr);
+}
@@ -0,0 +1,18 @@
+#ifndef STARTUPPROFILER_H
+#define STARTUPPROFILER_H
+
+// 起動時間の計測（--startup-profile 指定時のみ有効）
+class StartupProfiler
+{
+public:
+    static void start();
+    static bool isEnabled();
+
+    // 前回のマークからの経過時間を区間として記録
+    static void mark(const char *phase);
+
+    // 記録した区間を標準エラー出力へ一度だけ出力
+    static void report();
+};
+
+#endif // STARTUPPROFILER_H
@@ -0,0 +1,373 @@
+#include "SyntaxHighlighter.h"
+#include <QFileInfo>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTextLayout>
+
+namespace {
+// 1フレーム（16ms）のうちハイライトに使う時間
+const int FrameBudgetMs = 8;
+const int IdleIntervalMs = 16;
+}
+
+SyntaxHighlighter::SyntaxHighlighter(QObject *parent)
+    : QSyntaxHighlighter(parent)
+    , currentLanguage(PlainText)
+    , rules(&ruleTable(PlainText))
+    , frontier(-1)
+    , knownBlockCount(0)
+    , blocksThisTurn(0)
+    , budgetClockRunning(false)
+    , keepDeferredFormats(true)
+    , idleTimer(new QTimer(this))
+{
+    idleTimer->setSingleShot(true);
+    idleTimer->setInterval(IdleIntervalMs);
+    connect(idleTimer, &QTimer::timeout, this, &SyntaxHighlighter::processIdleSlice);
+}
+
+void SyntaxHighlighter::attach(QTextDocument *document)
+{
+    attachedDocument = document;
+    applyDocument();
+}
+
+void SyntaxHighlighter::setLanguage(Language language)
+{
+    if (language == currentLanguage) return;
+    const bool sameDocument = document() && language != PlainText;
+    currentLanguage = language;
+    rules = &ruleTable(language);
+    applyDocument();
+
+    // 同じ文書のままでは setDocument の全体の再ハイライトが起きず、後回しのブロックに
+    // 前の言語の色が残るので、書式を置き直さずに一度全体を通して消しておく
+    // （予算内の先頭のブロックはこのとき新しい言語で確定する）
+    if (sameDocument) {
+        keepDeferredFormats = false;
+        rehighlight();
+        keepDeferredFormats = true;
+    }
+}
+
+void SyntaxHighlighter::applyDocument()
+{
+    // プレーンテキストでは文書から外してハイライト処理自体を行わない
+    QTextDocument *target = (currentLanguage == PlainText) ? nullptr : attachedDocument.data();
+    frontier = -1;
+    idleTimer->stop();
+
+    if (document() != target) {
+        if (document()) {
+            disconnect(document(), &QTextDocument::contentsChange,
+                       this, &SyntaxHighlighter::onContentsChange);
+        }
+        if (target) {
+            // QSyntaxHighlighter自身の接続より先に呼ばれるよう、setDocument前に接続
+            connect(target, &QTextDocument::contentsChange,
+                    this, &SyntaxHighlighter::onContentsChange);
+            knownBlockCount = target->blockCount();
+        }
+        // setDocument の全体の再ハイライトでも、予算を超えたブロックは書式を保って素通りする
+        setDocument(target);
+    }
+    // 全体の再ハイライトは rehighlight() で一度に行わず、先頭からアイドル時に進める
+    scheduleIdlePass();
+}
+
+SyntaxHighlighter::Language SyntaxHighlighter::languageForFile(const QString &fileName)
+{
+    const QString suffix = QFileInfo(fileName).suffix().toLower();
+
+    static const QStringList cppSuffixes = {"cpp", "cxx", "cc", "c", "h", "hpp", "hxx"};
+    if (cppSuffixes.contains(suffix)) return Cpp;
+    if (suffix == "py" || suffix == "pyw") return Python;
+    if (suffix == "js" || suffix == "mjs") return JavaScript;
+    if (suffix == "html" || suffix == "htm") return Html;
+    if (suffix == "json") return Json;
+    if (suffix == "xml" || suffix == "svg" || suffix == "qrc" || suffix == "ui") return Xml;
+    return PlainText;
+}
+
+void SyntaxHighlighter::onContentsChange(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+    Q_UNUSED(charsAdded);
+
+    // 行の追加・削除に合わせて確定済みブロック番号をずらす
+    const int blockCount = document()->blockCount();
+    const int delta = blockCount - knownBlockCount;
+    knownBlockCount = blockCount;
+    if (delta == 0) return;
+
+    const int changedBlock = document()->findBlock(position).blockNumber();
+    if (changedBlock >= 0 && frontier >= changedBlock) {
+        frontier = qMax(changedBlock - 1, frontier + delta);
+    }
+    scheduleIdlePass();
+}
+
+void SyntaxHighlighter::startBudgetClock()
+{
+    // イベントループ1周ぶんの処理を1つの予算で計る
+    if (budgetClockRunning) return;
+    budgetClockRunning = true;
+    blocksThisTurn = 0;
+    budgetClock.start();
+    QTimer::singleShot(0, this, [this]() { budgetClockRunning = false; });
+}
+
+void SyntaxHighlighter::scheduleIdlePass()
+{
+    if (document() && frontier < document()->blockCount() - 1 && !idleTimer->isActive()) {
+        idleTimer->start();
+    }
+}
+
+void SyntaxHighlighter::processIdleSlice()
+{
+    QTextDocument *doc = document();
+    if (!doc) return;
+
+    budgetClockRunning = true;
+    blocksThisTurn = 0;
+    budgetClock.start();
+
+    while (frontier < doc->blockCount() - 1 && !budgetClock.hasExpired(FrameBudgetMs)) {
+        rehighlightBlock(doc->findBlockByNumber(frontier + 1));
+    }
+
+    budgetClockRunning = false;
+    scheduleIdlePass();
+}
+
+void SyntaxHighlighter::highlightBlock(const QString &text)
+{
+    startBudgetClock();
+    const int blockNumber = currentBlock().blockNumber();
+
+    // 未確定領域、または予算切れのブロックは状態を変えずに後回し
+    // （状態が変わらないので QSyntaxHighlighter の連鎖もここで止まる）
+    const bool outOfBudget = blocksThisTurn > 0 && budgetClock.hasExpired(FrameBudgetMs);
+    if (blockNumber > frontier + 1 || outOfBudget) {
+        if (outOfBudget) {
+            frontier = qMin(frontier, blockNumber - 1);
+        }
+        // QSyntaxHighlighter は呼び出し前に書式を空にしているので、今の書式を置き直す
+        // （置き直さないと、確定するまで色が消え、ブロックごとに再レイアウトが起きる）
+        // 言語を切り替えた直後は前の言語の書式なので置き直さない
+        const QTextLayout *layout = currentBlock().layout();
+        if (layout && keepDeferredFormats) {
+            const QList<QTextLayout::FormatRange> formats = layout->formats();
+            for (const QTextLayout::FormatRange &range : formats) {
+                setFormat(range.start, range.length, range.format);
+            }
+        }
+        setCurrentBlockState(currentBlockState());
+        scheduleIdlePass();
+        return;
+    }
+
+    ++blocksThisTurn;
+    frontier = qMax(frontier, blockNumber);
+    applyRules(text);
+}
+
+void SyntaxHighlighter::applyRules(const QString &text)
+{
+    for (const Rule &rule : rules->rules) {
+        QRegularExpressionMatchIterator it = rule.pattern.globalMatch(text);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            setFormat(match.capturedStart(rule.captureGroup),
+                      match.capturedLength(rule.captureGroup),
+                      formatFor(rule.format));
+        }
+    }
+
+    // 複数行要素：前のブロックから継続中ならその終端から探す
+    setCurrentBlockState(NormalState);
+    const MultiLineRule *open = nullptr;
+    for (const MultiLineRule &rule : rules->multiLineRules) {
+        if (rule.state == previousBlockState()) {
+            open = &rule;
+            break;
+        }
+    }
+
+    int position = 0;
+    int searchFrom = 0;
+    while (position <= text.length()) {
+        if (!open) {
+            int best = -1;
+            int startLength = 0;
+            for (const MultiLineRule &rule : rules->multiLineRules) {
+                const QRegularExpressionMatch match = rule.start.match(text, position);
+                if (match.hasMatch() && (best < 0 || match.capturedStart() < best)) {
+                    best = match.capturedStart();
+                    startLength = match.capturedLength();
+                    open = &rule;
+                }
+            }
+            if (!open) break;
+            position = best;
+            searchFrom = best + startLength;
+        }
+
+        const QRegularExpressionMatch endMatch = open->end.match(text, searchFrom);
+        if (!endMatch.hasMatch()) {
+            setFormat(position, text.length() - position, formatFor(open->format));
+            setCurrentBlockState(open->state);
+            break;
+        }
+
+        const int end = endMatch.capturedEnd();
+        setFormat(position, end - position, formatFor(open->format));
+        position = end;
+        searchFrom = end;
+        open = nullptr;
+    }
+}
+
+const QTextCharFormat &SyntaxHighlighter::formatFor(FormatKind kind)
+{
+    static const QVector<QTextCharFormat> formats = []() {
+        QVector<QTextCharFormat> table(FormatCount);
+
+        table[KeywordFormat].setForeground(QColor("#00007f"));
+        table[KeywordFormat].setFontWeight(QFont::Bold);
+        table[TypeFormat].setForeground(QColor("#7f007f"));
+        table[NumberFormat].setForeground(QColor("#007f7f"));
+        table[StringFormat].setForeground(QColor("#007f00"));
+        table[CommentFormat].setForeground(QColor("#7f7f7f"));
+        table[CommentFormat].setFontItalic(true);
+        table[PreprocessorFormat].setForeground(QColor("#7f5f00"));
+        table[FunctionFormat].setForeground(QColor("#0000ff"));
+        table[TagFormat].setForeground(QColor("#00007f"));
+        table[TagFormat].setFontWeight(QFont::Bold);
+        table[AttributeFormat].setForeground(QColor("#7f0000"));
+        table[KeyFormat].setForeground(QColor("#7f007f"));
+        return table;
+    }();
+    return formats[kind];
+}
+
+const SyntaxHighlighter::RuleTable &SyntaxHighlighter::ruleTable(Language language)
+{
+    // 正規表現は言語ごとに一度だけコンパイルする
+    auto rule = [](const QString &pattern, FormatKind kind, int group = 0,
+                   QRegularExpression::PatternOptions options = QRegularExpression::NoPatternOption) {
+        QRegularExpression expression(pattern, options);
+        expression.optimize();
+        return Rule{expression, kind, group};
+    };
+    auto multiLine = [](const QString &start, const QString &end, FormatKind kind, int state) {
+        QRegularExpression startExpression(start);
+        QRegularExpression endExpression(end);
+        startExpression.optimize();
+        endExpression.optimize();
+        return MultiLineRule{startExpression, endExpression, kind, state};
+    };
+
+    const QString number = R"(\b(?:0[xX][0-9a-fA-F']+|0[bB][01']+|\d[\d']*(?:\.\d*)?(?:[eE][+-]?\d+)?)[uUlLfF]*\b)";
+    const QString doubleQuoted = R"("(?:[^"\\]|\\.)*")";
+    const QString singleQuoted = R"('(?:[^'\\]|\\.)*')";
+
+    // 表は初めて使われた言語の分だけ構築する
+    switch (language) {
+    case Cpp: {
+        static const RuleTable cpp = [&]() {
+            RuleTable table;
+            table.rules << rule(R"(\b(?:alignas|alignof|asm|auto|break|case|catch|class|co_await|co_return|co_yield|concept|const|consteval|constexpr|constinit|const_cast|continue|decltype|default|delete|do|dynamic_cast|else|enum|explicit|export|extern|false|final|for|friend|goto|if|inline|mutable|namespace|new|noexcept|nullptr|operator|override|private|protected|public|register|reinterpret_cast|requires|return|signals|sizeof|slots|static|static_assert|static_cast|struct|switch|template|this|thread_local|throw|true|try|typedef|typeid|typename|union|using|virtual|volatile|while)\b)", KeywordFormat)
+                        << rule(R"(\b(?:bool|char|char8_t|char16_t|char32_t|double|float|int|long|short|signed|unsigned|void|wchar_t|u?int(?:8|16|32|64)_t|size_t|qint\d+|quint\d+|qreal|Q[A-Z]\w*)\b)", TypeFormat)
+                        << rule(number, NumberFormat)
+                        << rule(R"(\b([A-Za-z_]\w*)(?=\s*\())", FunctionFormat, 1)
+                        << rule(R"(^\s*#\s*\w+)", PreprocessorFormat)
+                        << rule(doubleQuoted, StringFormat)
+                        << rule(singleQuoted, StringFormat)
+                        << rule(R"(#\s*include\s*(<[^>]*>))", StringFormat, 1)
+                        << rule(R"(//.*$)", CommentFormat);
+            table.multiLineRules << multiLine(R"(/\*)", R"(\*/)", CommentFormat, 1);
+            return table;
+        }();
+        return cpp;
+    }
+    case Python: {
+        static const RuleTable python = [&]() {
+            RuleTable table;
+            table.rules << rule(R"(\b(?:and|as|assert|async|await|break|case|class|continue|def|del|elif|else|except|finally|for|from|global|if|import|in|is|lambda|match|nonlocal|not|or|pass|raise|return|try|while|with|yield)\b)", KeywordFormat)
+                        << rule(R"(\b(?:True|False|None|self|cls)\b)", TypeFormat)
+                        << rule(number, NumberFormat)
+                        << rule(R"(\b(?:def|class)\s+(\w+))", FunctionFormat, 1)
+                        << rule(R"(^\s*@[\w.]+)", PreprocessorFormat)
+                        << rule(doubleQuoted, StringFormat)
+                        << rule(singleQuoted, StringFormat)
+                        << rule(R"(#.*$)", CommentFormat);
+            table.multiLineRules << multiLine(R"(""")", R"(""")", StringFormat, 2)
+                                 << multiLine(R"(''')", R"(''')", StringFormat, 3);
+            return table;
+        }();
+        return python;
+    }
+    case JavaScript: {
+        static const RuleTable javaScript = [&]() {
+            RuleTable table;
+            table.rules << rule(R"(\b(?:async|await|break|case|catch|class|const|continue|debugger|default|delete|do|else|export|extends|false|finally|for|function|if|import|in|instanceof|let|new|null|of|return|static|super|switch|this|throw|true|try|typeof|undefined|var|void|while|with|yield)\b)", KeywordFormat)
+                        << rule(number, NumberFormat)
+                        << rule(R"(\b([A-Za-z_$][\w$]*)(?=\s*\())", FunctionFormat, 1)
+                        << rule(doubleQuoted, StringFormat)
+                        << rule(singleQuoted, StringFormat)
+                        << rule(R"(`(?:[^`\\]|\\.)*`)", StringFormat)
+                        << rule(R"(//.*$)", CommentFormat);
+            table.multiLineRules << multiLine(R"(/\*)", R"(\*/)", CommentFormat, 1);
+            return table;
+        }();
+        return javaScript;
+    }
+    case Html: {
+        static const RuleTable html = [&]() {
+            RuleTable table;
+            table.rules << rule(R"(<!DOCTYPE[^>]*>)", PreprocessorFormat, 0, QRegularExpression::CaseInsensitiveOption)
+                        << rule(R"(</?\s*([A-Za-z][\w:.-]*))", TagFormat, 1)
+                        << rule(R"(\b([A-Za-z_:][\w:.-]*)\s*=)", AttributeFormat, 1)
+                        << rule(doubleQuoted, StringFormat)
+                        << rule(singleQuoted, StringFormat)
+                        << rule(R"(&#?\w+;)", NumberFormat);
+            table.multiLineRules << multiLine(R"(<!--)", R"(-->)", CommentFormat, 1);
+            return table;
+        }();
+        return html;
+    }
+    case Json: {
+        static const RuleTable json = [&]() {
+            RuleTable table;
+            table.rules << rule(R"(\b(?:true|false|null)\b)", KeywordFormat)
+                        << rule(R"(-?\b\d+(?:\.\d+)?(?:[eE][+-]?\d+)?\b)", NumberFormat)
+                        << rule(doubleQuoted, StringFormat)
+                        << rule(R"(("(?:[^"\\]|\\.)*")\s*:)", KeyFormat, 1);
+            return table;
+        }();
+        return json;
+    }
+    case Xml: {
+        static const RuleTable xml = [&]() {
+            RuleTable table;
+            table.rules << rule(R"(<\?[^?]*\?>)", PreprocessorFormat)
+                        << rule(R"(</?\s*([A-Za-z_][\w:.-]*))", TagFormat, 1)
+                        << rule(R"(\b([A-Za-z_:][\w:.-]*)\s*=)", AttributeFormat, 1)
+                        << rule(doubleQuoted, StringFormat)
+                        << rule(singleQuoted, StringFormat)
+                        << rule(R"(&#?\w+;)", NumberFormat);
+            table.multiLineRules << multiLine(R"(<!--)", R"(-->)", CommentFormat, 1)
+                                 << multiLine(R"(<!\[CDATA\[)", R"(\]\]>)", StringFormat, 4);
+            return table;
+        }();
+        return xml;
+    }
+    case PlainText:
+        break;
+    }
+
+    static const RuleTable plainText;
+    return plainText;
+}
@@ -0,0 +1,109 @@
+#ifndef SYNTAXHIGHLIGHTER_H
+#define SYNTAXHIGHLIGHTER_H
+
+#include <QSyntaxHighlighter>
+#include <QRegularExpression>
+#include <QTextCharFormat>
+#include <QElapsedTimer>
+#include <QPointer>
+#include <QVector>
+#include <QTimer>
+
+// 構文ハイライト（C++ / Python / JavaScript / HTML / JSON / XML）
+// ・ルール表は言語ごとに一度だけコンパイルして共有
+// ・ブロック状態（複数行コメント等）が変わったブロックだけ再ハイライト
+// ・先頭から確定済みのブロック番号（frontier）を持ち、残りはアイドル時に
+//   1フレームあたりの時間予算内で少しずつ処理する（言語の切り替えも同じ）
+// ・後回しにしたブロックはそれまでの書式を保つ（書式が変わらないので再レイアウトもしない）
+class SyntaxHighlighter : public QSyntaxHighlighter
+{
+    Q_OBJECT
+
+public:
+    enum Language {
+        PlainText,
+        Cpp,
+        Python,
+        JavaScript,
+        Html,
+        Json,
+        Xml
+    };
+
+    explicit SyntaxHighlighter(QObject *parent = nullptr);
+
+    void attach(QTextDocument *document);
+    void setLanguage(Language language);
+    Language language() const { return currentLanguage; }
+
+    // 先頭から何ブロック目までハイライトが確定しているか
+    int highlightedBlockCount() const { return frontier + 1; }
+
+    static Language languageForFile(const QString &fileName);
+
+protected:
+    void highlightBlock(const QString &text) override;
+
+private slots:
+    void onContentsChange(int position, int charsRemoved, int charsAdded);
+    void processIdleSlice();
+
+private:
+    enum FormatKind {
+        KeywordFormat,
+        TypeFormat,
+        NumberFormat,
+        StringFormat,
+        CommentFormat,
+        PreprocessorFormat,
+        FunctionFormat,
+        TagFormat,
+        AttributeFormat,
+        KeyFormat,
+        FormatCount
+    };
+
+    struct Rule {
+        QRegularExpression pattern;
+        FormatKind format;
+        int captureGroup;
+    };
+
+    // 行をまたぐ要素（ブロックコメント、三重引用符文字列など）
+    struct MultiLineRule {
+        QRegularExpression start;
+        QRegularExpression end;
+        FormatKind format;
+        int state;
+    };
+
+    struct RuleTable {
+        QVector<Rule> rules;
+        QVector<MultiLineRule> multiLineRules;
+    };
+
+    enum { NormalState = 0 };
+
+    static const RuleTable &ruleTable(Language language);
+    static const QTextCharFormat &formatFor(FormatKind kind);
+
+    void applyDocument();
+    void applyRules(const QString &text);
+    void startBudgetClock();
+    void scheduleIdlePass();
+
+    Language currentLanguage;
+    const RuleTable *rules;
+    QPointer<QTextDocument> attachedDocument;
+
+    // 時間予算付きハイライト用
+    int frontier;             // このブロック番号までは確定済み
+    int knownBlockCount;
+    int blocksThisTurn;
+    bool budgetClockRunning;
+    bool keepDeferredFormats;  // 後回しのブロックに今の書式を置き直すか
+    QElapsedTimer budgetClock;
+    QTimer *idleTimer;
+};
+
+#endif // SYNTAXHIGHLIGHTER_H
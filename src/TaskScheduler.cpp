@@ -0,0 +1,260 @@
+#include "TaskScheduler.h"
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QThread>
+#include <chrono>
+
+namespace {
+// 現在のスレッドがどのスケジューラの何番目のワーカーか（ワーカー以外は -1）
+thread_local TaskScheduler *currentScheduler = nullptr;
+thread_local int currentWorker = -1;
+
+qint64 nowNanoseconds()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+// TaskContext実装
+TaskScheduler::TaskContext::TaskContext(TaskScheduler *scheduler, quint64 id, const QString &name,
+                                        const CancellationToken &token)
+    : scheduler(scheduler)
+    , id(id)
+    , name(name)
+    , token(token)
+    , lastPercent(-1)
+{
+}
+
+void TaskScheduler::TaskContext::setProgress(qint64 done, qint64 total)
+{
+    const int percent = total > 0 ? int(qBound<qint64>(0, done * 100 / total, 100)) : 0;
+    if (percent == lastPercent) return;
+    lastPercent = percent;
+
+    TaskScheduler *target = scheduler;
+    const quint64 taskId = id;
+    const QString taskName = name;
+    QMetaObject::invokeMethod(target, [target, taskId, taskName, percent]() {
+        emit target->progressChanged(taskId, taskName, percent);
+    }, Qt::QueuedConnection);
+}
+
+// TaskScheduler実装
+TaskScheduler &TaskScheduler::shared()
+{
+    // アプリケーションと一緒に破棄する（ワーカーの終了を待ってから QCoreApplication が消える）
+    static TaskScheduler *scheduler = new TaskScheduler(0, QCoreApplication::instance());
+    return *scheduler;
+}
+
+TaskScheduler::TaskScheduler(int workerCount, QObject *parent)
+    : QObject(parent)
+{
+    if (workerCount <= 0) {
+        // UIスレッドの分を1つ残す
+        workerCount = qMax(2, QThread::idealThreadCount() - 1);
+    }
+
+    for (int i = 0; i < workerCount; ++i) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (int i = 0; i < workerCount; ++i) {
+        workers[i]->thread = std::thread(&TaskScheduler::workerLoop, this, i);
+    }
+    lastSampleNanoseconds = nowNanoseconds();
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    cancelAll();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (auto &worker : workers) {
+        worker->thread.join();
+    }
+}
+
+quint64 TaskScheduler::submit(const QString &name, Priority priority, Work work, Completion done)
+{
+    Task task;
+    task.id = nextId.fetch_add(1);
+    task.name = name;
+    task.work = std::move(work);
+    task.done = std::move(done);
+    const quint64 id = task.id;
+
+    {
+        std::lock_guard<std::mutex> lock(tokenMutex);
+        activeTokens.insert(id, task.token);
+    }
+
+    // ワーカー内から投入されたタスクは自分のキューへ（局所性が高く、他のワーカーが盗める）
+    TaskQueue &queue = (currentScheduler == this && currentWorker >= 0)
+        ? workers[currentWorker]->queue : injectionQueue;
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks[priority].push_back(std::move(task));
+    }
+
+    submittedCount.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        pendingTasks.fetch_add(1);
+    }
+    wakeUp.notify_one();
+    return id;
+}
+
+void TaskScheduler::cancel(quint64 id)
+{
+    std::lock_guard<std::mutex> lock(tokenMutex);
+    auto it = activeTokens.find(id);
+    if (it != activeTokens.end()) {
+        it.value().cancel();
+    }
+}
+
+void TaskScheduler::cancelAll()
+{
+    std::lock_guard<std::mutex> lock(tokenMutex);
+    for (auto it = activeTokens.begin(); it != activeTokens.end(); ++it) {
+        it.value().cancel();
+    }
+}
+
+bool TaskScheduler::popBack(TaskQueue &queue, int priority, Task &task)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    std::deque<Task> &tasks = queue.tasks[priority];
+    if (tasks.empty()) return false;
+    task = std::move(tasks.back());
+    tasks.pop_back();
+    return true;
+}
+
+bool TaskScheduler::popFront(TaskQueue &queue, int priority, Task &task)
+{
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    std::deque<Task> &tasks = queue.tasks[priority];
+    if (tasks.empty()) return false;
+    task = std::move(tasks.front());
+    tasks.pop_front();
+    return true;
+}
+
+bool TaskScheduler::takeTask(int index, Task &task)
+{
+    const int count = int(workers.size());
+    for (int priority = 0; priority < PriorityCount; ++priority) {
+        if (popBack(workers[index]->queue, priority, task)) return true;
+        if (popFront(injectionQueue, priority, task)) return true;
+
+        // 他のワーカーから古い順に盗む
+        for (int offset = 1; offset < count; ++offset) {
+            if (popFront(workers[(index + offset) % count]->queue, priority, task)) {
+                stolenCount.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::workerLoop(int index)
+{
+    currentScheduler = this;
+    currentWorker = index;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeUp.wait(lock, [this]() { return stopping || pendingTasks.load() > 0; });
+            if (stopping) return;
+        }
+
+        Task task;
+        if (!takeTask(index, task)) {
+            // 他のワーカーが先に取った
+            std::this_thread::yield();
+            continue;
+        }
+        pendingTasks.fetch_sub(1);
+        runTask(index, task);
+    }
+}
+
+void TaskScheduler::runTask(int index, Task &task)
+{
+    Worker &worker = *workers[index];
+    const qint64 started = nowNanoseconds();
+    worker.busySince.store(started, std::memory_order_relaxed);
+
+    if (!task.token.isCancelled()) {
+        TaskContext context(this, task.id, task.name, task.token);
+        task.work(context);
+    }
+
+    worker.busyNanoseconds.fetch_add(nowNanoseconds() - started, std::memory_order_relaxed);
+    worker.busySince.store(0, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(tokenMutex);
+        activeTokens.remove(task.id);
+    }
+    const bool cancelled = task.token.isCancelled();
+    completedCount.fetch_add(1, std::memory_order_relaxed);
+    if (cancelled) {
+        cancelledCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    const quint64 id = task.id;
+    const QString name = task.name;
+    Completion done = std::move(task.done);
+    QMetaObject::invokeMethod(this, [this, id, name, done, cancelled]() {
+        if (done) {
+            done(cancelled);
+        }
+        emit taskFinished(id, name, cancelled);
+    }, Qt::QueuedConnection);
+}
+
+TaskScheduler::Statistics TaskScheduler::statistics()
+{
+    Statistics stats;
+    stats.workerCount = int(workers.size());
+    stats.submitted = submittedCount.load();
+    stats.completed = completedCount.load();
+    stats.cancelled = cancelledCount.load();
+    stats.stolen = stolenCount.load();
+
+    auto countQueue = [&stats](TaskQueue &queue) {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        for (int priority = 0; priority < PriorityCount; ++priority) {
+            stats.queued[priority] += int(queue.tasks[priority].size());
+        }
+    };
+    countQueue(injectionQueue);
+
+    const qint64 now = nowNanoseconds();
+    const qint64 elapsed = qMax<qint64>(1, now - lastSampleNanoseconds);
+    lastSampleNanoseconds = now;
+
+    for (auto &worker : workers) {
+        countQueue(worker->queue);
+        // 実行中のタスクも経過分を稼働時間に含める
+        qint64 busy = worker->busyNanoseconds.load(std::memory_order_relaxed);
+        const qint64 since = worker->busySince.load(std::memory_order_relaxed);
+        if (since != 0) {
+            ++stats.busyWorkers;
+            busy += now - since;
+        }
+        stats.utilization.append(qMin(1.0, double(busy - worker->sampledBusyNanoseconds) / elapsed));
+        worker->sampledBusyNanoseconds = busy;
+    }
+    return stats;
+}
@@ -0,0 +1,146 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QObject>
+#include <QHash>
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// バックグラウンド処理用のワークスティーリング型スレッドプール（QtCoreのみ使用）
+// ・優先度クラスごとにキューを持ち、高い優先度から取り出す
+// ・各ワーカーは自分のキューの末尾から取り、空なら共有キュー、他ワーカーのキュー先頭の順に探す
+// ・取り消しは協調的（処理側が TaskContext::isCancelled() を確認して終了する）
+// ・完了通知と進捗はスケジューラのスレッド（UIスレッド）へキューイングして渡す
+class TaskScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Priority {
+        Interactive = 0,   // ユーザーが結果を待っている処理（読み込み・保存）
+        Visible,           // 画面に表示中の内容に関する処理
+        Background,        // 急がない処理
+        PriorityCount
+    };
+
+    // 協調的な取り消しフラグ（コピーしても同じフラグを共有する）
+    class CancellationToken
+    {
+    public:
+        CancellationToken() : flag(std::make_shared<std::atomic<bool>>(false)) {}
+        bool isCancelled() const { return flag->load(std::memory_order_relaxed); }
+        void cancel() { flag->store(true, std::memory_order_relaxed); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> flag;
+    };
+
+    // 実行中のタスクに渡される文脈
+    class TaskContext
+    {
+    public:
+        bool isCancelled() const { return token.isCancelled(); }
+        // 進捗（0〜100）。値が変わったときだけUIスレッドへ通知する
+        void setProgress(qint64 done, qint64 total);
+
+    private:
+        friend class TaskScheduler;
+        TaskContext(TaskScheduler *scheduler, quint64 id, const QString &name,
+                    const CancellationToken &token);
+
+        TaskScheduler *scheduler;
+        quint64 id;
+        QString name;
+        CancellationToken token;
+        int lastPercent;
+    };
+
+    using Work = std::function<void(TaskContext &context)>;
+    using Completion = std::function<void(bool cancelled)>;
+
+    struct Statistics {
+        int workerCount = 0;
+        int busyWorkers = 0;
+        int queued[PriorityCount] = {0, 0, 0};
+        quint64 submitted = 0;
+        quint64 completed = 0;
+        quint64 cancelled = 0;
+        quint64 stolen = 0;
+        QVector<double> utilization;   // 前回の取得からのワーカーごとの稼働率（0〜1）
+    };
+
+    explicit TaskScheduler(int workerCount = 0, QObject *parent = nullptr);
+    ~TaskScheduler();
+
+    // UI のウィンドウがすべてで共有するスケジューラ（最初の呼び出しで QCoreApplication の子として作る）
+    // ウィンドウごとに作るとワーカーがウィンドウ数だけ増え、コア数を超えて奪い合う
+    static TaskScheduler &shared();
+
+    // work はワーカースレッドで、done はスケジューラのスレッドで呼ばれる
+    quint64 submit(const QString &name, Priority priority, Work work, Completion done = Completion());
+
+    void cancel(quint64 id);
+    void cancelAll();
+
+    Statistics statistics();
+
+signals:
+    void progressChanged(quint64 id, const QString &name, int percent);
+    void taskFinished(quint64 id, const QString &name, bool cancelled);
+
+private:
+    struct Task {
+        quint64 id = 0;
+        QString name;
+        Work work;
+        Completion done;
+        CancellationToken token;
+    };
+
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks[PriorityCount];
+    };
+
+    struct Worker {
+        TaskQueue queue;
+        std::thread thread;
+        std::atomic<qint64> busySince{0};        // 実行中タスクの開始時刻（待機中は 0）
+        std::atomic<qint64> busyNanoseconds{0};  // 完了したタスクの累計実行時間
+        qint64 sampledBusyNanoseconds = 0;
+    };
+
+    void workerLoop(int index);
+    bool takeTask(int index, Task &task);
+    static bool popBack(TaskQueue &queue, int priority, Task &task);
+    static bool popFront(TaskQueue &queue, int priority, Task &task);
+    void runTask(int index, Task &task);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    TaskQueue injectionQueue;           // ワーカー以外のスレッドから投入されたタスク
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeUp;
+    std::atomic<int> pendingTasks{0};
+    bool stopping = false;
+
+    std::mutex tokenMutex;
+    QHash<quint64, CancellationToken> activeTokens;
+
+    std::atomic<quint64> nextId{1};
+    std::atomic<quint64> submittedCount{0};
+    std::atomic<quint64> completedCount{0};
+    std::atomic<quint64> cancelledCount{0};
+    std::atomic<quint64> stolenCount{0};
+    qint64 lastSampleNanoseconds = 0;
+};
+
+#endif // TASKSCHEDULER_H
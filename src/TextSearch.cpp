@@ -0,0 +1,61 @@
+#include "TextSearch.h"
+#include "TextMatch.h"
+
+namespace {
+
+// QString::indexOf(Qt::CaseInsensitive) と同じ畳み込み、QTextDocument::find と同じ単語の判定
+struct QtTraits {
+    static char16_t fold(char16_t c) { return char16_t(QChar::toCaseFolded(char32_t(c))); }
+    static bool isWordCharacter(char16_t c) { return QChar::isLetterOrNumber(char32_t(c)); }
+};
+
+std::u16string_view view(QStringView text)
+{
+    return std::u16string_view(text.utf16(), size_t(text.size()));
+}
+
+TextMatch::Options matchOptions(const TextSearch::Options &options)
+{
+    TextMatch::Options result;
+    result.caseSensitive = options.caseSensitive;
+    result.wholeWords = options.wholeWords;
+    return result;
+}
+
+}
+
+namespace TextSearch {
+
+int indexIn(QStringView line, QStringView needle, int from, const Options &options)
+{
+    if (needle.isEmpty() || from < 0) return -1;
+    const size_t index = TextMatch::indexIn<QtTraits>(view(line), view(needle), size_t(from), matchOptions(options));
+    return index == TextMatch::NoMatch ? -1 : int(index);
+}
+
+int replaceAll(QString &line, QStringView needle, QStringView replacement, const Options &options)
+{
+    if (needle.isEmpty() || line.size() < needle.size()) return 0;
+
+    // 照合は元の行のまま行う（NBSP の読み替えは照合処理の中で済ませる）
+    const TextMatch::Options match = matchOptions(options);
+    size_t index = TextMatch::indexIn<QtTraits>(view(line), view(needle), 0, match);
+    if (index == TextMatch::NoMatch) return 0;
+
+    QString result;
+    result.reserve(line.size());
+    qsizetype copied = 0;
+    int count = 0;
+    while (index != TextMatch::NoMatch) {
+        result += QStringView(line).mid(copied, qsizetype(index) - copied);
+        result += replacement;
+        copied = qsizetype(index) + needle.size();
+        ++count;
+        index = TextMatch::indexIn<QtTraits>(view(line), view(needle), size_t(copied), match);
+    }
+    result += QStringView(line).mid(copied);
+    line = result;
+    return count;
+}
+
+} // namespace TextSearch
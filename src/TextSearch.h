@@ -0,0 +1,28 @@
+#ifndef TEXTSEARCH_H
+#define TEXTSEARCH_H
+
+#include <QString>
+#include <QStringView>
+
+// 検索・置換の共通処理（エディタの「すべて置換」とバッチモードで同じ規則を使う）
+// 照合は wlcore の TextMatch に Qt の文字分類を渡して行う
+// QTextDocument::find と同じ規則で照合する
+// ・行（段落）単位で照合し、行をまたぐ一致はない
+// ・NBSP は空白として照合する
+// ・単語単位では前後が文字・数字でない位置だけを一致とし、外れたら1文字先から探し直す
+namespace TextSearch {
+
+struct Options {
+    bool caseSensitive = false;
+    bool wholeWords = false;
+};
+
+// line の from 以降で最初に一致する位置（なければ -1）
+int indexIn(QStringView line, QStringView needle, int from, const Options &options);
+
+// 行内の一致を左から重ならないように置き換え、置き換えた数を返す
+int replaceAll(QString &line, QStringView needle, QStringView replacement, const Options &options);
+
+} // namespace TextSearch
+
+#endif // TEXTSEARCH_H
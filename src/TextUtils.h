@@ -0,0 +1,56 @@
+#ifndef TEXTUTILS_H
+#define TEXTUTILS_H
+
+#include <QChar>
+
+// 文字種判定ヘルパー（CJK対応の文字数・単語数計算で共用）
+namespace TextUtils {
+
+// 漢字・かな・ハングルなど、1文字を1語として数える文字
+inline bool isCjkCharacter(char32_t cp)
+{
+    return (cp >= 0x3040 && cp <= 0x309F)     // ひらがな
+        || (cp >= 0x30A0 && cp <= 0x30FF)     // カタカナ
+        || (cp >= 0x31F0 && cp <= 0x31FF)     // カタカナ拡張
+        || (cp >= 0x3400 && cp <= 0x4DBF)     // CJK統合漢字拡張A
+        || (cp >= 0x4E00 && cp <= 0x9FFF)     // CJK統合漢字
+        || (cp >= 0xAC00 && cp <= 0xD7AF)     // ハングル音節
+        || (cp >= 0xF900 && cp <= 0xFAFF)     // CJK互換漢字
+        || (cp >= 0xFF66 && cp <= 0xFF9F)     // 半角カタカナ
+        || (cp >= 0x20000 && cp <= 0x3FFFF);  // CJK統合漢字拡張B以降
+}
+
+// 全角記号・句読点（文字としては数えるが単語にはしない）
+inline bool isCjkPunctuation(char32_t cp)
+{
+    return (cp >= 0x3000 && cp <= 0x303F)     // CJK記号・句読点
+        || (cp >= 0xFF01 && cp <= 0xFF0F)     // 全角記号
+        || (cp >= 0xFF1A && cp <= 0xFF20)
+        || (cp >= 0xFF3B && cp <= 0xFF40)
+        || (cp >= 0xFF5B && cp <= 0xFF65);
+}
+
+// 等幅表示での桁数（全角・CJKは2桁、結合文字などの幅0は扱わず1桁）
+inline int displayWidth(char32_t cp)
+{
+    if (cp < 0x1100) return 1;
+    return ((cp >= 0x1100 && cp <= 0x115F)        // ハングル字母
+         || (cp >= 0x2E80 && cp <= 0x303E)        // CJK部首・記号・句読点
+         || (cp >= 0x3041 && cp <= 0x33FF)        // かな・CJK互換
+         || (cp >= 0x3400 && cp <= 0x4DBF)        // CJK統合漢字拡張A
+         || (cp >= 0x4E00 && cp <= 0x9FFF)        // CJK統合漢字
+         || (cp >= 0xA000 && cp <= 0xA4CF)        // イ文字
+         || (cp >= 0xAC00 && cp <= 0xD7A3)        // ハングル音節
+         || (cp >= 0xF900 && cp <= 0xFAFF)        // CJK互換漢字
+         || (cp >= 0xFE30 && cp <= 0xFE4F)        // CJK互換形
+         || (cp >= 0xFF00 && cp <= 0xFF60)        // 全角英数・記号
+         || (cp >= 0xFFE0 && cp <= 0xFFE6)
+         || (cp >= 0x1F300 && cp <= 0x1F64F)      // 絵文字
+         || (cp >= 0x1F900 && cp <= 0x1F9FF)
+         || (cp >= 0x20000 && cp <= 0x3FFFD))     // CJK統合漢字拡張B以降
+        ? 2 : 1;
+}
+
+} // namespace TextUtils
+
+#endif // TEXTUTILS_H
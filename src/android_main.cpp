@@ -2,54 +2,55 @@
 
 #include <jni.h>
 #include <android/log.h>
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <memory>
+#include "AndroidTextEditor.h"
 
 #define LOG_TAG "WLEditor"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
 #define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
 
-// Simple text editor implementation for Android
-class AndroidTextEditor {
-private:
-    std::string content;
-    int cursor_pos;
-    
-public:
-    AndroidTextEditor() : cursor_pos(0) {
-        LOGI("AndroidTextEditor created");
-    }
-    
-    void insertText(const std::string& text) {
-        content.insert(cursor_pos, text);
-        cursor_pos += text.length();
-        LOGI("Text inserted: %s", text.c_str());
-    }
-    
-    void deleteChar() {
-        if (cursor_pos > 0) {
-            content.erase(cursor_pos - 1, 1);
-            cursor_pos--;
-            LOGI("Character deleted");
-        }
-    }
-    
-    std::string getText() const {
-        return content;
-    }
-    
-    void setCursor(int pos) {
-        if (pos >= 0 && pos <= static_cast<int>(content.length())) {
-            cursor_pos = pos;
-        }
-    }
-    
-    int getCursor() const {
-        return cursor_pos;
-    }
-};
-
+// 編集コア（AndroidTextEditor）と、差分を Java へ渡すダイレクト ByteBuffer
+// 編集系の呼び出しは差分を書き込んだバイト数を返す（-1 ならあふれたので全体を読み直す）
+// 書き込んだ差分は次の編集系の呼び出しまで有効
 static std::unique_ptr<AndroidTextEditor> editor;
+static DeltaEncoder deltas;
+
+namespace {
+// Java の String を UTF-16 のまま取り出す（修正 UTF-8 への変換をしない）
+std::u16string toUtf16(JNIEnv *env, jstring text)
+{
+    std::u16string result;
+    if (!text) return result;
+    const jsize length = env->GetStringLength(text);
+    result.resize(size_t(length));
+    env->GetStringRegion(text, 0, length, reinterpret_cast<jchar *>(&result[0]));
+    return result;
+}
+
+jint pendingDeltas()
+{
+    if (!deltas.isAttached()) return 0;
+    return deltas.overflowed() ? -1 : jint(deltas.size());
+}
+
+void beginEdit()
+{
+    deltas.reset();
+}
+
+// 範囲を [0, length] に収める
+bool clampRange(jint &offset, jint &length)
+{
+    if (!editor || offset < 0 || length < 0) return false;
+    const jint total = jint(editor->length());
+    offset = std::min(offset, total);
+    length = std::min(length, total - offset);
+    return true;
+}
+}
 
 extern "C" {
 
@@ -57,31 +58,179 @@ JNIEXPORT void JNICALL
 Java_com_wleditor_app_MainActivity_nativeInit(JNIEnv *env, jclass clazz) {
     LOGI("WLEditor Android Native Init");
     editor = std::make_unique<AndroidTextEditor>();
+    editor->setDeltaListener([](const AndroidTextEditor::Delta &delta) {
+        deltas.append(delta);
+    });
     LOGI("WLEditor initialized successfully");
 }
 
 JNIEXPORT void JNICALL
+Java_com_wleditor_app_MainActivity_attachDeltaBuffer(JNIEnv *env, jclass clazz, jobject buffer) {
+    void *address = buffer ? env->GetDirectBufferAddress(buffer) : nullptr;
+    const jlong capacity = buffer ? env->GetDirectBufferCapacity(buffer) : 0;
+    if (buffer && (!address || capacity < jlong(DeltaEncoder::HeaderBytes))) {
+        LOGE("attachDeltaBuffer: a direct ByteBuffer is required");
+        return;
+    }
+    deltas.attach(address, size_t(capacity));
+}
+
+JNIEXPORT jint JNICALL
 Java_com_wleditor_app_MainActivity_insertText(JNIEnv *env, jclass clazz, jstring text) {
-    if (editor) {
-        const char* nativeText = env->GetStringUTFChars(text, 0);
-        editor->insertText(std::string(nativeText));
-        env->ReleaseStringUTFChars(text, nativeText);
+    if (!editor) return 0;
+    beginEdit();
+    editor->insertText(toUtf16(env, text));
+    return pendingDeltas();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_deleteChar(JNIEnv *env, jclass clazz) {
+    if (!editor) return 0;
+    beginEdit();
+    editor->deleteChar();
+    return pendingDeltas();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_deleteForward(JNIEnv *env, jclass clazz) {
+    if (!editor) return 0;
+    beginEdit();
+    editor->deleteForward();
+    return pendingDeltas();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_replaceText(JNIEnv *env, jclass clazz, jint offset, jint length, jstring text) {
+    if (!clampRange(offset, length)) return 0;
+    beginEdit();
+    editor->replace(size_t(offset), size_t(length), toUtf16(env, text));
+    return pendingDeltas();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_setText(JNIEnv *env, jclass clazz, jstring text) {
+    if (!editor) return 0;
+    beginEdit();
+    editor->setText(toUtf16(env, text));
+    return pendingDeltas();
+}
+
+// ContentResolver から得た記述子のファイルを読み込み、UTF-16 の長さを返す（失敗なら -1）
+// 本文は写像からネイティブの GapBuffer へ直接復号し、Java のヒープを通さない
+// 記述子は閉じない（ParcelFileDescriptor が持ち主）。差分は書かず、Java 側は全体を読み直す
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_loadFile(JNIEnv *env, jclass clazz, jint fd) {
+    if (!editor || fd < 0) return -1;
+    beginEdit();
+    const int error = editor->loadFile(fd);
+    if (error != 0) {
+        LOGE("loadFile: %s", std::strerror(error));
+        return -1;
     }
+    return jint(editor->length());
 }
 
-JNIEXPORT jstring JNICALL
-Java_com_wleditor_app_MainActivity_getText(JNIEnv *env, jclass clazz) {
-    if (editor) {
-        return env->NewStringUTF(editor->getText().c_str());
+// 同じ記述子へ UTF-8 で書き戻す（"rw" で開いたもの。書いた長さで切り詰める）。成功なら true
+JNIEXPORT jboolean JNICALL
+Java_com_wleditor_app_MainActivity_saveFile(JNIEnv *env, jclass clazz, jint fd) {
+    if (!editor || fd < 0) return JNI_FALSE;
+    const int error = editor->saveFile(fd);
+    if (error != 0) {
+        LOGE("saveFile: %s", std::strerror(error));
+        return JNI_FALSE;
     }
-    return env->NewStringUTF("");
+    return JNI_TRUE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_undo(JNIEnv *env, jclass clazz) {
+    if (!editor) return 0;
+    beginEdit();
+    editor->undo();
+    return pendingDeltas();
 }
 
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_redo(JNIEnv *env, jclass clazz) {
+    if (!editor) return 0;
+    beginEdit();
+    editor->redo();
+    return pendingDeltas();
+}
+
+// 取り消し履歴の書き出し先（Context.getCacheDir()）
 JNIEXPORT void JNICALL
-Java_com_wleditor_app_MainActivity_deleteChar(JNIEnv *env, jclass clazz) {
-    if (editor) {
-        editor->deleteChar();
+Java_com_wleditor_app_MainActivity_setCacheDir(JNIEnv *env, jclass clazz, jstring path) {
+    if (!editor || !path) return;
+    const char *chars = env->GetStringUTFChars(path, nullptr);
+    editor->setSpillDirectory(chars);
+    env->ReleaseStringUTFChars(path, chars);
+}
+
+// ComponentCallbacks2.onTrimMemory の level をそのまま受け取り、減ったバイト数を返す
+JNIEXPORT jlong JNICALL
+Java_com_wleditor_app_MainActivity_nativeTrimMemory(JNIEnv *env, jclass clazz, jint level) {
+    if (!editor) return 0;
+    const size_t freed = editor->onTrimMemory(level);
+    LOGI("onTrimMemory(%d): %zu bytes freed, %zu bytes in use", int(level), freed, editor->memoryBytes());
+    return jlong(freed);
+}
+
+JNIEXPORT void JNICALL
+Java_com_wleditor_app_MainActivity_setCursor(JNIEnv *env, jclass clazz, jint position) {
+    if (editor && position >= 0) {
+        editor->setCursor(size_t(position));
+    }
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_getCursor(JNIEnv *env, jclass clazz) {
+    return editor ? jint(editor->cursor()) : 0;
+}
+
+// 書記素クラスタ単位でカーソルを動かし、新しい位置を返す
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_moveCursor(JNIEnv *env, jclass clazz, jint count) {
+    if (!editor) return 0;
+    editor->moveCursor(count);
+    return jint(editor->cursor());
+}
+
+// 位置の単位変換（0: UTF-16, 1: コードポイント, 2: UTF-8 バイト, 3: 行）。IME の変換中にも呼べる O(log n)
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_convertOffset(JNIEnv *env, jclass clazz, jint offset, jint from, jint to) {
+    if (!editor || offset < 0 || from < 0 || from > 3 || to < 0 || to > 3) return -1;
+    return jint(editor->convertOffset(size_t(offset), TextOffsetIndex::Unit(from), TextOffsetIndex::Unit(to)));
+}
+
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_getLength(JNIEnv *env, jclass clazz) {
+    return editor ? jint(editor->length()) : 0;
+}
+
+JNIEXPORT jstring JNICALL
+Java_com_wleditor_app_MainActivity_getTextRange(JNIEnv *env, jclass clazz, jint offset, jint length) {
+    if (!clampRange(offset, length)) {
+        return env->NewString(nullptr, 0);
     }
+    const std::u16string text = editor->text(size_t(offset), size_t(length));
+    return env->NewString(reinterpret_cast<const jchar *>(text.data()), jsize(text.size()));
+}
+
+// 範囲を UTF-16 のまま target（ダイレクト ByteBuffer）へ写し、写した単位数を返す
+JNIEXPORT jint JNICALL
+Java_com_wleditor_app_MainActivity_readRange(JNIEnv *env, jclass clazz, jint offset, jint length, jobject target) {
+    void *address = target ? env->GetDirectBufferAddress(target) : nullptr;
+    if (!address || !clampRange(offset, length)) return -1;
+    const jlong capacity = env->GetDirectBufferCapacity(target) / jlong(sizeof(char16_t));
+    length = jint(std::min<jlong>(length, capacity));
+    return jint(editor->copyText(size_t(offset), size_t(length), static_cast<char16_t *>(address)));
+}
+
+// 全文の取得（起動時・あふれた後の読み直し用）
+JNIEXPORT jstring JNICALL
+Java_com_wleditor_app_MainActivity_getText(JNIEnv *env, jclass clazz) {
+    return Java_com_wleditor_app_MainActivity_getTextRange(env, clazz, 0, editor ? jint(editor->length()) : 0);
 }
 
 // JNI_OnLoad is called when the library is loaded
@@ -92,4 +241,4 @@ JNIEXPORT jint JNICALL JNI_OnLoad(JavaVM* vm, void* reserved) {
 
 } // extern "C"
 
-#endif // ANDROID_BUILD
\ No newline at end of file
+#endif // ANDROID_BUILD
@@ -0,0 +1,53 @@
+# デスクトップ版 wledit（編集コアは wlcore をリンクする）
+TEMPLATE = app
+TARGET = wledit
+QT += core gui widgets network
+CONFIG += c++17
+
+INCLUDEPATH += core
+LIBS += -L$$OUT_PWD/core -lwlcore
+PRE_TARGETDEPS += $$OUT_PWD/core/libwlcore.a
+
+SOURCES += \
+    main.cpp \
+    MainWindow.cpp \
+    DocumentStatistics.cpp \
+    StartupProfiler.cpp \
+    SyntaxHighlighter.cpp \
+    OverviewRuler.cpp \
+    SingleInstance.cpp \
+    DocumentWorkspace.cpp \
+    TaskScheduler.cpp \
+    DocumentUndo.cpp \
+    ClipboardRing.cpp \
+    ColumnBlock.cpp \
+    DocumentRange.cpp \
+    TextSearch.cpp \
+    BatchProcessor.cpp \
+    KeyMacro.cpp \
+    Keymap.cpp \
+    PerformanceHud.cpp \
+    DocumentMemory.cpp \
+    Metrics.cpp
+
+HEADERS += \
+    MainWindow.h \
+    DocumentStatistics.h \
+    TextUtils.h \
+    StartupProfiler.h \
+    SyntaxHighlighter.h \
+    OverviewRuler.h \
+    SingleInstance.h \
+    DocumentWorkspace.h \
+    TaskScheduler.h \
+    DocumentUndo.h \
+    ClipboardRing.h \
+    ColumnBlock.h \
+    DocumentRange.h \
+    TextSearch.h \
+    BatchProcessor.h \
+    KeyMacro.h \
+    Keymap.h \
+    PerformanceHud.h \
+    DocumentMemory.h \
+    Metrics.h
@@ -0,0 +1,110 @@
+#include "GapBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+const size_t MinimumGap = 4096;
+}
+
+void GapBuffer::assign(std::u16string_view text)
+{
+    buffer.assign(text.begin(), text.end());
+    buffer.resize(text.size() + MinimumGap);
+    gapStart = text.size();
+    gapEnd = buffer.size();
+}
+
+char16_t *GapBuffer::assignUninitialized(size_t length)
+{
+    std::vector<char16_t>(length + MinimumGap).swap(buffer);
+    gapStart = length;
+    gapEnd = buffer.size();
+    return buffer.data();
+}
+
+void GapBuffer::clear()
+{
+    std::vector<char16_t>().swap(buffer);
+    gapStart = 0;
+    gapEnd = 0;
+}
+
+size_t GapBuffer::compact()
+{
+    const size_t before = capacityBytes();
+    std::vector<char16_t> compacted;
+    compacted.reserve(size());
+    compacted.insert(compacted.end(), buffer.begin(), buffer.begin() + gapStart);
+    compacted.insert(compacted.end(), buffer.begin() + gapEnd, buffer.end());
+    buffer.swap(compacted);
+    gapStart = buffer.size();
+    gapEnd = buffer.size();
+    return before > capacityBytes() ? before - capacityBytes() : 0;
+}
+
+void GapBuffer::moveGap(size_t position)
+{
+    if (position < gapStart) {
+        const size_t count = gapStart - position;
+        std::memmove(buffer.data() + gapEnd - count, buffer.data() + position, count * sizeof(char16_t));
+        gapStart = position;
+        gapEnd -= count;
+    } else if (position > gapStart) {
+        const size_t count = position - gapStart;
+        std::memmove(buffer.data() + gapStart, buffer.data() + gapEnd, count * sizeof(char16_t));
+        gapStart += count;
+        gapEnd += count;
+    }
+}
+
+void GapBuffer::ensureGap(size_t length)
+{
+    if (gapEnd - gapStart >= length) return;
+
+    // 全体の半分程度のギャップを確保し直す（再確保の回数を対数回に抑える）
+    const size_t textLength = size();
+    const size_t gap = std::max(length + MinimumGap, textLength / 2);
+    std::vector<char16_t> grown(textLength + gap);
+    std::copy(buffer.begin(), buffer.begin() + gapStart, grown.begin());
+    std::copy(buffer.begin() + gapEnd, buffer.end(), grown.begin() + gapStart + gap);
+    gapEnd = gapStart + gap;
+    buffer.swap(grown);
+}
+
+void GapBuffer::replace(size_t position, size_t removed, std::u16string_view inserted)
+{
+    position = std::min(position, size());
+    removed = std::min(removed, size() - position);
+
+    moveGap(position);
+    gapEnd += removed;
+    ensureGap(inserted.size());
+    std::copy(inserted.begin(), inserted.end(), buffer.begin() + gapStart);
+    gapStart += inserted.size();
+}
+
+std::u16string GapBuffer::text(size_t position, size_t length) const
+{
+    position = std::min(position, size());
+    length = std::min(length, size() - position);
+
+    std::u16string result;
+    result.reserve(length);
+    const std::u16string_view head = before();
+    const std::u16string_view tail = after();
+    if (position < head.size()) {
+        const size_t count = std::min(length, head.size() - position);
+        result.append(head.substr(position, count));
+        length -= count;
+        position = head.size();
+    }
+    if (length > 0) {
+        result.append(tail.substr(position - head.size(), length));
+    }
+    return result;
+}
+
+char16_t GapBuffer::at(size_t position) const
+{
+    return position < gapStart ? buffer[position] : buffer[position + (gapEnd - gapStart)];
+}
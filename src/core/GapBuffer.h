@@ -0,0 +1,47 @@
+#ifndef GAPBUFFER_H
+#define GAPBUFFER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// UTF-16 のギャップバッファ（Qt非依存）
+// 直前の編集位置にギャップを置くので、同じ付近での連続編集は移動量が小さい
+class GapBuffer
+{
+public:
+    size_t size() const { return buffer.size() - (gapEnd - gapStart); }
+    bool empty() const { return size() == 0; }
+
+    void assign(std::u16string_view text);
+    void clear();
+    // 中身を length 単位の未初期化の本文に置き換え、その書き込み先を返す
+    // 復号しながら直接書き込むためのもので、呼び出し側が length 単位をすべて埋める
+    char16_t *assignUninitialized(size_t length);
+
+    // [position, position + removed) を inserted に置き換える
+    void replace(size_t position, size_t removed, std::u16string_view inserted);
+
+    std::u16string text(size_t position, size_t length) const;
+    char16_t at(size_t position) const;
+
+    // ギャップの前後の区間（この順に連結すると全文）
+    std::u16string_view before() const { return std::u16string_view(buffer.data(), gapStart); }
+    std::u16string_view after() const { return std::u16string_view(buffer.data() + gapEnd, buffer.size() - gapEnd); }
+
+    size_t capacityBytes() const { return buffer.capacity() * sizeof(char16_t); }
+    // ギャップをなくして本文ちょうどの大きさに確保し直し、減ったバイト数を返す
+    // （次の挿入でギャップを確保し直す）
+    size_t compact();
+
+private:
+    void moveGap(size_t position);
+    void ensureGap(size_t length);
+
+    std::vector<char16_t> buffer;
+    size_t gapStart = 0;
+    size_t gapEnd = 0;
+};
+
+#endif // GAPBUFFER_H
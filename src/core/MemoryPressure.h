@@ -0,0 +1,48 @@
+#ifndef MEMORYPRESSURE_H
+#define MEMORYPRESSURE_H
+
+// メモリ不足への対応の段階（Android の ComponentCallbacks2.TRIM_MEMORY_* と同じ値）
+// Android 版は onTrimMemory の値をそのまま渡し、デスクトップ版・テストも同じ値で呼ぶ
+// 値の大小は深刻さの順ではない（UiHidden は画面から外れただけ）ので、段階ごとに対応を決める
+namespace MemoryPressure {
+
+enum Level {
+    RunningModerate = 5,
+    RunningLow = 10,
+    RunningCritical = 15,
+    UiHidden = 20,
+    Background = 40,
+    Moderate = 60,
+    Complete = 80
+};
+
+enum Action {
+    ReleaseCaches = 0x1,   // 作り直せるキャッシュ（行索引・検索結果・描画用の要約）を捨てる
+    Compact = 0x2,         // バッファのギャップを詰める
+    SpillUndo = 0x4        // 取り消し履歴の文字列をディスクへ書き出す
+};
+
+// ・実行中の不足（Running*）は段階に応じて強くする
+// ・画面から外れただけ（UiHidden）ならキャッシュだけ捨てる
+// ・バックグラウンドの一覧に入ったら詰めるまで。書き出すのは次に終了させられる Complete だけ
+// ・知らない値はキャッシュだけ捨てる
+inline int actions(int level)
+{
+    switch (level) {
+    case RunningModerate: return ReleaseCaches;
+    case RunningLow: return ReleaseCaches | Compact;
+    case RunningCritical: return ReleaseCaches | Compact | SpillUndo;
+    case UiHidden: return ReleaseCaches;
+    case Background: return ReleaseCaches | Compact;
+    case Moderate: return ReleaseCaches | Compact;
+    case Complete: return ReleaseCaches | Compact | SpillUndo;
+    default: return ReleaseCaches;
+    }
+}
+
+inline bool shouldCompact(int level) { return (actions(level) & Compact) != 0; }
+inline bool shouldSpillUndo(int level) { return (actions(level) & SpillUndo) != 0; }
+
+} // namespace MemoryPressure
+
+#endif // MEMORYPRESSURE_H
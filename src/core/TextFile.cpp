@@ -0,0 +1,235 @@
+#include "TextFile.h"
+#include "GapBuffer.h"
+#include <cerrno>
+#include <cstdint>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+const char32_t Replacement = 0xFFFD;
+const size_t BlockBytes = 64 * 1024;
+
+bool isHighSurrogate(char16_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+bool isLowSurrogate(char16_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+
+// p から1文字を読み、読んだバイト数を返す。不正なら1バイトだけ進めて U+FFFD とする
+size_t decodeOne(const unsigned char *p, size_t available, char32_t &codePoint)
+{
+    const unsigned char lead = p[0];
+    size_t length;
+    char32_t minimum;
+    if (lead >= 0xC2 && lead <= 0xDF) {
+        length = 2;
+        codePoint = lead & 0x1F;
+        minimum = 0x80;
+    } else if (lead >= 0xE0 && lead <= 0xEF) {
+        length = 3;
+        codePoint = lead & 0x0F;
+        minimum = 0x800;
+    } else if (lead >= 0xF0 && lead <= 0xF4) {
+        length = 4;
+        codePoint = lead & 0x07;
+        minimum = 0x10000;
+    } else {
+        codePoint = lead < 0x80 ? lead : Replacement;
+        return 1;
+    }
+    if (available < length) {
+        codePoint = Replacement;
+        return 1;
+    }
+    for (size_t i = 1; i < length; ++i) {
+        if ((p[i] & 0xC0) != 0x80) {
+            codePoint = Replacement;
+            return 1;
+        }
+        codePoint = (codePoint << 6) | (p[i] & 0x3F);
+    }
+    // 冗長な表現・サロゲート・範囲外
+    if (codePoint < minimum || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+        codePoint = Replacement;
+        return 1;
+    }
+    return length;
+}
+
+void decodeWithBom(std::string_view bytes, GapBuffer &text, bool *hasBom)
+{
+    const bool bom = bytes.size() >= 3 && bytes.compare(0, 3, "\xEF\xBB\xBF") == 0;
+    if (bom) bytes.remove_prefix(3);
+    if (hasBom) *hasBom = bom;
+    TextFile::decode(bytes, text);
+}
+
+// 64KB ずつ UTF-8 に詰めて先頭から書く。位置を指定できない記述子（パイプ）なら順に書く
+class Writer
+{
+public:
+    explicit Writer(int fd) : fd(fd) {}
+
+    void put(char32_t codePoint)
+    {
+        if (used + 4 > BlockBytes) flush();
+        if (codePoint < 0x80) {
+            block[used++] = char(codePoint);
+        } else if (codePoint < 0x800) {
+            block[used++] = char(0xC0 | (codePoint >> 6));
+            block[used++] = char(0x80 | (codePoint & 0x3F));
+        } else if (codePoint < 0x10000) {
+            block[used++] = char(0xE0 | (codePoint >> 12));
+            block[used++] = char(0x80 | ((codePoint >> 6) & 0x3F));
+            block[used++] = char(0x80 | (codePoint & 0x3F));
+        } else {
+            block[used++] = char(0xF0 | (codePoint >> 18));
+            block[used++] = char(0x80 | ((codePoint >> 12) & 0x3F));
+            block[used++] = char(0x80 | ((codePoint >> 6) & 0x3F));
+            block[used++] = char(0x80 | (codePoint & 0x3F));
+        }
+    }
+
+    // 書き残しを書き、古い内容の残りを切り詰めて同期する
+    int finish()
+    {
+        flush();
+        if (error == 0 && !stream && ftruncate(fd, written) != 0) error = errno;
+        if (error == 0 && fsync(fd) != 0 && errno != EINVAL) error = errno;
+        return error;
+    }
+
+private:
+    void flush()
+    {
+        size_t done = 0;
+        while (error == 0 && done < used) {
+            const ssize_t count = stream ? write(fd, block + done, used - done)
+                                         : pwrite(fd, block + done, used - done, written);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                if (errno == ESPIPE && !stream && written == 0) {
+                    stream = true;
+                    continue;
+                }
+                error = errno;
+                break;
+            }
+            done += size_t(count);
+            written += count;
+        }
+        used = 0;
+    }
+
+    int fd;
+    char block[BlockBytes];
+    size_t used = 0;
+    off_t written = 0;
+    bool stream = false;
+    int error = 0;
+};
+}
+
+namespace TextFile {
+
+void decode(std::string_view bytes, GapBuffer &text)
+{
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(bytes.data());
+    const size_t size = bytes.size();
+
+    // 1回目で UTF-16 の長さを数え、ちょうどの大きさで確保して2回目で書き込む
+    size_t units = 0;
+    for (size_t i = 0; i < size;) {
+        if (data[i] < 0x80) {
+            ++i;
+            ++units;
+            continue;
+        }
+        char32_t codePoint;
+        i += decodeOne(data + i, size - i, codePoint);
+        units += codePoint >= 0x10000 ? 2 : 1;
+    }
+
+    char16_t *out = text.assignUninitialized(units);
+    for (size_t i = 0; i < size;) {
+        if (data[i] < 0x80) {
+            *out++ = data[i++];
+            continue;
+        }
+        char32_t codePoint;
+        i += decodeOne(data + i, size - i, codePoint);
+        if (codePoint >= 0x10000) {
+            *out++ = char16_t(0xD800 + ((codePoint - 0x10000) >> 10));
+            *out++ = char16_t(0xDC00 + ((codePoint - 0x10000) & 0x3FF));
+        } else {
+            *out++ = char16_t(codePoint);
+        }
+    }
+}
+
+int load(int fd, GapBuffer &text, bool *hasBom)
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0) return errno;
+    const bool seekable = S_ISREG(info.st_mode);
+    if (seekable && uint64_t(info.st_size) > SIZE_MAX) return EFBIG;
+
+    if (seekable && info.st_size > 0) {
+        const size_t size = size_t(info.st_size);
+        void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping != MAP_FAILED) {
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            decodeWithBom(std::string_view(static_cast<const char *>(mapping), size), text, hasBom);
+            munmap(mapping, size);
+            return 0;
+        }
+    }
+
+    // mmap できない記述子は read で読む
+    std::string bytes;
+    if (seekable) bytes.reserve(size_t(info.st_size));
+    char block[BlockBytes];
+    off_t position = 0;
+    for (;;) {
+        const ssize_t count = seekable ? pread(fd, block, sizeof(block), position) : read(fd, block, sizeof(block));
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        if (count == 0) break;
+        bytes.append(block, size_t(count));
+        position += count;
+    }
+    decodeWithBom(bytes, text, hasBom);
+    return 0;
+}
+
+int save(int fd, const GapBuffer &text, bool writeBom)
+{
+    Writer writer(fd);
+    if (writeBom) writer.put(0xFEFF);
+
+    // サロゲートペアはギャップの前後に分かれていることがある
+    char16_t pendingHigh = 0;
+    for (const std::u16string_view span : {text.before(), text.after()}) {
+        for (const char16_t unit : span) {
+            if (pendingHigh) {
+                if (isLowSurrogate(unit)) {
+                    writer.put(0x10000 + ((char32_t(pendingHigh) - 0xD800) << 10) + (unit - 0xDC00));
+                    pendingHigh = 0;
+                    continue;
+                }
+                writer.put(Replacement);
+                pendingHigh = 0;
+            }
+            if (isHighSurrogate(unit)) {
+                pendingHigh = unit;
+            } else {
+                writer.put(isLowSurrogate(unit) ? Replacement : unit);
+            }
+        }
+    }
+    if (pendingHigh) writer.put(Replacement);
+    return writer.finish();
+}
+
+} // namespace TextFile
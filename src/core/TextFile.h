@@ -0,0 +1,26 @@
+#ifndef TEXTFILE_H
+#define TEXTFILE_H
+
+#include <cstddef>
+#include <string_view>
+
+class GapBuffer;
+
+// ファイル記述子を介した UTF-8 テキストの読み書き（POSIX のみ。Qt・JNI 非依存）
+// 読み込みはファイルを mmap し、写像から GapBuffer へ直接 UTF-16 に復号する（中間の文字列を作らない）
+// mmap できない記述子（パイプ・一部のドキュメントプロバイダ）は read で読む
+// 記述子は閉じず、位置も変えない（持ち主は呼び出し側。Android では ParcelFileDescriptor）
+// 戻り値は成功なら 0、失敗なら errno の値
+namespace TextFile {
+
+// 不正な UTF-8 は1バイトごとに U+FFFD に置き換える。先頭の BOM は本文に含めず hasBom で返す
+int load(int fd, GapBuffer &text, bool *hasBom = nullptr);
+// 先頭から書き、書いた長さで切り詰める。対になっていないサロゲートは U+FFFD として書く
+int save(int fd, const GapBuffer &text, bool writeBom = false);
+
+// UTF-8 を UTF-16 に復号して text を置き換える（load が写像に対して使う）
+void decode(std::string_view bytes, GapBuffer &text);
+
+} // namespace TextFile
+
+#endif // TEXTFILE_H
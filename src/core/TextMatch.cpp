@@ -0,0 +1,66 @@
+#include "TextMatch.h"
+
+namespace TextMatch {
+
+char16_t PortableTraits::fold(char16_t c)
+{
+    if (c < 0x80) {
+        return c >= u'A' && c <= u'Z' ? char16_t(c + 32) : c;
+    }
+    if ((c >= 0xC0 && c <= 0xDE && c != 0xD7) || (c >= 0x391 && c <= 0x3A9 && c != 0x3A2)
+        || (c >= 0x410 && c <= 0x42F) || (c >= 0xFF21 && c <= 0xFF3A)) {
+        return char16_t(c + 32);
+    }
+    if (c >= 0x400 && c <= 0x40F) {
+        return char16_t(c + 80);
+    }
+    // ラテン文字拡張A は大文字・小文字が交互に並ぶ（途中で偶奇が入れ替わる）
+    if (((c >= 0x100 && c <= 0x12F) || (c >= 0x132 && c <= 0x137) || (c >= 0x14A && c <= 0x177)) && c % 2 == 0) {
+        return char16_t(c + 1);
+    }
+    if (((c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17E)) && c % 2 == 1) {
+        return char16_t(c + 1);
+    }
+    if (c == 0x178) return 0xFF;
+    return c;
+}
+
+bool PortableTraits::isWordCharacter(char16_t c)
+{
+    if (c < 0x80) {
+        return (c >= u'0' && c <= u'9') || (c >= u'A' && c <= u'Z') || (c >= u'a' && c <= u'z');
+    }
+    if (c <= 0xBF || c == 0xD7 || c == 0xF7) return false;
+    if ((c >= 0x2000 && c <= 0x206F) || (c >= 0x2190 && c <= 0x2BFF) || (c >= 0x3000 && c <= 0x303F)) {
+        return false;
+    }
+    if ((c >= 0xFF01 && c <= 0xFF0F) || (c >= 0xFF1A && c <= 0xFF20) || (c >= 0xFF3B && c <= 0xFF40)
+        || (c >= 0xFF5B && c <= 0xFF65)) {
+        return false;
+    }
+    return true;
+}
+
+size_t replaceAll(std::u16string &line, std::u16string_view needle, std::u16string_view replacement,
+                  const Options &options)
+{
+    size_t index = indexIn<PortableTraits>(line, needle, 0, options);
+    if (index == NoMatch) return 0;
+
+    std::u16string result;
+    result.reserve(line.size());
+    size_t copied = 0;
+    size_t count = 0;
+    while (index != NoMatch) {
+        result.append(line, copied, index - copied);
+        result.append(replacement);
+        copied = index + needle.size();
+        ++count;
+        index = indexIn<PortableTraits>(line, needle, copied, options);
+    }
+    result.append(line, copied, std::u16string::npos);
+    line.swap(result);
+    return count;
+}
+
+} // namespace TextMatch
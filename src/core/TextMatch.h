@@ -0,0 +1,99 @@
+#ifndef TEXTMATCH_H
+#define TEXTMATCH_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// 検索エンジン（Qt非依存）。デスクトップ版の TextSearch と Android 版で同じ照合処理を使う
+// QTextDocument::find と同じ規則で照合する
+// ・行（段落）単位で照合し、行をまたぐ一致はない
+// ・本文の NBSP は空白として照合する（写しは作らず、比較の際に読み替える）
+// ・単語単位では前後が単語の文字でない位置だけを一致とし、外れたら1文字先から探し直す
+// 大文字小文字の畳み込みと単語の文字の判定は Traits で差し替える（ASCII の畳み込みは A-Z だけ）
+//   struct Traits {
+//       static char16_t fold(char16_t c);
+//       static bool isWordCharacter(char16_t c);
+//   };
+namespace TextMatch {
+
+const size_t NoMatch = std::u16string_view::npos;
+
+struct Options {
+    bool caseSensitive = false;
+    bool wholeWords = false;
+};
+
+// Unicode データなしで使える規則。畳み込みはラテン文字（拡張A まで）・ギリシャ文字・
+// キリル文字・全角英字だけ、単語の文字は英数字と、記号・句読点の範囲を除く非 ASCII 文字
+struct PortableTraits {
+    static char16_t fold(char16_t c);
+    static bool isWordCharacter(char16_t c);
+};
+
+inline char16_t haystackUnit(char16_t c)
+{
+    return c == 0x00A0 ? u' ' : c;
+}
+
+template <typename Traits>
+bool isWholeWord(std::u16string_view line, size_t start, size_t length)
+{
+    const size_t end = start + length;
+    return (start == 0 || !Traits::isWordCharacter(haystackUnit(line[start - 1])))
+        && (end == line.size() || !Traits::isWordCharacter(haystackUnit(line[end])));
+}
+
+// 畳み込み。ASCII は表を引かずに A-Z だけを小文字にする（Traits もこの規則に従うこと）
+template <typename Traits>
+char16_t foldUnit(char16_t c)
+{
+    if (c < 0x80) return c >= u'A' && c <= u'Z' ? char16_t(c + 32) : c;
+    return Traits::fold(c);
+}
+
+// line の from 以降で最初に一致する位置（なければ NoMatch）
+template <typename Traits>
+size_t indexIn(std::u16string_view line, std::u16string_view needle, size_t from, const Options &options)
+{
+    const size_t length = needle.size();
+    if (length == 0 || length > line.size()) return NoMatch;
+
+    // 大文字小文字を区別し、検索語に空白がなければ NBSP の読み替えは要らないので、
+    // 標準の検索（先頭の文字を探してから比べる）で候補へ飛ぶ
+    if (options.caseSensitive && needle.find(u' ') == NoMatch && needle.find(u'\u00A0') == NoMatch) {
+        for (size_t index = line.find(needle, from); index != NoMatch; index = line.find(needle, index + 1)) {
+            if (!options.wholeWords || isWholeWord<Traits>(line, index, length)) return index;
+        }
+        return NoMatch;
+    }
+
+    // それ以外は先頭の文字が合う位置でだけ残りを畳み込んで比べる
+    const char16_t first = options.caseSensitive ? needle[0] : foldUnit<Traits>(needle[0]);
+    for (size_t index = from; index + length <= line.size(); ++index) {
+        const char16_t unit = haystackUnit(line[index]);
+        if ((options.caseSensitive ? unit : foldUnit<Traits>(unit)) != first) continue;
+
+        size_t matched = 1;
+        if (options.caseSensitive) {
+            while (matched < length && haystackUnit(line[index + matched]) == needle[matched]) ++matched;
+        } else {
+            while (matched < length
+                   && foldUnit<Traits>(haystackUnit(line[index + matched])) == foldUnit<Traits>(needle[matched])) {
+                ++matched;
+            }
+        }
+        if (matched == length && (!options.wholeWords || isWholeWord<Traits>(line, index, length))) {
+            return index;
+        }
+    }
+    return NoMatch;
+}
+
+// 行内の一致を左から重ならないように置き換え、置き換えた数を返す
+size_t replaceAll(std::u16string &line, std::u16string_view needle, std::u16string_view replacement,
+                  const Options &options);
+
+} // namespace TextMatch
+
+#endif // TEXTMATCH_H
@@ -0,0 +1,218 @@
+#include "TextOffsetIndex.h"
+#include "GapBuffer.h"
+#include <algorithm>
+
+namespace {
+bool isHighSurrogate(char16_t c) { return c >= 0xD800 && c <= 0xDBFF; }
+bool isLowSurrogate(char16_t c) { return c >= 0xDC00 && c <= 0xDFFF; }
+}
+
+TextOffsetIndex::Counts &TextOffsetIndex::Counts::operator+=(const Counts &other)
+{
+    units += other.units;
+    codePoints += other.codePoints;
+    bytes += other.bytes;
+    lines += other.lines;
+    return *this;
+}
+
+TextOffsetIndex::Counts &TextOffsetIndex::Counts::operator-=(const Counts &other)
+{
+    units -= other.units;
+    codePoints -= other.codePoints;
+    bytes -= other.bytes;
+    lines -= other.lines;
+    return *this;
+}
+
+TextOffsetIndex::Counts TextOffsetIndex::count(const GapBuffer &text, size_t offset, size_t length)
+{
+    Counts counts;
+    const std::u16string_view parts[2] = {text.before(), text.after()};
+    size_t partStart = 0;
+    for (const std::u16string_view &part : parts) {
+        const size_t from = std::max(offset, partStart);
+        const size_t to = std::min(offset + length, partStart + part.size());
+        for (size_t i = from; i < to; ++i) {
+            counts += weight(part[i - partStart]);
+        }
+        partStart += part.size();
+    }
+    return counts;
+}
+
+void TextOffsetIndex::reset(const GapBuffer &text)
+{
+    chunks.clear();
+    for (size_t offset = 0; offset < text.size(); offset += ChunkUnits) {
+        chunks.push_back(count(text, offset, std::min(ChunkUnits, text.size() - offset)));
+    }
+    if (chunks.empty()) {
+        chunks.emplace_back();
+    }
+    rebuildTree();
+}
+
+void TextOffsetIndex::clear()
+{
+    std::vector<Counts>().swap(chunks);
+    std::vector<Counts>().swap(tree);
+    totals = Counts();
+}
+
+void TextOffsetIndex::rebuildTree()
+{
+    // Fenwick 木を O(n) で組み立てる
+    const size_t n = chunks.size();
+    tree.assign(n + 1, Counts());
+    totals = Counts();
+    for (size_t i = 1; i <= n; ++i) {
+        tree[i] += chunks[i - 1];
+        totals += chunks[i - 1];
+        const size_t parent = i + (i & (~i + 1));
+        if (parent <= n) {
+            tree[parent] += tree[i];
+        }
+    }
+}
+
+void TextOffsetIndex::add(size_t chunk, const Counts &delta, bool subtract)
+{
+    if (subtract) {
+        chunks[chunk] -= delta;
+        totals -= delta;
+    } else {
+        chunks[chunk] += delta;
+        totals += delta;
+    }
+    for (size_t i = chunk + 1; i < tree.size(); i += i & (~i + 1)) {
+        if (subtract) {
+            tree[i] -= delta;
+        } else {
+            tree[i] += delta;
+        }
+    }
+}
+
+size_t TextOffsetIndex::locate(Unit unit, size_t offset, Counts &before, bool beforeOffset) const
+{
+    // 手前までの長さが offset 以下（beforeOffset なら未満）になる最後のチャンクを木の上から降りて探す
+    const size_t n = chunks.size();
+    size_t position = 0;
+    Counts accumulated;
+    size_t step = 1;
+    while (step * 2 <= n) step *= 2;
+    for (; step > 0; step /= 2) {
+        if (position + step <= n) {
+            Counts next = accumulated;
+            next += tree[position + step];
+            if (beforeOffset ? next.get(unit) < offset : next.get(unit) <= offset) {
+                position += step;
+                accumulated = next;
+            }
+        }
+    }
+    if (position >= n) {
+        // 末尾の位置は最後のチャンクに含める
+        position = n - 1;
+        accumulated -= chunks[position];
+    }
+    before = accumulated;
+    return position;
+}
+
+size_t TextOffsetIndex::convert(const GapBuffer &text, size_t offset, Unit from, Unit to) const
+{
+    if (chunks.empty()) return 0;
+    offset = std::min(offset, totals.get(from));
+    if (from == to) return offset;
+
+    // 行の区切りのように長さ 0 のチャンクが続く単位でも、offset に届く最初のチャンクから数える
+    Counts counts;
+    locate(from, offset, counts, true);
+    size_t position = counts.units;
+    if (from == Utf16) {
+        counts += count(text, position, offset - position);
+        position = offset;
+    } else {
+        // ギャップの前後の区間を直接走査する（1単位ずつ at() を呼ばない）
+        const std::u16string_view parts[2] = {text.before(), text.after()};
+        size_t partStart = 0;
+        for (const std::u16string_view &part : parts) {
+            const size_t partEnd = partStart + part.size();
+            while (counts.get(from) < offset && position < partEnd) {
+                counts += weight(part[position - partStart]);
+                ++position;
+            }
+            partStart = partEnd;
+        }
+    }
+    // サロゲートペアの間では止まらない
+    if (position > 0 && position < text.size()
+        && isLowSurrogate(text.at(position)) && isHighSurrogate(text.at(position - 1))) {
+        counts += weight(text.at(position));
+    }
+    return counts.get(to);
+}
+
+void TextOffsetIndex::remove(const GapBuffer &text, size_t offset, size_t count)
+{
+    if (chunks.empty()) return;
+    offset = std::min(offset, totals.units);
+    count = std::min(count, totals.units - offset);
+
+    // 索引からは取り除いた分だけ詰め、本文（変更前）は textOffset から読む
+    size_t textOffset = offset;
+    bool emptied = false;
+    while (count > 0) {
+        Counts before;
+        const size_t chunk = locate(Utf16, offset, before);
+        const size_t inChunk = std::min(count, before.units + chunks[chunk].units - offset);
+        add(chunk, this->count(text, textOffset, inChunk), true);
+        emptied = emptied || chunks[chunk].units == 0;
+        textOffset += inChunk;
+        count -= inChunk;
+    }
+    if (emptied) {
+        removeEmptyChunks();
+    }
+}
+
+void TextOffsetIndex::insert(const GapBuffer &text, size_t offset, size_t count)
+{
+    if (chunks.empty()) {
+        reset(text);
+        return;
+    }
+    if (count == 0) return;
+
+    Counts before;
+    const size_t chunk = locate(Utf16, std::min(offset, totals.units), before);
+    add(chunk, this->count(text, offset, count), false);
+    if (chunks[chunk].units > 2 * ChunkUnits) {
+        splitChunk(text, chunk, before.units);
+    }
+}
+
+void TextOffsetIndex::splitChunk(const GapBuffer &text, size_t chunk, size_t start)
+{
+    std::vector<Counts> pieces;
+    const size_t length = chunks[chunk].units;
+    for (size_t offset = 0; offset < length; offset += ChunkUnits) {
+        pieces.push_back(count(text, start + offset, std::min(ChunkUnits, length - offset)));
+    }
+    chunks.erase(chunks.begin() + std::ptrdiff_t(chunk));
+    chunks.insert(chunks.begin() + std::ptrdiff_t(chunk), pieces.begin(), pieces.end());
+    rebuildTree();
+}
+
+void TextOffsetIndex::removeEmptyChunks()
+{
+    chunks.erase(std::remove_if(chunks.begin(), chunks.end(),
+                                [](const Counts &counts) { return counts.units == 0; }),
+                 chunks.end());
+    if (chunks.empty()) {
+        chunks.emplace_back();
+    }
+    rebuildTree();
+}
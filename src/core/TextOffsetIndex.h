@@ -0,0 +1,83 @@
+#ifndef TEXTOFFSETINDEX_H
+#define TEXTOFFSETINDEX_H
+
+#include <cstddef>
+#include <vector>
+
+class GapBuffer;
+
+// UTF-16 単位・コードポイント・UTF-8 バイト・行の位置を相互に変換する索引（Qt非依存）
+// 文書をおよそ ChunkUnits 単位のチャンクに分け、チャンクごとの4種類の長さを
+// Fenwick 木で持つ。変換はチャンクの特定に O(log n)、チャンク内の走査に O(ChunkUnits)
+// 編集は触れたチャンクだけを数え直す（本文は GapBuffer を参照し、索引自体は持たない）
+class TextOffsetIndex
+{
+public:
+    enum Unit {
+        Utf16,
+        CodePoints,
+        Utf8,
+        Lines       // 改行（LF）の数。Lines への変換は行番号、Lines からの変換は行頭の位置
+    };
+
+    struct Counts {
+        size_t units = 0;
+        size_t codePoints = 0;
+        size_t bytes = 0;
+        size_t lines = 0;
+
+        size_t get(Unit unit) const
+        {
+            return unit == Utf16 ? units : unit == CodePoints ? codePoints : unit == Utf8 ? bytes : lines;
+        }
+        Counts &operator+=(const Counts &other);
+        Counts &operator-=(const Counts &other);
+    };
+
+    static constexpr size_t ChunkUnits = 1024;
+
+    // text 全体から作り直す
+    void reset(const GapBuffer &text);
+    // 索引を捨ててメモリを返す（使う前に reset で作り直す）
+    void clear();
+    // 編集の前に [offset, offset + count) を取り除く（text は変更前のもの）
+    void remove(const GapBuffer &text, size_t offset, size_t count);
+    // 編集の後に [offset, offset + count) を加える（text は変更後のもの）
+    void insert(const GapBuffer &text, size_t offset, size_t count);
+
+    Counts total() const { return totals; }
+    // offset（from 単位）を to 単位に変換する。文字の途中を指す位置は次の文字の境界に丸める
+    size_t convert(const GapBuffer &text, size_t offset, Unit from, Unit to) const;
+    size_t memoryBytes() const { return (chunks.capacity() + tree.capacity()) * sizeof(Counts); }
+
+    // 1単位の長さ。サロゲートペアは上位側に1コードポイント・4バイトを数え、下位側は 0 とする
+    // こうすると長さが単位ごとの和になり、チャンクの境界がペアを分けても合計が合う
+    static Counts weight(char16_t unit)
+    {
+        Counts counts;
+        counts.units = 1;
+        if (unit >= 0xDC00 && unit <= 0xDFFF) {
+            return counts;
+        }
+        counts.codePoints = 1;
+        counts.lines = unit == u'\n' ? 1 : 0;
+        counts.bytes = unit < 0x80 ? 1 : unit < 0x800 ? 2 : unit >= 0xD800 && unit <= 0xDBFF ? 4 : 3;
+        return counts;
+    }
+    static Counts count(const GapBuffer &text, size_t offset, size_t length);
+
+private:
+    // offset（unit 単位）を含むチャンクと、その手前までの長さを求める
+    // beforeOffset なら offset の直前の単位を含むチャンク（長さ 0 のチャンクを飛び越えない）
+    size_t locate(Unit unit, size_t offset, Counts &before, bool beforeOffset = false) const;
+    void add(size_t chunk, const Counts &delta, bool subtract);
+    void splitChunk(const GapBuffer &text, size_t chunk, size_t start);
+    void removeEmptyChunks();
+    void rebuildTree();
+
+    std::vector<Counts> chunks;   // チャンクごとの長さ
+    std::vector<Counts> tree;     // Fenwick 木（1 始まり）
+    Counts totals;
+};
+
+#endif // TEXTOFFSETINDEX_H
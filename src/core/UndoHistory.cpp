@@ -0,0 +1,473 @@
+#include "UndoHistory.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+const size_t ChunkCharacters = 32 * 1024;     // アリーナの1チャンク（64KB）
+const int64_t RunTimeoutMs = 2000;            // これより間隔が空いた入力は別のステップ
+const size_t DefaultLimitBytes = 64 * 1024 * 1024;
+const char Magic[8] = {'W', 'L', 'U', 'N', 'D', 'O', 1, 0};
+
+template <typename T>
+void put(std::string &out, T value)
+{
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void putText(std::string &out, std::u16string_view text)
+{
+    put<uint32_t>(out, uint32_t(text.size()));
+    out.append(reinterpret_cast<const char*>(text.data()), text.size() * sizeof(char16_t));
+}
+
+// 範囲外を読もうとしたら失敗にする読み取り位置
+struct Reader {
+    std::string_view data;
+    size_t pos = 0;
+
+    template <typename T>
+    bool get(T &value)
+    {
+        if (data.size() - pos < sizeof(T)) return false;
+        std::memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+
+    bool getText(std::u16string &text)
+    {
+        uint32_t length = 0;
+        if (!get(length) || (data.size() - pos) / sizeof(char16_t) < length) return false;
+        text.resize(length);
+        std::memcpy(&text[0], data.data() + pos, length * sizeof(char16_t));
+        pos += length * sizeof(char16_t);
+        return true;
+    }
+};
+}
+
+UndoHistory::UndoHistory()
+    : firstChunkIndex(0)
+    , chunkBytes(0)
+    , spillLost(false)
+    , lost(0)
+    , firstEditIndex(0)
+    , undoCount(0)
+    , nextSerial(1)
+    , evictedSerial(0)
+    , runOpen(false)
+    , limit(DefaultLimitBytes)
+{
+}
+
+UndoHistory::SpillFile::~SpillFile()
+{
+    std::remove(path.c_str());
+}
+
+bool UndoHistory::SpillFile::write()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (reclaimed || written) return false;
+
+    std::FILE *file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = true;
+    for (const std::u16string &chunk : chunks) {
+        ok = ok && std::fwrite(chunk.data(), sizeof(char16_t), chunk.size(), file) == chunk.size();
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) return false;   // 書きかけのファイルは SpillFile と一緒に消える
+
+    std::deque<std::u16string>().swap(chunks);
+    written = true;
+    return true;
+}
+
+size_t UndoHistory::spill(const std::string &path)
+{
+    const size_t freed = chunkBytes;
+    const std::function<bool()> write = beginSpill(path);
+    if (!write) return 0;
+    if (!write()) {
+        ensureLoaded();   // 書けなかったアリーナを戻す
+        return 0;
+    }
+    return freed;
+}
+
+std::function<bool()> UndoHistory::beginSpill(const std::string &path)
+{
+    if (spilled || chunkBytes == 0) return {};
+
+    const std::shared_ptr<SpillFile> file = std::make_shared<SpillFile>();
+    file->path = path;
+    for (std::u16string &chunk : chunks) {
+        file->lengths.push_back(chunk.size());
+        file->chunks.emplace_back();
+        file->chunks.back().swap(chunk);
+    }
+    chunkBytes = 0;
+    spilled = file;
+    return [file]() { return file->write(); };
+}
+
+void UndoHistory::ensureLoaded() const
+{
+    if (!spilled) return;
+
+    const std::shared_ptr<SpillFile> file = std::move(spilled);
+    std::lock_guard<std::mutex> lock(file->mutex);
+    chunkBytes = 0;
+    if (!file->written) {
+        // まだ書いていない（書けなかった）アリーナは読み直さずに戻す
+        file->reclaimed = true;
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            chunks[i].swap(file->chunks[i]);
+            chunkBytes += chunks[i].capacity() * sizeof(char16_t);
+        }
+        return;
+    }
+    std::FILE *in = std::fopen(file->path.c_str(), "rb");
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        std::u16string &chunk = chunks[i];
+        chunk.reserve(std::max(ChunkCharacters, file->lengths[i]));
+        chunk.resize(file->lengths[i]);
+        if (!in || std::fread(&chunk[0], sizeof(char16_t), chunk.size(), in) != chunk.size()) {
+            spillLost = true;
+        }
+        chunkBytes += chunk.capacity() * sizeof(char16_t);
+    }
+    if (in) std::fclose(in);
+}
+
+void UndoHistory::reloadSpilled()
+{
+    ensureLoaded();
+    if (spillLost) {
+        clear();
+        ++lost;
+    }
+}
+
+void UndoHistory::setMemoryLimit(size_t bytes)
+{
+    reloadSpilled();
+    limit = bytes;
+    enforceLimit();
+}
+
+size_t UndoHistory::memoryUsage() const
+{
+    return chunkBytes + edits.size() * sizeof(Edit) + steps.size() * sizeof(Step);
+}
+
+uint64_t UndoHistory::stateId() const
+{
+    return undoCount > 0 ? steps[undoCount - 1].serial : evictedSerial;
+}
+
+UndoHistory::TextRef UndoHistory::store(std::u16string_view text)
+{
+    ensureLoaded();
+    TextRef ref;
+    if (text.empty()) {
+        // 空文字列は参照順序を保つため末尾チャンクの番号だけ持つ
+        ref.chunk = firstChunkIndex + (chunks.empty() ? 0 : chunks.size() - 1);
+        return ref;
+    }
+
+    if (chunks.empty() || chunks.back().size() + text.size() > chunks.back().capacity()) {
+        // 大きな文字列は専用のチャンクに入れる
+        chunks.emplace_back();
+        chunks.back().reserve(std::max(ChunkCharacters, text.size()));
+        chunkBytes += chunks.back().capacity() * sizeof(char16_t);
+    }
+
+    std::u16string &chunk = chunks.back();
+    ref.chunk = firstChunkIndex + chunks.size() - 1;
+    ref.offset = uint32_t(chunk.size());
+    ref.length = uint32_t(text.size());
+    chunk.append(text);
+    return ref;
+}
+
+bool UndoHistory::extendTail(TextRef &ref, std::u16string_view text)
+{
+    // 末尾チャンクの最後の文字列なら、その場で延長できる
+    ensureLoaded();
+    if (chunks.empty() || ref.length == 0) return false;
+    std::u16string &chunk = chunks.back();
+    if (ref.chunk != firstChunkIndex + chunks.size() - 1
+        || ref.offset + ref.length != chunk.size()
+        || chunk.size() + text.size() > chunk.capacity()) {
+        return false;
+    }
+    chunk.append(text);
+    ref.length += uint32_t(text.size());
+    return true;
+}
+
+std::u16string_view UndoHistory::text(const TextRef &ref) const
+{
+    if (ref.length == 0) return std::u16string_view();
+    ensureLoaded();
+    const std::u16string &chunk = chunks[size_t(ref.chunk - firstChunkIndex)];
+    return std::u16string_view(chunk).substr(ref.offset, ref.length);
+}
+
+void UndoHistory::record(int64_t position, std::u16string_view removed, std::u16string_view inserted,
+                         Kind kind, int64_t timeMs)
+{
+    if (removed.empty() && inserted.empty()) return;
+    reloadSpilled();
+    truncateRedo();
+
+    Step *last = (runOpen && !steps.empty()) ? &steps.back() : nullptr;
+    bool merge = last && kind != Other && last->kind == kind && timeMs - last->time <= RunTimeoutMs;
+    Edit *previous = merge ? &edits.back() : nullptr;
+
+    if (merge && kind == Typing) {
+        // 直前の入力の直後に続く入力だけまとめる
+        merge = previous->position + previous->inserted.length == position;
+        if (merge && extendTail(previous->inserted, inserted)) {
+            last->time = timeMs;
+            enforceLimit();
+            return;
+        }
+    } else if (merge && kind == Deleting) {
+        const bool forward = position == previous->position;                              // Delete
+        const bool backward = position + int64_t(removed.size()) == previous->position;   // BackSpace
+        merge = forward || backward;
+        if (forward && extendTail(previous->removed, removed)) {
+            last->time = timeMs;
+            enforceLimit();
+            return;
+        }
+    }
+
+    Edit edit;
+    edit.position = position;
+    edit.removed = store(removed);
+    edit.inserted = store(inserted);
+    edits.push_back(edit);
+
+    if (merge) {
+        last->editCount++;
+        last->time = timeMs;
+    } else {
+        Step step;
+        step.serial = nextSerial++;
+        step.firstEdit = firstEditIndex + edits.size() - 1;
+        step.editCount = 1;
+        step.kind = kind;
+        step.time = timeMs;
+        steps.push_back(step);
+        undoCount = steps.size();
+    }
+    runOpen = true;
+    enforceLimit();
+}
+
+std::vector<UndoHistory::Change> UndoHistory::changesOf(const Step &step) const
+{
+    std::vector<Change> changes;
+    changes.reserve(step.editCount);
+    for (uint32_t i = 0; i < step.editCount; ++i) {
+        const Edit &e = edit(step.firstEdit + i);
+        changes.push_back(Change{e.position, text(e.removed), text(e.inserted)});
+    }
+    return changes;
+}
+
+std::vector<UndoHistory::Change> UndoHistory::undo()
+{
+    reloadSpilled();
+    if (!canUndo()) return {};
+    runOpen = false;
+    --undoCount;
+    return changesOf(steps[undoCount]);
+}
+
+std::vector<UndoHistory::Change> UndoHistory::redo()
+{
+    reloadSpilled();
+    if (!canRedo()) return {};
+    runOpen = false;
+    ++undoCount;
+    return changesOf(steps[undoCount - 1]);
+}
+
+void UndoHistory::clear()
+{
+    spilled.reset();
+    spillLost = false;
+    chunks.clear();
+    firstChunkIndex = 0;
+    chunkBytes = 0;
+    edits.clear();
+    firstEditIndex = 0;
+    evictedSerial = steps.empty() ? evictedSerial : nextSerial - 1;
+    steps.clear();
+    undoCount = 0;
+    runOpen = false;
+}
+
+void UndoHistory::truncateRedo()
+{
+    if (!canRedo()) return;
+
+    while (steps.size() > undoCount) {
+        const Step &step = steps.back();
+        for (uint32_t i = 0; i < step.editCount; ++i) {
+            edits.pop_back();
+        }
+        steps.pop_back();
+    }
+    releaseTrailingChunks();
+}
+
+void UndoHistory::enforceLimit()
+{
+    // 取り消し可能なステップを古い順に捨てる（やり直し側と、最新の取り消し可能なステップは残す）
+    bool evicted = false;
+    while (memoryUsage() > limit && undoCount > 1) {
+        const Step &step = steps.front();
+        for (uint32_t i = 0; i < step.editCount; ++i) {
+            edits.pop_front();
+        }
+        firstEditIndex += step.editCount;
+        evictedSerial = step.serial;
+        steps.pop_front();
+        --undoCount;
+        evicted = true;
+        releaseLeadingChunks();
+    }
+    if (evicted && steps.empty()) {
+        runOpen = false;
+    }
+}
+
+void UndoHistory::releaseLeadingChunks()
+{
+    ensureLoaded();
+    if (edits.empty()) {
+        chunks.clear();
+        firstChunkIndex = 0;
+        chunkBytes = 0;
+        return;
+    }
+
+    // 残っている最も古い編集より前のチャンクは参照されない（空文字列はチャンクを参照しない）
+    const Edit &oldest = edits.front();
+    const uint64_t keepFrom = oldest.removed.length == 0 ? oldest.inserted.chunk
+                            : oldest.inserted.length == 0 ? oldest.removed.chunk
+                            : std::min(oldest.removed.chunk, oldest.inserted.chunk);
+    while (!chunks.empty() && firstChunkIndex < keepFrom) {
+        chunkBytes -= chunks.front().capacity() * sizeof(char16_t);
+        chunks.pop_front();
+        ++firstChunkIndex;
+    }
+}
+
+void UndoHistory::releaseTrailingChunks()
+{
+    ensureLoaded();
+    if (edits.empty()) {
+        chunks.clear();
+        firstChunkIndex = 0;
+        chunkBytes = 0;
+        return;
+    }
+
+    const Edit &newest = edits.back();
+    const uint64_t keepTo = std::max(newest.removed.chunk, newest.inserted.chunk);
+    while (!chunks.empty() && firstChunkIndex + chunks.size() - 1 > keepTo) {
+        chunkBytes -= chunks.back().capacity() * sizeof(char16_t);
+        chunks.pop_back();
+    }
+
+    // 末尾チャンクの未参照部分は次の記録で再利用する
+    if (!chunks.empty() && firstChunkIndex + chunks.size() - 1 == keepTo) {
+        size_t end = 0;
+        for (const TextRef *ref : {&newest.removed, &newest.inserted}) {
+            if (ref->length > 0 && ref->chunk == keepTo) {
+                end = std::max(end, size_t(ref->offset + ref->length));
+            }
+        }
+        chunks.back().resize(end);
+    }
+}
+
+std::string UndoHistory::serialize() const
+{
+    ensureLoaded();
+    if (spillLost) return UndoHistory().serialize();
+
+    std::string out(Magic, sizeof(Magic));
+    put<uint64_t>(out, nextSerial);
+    put<uint64_t>(out, evictedSerial);
+    put<uint64_t>(out, steps.size());
+    put<uint64_t>(out, undoCount);
+
+    for (const Step &step : steps) {
+        put<uint64_t>(out, step.serial);
+        put<uint8_t>(out, step.kind);
+        put<int64_t>(out, step.time);
+        put<uint32_t>(out, step.editCount);
+        for (uint32_t i = 0; i < step.editCount; ++i) {
+            const Edit &e = edit(step.firstEdit + i);
+            put<int64_t>(out, e.position);
+            putText(out, text(e.removed));
+            putText(out, text(e.inserted));
+        }
+    }
+    return out;
+}
+
+bool UndoHistory::deserialize(std::string_view data)
+{
+    Reader reader{data};
+    if (data.size() < sizeof(Magic) || std::memcmp(data.data(), Magic, sizeof(Magic)) != 0) {
+        return false;
+    }
+    reader.pos = sizeof(Magic);
+
+    uint64_t serial = 0, evicted = 0, stepCount = 0, undone = 0;
+    if (!reader.get(serial) || !reader.get(evicted) || !reader.get(stepCount) || !reader.get(undone)
+        || undone > stepCount) {
+        return false;
+    }
+
+    UndoHistory loaded;
+    loaded.limit = limit;
+    std::u16string removed, inserted;
+    for (uint64_t s = 0; s < stepCount; ++s) {
+        Step step;
+        uint8_t kind = 0;
+        if (!reader.get(step.serial) || !reader.get(kind) || !reader.get(step.time)
+            || !reader.get(step.editCount) || step.editCount == 0) {
+            return false;
+        }
+        step.kind = Kind(kind);
+        step.firstEdit = loaded.edits.size();
+        for (uint32_t i = 0; i < step.editCount; ++i) {
+            Edit e;
+            if (!reader.get(e.position) || !reader.getText(removed) || !reader.getText(inserted)) {
+                return false;
+            }
+            e.removed = loaded.store(removed);
+            e.inserted = loaded.store(inserted);
+            loaded.edits.push_back(e);
+        }
+        loaded.steps.push_back(step);
+    }
+    loaded.undoCount = size_t(undone);
+    loaded.nextSerial = serial;
+    loaded.evictedSerial = evicted;
+
+    *this = std::move(loaded);
+    enforceLimit();
+    return true;
+}
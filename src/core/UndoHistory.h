@@ -0,0 +1,146 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 差分（位置・削除文字列・挿入文字列）だけを持つ軽量な取り消し履歴（Qt非依存）
+// ・文字列はチャンク単位のアリーナにまとめて格納し、編集ごとの確保を避ける
+// ・連続した入力／削除は1つのステップにまとめる
+// ・メモリ上限を超えたら古いステップから捨てる（最新のステップは上限を超えていても残す）
+// ・メモリ不足のときは文字列のアリーナをファイルへ書き出し、次に文字列を使うときに読み戻す
+class UndoHistory
+{
+public:
+    enum Kind : uint8_t {
+        Other = 0,   // 貼り付け・置換など（まとめない）
+        Typing,      // 連続した文字入力
+        Deleting     // 連続した1文字削除（BackSpace / Delete）
+    };
+
+    struct Change {
+        int64_t position;
+        std::u16string_view removed;
+        std::u16string_view inserted;
+    };
+
+    UndoHistory();
+
+    void setMemoryLimit(size_t bytes);
+    size_t memoryLimit() const { return limit; }
+
+    void record(int64_t position, std::u16string_view removed, std::u16string_view inserted,
+                Kind kind, int64_t timeMs);
+    // 次の記録を必ず新しいステップにする
+    void breakRun() { runOpen = false; }
+
+    bool canUndo() const { return undoCount > 0; }
+    bool canRedo() const { return undoCount < steps.size(); }
+
+    // 取り消すステップの変更。逆順に「position から inserted の長さ分を removed に置き換え」て適用する
+    // 返す文字列は次に履歴を変更するまで有効
+    std::vector<Change> undo();
+    // やり直すステップの変更。順に「position から removed の長さ分を inserted に置き換え」て適用する
+    std::vector<Change> redo();
+
+    void clear();
+
+    // 文字列のアリーナを path へ書き出してメモリから外し、減ったバイト数を返す（失敗なら 0）
+    // ステップの構成は残すので canUndo などはそのまま使え、取り消し・やり直し・記録の際に読み戻す
+    // 読み戻せなかったときは履歴を空にする。書き出したファイルは読み戻した時点で消す
+    size_t spill(const std::string &path);
+    // spill の書き込みを別のスレッドで行うための前半。アリーナを履歴から外し、書き込む関数を返す
+    // （書き出すものがなければ空）。返した関数はどのスレッドから呼んでもよく、書けたら true
+    // 書き終わる前に文字列が要ると、書き込みをやめて外したアリーナをそのまま戻す（書き込み中なら待つ）
+    // 外したアリーナは memoryUsage に数えない
+    std::function<bool()> beginSpill(const std::string &path);
+    bool isSpilled() const { return spilled != nullptr; }
+    // 書き出した文字列を読み戻せずに履歴を空にした回数（利用者に知らせるため）
+    uint64_t lostCount() const { return lost; }
+
+    size_t undoDepth() const { return undoCount; }
+    size_t redoDepth() const { return steps.size() - undoCount; }
+    size_t memoryUsage() const;
+
+    // 現在の状態を表す番号（保存した時点の状態との比較に使う）
+    uint64_t stateId() const;
+
+    std::string serialize() const;
+    bool deserialize(std::string_view data);
+
+private:
+    struct TextRef {
+        uint64_t chunk = 0;
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    struct Edit {
+        int64_t position;
+        TextRef removed;
+        TextRef inserted;
+    };
+
+    struct Step {
+        uint64_t serial;
+        uint64_t firstEdit;   // edits の通し番号
+        uint32_t editCount;
+        Kind kind;
+        int64_t time;
+    };
+
+    // 書き込みの関数と履歴が共有する。mutex の下で書き込みと取り戻しを排他にする
+    struct SpillFile {
+        std::mutex mutex;
+        std::string path;
+        std::vector<size_t> lengths;        // チャンクごとの文字数
+        std::deque<std::u16string> chunks;  // 書き終えるまで持つ外したアリーナ
+        bool written = false;
+        bool reclaimed = false;
+        bool write();
+        ~SpillFile();
+    };
+
+    // 書き出したアリーナを読み戻す（文字列を参照する処理の先頭で呼ぶ）
+    void ensureLoaded() const;
+    // 読み戻し、読み戻せなかったら履歴を空にする
+    void reloadSpilled();
+
+    TextRef store(std::u16string_view text);
+    bool extendTail(TextRef &ref, std::u16string_view text);
+    std::u16string_view text(const TextRef &ref) const;
+    const Edit &edit(uint64_t index) const { return edits[size_t(index - firstEditIndex)]; }
+    std::vector<Change> changesOf(const Step &step) const;
+
+    void truncateRedo();
+    void enforceLimit();
+    void releaseLeadingChunks();
+    void releaseTrailingChunks();
+
+    // 書き出し中は chunks の各要素が空になる（読み戻しは const な参照からも行う）
+    mutable std::deque<std::u16string> chunks;
+    uint64_t firstChunkIndex;
+    mutable size_t chunkBytes;
+    mutable std::shared_ptr<SpillFile> spilled;
+    mutable bool spillLost;
+    uint64_t lost;
+
+    std::deque<Edit> edits;
+    uint64_t firstEditIndex;
+
+    std::deque<Step> steps;
+    size_t undoCount;          // steps[0, undoCount) が取り消し可能、残りはやり直し可能
+    uint64_t nextSerial;
+    uint64_t evictedSerial;    // 捨てた最後のステップの番号
+    bool runOpen;
+    size_t limit;
+};
+
+#endif // UNDOHISTORY_H
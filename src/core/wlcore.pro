@@ -0,0 +1,20 @@
+# 編集コア（Qt非依存の静的ライブラリ）
+TEMPLATE = lib
+TARGET = wlcore
+CONFIG += staticlib c++17
+CONFIG -= qt
+
+SOURCES += \
+    GapBuffer.cpp \
+    UndoHistory.cpp \
+    TextOffsetIndex.cpp \
+    TextMatch.cpp \
+    TextFile.cpp
+
+HEADERS += \
+    GapBuffer.h \
+    UndoHistory.h \
+    TextOffsetIndex.h \
+    TextMatch.h \
+    TextFile.h \
+    MemoryPressure.h
@@ -2,6 +2,12 @@
 #include <QIcon>
 #include <QFile>
 #include "MainWindow.h"
+#include "StartupProfiler.h"
+#include "SingleInstance.h"
+#include "BatchProcessor.h"
+#include "Metrics.h"
+#include <QCoreApplication>
+#include <cstring>
 
 #ifdef Q_OS_ANDROID
 #include <QDir>
@@ -10,7 +16,27 @@
 
 int main(int argc, char *argv[])
 {
+    // 起動プロファイル指定はQApplication生成前に確認する（生成時間も計測対象）
+    bool batch = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--startup-profile") == 0) {
+            StartupProfiler::start();
+        } else if (std::strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        }
+    }
+    
+    // バッチモードは画面を使わない（QCoreApplicationのみ、単一インスタンスも使わない）
+    if (batch) {
+        QCoreApplication app(argc, argv);
+        app.setApplicationName("WLEditor");
+        app.setApplicationVersion("1.3.0");
+        app.setOrganizationName("WLEditor");
+        return BatchProcessor::run(app.arguments().mid(1));
+    }
+    
     QApplication app(argc, argv);
+    StartupProfiler::mark("QApplication");
     
     app.setApplicationName("WLEditor");
     app.setApplicationVersion("1.3.0");
@@ -70,17 +96,54 @@ int main(int argc, char *argv[])
     );
 #endif
     
-    MainWindow window;
+    // コマンドライン引数のファイル（--で始まるオプションは除く）
+    const QStringList args = app.arguments().mid(1);
+    QStringList files;
+    QString keyRecordingPath;
+    QString metricsTarget;
+    int metricsInterval = 15;
+    for (int i = 0; i < args.size(); ++i) {
+        if (args.at(i) == "--record-keys" && i + 1 < args.size()) {
+            keyRecordingPath = args.at(++i);
+        } else if (args.at(i) == "--metrics-out" && i + 1 < args.size()) {
+            metricsTarget = args.at(++i);
+        } else if (args.at(i) == "--metrics-interval" && i + 1 < args.size()) {
+            metricsInterval = args.at(++i).toInt();
+        } else if (!args.at(i).startsWith("--")) {
+            files << args.at(i);
+        }
+    }
     
-    // コマンドライン引数でファイルが指定された場合
-    if (argc > 1) {
-        QString fileName = argv[1];
-        if (QFile::exists(fileName)) {
-            window.openFileFromArgs(fileName);
+    // 既に起動しているプロセスがあればファイルを渡して終了（キーの記録中は自分で開く）
+    SingleInstance instance;
+    if (!args.contains("--new-instance") && keyRecordingPath.isEmpty()) {
+        if (SingleInstance::sendToRunningInstance(files)) {
+            return 0;
+        }
+        // 持ち主が起動途中で応答しなかった場合に備えて1回だけやり直し、だめなら単独で動く
+        if (!instance.listen() && SingleInstance::sendToRunningInstance(files)) {
+            return 0;
         }
     }
+    StartupProfiler::mark("single instance");
+    
+    // 計測値の定期的な書き出し（Prometheus のテキスト形式。unix:PATH ならソケットへ）
+    if (!metricsTarget.isEmpty()) {
+        Metrics::startExport(metricsTarget, metricsInterval);
+    }
     
-    window.show();
+    // --record-keys は最初のウィンドウのキー操作を記録する
+    MainWindow *first = MainWindow::openWindow(files.value(0));
+    if (!keyRecordingPath.isEmpty()) {
+        first->recordKeys(keyRecordingPath);
+    }
+    for (int i = 1; i < files.size(); ++i) {
+        MainWindow::openWindow(files.at(i));
+    }
+    StartupProfiler::mark("show");
     
-    return app.exec();
+    const int result = app.exec();
+    // 終了時にもう1回書き出してからスレッドを止める
+    Metrics::stopExport();
+    return result;
 }
\ No newline at end of file
@@ -0,0 +1,353 @@
+// Android 版編集コア（AndroidTextEditor / DeltaEncoder）のホスト上のテスト
+// 端末なしで JNI 層の下を確かめる。失敗した検査を表示し、1つでもあれば 1 を返す
+#include "../src/AndroidTextEditor.h"
+#include "MemoryPressure.h"
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while (0)
+
+struct Recorded {
+    size_t offset;
+    size_t removed;
+    std::u16string inserted;
+};
+
+void testEditsReportDeltas()
+{
+    AndroidTextEditor editor;
+    std::vector<Recorded> log;
+    editor.setDeltaListener([&log](const AndroidTextEditor::Delta &delta) {
+        log.push_back({delta.offset, delta.removed, std::u16string(delta.inserted)});
+    });
+
+    editor.insertText(u"hello");
+    editor.insertText(u" world");
+    CHECK(editor.text(0, editor.length()) == u"hello world");
+    CHECK(editor.cursor() == 11);
+    CHECK(log.size() == 2);
+    CHECK(log[1].offset == 5 && log[1].removed == 0 && log[1].inserted == u" world");
+
+    editor.replace(0, 5, u"HELLO");
+    CHECK(editor.text(0, 5) == u"HELLO");
+    CHECK(log.back().offset == 0 && log.back().removed == 5);
+
+    editor.setCursor(5);
+    editor.deleteChar();
+    CHECK(editor.text(0, editor.length()) == u"HELL world");
+    CHECK(log.back().offset == 4 && log.back().removed == 1 && log.back().inserted.empty());
+
+    // 何も変わらない編集は通知しない
+    const size_t count = log.size();
+    editor.replace(3, 0, u"");
+    CHECK(log.size() == count);
+}
+
+void testDeleteSurrogatePair()
+{
+    AndroidTextEditor editor;
+    editor.insertText(u"a\U0001F600");
+    CHECK(editor.length() == 3);
+    editor.deleteChar();
+    CHECK(editor.length() == 1);
+    CHECK(editor.text(0, 1) == u"a");
+}
+
+void testRangeRead()
+{
+    AndroidTextEditor editor;
+    editor.setText(u"0123456789");
+    // ギャップを途中に置いてから、ギャップをまたぐ範囲を読む
+    editor.setCursor(4);
+    editor.insertText(u"x");
+    char16_t out[8] = {};
+    CHECK(editor.copyText(2, 5, out) == 5);
+    CHECK(std::u16string(out, 5) == u"23x45");
+    CHECK(editor.copyText(9, 100, out) == 2);
+    CHECK(std::u16string(out, 2) == u"89");
+}
+
+void testDeltaEncoder()
+{
+    alignas(4) unsigned char buffer[64];
+    DeltaEncoder encoder;
+    encoder.attach(buffer, sizeof(buffer));
+
+    const std::u16string text = u"abc";
+    encoder.append(AndroidTextEditor::Delta{7, 2, text});
+    CHECK(!encoder.overflowed());
+    CHECK(encoder.size() == DeltaEncoder::HeaderBytes + 8);   // 3単位 = 6バイト → 8バイトに詰める
+
+    int32_t header[4];
+    std::memcpy(header, buffer, sizeof(header));
+    CHECK(header[0] == 7 && header[1] == 2 && header[2] == 3);
+    CHECK(header[3] == DeltaEncoder::InlineText);
+    CHECK(std::memcmp(buffer + DeltaEncoder::HeaderBytes, text.data(), 6) == 0);
+
+    // 入りきらない文字列はヘッダだけ書く
+    const std::u16string large(100, u'z');
+    encoder.append(AndroidTextEditor::Delta{0, 0, large});
+    CHECK(!encoder.overflowed());
+    std::memcpy(header, buffer + 24, sizeof(header));
+    CHECK(header[2] == 100 && header[3] == 0);
+    CHECK(encoder.size() == 40);
+
+    // 範囲読み出しのレコードの後に差分が続けばあふれ（呼び出し後の本文では読めない）
+    encoder.append(AndroidTextEditor::Delta{0, 0, text});
+    CHECK(encoder.overflowed());
+
+    encoder.reset();
+    CHECK(encoder.size() == 0 && !encoder.overflowed());
+
+    // ヘッダも入らなければあふれ
+    encoder.append(AndroidTextEditor::Delta{0, 0, text});
+    encoder.append(AndroidTextEditor::Delta{0, 0, text});
+    encoder.append(AndroidTextEditor::Delta{0, 1, std::u16string()});
+    CHECK(!encoder.overflowed() && encoder.size() == 64);
+    encoder.append(AndroidTextEditor::Delta{0, 1, std::u16string()});
+    CHECK(encoder.overflowed());
+}
+
+// 全文を先頭から数えた、変換の期待値
+size_t referenceConvert(const std::u16string &text, size_t offset, TextOffsetIndex::Unit from,
+                        TextOffsetIndex::Unit to)
+{
+    TextOffsetIndex::Counts counts;
+    size_t position = 0;
+    while (counts.get(from) < offset && position < text.size()) {
+        counts += TextOffsetIndex::weight(text[position++]);
+    }
+    if (position > 0 && position < text.size() && text[position] >= 0xDC00 && text[position] <= 0xDFFF
+        && text[position - 1] >= 0xD800 && text[position - 1] <= 0xDBFF) {
+        counts += TextOffsetIndex::weight(text[position]);
+    }
+    return counts.get(to);
+}
+
+void testOffsetIndex()
+{
+    AndroidTextEditor editor;
+    editor.setText(u"aあ\U0001F600b");
+    // a(1) あ(3) 😀(4) b(1)
+    CHECK(editor.offsetIndex().total().units == 5);
+    CHECK(editor.offsetIndex().total().codePoints == 4);
+    CHECK(editor.offsetIndex().total().bytes == 9);
+    CHECK(editor.convertOffset(2, TextOffsetIndex::Utf16, TextOffsetIndex::Utf8) == 4);
+    CHECK(editor.convertOffset(3, TextOffsetIndex::CodePoints, TextOffsetIndex::Utf16) == 4);
+    CHECK(editor.convertOffset(8, TextOffsetIndex::Utf8, TextOffsetIndex::CodePoints) == 3);
+    // サロゲートペアの間は次の境界へ
+    CHECK(editor.convertOffset(3, TextOffsetIndex::Utf16, TextOffsetIndex::CodePoints) == 3);
+
+    // チャンクの分割・削除をまたぐ無作為な編集のあとも、先頭から数えた値と一致する
+    std::mt19937 random(12345);
+    const char16_t samples[] = {u'x', u'\n', u'あ', u'漢', 0xD83D, 0xDE00, u'é'};
+    std::u16string reference;
+    editor.setText(reference);
+    for (int round = 0; round < 400; ++round) {
+        const size_t offset = reference.empty() ? 0 : random() % (reference.size() + 1);
+        const size_t removed = reference.empty() ? 0 : random() % std::min<size_t>(reference.size() - offset + 1, 3000);
+        std::u16string inserted;
+        const size_t insertedLength = random() % (round % 10 == 0 ? 5000 : 40);
+        for (size_t i = 0; i < insertedLength; ++i) {
+            const char16_t c = samples[random() % (sizeof(samples) / sizeof(samples[0]))];
+            if (c == 0xD83D || c == 0xDE00) {
+                inserted += u"\U0001F600";
+            } else {
+                inserted += c;
+            }
+        }
+        editor.replace(offset, removed, inserted);
+        reference.replace(std::min(offset, reference.size()), removed, inserted);
+    }
+    CHECK(editor.text(0, editor.length()) == reference);
+    const TextOffsetIndex::Counts total = editor.offsetIndex().total();
+    CHECK(total.units == reference.size());
+    for (size_t offset = 0; offset <= total.units; offset += 7) {
+        CHECK(editor.convertOffset(offset, TextOffsetIndex::Utf16, TextOffsetIndex::Utf8)
+              == referenceConvert(reference, offset, TextOffsetIndex::Utf16, TextOffsetIndex::Utf8));
+    }
+    for (size_t offset = 0; offset <= total.codePoints; offset += 5) {
+        CHECK(editor.convertOffset(offset, TextOffsetIndex::CodePoints, TextOffsetIndex::Utf16)
+              == referenceConvert(reference, offset, TextOffsetIndex::CodePoints, TextOffsetIndex::Utf16));
+    }
+    for (size_t offset = 0; offset <= total.bytes; offset += 11) {
+        CHECK(editor.convertOffset(offset, TextOffsetIndex::Utf8, TextOffsetIndex::CodePoints)
+              == referenceConvert(reference, offset, TextOffsetIndex::Utf8, TextOffsetIndex::CodePoints));
+    }
+}
+
+void testGraphemeClusters()
+{
+    AndroidTextEditor editor;
+    // 濁点の結合文字・国旗2つ・ZWJ でつないだ家族の絵文字・CRLF
+    const std::u16string text = u"か\u3099\U0001F1EF\U0001F1F5\U0001F1FA\U0001F1F8"
+                                u"\U0001F468\u200D\U0001F469\u200D\U0001F467\r\ne\u0301";
+    editor.setText(text);
+    std::vector<size_t> stops;
+    for (size_t position = 0; position < editor.length();) {
+        position = editor.nextGrapheme(position);
+        stops.push_back(position);
+    }
+    const std::vector<size_t> expected = {2, 6, 10, 18, 20, 22};
+    CHECK(stops == expected);
+
+    editor.setCursor(editor.length());
+    editor.moveCursor(-2);
+    CHECK(editor.cursor() == 18);
+    editor.deleteChar();   // 家族の絵文字をまとめて削除
+    CHECK(editor.length() == text.size() - 8);
+    CHECK(editor.cursor() == 10);
+    editor.setCursor(0);
+    editor.deleteForward();   // か + 濁点
+    CHECK(editor.text(0, 2) == u"\U0001F1EF");
+    // サロゲートペアの間には置かない
+    editor.setCursor(1);
+    CHECK(editor.cursor() == 2);
+}
+
+void testFileRoundTrip()
+{
+    // 記述子から読み込み、編集して同じ記述子へ書き戻す
+    std::FILE *file = std::tmpfile();
+    CHECK(file != nullptr);
+    if (!file) return;
+    const int fd = fileno(file);
+    CHECK(write(fd, "line1\nこんにちは\n", 22) == 22);
+
+    AndroidTextEditor editor;
+    size_t notified = 0;
+    editor.setDeltaListener([&notified](const AndroidTextEditor::Delta &) { ++notified; });
+    CHECK(editor.loadFile(fd) == 0);
+    CHECK(notified == 0);
+    CHECK(editor.text(0, editor.length()) == u"line1\nこんにちは\n");
+    CHECK(editor.convertOffset(6, TextOffsetIndex::Utf16, TextOffsetIndex::Utf8) == 6);
+    CHECK(editor.convertOffset(1, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 6);
+
+    editor.setCursor(editor.length());
+    editor.insertText(u"end");
+    CHECK(editor.saveFile(fd) == 0);
+    char saved[32] = {};
+    CHECK(pread(fd, saved, sizeof(saved), 0) == 25);
+    CHECK(std::memcmp(saved, "line1\nこんにちは\nend", 25) == 0);
+    std::fclose(file);
+
+    CHECK(editor.loadFile(-1) != 0);
+    CHECK(editor.length() == 15);   // 失敗しても中身は変わらない
+}
+
+void testUndoRedo()
+{
+    AndroidTextEditor editor;
+    std::vector<Recorded> log;
+    editor.setDeltaListener([&log](const AndroidTextEditor::Delta &delta) {
+        log.push_back({delta.offset, delta.removed, std::u16string(delta.inserted)});
+    });
+    editor.insertText(u"a");
+    editor.insertText(u"bc");   // 連続入力は1ステップ
+    editor.replace(0, 1, u"A");
+    CHECK(editor.undo());
+    CHECK(editor.text(0, editor.length()) == u"abc");
+    CHECK(log.back().offset == 0 && log.back().removed == 1 && log.back().inserted == u"a");
+    CHECK(editor.undo());
+    CHECK(editor.length() == 0 && !editor.canUndo());
+    CHECK(!editor.undo());
+    CHECK(editor.redo() && editor.redo());
+    CHECK(editor.text(0, editor.length()) == u"Abc");
+    editor.setText(u"new");
+    CHECK(!editor.canUndo());
+}
+
+void testTrimMemory()
+{
+    AndroidTextEditor editor;
+    editor.setSpillDirectory("/tmp");
+    editor.setText(std::u16string(200000, u'a') + u"\nline2");
+    for (int i = 0; i < 100; ++i) {
+        editor.setCursor(size_t(i) * 1000);
+        editor.insertText(std::u16string(500, u'x'));
+    }
+    const size_t used = editor.memoryBytes();
+
+    // 索引だけ捨て、次の変換で作り直す
+    const size_t indexFreed = editor.onTrimMemory(MemoryPressure::RunningModerate);
+    CHECK(indexFreed > 0 && editor.memoryBytes() == used - indexFreed);
+    CHECK(editor.convertOffset(1, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 200001 + 50000);
+
+    // 画面から外れただけなら索引だけ捨てる
+    const size_t hidden = editor.memoryBytes();
+    const size_t hiddenFreed = editor.onTrimMemory(MemoryPressure::UiHidden);
+    CHECK(hiddenFreed > 0 && hiddenFreed < 64 * 1024 && editor.memoryBytes() == hidden - hiddenFreed);
+    CHECK(editor.convertOffset(1, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 200001 + 50000);
+
+    // 実行中の深刻な不足では、ギャップを詰めて取り消し履歴も書き出す（書き込みは別スレッド）
+    const size_t before = editor.memoryBytes();
+    const size_t freed = editor.onTrimMemory(MemoryPressure::RunningCritical);
+    CHECK(freed > 100000 && editor.memoryBytes() == before - freed);
+    CHECK(editor.memoryBytes() < editor.length() * sizeof(char16_t) + 64 * 1024);
+
+    // 書き出した後も編集・取り消しは普通にできる
+    editor.setCursor(0);
+    editor.insertText(u"z");
+    CHECK(editor.text(0, 2) == u"zx");
+    CHECK(editor.undo() && editor.undo());
+    CHECK(editor.text(0, 2) == u"xx" && editor.length() == 200006 + 99 * 500);
+    CHECK(editor.convertOffset(1, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 200001 + 49500);
+}
+
+void testPressureActions()
+{
+    using namespace MemoryPressure;
+    CHECK(actions(RunningModerate) == ReleaseCaches);
+    CHECK(actions(UiHidden) == ReleaseCaches);
+    CHECK(shouldCompact(RunningLow) && !shouldSpillUndo(RunningLow));
+    CHECK(shouldCompact(Background) && !shouldSpillUndo(Background) && !shouldSpillUndo(Moderate));
+    CHECK(shouldSpillUndo(RunningCritical) && shouldSpillUndo(Complete));
+    CHECK(actions(99) == ReleaseCaches);
+}
+
+void testKeystrokeCostIndependentOfSize()
+{
+    // 大きな文書でも1キーの差分は挿入した分だけ
+    AndroidTextEditor editor;
+    editor.setText(std::u16string(1 << 20, u'a'));
+    unsigned char buffer[256];
+    DeltaEncoder encoder;
+    encoder.attach(buffer, sizeof(buffer));
+    editor.setDeltaListener([&encoder](const AndroidTextEditor::Delta &delta) { encoder.append(delta); });
+    editor.setCursor(12345);
+    encoder.reset();
+    editor.insertText(u"b");
+    CHECK(encoder.size() == DeltaEncoder::HeaderBytes + 4);
+}
+}
+
+int main()
+{
+    testEditsReportDeltas();
+    testDeleteSurrogatePair();
+    testRangeRead();
+    testDeltaEncoder();
+    testOffsetIndex();
+    testGraphemeClusters();
+    testFileRoundTrip();
+    testUndoRedo();
+    testTrimMemory();
+    testPressureActions();
+    testKeystrokeCostIndependentOfSize();
+    if (failures == 0) {
+        std::printf("android_core_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+// バッチ処理（BatchProcessor）のホスト上のテスト
+// 一時ディレクトリにファイルを作って処理し、失敗した検査を表示し、1つでもあれば 1 を返す
+#include "../src/BatchProcessor.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <limits>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while (0)
+
+const QByteArray Bom("\xEF\xBB\xBF");
+
+bool writeFile(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+QByteArray readFile(const QString &path)
+{
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+// script を input に適用し、出力ファイルの内容を返す
+QByteArray process(const QTemporaryDir &dir, const QString &source, const QByteArray &input,
+                   BatchProcessor::Result *result = nullptr)
+{
+    BatchProcessor::Script script;
+    QString error;
+    CHECK(BatchProcessor::parseScript(source, script, error));
+    const QString inputPath = dir.filePath("in.txt");
+    const QString outputPath = dir.filePath("out.txt");
+    CHECK(writeFile(inputPath, input));
+    const BatchProcessor::Result processed = BatchProcessor::processFile(script, inputPath, outputPath, nullptr);
+    CHECK(processed.ok);
+    if (result) *result = processed;
+    return readFile(outputPath);
+}
+
+void testParseScript()
+{
+    BatchProcessor::Script script;
+    QString error;
+    const QString source =
+        "# 注釈だけの行\n"
+        "replace \"a b\" \"x\\ty\" case word\n"
+        "delete-lines 2 $\n"
+        "move-lines 1 2 5\n"
+        "write-lines 3 4 \"{name} part.txt\"\n"
+        "read-file 1 header.txt   # 行末の注釈\n"
+        "input-encoding UTF-16LE\n"
+        "output-encoding UTF-8\n"
+        "eol crlf\n";
+    CHECK(BatchProcessor::parseScript(source, script, error));
+    CHECK(script.operations.size() == 5);
+    if (script.operations.size() == 5) {
+        const BatchProcessor::Operation &replace = script.operations.at(0);
+        CHECK(replace.type == BatchProcessor::Operation::Replace);
+        CHECK(replace.find == "a b" && replace.replacement == "x\ty");
+        CHECK(replace.options.caseSensitive && replace.options.wholeWords);
+        CHECK(replace.scriptLine == 2);
+
+        const BatchProcessor::Operation &remove = script.operations.at(1);
+        CHECK(remove.type == BatchProcessor::Operation::DeleteLines);
+        CHECK(remove.from == 2 && remove.to == std::numeric_limits<qint64>::max());
+
+        const BatchProcessor::Operation &move = script.operations.at(2);
+        CHECK(move.type == BatchProcessor::Operation::MoveLines);
+        CHECK(move.from == 1 && move.to == 2 && move.destination == 5);
+
+        CHECK(script.operations.at(3).type == BatchProcessor::Operation::WriteLines);
+        CHECK(script.operations.at(3).path == "{name} part.txt");
+        CHECK(script.operations.at(4).type == BatchProcessor::Operation::ReadFile);
+        CHECK(script.operations.at(4).destination == 1 && script.operations.at(4).path == "header.txt");
+    }
+    CHECK(script.inputEncoding == "UTF-16LE" && script.outputEncoding == "UTF-8");
+    CHECK(script.eol == "\r\n");
+
+    // 誤りは行番号つきで返す
+    const char *const invalid[] = {
+        "frobnicate 1",
+        "replace \"open",
+        "replace \"\" x",
+        "delete-lines 3 2",
+        "delete-lines 0 1",
+        "move-lines 1 3 2",         // 移動先がブロックの中
+        "move-lines 1 $ 9",
+        "replace a b maybe",
+        "eol cr",
+        "input-encoding no-such-encoding",
+    };
+    for (const char *line : invalid) {
+        BatchProcessor::Script rejected;
+        error.clear();
+        CHECK(!BatchProcessor::parseScript(QString("eol lf\n") + line, rejected, error));
+        CHECK(error.startsWith("line 2: "));
+    }
+}
+
+void testReplaceAndDeleteKeepBom(const QTemporaryDir &dir)
+{
+    BatchProcessor::Result result;
+    const QByteArray output = process(dir, "replace o 0\ndelete-lines 2 2\n",
+                                      Bom + "one\r\ntwo\r\nthree\r\nfour\r\n", &result);
+    // BOM と CRLF と最後の改行は入力のまま
+    CHECK(output == Bom + "0ne\r\nthree\r\nf0ur\r\n");
+    CHECK(result.lines == 3 && result.replacements == 3);
+
+    // BOM のない入力には書かない
+    CHECK(process(dir, "delete-lines 1 1\n", "a\nb") == "b");
+    // Unicode でない出力の符号化では BOM を書けない
+    CHECK(process(dir, "output-encoding ISO-8859-1\n", Bom + "caf\xC3\xA9\n") == "caf\xE9\n");
+    // BOM だけのファイルも BOM だけのまま
+    CHECK(process(dir, "replace a b\n", Bom) == Bom);
+}
+
+void testMoveLines(const QTemporaryDir &dir)
+{
+    // 後ろへ（4行目の前へ）
+    CHECK(process(dir, "move-lines 1 2 4\n", "a\nb\nc\nd\ne") == "c\na\nb\nd\ne");
+    // 前へ（2行目の前へ）
+    CHECK(process(dir, "move-lines 4 5 2\n", "a\nb\nc\nd\ne\n") == "a\nd\ne\nb\nc\n");
+    // 最終行の後ろへ
+    CHECK(process(dir, "move-lines 1 1 $\n", "a\nb\nc\n") == "b\nc\na\n");
+}
+
+void testWriteAndReadLines(const QTemporaryDir &dir)
+{
+    const QString block = dir.filePath("{name}-block.txt");
+    CHECK(process(dir, QString("write-lines 2 3 \"%1\"\n").arg(block), "a\r\nb\r\nc\r\nd\r\n")
+          == "a\r\nb\r\nc\r\nd\r\n");
+    CHECK(readFile(dir.filePath("in-block.txt")) == "b\r\nc\r\n");
+
+    // 読み込むファイルの BOM は本文に入れない
+    const QString header = dir.filePath("header.txt");
+    CHECK(writeFile(header, Bom + "x\ny\n"));
+    CHECK(process(dir, QString("read-file 2 \"%1\"\n").arg(header), "a\nb\n") == "a\nx\ny\nb\n");
+    CHECK(process(dir, QString("read-file $ \"%1\"\n").arg(header), "a\n") == "a\nx\ny\n");
+
+    // 読めないファイルは失敗として返す
+    BatchProcessor::Script script;
+    QString error;
+    CHECK(BatchProcessor::parseScript(QString("read-file 1 \"%1\"\n").arg(dir.filePath("missing.txt")),
+                                      script, error));
+    CHECK(writeFile(dir.filePath("in.txt"), "a\n"));
+    const BatchProcessor::Result result =
+        BatchProcessor::processFile(script, dir.filePath("in.txt"), dir.filePath("out.txt"), nullptr);
+    CHECK(!result.ok && result.error.contains("missing.txt"));
+}
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QTemporaryDir dir;
+    CHECK(dir.isValid());
+
+    testParseScript();
+    testReplaceAndDeleteKeepBom(dir);
+    testMoveLines(dir);
+    testWriteAndReadLines(dir);
+    if (failures == 0) {
+        std::printf("batch_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,278 @@
+// 編集コア（wlcore）のホスト上のテスト
+// 失敗した検査を表示し、1つでもあれば 1 を返す
+#include "GapBuffer.h"
+#include "TextFile.h"
+#include "TextMatch.h"
+#include "TextOffsetIndex.h"
+#include "UndoHistory.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while (0)
+
+std::u16string contents(const GapBuffer &buffer)
+{
+    return buffer.text(0, buffer.size());
+}
+
+void testGapBuffer()
+{
+    GapBuffer buffer;
+    buffer.assign(u"hello world");
+    buffer.replace(5, 0, u",");
+    buffer.replace(0, 1, u"H");
+    buffer.replace(buffer.size(), 0, u"!");
+    CHECK(contents(buffer) == u"Hello, world!");
+    CHECK(buffer.at(7) == u'w');
+    buffer.replace(5, 100, u"");
+    CHECK(contents(buffer) == u"Hello");
+    // ギャップより大きい挿入
+    buffer.replace(2, 0, std::u16string(10000, u'x'));
+    CHECK(buffer.size() == 10005);
+    CHECK(buffer.text(10002, 3) == u"llo");
+
+    // 詰めても中身は変わらず、次の挿入でギャップを確保し直す
+    buffer.replace(5000, 0, u"");
+    CHECK(buffer.compact() > 0);
+    CHECK(buffer.capacityBytes() == buffer.size() * sizeof(char16_t));
+    buffer.replace(5000, 0, u"y");
+    CHECK(buffer.size() == 10006 && buffer.at(5000) == u'y' && buffer.text(10003, 3) == u"llo");
+}
+
+void testUndoHistory()
+{
+    UndoHistory history;
+    history.record(0, u"", u"a", UndoHistory::Typing, 0);
+    history.record(1, u"", u"b", UndoHistory::Typing, 10);
+    history.record(0, u"ab", u"xyz", UndoHistory::Other, 20);
+    CHECK(history.undoDepth() == 2);
+
+    const uint64_t state = history.stateId();
+    std::vector<UndoHistory::Change> changes = history.undo();
+    CHECK(changes.size() == 1);
+    CHECK(changes[0].position == 0 && changes[0].removed == u"ab" && changes[0].inserted == u"xyz");
+    changes = history.undo();
+    CHECK(changes.size() == 1 && changes[0].inserted == u"ab");   // 連続入力は1ステップ
+    CHECK(!history.canUndo() && history.redoDepth() == 2);
+    history.redo();
+    history.redo();
+    CHECK(history.stateId() == state);
+
+    UndoHistory restored;
+    CHECK(restored.deserialize(history.serialize()));
+    CHECK(restored.undoDepth() == 2 && restored.stateId() == state);
+}
+
+void testUndoLimit()
+{
+    UndoHistory history;
+    history.setMemoryLimit(256 * 1024);
+    // 上限より大きなステップでも最新なら取り消せる
+    history.record(0, u"", std::u16string(200000, u'a'), UndoHistory::Other, 0);
+    CHECK(history.undoDepth() == 1 && history.memoryUsage() > 256 * 1024);
+    // 次のステップが入ると古いほうから捨てる
+    history.record(0, u"", u"b", UndoHistory::Other, 10);
+    CHECK(history.undoDepth() == 1 && history.memoryUsage() <= 256 * 1024);
+    std::vector<UndoHistory::Change> changes = history.undo();
+    CHECK(changes.size() == 1 && changes[0].inserted == u"b" && !history.canUndo());
+}
+
+void testUndoSpill()
+{
+    char path[] = "/tmp/wledit_undo_spill_XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    close(fd);
+
+    UndoHistory history;
+    history.record(0, u"", u"first", UndoHistory::Other, 0);
+    history.record(5, u"", std::u16string(50000, u'x'), UndoHistory::Other, 10);
+    history.record(0, u"first", u"1st", UndoHistory::Other, 20);
+    history.undo();
+    const size_t usage = history.memoryUsage();
+    const uint64_t state = history.stateId();
+
+    // 書き出した後も深さ・状態番号はそのまま、取り消すときに読み戻す
+    CHECK(history.spill(path) > 100000);
+    CHECK(history.isSpilled() && history.memoryUsage() < usage);
+    CHECK(history.undoDepth() == 2 && history.redoDepth() == 1 && history.stateId() == state);
+    CHECK(history.spill(path) == 0);   // 書き出し済み
+    std::vector<UndoHistory::Change> changes = history.undo();
+    CHECK(!history.isSpilled() && access(path, F_OK) != 0);
+    CHECK(changes.size() == 1 && changes[0].inserted == std::u16string(50000, u'x'));
+    changes = history.redo();
+    CHECK(changes.size() == 1 && changes[0].position == 5);
+    changes = history.redo();
+    CHECK(changes.size() == 1 && changes[0].removed == u"first" && changes[0].inserted == u"1st");
+
+    // 書き出し中の記録・保存
+    CHECK(history.spill(path) > 0);
+    history.record(0, u"1st", u"one", UndoHistory::Other, 30);
+    CHECK(!history.isSpilled() && history.undoDepth() == 4);
+    CHECK(history.spill(path) > 0);
+    UndoHistory restored;
+    CHECK(restored.deserialize(history.serialize()) && restored.undoDepth() == 4);
+    CHECK(restored.undo()[0].removed == u"1st");
+
+    // 書き込みを後で行う（別スレッドから呼ぶ形）。書く前に文字列が要れば書かずに戻す
+    std::function<bool()> write = history.beginSpill(path);
+    CHECK(write && history.isSpilled() && history.memoryUsage() < usage);
+    CHECK(history.undo()[0].inserted == u"one" && !history.isSpilled());
+    CHECK(!write() && access(path, F_OK) != 0);
+    history.redo();
+    write = history.beginSpill(path);
+    CHECK(write && write() && access(path, F_OK) == 0);
+    write = nullptr;
+    CHECK(history.undo()[0].removed == u"1st" && access(path, F_OK) != 0);
+    history.redo();
+
+    // 読み戻せなければ履歴を空にする
+    CHECK(!history.isSpilled() && history.spill(path) > 0);
+    unlink(path);
+    CHECK(history.undo().empty() && !history.canUndo() && !history.canRedo());
+}
+
+void testLineIndex()
+{
+    GapBuffer buffer;
+    buffer.assign(u"one\ntwo\n\nthree");
+    TextOffsetIndex index;
+    index.reset(buffer);
+    CHECK(index.total().lines == 3);
+    CHECK(index.convert(buffer, 0, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 0);
+    CHECK(index.convert(buffer, 2, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 8);
+    CHECK(index.convert(buffer, 3, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 9);
+    CHECK(index.convert(buffer, 5, TextOffsetIndex::Utf16, TextOffsetIndex::Lines) == 1);
+
+    // 改行のないチャンクが続いても行頭を正しく引ける
+    std::u16string text = u"a\n";
+    text += std::u16string(5 * TextOffsetIndex::ChunkUnits, u'x');
+    text += u"\nb";
+    buffer.assign(text);
+    index.reset(buffer);
+    CHECK(index.convert(buffer, 1, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 2);
+    CHECK(index.convert(buffer, 2, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == text.size() - 1);
+
+    // 編集に追従する
+    index.remove(buffer, 1, 1);
+    buffer.replace(1, 1, u"");
+    CHECK(index.total().lines == 1);
+    buffer.replace(0, 0, u"\n\n");
+    index.insert(buffer, 0, 2);
+    CHECK(index.convert(buffer, 2, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == 2);
+    CHECK(index.convert(buffer, 3, TextOffsetIndex::Lines, TextOffsetIndex::Utf16) == buffer.size() - 1);
+}
+
+void testTextMatch()
+{
+    using TextMatch::indexIn;
+    using Traits = TextMatch::PortableTraits;
+    TextMatch::Options options;
+    CHECK(indexIn<Traits>(u"Hello World", u"world", 0, options) == 6);
+    CHECK(indexIn<Traits>(u"ÄBC äbc", u"äbc", 0, options) == 0);
+    CHECK(indexIn<Traits>(u"ＡＢＣ", u"ａｂｃ", 0, options) == 0);
+    options.caseSensitive = true;
+    CHECK(indexIn<Traits>(u"Hello World", u"world", 0, options) == TextMatch::NoMatch);
+    CHECK(indexIn<Traits>(u"a\u00A0b", u"a b", 0, options) == 0);   // NBSP は空白として照合
+    CHECK(indexIn<Traits>(u"abc abd", u"abd", 1, options) == 4);
+    CHECK(indexIn<Traits>(u"abc", u"bc", 5, options) == TextMatch::NoMatch);
+    CHECK(indexIn<Traits>(u"a\u00A0b", u"a\u00A0b", 0, options) == TextMatch::NoMatch);
+    options.wholeWords = true;
+    CHECK(indexIn<Traits>(u"Cats Cat", u"Cat", 0, options) == 5);
+    options = TextMatch::Options();
+    CHECK(indexIn<Traits>(u"xÀbC", u"àBc", 0, options) == 1);
+
+    options = TextMatch::Options();
+    options.wholeWords = true;
+    CHECK(indexIn<Traits>(u"cat concat cat", u"cat", 1, options) == 11);
+    CHECK(indexIn<Traits>(u"猫cat", u"cat", 0, options) == TextMatch::NoMatch);
+    CHECK(indexIn<Traits>(u"「cat」", u"cat", 0, options) == 1);
+
+    std::u16string line = u"aaa bab aaa";
+    CHECK(TextMatch::replaceAll(line, u"aa", u"x", TextMatch::Options()) == 2);
+    CHECK(line == u"xa bab xa");
+}
+
+std::string readAll(int fd)
+{
+    std::string bytes(size_t(lseek(fd, 0, SEEK_END)), '\0');
+    CHECK(pread(fd, &bytes[0], bytes.size(), 0) == ssize_t(bytes.size()));
+    return bytes;
+}
+
+void testTextFile()
+{
+    GapBuffer buffer;
+    TextFile::decode("a\xC3\xA9\xE3\x81\x82\xF0\x9F\x98\x80", buffer);
+    CHECK(contents(buffer) == u"aéあ\U0001F600");
+    // 不正な列は1バイトごとに U+FFFD（冗長な表現・サロゲート・途中で切れた列）
+    TextFile::decode("\xC0\xAF|\xED\xA0\x80|\xE3\x81", buffer);
+    CHECK(contents(buffer) == u"\uFFFD\uFFFD|\uFFFD\uFFFD\uFFFD|\uFFFD\uFFFD");
+
+    char path[] = "/tmp/wledit_core_test_XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0) return;
+    unlink(path);
+
+    const std::string original = "\xEF\xBB\xBF" "first line\n二行目 \xF0\x9F\x98\x80\n" + std::string(100000, 'x');
+    CHECK(pwrite(fd, original.data(), original.size(), 0) == ssize_t(original.size()));
+    bool bom = false;
+    CHECK(TextFile::load(fd, buffer, &bom) == 0);
+    CHECK(bom);
+    CHECK(buffer.size() == 10 + 1 + 4 + 2 + 1 + 100000);
+    CHECK(buffer.text(0, 5) == u"first");
+
+    // ギャップがサロゲートペアの間にあっても1文字として書く。短くなった分は切り詰める
+    buffer.replace(17, 100001, u"!");
+    buffer.replace(16, 0, u"");
+    CHECK(TextFile::save(fd, buffer, bom) == 0);
+    CHECK(readAll(fd) == "\xEF\xBB\xBF" "first line\n二行目 \xF0\x9F\x98\x80!");
+
+    // 空のファイルと、対になっていないサロゲート
+    buffer.assign(u"");
+    CHECK(TextFile::save(fd, buffer) == 0);
+    CHECK(readAll(fd).empty());
+    CHECK(TextFile::load(fd, buffer) == 0 && buffer.empty());
+    buffer.assign(std::u16string(u"a") + char16_t(0xD800));
+    CHECK(TextFile::save(fd, buffer) == 0);
+    CHECK(readAll(fd) == "a\xEF\xBF\xBD");
+    close(fd);
+
+    // mmap できない記述子（パイプ）は read で読む
+    int pipeFds[2];
+    CHECK(pipe(pipeFds) == 0);
+    CHECK(write(pipeFds[1], "pipe\n", 5) == 5);
+    close(pipeFds[1]);
+    CHECK(TextFile::load(pipeFds[0], buffer) == 0);
+    CHECK(contents(buffer) == u"pipe\n");
+    close(pipeFds[0]);
+    CHECK(TextFile::load(-1, buffer) != 0);
+}
+}
+
+int main()
+{
+    testGapBuffer();
+    testUndoHistory();
+    testUndoLimit();
+    testUndoSpill();
+    testLineIndex();
+    testTextMatch();
+    testTextFile();
+    if (failures == 0) {
+        std::printf("core_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,158 @@
+// Qt の文書を扱う編集処理（DocumentRange・ColumnBlock・DocumentUndo と構文ハイライト）のホスト上のテスト
+// offscreen QPA で動かす。失敗した検査を表示し、1つでもあれば 1 を返す
+#include "../src/ColumnBlock.h"
+#include "../src/DocumentRange.h"
+#include "../src/DocumentUndo.h"
+#include "../src/SyntaxHighlighter.h"
+#include <QDeadlineTimer>
+#include <QGuiApplication>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTextLayout>
+#include <cstdio>
+
+namespace {
+int failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failures; \
+        } \
+    } while (0)
+
+// 段落区切りは U+2029 で比べる（DocumentRange::text と同じ形）
+QString contents(QTextDocument &document)
+{
+    return DocumentRange::text(&document, 0, document.characterCount() - 1);
+}
+
+QString moved(const QString &text, int start, int end, int target)
+{
+    const QString block = text.mid(start, end - start);
+    if (target < start) {
+        return text.left(target) + block + text.mid(target, start - target) + text.mid(end);
+    }
+    return text.left(start) + text.mid(end, target - end) + block + text.mid(target);
+}
+
+// 行ごとに違う内容にして、ずれた位置から読むと比較で分かるようにする
+QString numberedLines(int count)
+{
+    QString text;
+    for (int i = 0; i < count; ++i) {
+        text += QString("line %1 \U0001F600\n").arg(i);
+    }
+    return text;
+}
+
+void testMoveAcrossChunks(int chunkCharacters, int lineCount)
+{
+    QTextDocument document;
+    document.setPlainText(numberedLines(lineCount));
+    const QString original = contents(document);
+    const int length = original.size();
+    // 範囲は複数チャンクにまたがり、境界はサロゲートペアの途中にならない位置にする
+    const int start = original.indexOf(QString("line %1 ").arg(lineCount / 4));
+    const int end = original.indexOf(QString("line %1 ").arg(lineCount * 3 / 4));
+    CHECK(start > 0 && end - start > chunkCharacters);
+
+    // 前へ
+    const int before = original.indexOf(QString("line %1 ").arg(lineCount / 8));
+    DocumentRange::move(&document, start, end, before, chunkCharacters);
+    CHECK(contents(document) == moved(original, start, end, before));
+    CHECK(document.characterCount() - 1 == length);
+
+    // 後ろへ
+    document.setPlainText(numberedLines(lineCount));
+    const int after = original.indexOf(QString("line %1 ").arg(lineCount * 7 / 8));
+    DocumentRange::move(&document, start, end, after, chunkCharacters);
+    CHECK(contents(document) == moved(original, start, end, after));
+}
+
+void testChunkEndKeepsSurrogatePairs()
+{
+    QTextDocument document;
+    document.setPlainText(QString("ab\U0001F600cd"));
+    // 上限がペアの途中なら手前で切る
+    CHECK(DocumentRange::chunkEnd(&document, 0, 6, 3) == 2);
+    CHECK(DocumentRange::chunkEnd(&document, 0, 6, 4) == 4);
+}
+
+void testPasteColumns()
+{
+    QTextDocument document;
+    document.setPlainText("abcd\nefgh\nij");
+    // 段落区切り（U+2029）でも '\n' と同じく1行ずつ貼る。短い行は空白で埋める
+    ColumnBlock::paste(&document, 0, 2, u"X\u2029Y\nZ", 8);
+    CHECK(document.toPlainText() == "abXcd\nefYgh\nijZ");
+    ColumnBlock::paste(&document, 2, 4, u"1\u20292", 8);
+    CHECK(document.toPlainText() == "abXcd\nefYgh\nijZ 1\n    2");
+}
+
+// 読み込んだ .cpp を構文ハイライトしても（書式だけの変更では）変更ありにならない
+void testHighlightKeepsUnmodified()
+{
+    QTextDocument document;
+    SyntaxHighlighter *highlighter = new SyntaxHighlighter(&document);
+    highlighter->attach(&document);
+    DocumentUndo *history = new DocumentUndo(&document);
+
+    // MainWindow がファイルを開くときと同じ手順
+    QString text;
+    for (int i = 0; i < 5000; ++i) {
+        text += QString("int f%1() { return %1; } /* comment\n continued */ // line\n").arg(i);
+    }
+    highlighter->setLanguage(SyntaxHighlighter::languageForFile("example.cpp"));
+    history->suspend();
+    document.setPlainText(text);
+    history->reset();
+    document.setModified(false);
+
+    // アイドル時の処理がすべて終わるまで回す
+    const QDeadlineTimer deadline(30000);
+    while (highlighter->highlightedBlockCount() < document.blockCount() && !deadline.hasExpired()) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+    }
+    QCoreApplication::processEvents();
+    CHECK(highlighter->highlightedBlockCount() == document.blockCount());
+    CHECK(!document.isModified());
+
+    // 本文を変えれば変更あり、保存後の言語の切り替えでは変わらない
+    QTextCursor cursor(&document);
+    cursor.insertText("x");
+    CHECK(document.isModified());
+    history->markClean(history->checkpoint());
+    document.setModified(false);
+    highlighter->setLanguage(SyntaxHighlighter::Python);
+    // まだ確定していない末尾のブロックにも C++ の注釈の書式は残らない
+    const QTextBlock last = document.lastBlock().previous();
+    for (const QTextLayout::FormatRange &range : last.layout()->formats()) {
+        CHECK(!range.format.fontItalic());
+    }
+    while (highlighter->highlightedBlockCount() < document.blockCount() && !deadline.hasExpired()) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+    }
+    CHECK(!document.isModified());
+}
+}
+
+int main(int argc, char **argv)
+{
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+    QGuiApplication app(argc, argv);
+
+    testChunkEndKeepsSurrogatePairs();
+    testPasteColumns();
+    testHighlightKeepsUnmodified();
+    // 小さなチャンクで境界の処理を細かく確かめる
+    testMoveAcrossChunks(7, 400);
+    // 既定のチャンク（ChunkCharacters）より大きなブロック
+    testMoveAcrossChunks(DocumentRange::ChunkCharacters, 240000);
+    if (failures == 0) {
+        std::printf("document_test: all checks passed\n");
+    }
+    return failures == 0 ? 0 : 1;
+}